@@ -0,0 +1,121 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Plain thread_local int: constant-initialized, so reading it never
+// allocates (it is read from inside malloc)
+static thread_local int t_scope = AllocCounter::Other;
+static std::atomic<quint64> s_allocations[AllocCounter::ScopeCount];
+static std::atomic<quint64> s_bytes[AllocCounter::ScopeCount];
+
+static void count(std::size_t size)
+{
+    s_allocations[t_scope].fetch_add(1, std::memory_order_relaxed);
+    s_bytes[t_scope].fetch_add(size, std::memory_order_relaxed);
+}
+
+AllocCounter::Guard::Guard(Scope scope)
+    : m_previous(t_scope)
+{
+    t_scope = scope;
+}
+
+AllocCounter::Guard::~Guard()
+{
+    t_scope = m_previous;
+}
+
+AllocCounter::Counts AllocCounter::counts(Scope scope)
+{
+    Counts c;
+    c.allocations = s_allocations[scope].load(std::memory_order_relaxed);
+    c.bytes = s_bytes[scope].load(std::memory_order_relaxed);
+    return c;
+}
+
+void AllocCounter::reset()
+{
+    for (int i = 0; i < ScopeCount; ++i) {
+        s_allocations[i].store(0, std::memory_order_relaxed);
+        s_bytes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char *AllocCounter::name(Scope scope)
+{
+    switch (scope) {
+    case Relay: return "relay";
+    case Parse: return "parse";
+    case Log: return "log";
+    default: return "other";
+    }
+}
+
+#if defined(__GLIBC__)
+
+// glibc's own entry points: malloc() below forwards to them, and operator
+// new uses them directly so an allocation is not counted twice
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+
+void *malloc(std::size_t size) noexcept
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size) noexcept
+{
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept
+{
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+}
+
+static void *rawAlloc(std::size_t size) { return __libc_malloc(size); }
+
+#else
+
+static void *rawAlloc(std::size_t size) { return std::malloc(size); }
+
+#endif
+
+// Over-aligned new/delete are left to the library; nothing here uses them
+void *operator new(std::size_t size)
+{
+    count(size);
+    if (void *p = rawAlloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    count(size);
+    return rawAlloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
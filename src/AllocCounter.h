@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * @brief Opt-in allocation accounting for the proxy's hot paths
+ *
+ * Only in builds with PAQET_ALLOC_COUNTING (CMake option of the same name,
+ * always on for test_relay_allocations): AllocCounter.cpp then replaces the
+ * global operator new/delete and, with glibc, interposes malloc, calloc and
+ * realloc, so QByteArray and friends are seen too. Every allocation of the
+ * process counts against the scope its thread is in at that moment (Other
+ * outside any Guard); the counts are totals over all threads.
+ *
+ * Code marks a hot path with PAQET_ALLOC_SCOPE(Relay), which compiles to
+ * nothing in normal builds.
+ */
+class AllocCounter
+{
+public:
+    enum Scope {
+        Other,
+        Relay,    // moving tunnel and body bytes
+        Parse,    // request heads and SOCKS requests
+        Log,      // building and queueing log lines
+        ScopeCount
+    };
+
+    struct Counts {
+        quint64 allocations = 0;
+        quint64 bytes = 0;
+    };
+
+    /**
+     * @brief Attributes the calling thread's allocations to a scope for its
+     * lifetime; nests
+     */
+    class Guard
+    {
+    public:
+        explicit Guard(Scope scope);
+        ~Guard();
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        int m_previous;
+    };
+
+    /** All threads, since the start or the last reset() */
+    static Counts counts(Scope scope);
+    static void reset();
+    static const char *name(Scope scope);
+};
+
+#ifdef PAQET_ALLOC_COUNTING
+#define PAQET_ALLOC_SCOPE(scope) const AllocCounter::Guard allocScope_(AllocCounter::scope)
+#else
+#define PAQET_ALLOC_SCOPE(scope) do {} while (false)
+#endif
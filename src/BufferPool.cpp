@@ -0,0 +1,151 @@
+#include "BufferPool.h"
+
+BufferPool::Buffer &BufferPool::Buffer::operator=(Buffer &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_pool = other.m_pool;
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_pool = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::reset()
+{
+    if (m_data)
+        m_pool->release(m_data, m_size);
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+BufferPool::BufferPool(Counters *counters)
+    : m_counters(counters)
+{
+    // The idle lists never grow past kMaxIdle, so releasing never allocates
+    m_small.reserve(kMaxIdle);
+    m_large.reserve(kMaxIdle);
+}
+
+BufferPool::~BufferPool()
+{
+    for (std::vector<char *> *list : {&m_small, &m_large}) {
+        const qint64 size = list == &m_small ? kSmallSize : kLargeSize;
+        add(m_counters->idleBytes, -size * qint64(list->size()));
+        for (char *data : *list)
+            delete[] data;
+    }
+}
+
+BufferPool::Buffer BufferPool::acquire(qint64 size)
+{
+    const qint64 slabSize = size <= kSmallSize ? kSmallSize : kLargeSize;
+    std::vector<char *> &list = freeList(slabSize);
+    Buffer buffer;
+    buffer.m_pool = this;
+    buffer.m_size = slabSize;
+    if (list.empty()) {
+        buffer.m_data = new char[slabSize];
+        add(m_counters->misses, 1);
+    } else {
+        buffer.m_data = list.back();
+        list.pop_back();
+        add(m_counters->idleBytes, -slabSize);
+    }
+    add(m_counters->acquired, 1);
+    add(m_counters->inUseBytes, slabSize);
+    const qint64 inUse = m_counters->inUseBytes.load(std::memory_order_relaxed);
+    if (inUse > m_counters->highWaterBytes.load(std::memory_order_relaxed))
+        m_counters->highWaterBytes.store(inUse, std::memory_order_relaxed);
+    return buffer;
+}
+
+void BufferPool::release(char *data, qint64 size)
+{
+    add(m_counters->inUseBytes, -size);
+    std::vector<char *> &list = freeList(size);
+    if (int(list.size()) >= kMaxIdle) {
+        delete[] data;
+        return;
+    }
+    list.push_back(data);
+    add(m_counters->idleBytes, size);
+}
+
+BufferPool::Stats BufferPool::stats(const Counters *counters, int count)
+{
+    Stats s;
+    for (int i = 0; i < count; ++i) {
+        const Counters &c = counters[i];
+        s.acquired += c.acquired.load(std::memory_order_relaxed);
+        s.misses += c.misses.load(std::memory_order_relaxed);
+        s.inUseBytes += c.inUseBytes.load(std::memory_order_relaxed);
+        s.highWaterBytes += c.highWaterBytes.load(std::memory_order_relaxed);
+        s.idleBytes += c.idleBytes.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+char *BufferChain::reserve(qint64 *room)
+{
+    if (m_count == 0 || at(m_count - 1).end == at(m_count - 1).buffer.size()) {
+        if (m_count == kMaxSlabs) {
+            *room = 0;
+            return nullptr;
+        }
+        Slab &slab = at(m_count++);
+        slab.buffer = m_pool->acquire(m_slabSize);
+        slab.begin = 0;
+        slab.end = 0;
+    }
+    Slab &tail = at(m_count - 1);
+    *room = tail.buffer.size() - tail.end;
+    return tail.buffer.data() + tail.end;
+}
+
+void BufferChain::commit(qint64 bytes)
+{
+    Slab &tail = at(m_count - 1);
+    tail.end += bytes;
+    m_size += bytes;
+    if (tail.end == 0) {
+        tail.buffer.reset();
+        --m_count;
+    }
+}
+
+const char *BufferChain::front(qint64 *length) const
+{
+    if (m_size == 0) {
+        *length = 0;
+        return nullptr;
+    }
+    const Slab &head = at(0);
+    *length = head.end - head.begin;
+    return head.buffer.data() + head.begin;
+}
+
+void BufferChain::consume(qint64 bytes)
+{
+    Slab &head = at(0);
+    head.begin += bytes;
+    m_size -= bytes;
+    if (head.begin == head.end) {
+        head.buffer.reset();
+        m_head = (m_head + 1) % kMaxSlabs;
+        --m_count;
+    }
+}
+
+void BufferChain::clear()
+{
+    for (int i = 0; i < m_count; ++i)
+        at(i).buffer.reset();
+    m_head = 0;
+    m_count = 0;
+    m_size = 0;
+}
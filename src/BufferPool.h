@@ -0,0 +1,155 @@
+#pragma once
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Per-worker free lists of fixed-size I/O slabs for the relay
+ *
+ * Relayed bytes are read into and written from slabs instead of a fresh
+ * QByteArray per read, so a busy worker stops spending its time in
+ * malloc/free. There are two slab sizes: kSmallSize for the chains of
+ * EpollRelay tunnels, kLargeSize for one pass of the Qt relay. A slab is
+ * handed out as a move-only Buffer and goes back to its free list when the
+ * Buffer is dropped; up to kMaxIdle slabs per size stay cached, the rest
+ * are freed.
+ *
+ * Lives in (and must be used from) one worker thread, and must outlive its
+ * Buffers. Its Counters are written by that thread only.
+ */
+class BufferPool
+{
+public:
+    static constexpr qint64 kSmallSize = 16 * 1024;
+    static constexpr qint64 kLargeSize = 64 * 1024;
+    static constexpr int kMaxIdle = 64;   // cached slabs per size
+
+    /**
+     * One pool's counters, read from any thread. Single writer: updates are
+     * a relaxed load and store (as TrafficCounters), padded to a cache line.
+     */
+    struct alignas(64) Counters {
+        std::atomic<qint64> acquired{0};        // slabs handed out
+        std::atomic<qint64> misses{0};          // ... that had to be allocated
+        std::atomic<qint64> inUseBytes{0};      // handed out and not returned yet
+        std::atomic<qint64> highWaterBytes{0};  // most bytes in use at once
+        std::atomic<qint64> idleBytes{0};       // cached in free lists
+    };
+
+    struct Stats {
+        qint64 acquired = 0;
+        qint64 misses = 0;
+        qint64 inUseBytes = 0;
+        qint64 highWaterBytes = 0;
+        qint64 idleBytes = 0;
+    };
+
+    /**
+     * @brief One slab on loan from a pool; empty when default-constructed
+     * or moved from
+     */
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept { *this = std::move(other); }
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+        ~Buffer() { reset(); }
+
+        char *data() const { return m_data; }
+        qint64 size() const { return m_size; }
+        bool isNull() const { return m_data == nullptr; }
+
+        /** Give the slab back to the pool */
+        void reset();
+
+    private:
+        friend class BufferPool;
+        BufferPool *m_pool = nullptr;
+        char *m_data = nullptr;
+        qint64 m_size = 0;
+    };
+
+    explicit BufferPool(Counters *counters);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /** A slab of kSmallSize, or of kLargeSize when @p size needs more */
+    Buffer acquire(qint64 size);
+
+    /** Totals over @p count pools' counters (high-water marks are summed) */
+    static Stats stats(const Counters *counters, int count);
+
+private:
+    static void add(std::atomic<qint64> &counter, qint64 delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    void release(char *data, qint64 size);
+    std::vector<char *> &freeList(qint64 size) { return size == kSmallSize ? m_small : m_large; }
+
+    Counters *m_counters;
+    std::vector<char *> m_small;
+    std::vector<char *> m_large;
+};
+
+/**
+ * @brief FIFO of pooled slabs for one relay direction
+ *
+ * Bytes are read in at the tail and sent from the head, so a send that
+ * takes only part of a slab leaves the rest where it is. A slab goes back
+ * to the pool as soon as it is drained: an idle direction holds no memory.
+ * The slabs sit in a fixed ring of kMaxSlabs, so the chain itself never
+ * allocates; the caller bounds what it buffers accordingly.
+ */
+class BufferChain
+{
+public:
+    static constexpr int kMaxSlabs = 8;
+
+    BufferChain() = default;
+    BufferChain(BufferPool *pool, qint64 slabSize) : m_pool(pool), m_slabSize(slabSize) {}
+
+    qint64 size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    /**
+     * @brief Free space at the tail to read into, taking a slab from the
+     * pool when the tail is full; follow with commit()
+     * @return nullptr (and 0 room) when the ring is full
+     */
+    char *reserve(qint64 *room);
+    /** @p bytes were stored at reserve(); 0 returns an unused slab */
+    void commit(qint64 bytes);
+
+    /** The first contiguous unsent bytes (nullptr when empty) */
+    const char *front(qint64 *length) const;
+    /** @p bytes from front() were sent */
+    void consume(qint64 bytes);
+
+    void clear();
+
+private:
+    struct Slab {
+        BufferPool::Buffer buffer;
+        qint64 begin = 0;   // unsent bytes are [begin, end)
+        qint64 end = 0;
+    };
+
+    Slab &at(int i) { return m_slabs[(m_head + i) % kMaxSlabs]; }
+    const Slab &at(int i) const { return m_slabs[(m_head + i) % kMaxSlabs]; }
+
+    BufferPool *m_pool = nullptr;
+    qint64 m_slabSize = BufferPool::kSmallSize;
+    std::array<Slab, kMaxSlabs> m_slabs;
+    int m_head = 0;    // ring index of the first slab
+    int m_count = 0;   // slabs in use
+    qint64 m_size = 0;
+};
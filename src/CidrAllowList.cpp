@@ -0,0 +1,107 @@
+#include "CidrAllowList.h"
+#include <QtEndian>
+#include <algorithm>
+
+template <typename T>
+void CidrAllowList::merge(std::vector<Range<T>> &ranges) {
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Range<T> &a, const Range<T> &b) { return a.first < b.first; });
+    std::vector<Range<T>> merged;
+    for (const Range<T> &r : ranges) {
+        // Overlapping or nested; adjacent ranges stay separate, which only
+        // costs a slot
+        if (!merged.empty() && r.first <= merged.back().last) {
+            if (merged.back().last < r.last)
+                merged.back().last = r.last;
+            continue;
+        }
+        merged.push_back(r);
+    }
+    ranges.swap(merged);
+}
+
+std::shared_ptr<const CidrAllowList> CidrAllowList::compile(const QStringList &cidrs, QStringList *errors) {
+    std::shared_ptr<CidrAllowList> list(new CidrAllowList());
+    for (const QString &raw : cidrs) {
+        const QString entry = raw.trimmed();
+        if (entry.isEmpty() || entry.startsWith(QLatin1Char('#')))
+            continue;
+        QPair<QHostAddress, int> subnet;
+        if (entry.contains(QLatin1Char('/'))) {
+            subnet = QHostAddress::parseSubnet(entry);
+        } else {
+            const QHostAddress host(entry);
+            subnet = {host, host.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32};
+        }
+        if (subnet.first.isNull()) {
+            if (errors)
+                errors->append(QStringLiteral("invalid network \"%1\"").arg(entry));
+            continue;
+        }
+        const int prefix = subnet.second;
+        if (subnet.first.protocol() == QAbstractSocket::IPv4Protocol) {
+            const quint32 mask = prefix == 0 ? 0 : ~quint32(0) << (32 - prefix);
+            const quint32 first = subnet.first.toIPv4Address() & mask;
+            list->m_v4.push_back({first, first | ~mask});
+        } else {
+            const Q_IPV6ADDR raw6 = subnet.first.toIPv6Address();
+            const quint64 high = qFromBigEndian<quint64>(raw6.c);
+            const quint64 low = qFromBigEndian<quint64>(raw6.c + 8);
+            const quint64 highMask = prefix == 0 ? 0 : prefix >= 64 ? ~quint64(0) : ~quint64(0) << (64 - prefix);
+            const quint64 lowMask = prefix <= 64 ? 0 : prefix == 128 ? ~quint64(0) : ~quint64(0) << (128 - prefix);
+            const Address6 first{high & highMask, low & lowMask};
+            const Address6 last{first.high | ~highMask, first.low | ~lowMask};
+            list->m_v6.push_back({first, last});
+        }
+    }
+    merge(list->m_v4);
+    merge(list->m_v6);
+    return list;
+}
+
+const QStringList &CidrAllowList::privateNetworks() {
+    static const QStringList networks{
+        QStringLiteral("127.0.0.0/8"),
+        QStringLiteral("10.0.0.0/8"),
+        QStringLiteral("172.16.0.0/12"),
+        QStringLiteral("192.168.0.0/16"),
+        QStringLiteral("169.254.0.0/16"),
+        QStringLiteral("100.64.0.0/10"),   // carrier-grade NAT, also used by mesh VPNs
+        QStringLiteral("::1/128"),
+        QStringLiteral("fc00::/7"),
+        QStringLiteral("fe80::/10"),
+    };
+    return networks;
+}
+
+bool CidrAllowList::allows(const quint8 *bytes, int length) const {
+    if (length == 16) {
+        static const quint8 kMappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        if (std::equal(bytes, bytes + 12, kMappedPrefix))
+            return allows(bytes + 12, 4);
+        const Address6 address{qFromBigEndian<quint64>(bytes), qFromBigEndian<quint64>(bytes + 8)};
+        // Last range starting at or below the address
+        auto it = std::upper_bound(m_v6.begin(), m_v6.end(), address,
+                                   [](const Address6 &a, const Range<Address6> &r) { return a < r.first; });
+        return it != m_v6.begin() && address <= std::prev(it)->last;
+    }
+    if (length != 4)
+        return false;
+    const quint32 address = qFromBigEndian<quint32>(bytes);
+    auto it = std::upper_bound(m_v4.begin(), m_v4.end(), address,
+                               [](quint32 a, const Range<quint32> &r) { return a < r.first; });
+    return it != m_v4.begin() && address <= std::prev(it)->last;
+}
+
+bool CidrAllowList::allows(const QHostAddress &address) const {
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        quint8 bytes[4];
+        qToBigEndian(address.toIPv4Address(), bytes);
+        return allows(bytes, 4);
+    }
+    if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+        const Q_IPV6ADDR raw = address.toIPv6Address();
+        return allows(raw.c, 16);
+    }
+    return false;
+}
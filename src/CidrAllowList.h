@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QHostAddress>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Compiled set of client networks allowed to use the proxy
+ *
+ * CIDRs are merged into sorted, disjoint address ranges per family, so a
+ * check is one binary search over raw address bytes - cheap enough to run
+ * on every accepted descriptor before anything is allocated for it.
+ * IPv4-mapped IPv6 peers are checked against the IPv4 ranges.
+ *
+ * Immutable once compiled; safe to share between worker threads.
+ */
+class CidrAllowList
+{
+public:
+    /**
+     * @brief Parse "address/prefix" entries (a bare address is a single
+     * host); bad entries are skipped and described in @p errors
+     */
+    static std::shared_ptr<const CidrAllowList> compile(const QStringList &cidrs, QStringList *errors = nullptr);
+
+    /** Loopback plus the private, link-local and unique-local ranges */
+    static const QStringList &privateNetworks();
+
+    /**
+     * @param bytes Address in network byte order
+     * @param length 4 (IPv4) or 16 (IPv6)
+     */
+    bool allows(const quint8 *bytes, int length) const;
+    bool allows(const QHostAddress &address) const;
+
+    int rangeCount() const { return static_cast<int>(m_v4.size() + m_v6.size()); }
+
+private:
+    CidrAllowList() = default;
+
+    struct Address6 {
+        quint64 high = 0;
+        quint64 low = 0;
+        bool operator<(const Address6 &o) const { return high < o.high || (high == o.high && low < o.low); }
+        bool operator<=(const Address6 &o) const { return !(o < *this); }
+    };
+    template <typename T>
+    struct Range {
+        T first;
+        T last;
+    };
+    template <typename T>
+    static void merge(std::vector<Range<T>> &ranges);
+
+    std::vector<Range<quint32>> m_v4;
+    std::vector<Range<Address6>> m_v6;
+};
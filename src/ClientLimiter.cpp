@@ -0,0 +1,138 @@
+#include "ClientLimiter.h"
+#include <algorithm>
+
+static constexpr qint64 kMinBurst = 64 * 1024;   // one relay chunk
+static constexpr int kMinRefillDelayMs = 10;
+static constexpr int kMaxRefillDelayMs = 1000;
+
+class ClientLimiter::Client
+{
+public:
+    QHostAddress address;
+    int connections = 0;        // guarded by ClientLimiter::m_lock
+    qint64 totalConnections = 0;
+    qint64 refused = 0;
+    std::atomic<qint64> bytes[2]{};
+    std::mutex lock;            // guards the buckets
+    qint64 tokens[2] = {0, 0};
+    qint64 refilledAt[2] = {0, 0};
+};
+
+ClientLimiter::ClientLimiter(const Limits &limits)
+    : m_limits(limits)
+    , m_burst(qMax(kMinBurst, limits.bytesPerSec))
+{
+    m_clock.start();
+}
+
+ClientLimiter::~ClientLimiter() = default;
+
+std::shared_ptr<ClientLimiter::Client> ClientLimiter::enter(const QHostAddress &address, bool *overLimit) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    std::shared_ptr<Client> &client = m_clients[address];
+    if (!client) {
+        client = std::make_shared<Client>();
+        client->address = address;
+        const qint64 now = m_clock.elapsed();
+        for (int dir = 0; dir < 2; ++dir) {
+            client->tokens[dir] = m_burst;
+            client->refilledAt[dir] = now;
+        }
+    } else if (client->connections == 0) {
+        --m_idleClients;
+    }
+    ++client->connections;
+    ++client->totalConnections;
+    const bool refused = m_limits.maxConnections > 0 && client->connections > m_limits.maxConnections;
+    if (refused) {
+        ++client->refused;
+        m_refused.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (overLimit)
+        *overLimit = refused;
+    return client;
+}
+
+void ClientLimiter::leave(const std::shared_ptr<Client> &client) {
+    if (!client)
+        return;
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (--client->connections > 0)
+        return;
+    if (m_idleClients < kMaxIdleClients) {
+        ++m_idleClients;
+        return;
+    }
+    // Table full of idle clients: this one's statistics (and bucket) go
+    m_clients.remove(client->address);
+}
+
+void ClientLimiter::refill(Client &client, int dir, qint64 now) {
+    const qint64 elapsed = now - client.refilledAt[dir];
+    if (elapsed <= 0)
+        return;
+    const qint64 added = elapsed * m_limits.bytesPerSec / 1000;
+    if (added <= 0)
+        return;  // keep the fraction for the next call
+    client.tokens[dir] = qMin(m_burst, client.tokens[dir] + added);
+    client.refilledAt[dir] = now;
+}
+
+qint64 ClientLimiter::allowance(Client &client, int dir, qint64 want) {
+    if (m_limits.bytesPerSec <= 0)
+        return want;
+    std::lock_guard<std::mutex> guard(client.lock);
+    refill(client, dir, m_clock.elapsed());
+    return qBound<qint64>(0, client.tokens[dir], want);
+}
+
+void ClientLimiter::consume(Client &client, int dir, qint64 bytes) {
+    if (bytes <= 0)
+        return;
+    client.bytes[dir].fetch_add(bytes, std::memory_order_relaxed);
+    if (m_limits.bytesPerSec <= 0)
+        return;
+    std::lock_guard<std::mutex> guard(client.lock);
+    client.tokens[dir] -= bytes;
+}
+
+int ClientLimiter::refillDelayMs(Client &client, int dir) {
+    if (m_limits.bytesPerSec <= 0)
+        return 0;
+    std::lock_guard<std::mutex> guard(client.lock);
+    refill(client, dir, m_clock.elapsed());
+    // Wait for a chunk's worth, so a throttled flow moves in reasonably
+    // sized steps rather than waking up for a few bytes
+    const qint64 need = kMinBurst - client.tokens[dir];
+    if (need <= 0)
+        return kMinRefillDelayMs;
+    const qint64 ms = need * 1000 / m_limits.bytesPerSec + 1;
+    return static_cast<int>(qBound<qint64>(kMinRefillDelayMs, ms, kMaxRefillDelayMs));
+}
+
+int ClientLimiter::clientCount() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_clients.size() - m_idleClients;
+}
+
+QList<ClientLimiter::Stats> ClientLimiter::stats() const {
+    QList<Stats> result;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        result.reserve(m_clients.size());
+        for (const std::shared_ptr<Client> &client : m_clients) {
+            Stats st;
+            st.address = client->address;
+            st.connections = client->connections;
+            st.totalConnections = client->totalConnections;
+            st.refused = client->refused;
+            st.bytesUp = client->bytes[0].load(std::memory_order_relaxed);
+            st.bytesDown = client->bytes[1].load(std::memory_order_relaxed);
+            result.append(st);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const Stats &a, const Stats &b) {
+        return a.bytesUp + a.bytesDown > b.bytesUp + b.bytesDown;
+    });
+    return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Per-source-IP bookkeeping for clients sharing the proxy (LAN
+ * sharing): connection and byte statistics, and optionally a token bucket
+ * per direction and a cap on concurrent connections
+ *
+ * Shared by all proxy workers. The client table is guarded by one mutex
+ * that is only taken when a connection opens or closes; each client's
+ * buckets have their own small lock, so relaying connections of different
+ * clients never contend.
+ *
+ * The relay asks allowance() before reading from a source and reports what
+ * it actually moved with consume(); a few concurrent readers may overdraw
+ * a bucket slightly, which the next refill pays back. Nothing is dropped:
+ * a direction without tokens stops reading and retries after
+ * refillDelayMs(), so TCP flow control pushes back on the sender.
+ *
+ * Clients stay in the table after their last connection, for the
+ * statistics, until the table outgrows kMaxIdleClients.
+ */
+class ClientLimiter
+{
+public:
+    struct Limits {
+        qint64 bytesPerSec = 0;   // per direction, 0 = unlimited
+        int maxConnections = 0;   // 0 = unlimited
+    };
+
+    class Client;
+
+    struct Stats {
+        QHostAddress address;
+        int connections = 0;         // open now
+        qint64 totalConnections = 0;
+        qint64 refused = 0;          // over maxConnections
+        qint64 bytesUp = 0;          // client -> upstream
+        qint64 bytesDown = 0;        // upstream -> client
+    };
+
+    explicit ClientLimiter(const Limits &limits);
+    ~ClientLimiter();
+
+    const Limits &limits() const { return m_limits; }
+    bool isRateLimited() const { return m_limits.bytesPerSec > 0; }
+    bool isLimited() const { return m_limits.bytesPerSec > 0 || m_limits.maxConnections > 0; }
+
+    /**
+     * @brief Register a connection from @p address; pair with leave()
+     * @param overLimit Set when the client already had maxConnections open
+     * (the connection is registered anyway and should be refused)
+     */
+    std::shared_ptr<Client> enter(const QHostAddress &address, bool *overLimit);
+    void leave(const std::shared_ptr<Client> &client);
+
+    /** Bytes @p client may move in direction @p dir (0 or 1) now, at most @p want */
+    qint64 allowance(Client &client, int dir, qint64 want);
+    /** Count @p bytes moved by @p client and take them from its bucket */
+    void consume(Client &client, int dir, qint64 bytes);
+
+    /** How long until @p dir of @p client has a useful amount of tokens again */
+    int refillDelayMs(Client &client, int dir);
+
+    /** Clients with at least one connection open */
+    int clientCount() const;
+
+    /** Every known client, busiest first */
+    QList<Stats> stats() const;
+
+    static constexpr int kMaxIdleClients = 1024;
+
+    /** Connections refused for the per-client connection cap */
+    qint64 refusedConnections() const { return m_refused.load(std::memory_order_relaxed); }
+
+private:
+    void refill(Client &client, int dir, qint64 now);
+
+    Limits m_limits;
+    qint64 m_burst = 0;
+    QElapsedTimer m_clock;
+    mutable std::mutex m_lock;
+    QHash<QHostAddress, std::shared_ptr<Client>> m_clients;
+    int m_idleClients = 0;   // entries without an open connection
+    std::atomic<qint64> m_refused{0};
+};
@@ -0,0 +1,65 @@
+#include "ConnectGate.h"
+#include <QMetaObject>
+#include <QObject>
+#include <algorithm>
+
+ConnectGate::ConnectGate(int limit)
+    : m_limit(qMax(0, limit))
+{
+}
+
+bool ConnectGate::tryEnter() {
+    std::lock_guard<std::mutex> guard(m_lock);
+    // Never jump the queue: a free slot goes to the first waiter in leave()
+    if (m_limit > 0 && (m_active >= m_limit || !m_waiters.empty()))
+        return false;
+    ++m_active;
+    return true;
+}
+
+bool ConnectGate::enterOrWait(QObject *context, Admitted admitted, quint64 *ticket) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_limit == 0 || (m_active < m_limit && m_waiters.empty())) {
+        ++m_active;
+        return true;
+    }
+    *ticket = m_nextTicket++;
+    m_waiters.push_back({*ticket, context, std::move(admitted)});
+    m_queuedTotal.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool ConnectGate::cancel(quint64 ticket) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = std::find_if(m_waiters.begin(), m_waiters.end(),
+                           [ticket](const Waiter &w) { return w.ticket == ticket; });
+    if (it == m_waiters.end())
+        return false;
+    m_waiters.erase(it);
+    return true;
+}
+
+void ConnectGate::leave() {
+    Waiter next;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (m_waiters.empty()) {
+            --m_active;
+            return;
+        }
+        next = std::move(m_waiters.front());
+        m_waiters.pop_front();
+    }
+    // The slot stays taken and now belongs to the waiter
+    QMetaObject::invokeMethod(next.context, std::move(next.admitted), Qt::QueuedConnection);
+}
+
+int ConnectGate::active() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_active;
+}
+
+int ConnectGate::waiting() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return static_cast<int>(m_waiters.size());
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+class QObject;
+
+/**
+ * @brief Proxy-wide cap on concurrent tunnels through paqet, with a FIFO
+ * of connections waiting for a slot
+ *
+ * Shared by all proxy workers. A burst of CONNECTs beyond the cap does not
+ * open that many streams at once: the extra ones queue and are admitted in
+ * order as tunnels close. Slots are handed straight from leave() to the
+ * next waiter, whose callback is posted to its own thread. Waiting is
+ * bounded by the caller (a connection timeout that calls cancel()).
+ */
+class ConnectGate
+{
+public:
+    using Admitted = std::function<void()>;
+
+    /** @param limit Concurrent slots, 0 = unlimited */
+    explicit ConnectGate(int limit);
+
+    int limit() const { return m_limit; }
+
+    /** Take a slot if one is free */
+    bool tryEnter();
+
+    /**
+     * @brief Take a slot if one is free, otherwise queue for one, in a
+     * single step so a leave() in between cannot be missed
+     * @param admitted Runs on @p context's thread once a queued caller holds
+     * a slot (it must leave() it, also when its connection is gone)
+     * @param ticket Set for cancel() when queued
+     * @return true if the slot was taken right away (@p admitted is dropped)
+     */
+    bool enterOrWait(QObject *context, Admitted admitted, quint64 *ticket);
+
+    /**
+     * @brief Leave the queue
+     * @return false if the slot was already handed over: the admitted
+     * callback is on its way and owns it
+     */
+    bool cancel(quint64 ticket);
+
+    /** Give a slot back (to the next waiter, if any) */
+    void leave();
+
+    int active() const;
+    int waiting() const;
+    qint64 queuedTotal() const { return m_queuedTotal.load(std::memory_order_relaxed); }
+
+private:
+    struct Waiter {
+        quint64 ticket;
+        QObject *context;
+        Admitted admitted;
+    };
+
+    const int m_limit;
+    mutable std::mutex m_lock;
+    int m_active = 0;
+    std::deque<Waiter> m_waiters;
+    quint64 m_nextTicket = 1;
+    std::atomic<qint64> m_queuedTotal{0};
+};
@@ -0,0 +1,180 @@
+#include "ConnectionTableModel.h"
+#include <QDateTime>
+#include <algorithm>
+#include <functional>
+
+ConnectionTableModel::ConnectionTableModel(QObject *parent) : QAbstractTableModel(parent) {
+}
+
+int ConnectionTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int ConnectionTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ConnectionTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_rows.size())
+        return QVariant();
+    const HttpToSocksProxy::ConnectionInfo &c = m_rows.at(index.row());
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case TargetColumn: return c.target;
+        case ClientColumn: return c.client;
+        case StartedColumn: return QDateTime::fromMSecsSinceEpoch(c.startedMs).toString(QStringLiteral("HH:mm:ss"));
+        case UpColumn: return c.bytesUp;
+        case DownColumn: return c.bytesDown;
+        case StateColumn: return phaseName(c.phase);
+        default: return QVariant();
+        }
+    }
+    switch (role) {
+    case TargetRole: return c.target;
+    case ClientRole: return c.client;
+    case StartedRole: return c.startedMs;
+    case BytesUpRole: return c.bytesUp;
+    case BytesDownRole: return c.bytesDown;
+    case StateRole: return phaseName(c.phase);
+    default: return QVariant();
+    }
+}
+
+QVariant ConnectionTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (section) {
+    case TargetColumn: return tr("Target");
+    case ClientColumn: return tr("Client");
+    case StartedColumn: return tr("Started");
+    case UpColumn: return tr("Up");
+    case DownColumn: return tr("Down");
+    case StateColumn: return tr("State");
+    default: return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ConnectionTableModel::roleNames() const {
+    return {
+        { Qt::DisplayRole, "display" },
+        { TargetRole, "target" },
+        { ClientRole, "client" },
+        { StartedRole, "startedMs" },
+        { BytesUpRole, "bytesUp" },
+        { BytesDownRole, "bytesDown" },
+        { StateRole, "state" }
+    };
+}
+
+void ConnectionTableModel::setActive(bool active) {
+    if (active == m_active)
+        return;
+    m_active = active;
+    // Tracking restarts from a full snapshot, so stale rows must go either way
+    clear();
+    emit activeChanged();
+}
+
+void ConnectionTableModel::clear() {
+    if (m_rows.isEmpty())
+        return;
+    beginResetModel();
+    m_rows.clear();
+    m_rowOf.clear();
+    endResetModel();
+    emit countChanged();
+}
+
+void ConnectionTableModel::applyBatch(const HttpToSocksProxy::ConnectionBatch &batch) {
+    if (!m_active)
+        return;
+    const int before = m_rows.size();
+    removeRows(batch.removed);
+
+    int firstChanged = m_rows.size();
+    int lastChanged = -1;
+    auto update = [&](const HttpToSocksProxy::ConnectionInfo &info) {
+        const auto it = m_rowOf.constFind(info.id);
+        if (it == m_rowOf.constEnd())
+            return false;
+        HttpToSocksProxy::ConnectionInfo &row = m_rows[it.value()];
+        const QString client = row.client;
+        row = info;
+        if (row.client.isEmpty())
+            row.client = client;
+        firstChanged = qMin(firstChanged, it.value());
+        lastChanged = qMax(lastChanged, it.value());
+        return true;
+    };
+    for (const HttpToSocksProxy::ConnectionInfo &info : batch.changed)
+        update(info);
+
+    QList<HttpToSocksProxy::ConnectionInfo> fresh;
+    fresh.reserve(batch.added.size());
+    for (const HttpToSocksProxy::ConnectionInfo &info : batch.added) {
+        // Re-announced after tracking was toggled on the worker: just refresh
+        if (!update(info))
+            fresh.append(info);
+    }
+
+    if (lastChanged >= 0) {
+        emit dataChanged(index(firstChanged, 0), index(lastChanged, ColumnCount - 1),
+                         { Qt::DisplayRole, TargetRole, BytesUpRole, BytesDownRole, StateRole });
+    }
+    if (!fresh.isEmpty()) {
+        const int first = m_rows.size();
+        beginInsertRows(QModelIndex(), first, first + fresh.size() - 1);
+        for (int i = 0; i < fresh.size(); ++i) {
+            m_rowOf.insert(fresh.at(i).id, first + i);
+            m_rows.append(fresh.at(i));
+        }
+        endInsertRows();
+    }
+    if (m_rows.size() != before)
+        emit countChanged();
+}
+
+void ConnectionTableModel::removeRows(const QList<quint64> &ids) {
+    QList<int> rows;
+    rows.reserve(ids.size());
+    for (quint64 id : ids) {
+        const auto it = m_rowOf.constFind(id);
+        if (it != m_rowOf.constEnd())
+            rows.append(it.value());
+    }
+    if (rows.isEmpty())
+        return;
+    // From the bottom up, one removal per contiguous run, so row numbers
+    // still to be removed stay valid
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    for (int i = 0; i < rows.size();) {
+        const int last = rows.at(i);
+        int first = last;
+        while (++i < rows.size() && rows.at(i) == first - 1)
+            first = rows.at(i);
+        beginRemoveRows(QModelIndex(), first, last);
+        for (int row = first; row <= last; ++row)
+            m_rowOf.remove(m_rows.at(row).id);
+        m_rows.remove(first, last - first + 1);
+        endRemoveRows();
+    }
+    reindexFrom(rows.last());
+}
+
+void ConnectionTableModel::reindexFrom(int row) {
+    for (int i = row; i < m_rows.size(); ++i)
+        m_rowOf[m_rows.at(i).id] = i;
+}
+
+QString ConnectionTableModel::phaseName(HttpToSocksProxy::ConnectionPhase phase) {
+    switch (phase) {
+    case HttpToSocksProxy::ConnectionPhase::Request: return QStringLiteral("Request");
+    case HttpToSocksProxy::ConnectionPhase::Queued: return QStringLiteral("Queued");
+    case HttpToSocksProxy::ConnectionPhase::Connecting: return QStringLiteral("Connecting");
+    case HttpToSocksProxy::ConnectionPhase::Forwarding: return QStringLiteral("Forwarding");
+    case HttpToSocksProxy::ConnectionPhase::Tunnel: return QStringLiteral("Tunnel");
+    case HttpToSocksProxy::ConnectionPhase::Splice: return QStringLiteral("Splice");
+    case HttpToSocksProxy::ConnectionPhase::Closing: return QStringLiteral("Closing");
+    }
+    return QString();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "HttpToSocksProxy.h"
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QList>
+
+/**
+ * @brief Open connections of the HTTP proxy for QML, one row each
+ *
+ * Fed with HttpToSocksProxy::connectionBatch() diffs a few times per
+ * second: each batch becomes at most one row insert, one dataChanged and a
+ * remove per contiguous run of closed rows, so a table of thousands of
+ * connections stays cheap to keep current. Rows keep their arrival order.
+ */
+class ConnectionTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+public:
+    enum Columns {
+        TargetColumn,
+        ClientColumn,
+        StartedColumn,
+        UpColumn,
+        DownColumn,
+        StateColumn,
+        ColumnCount
+    };
+
+    enum Roles {
+        TargetRole = Qt::UserRole,
+        ClientRole,
+        StartedRole,
+        BytesUpRole,
+        BytesDownRole,
+        StateRole
+    };
+
+    explicit ConnectionTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const { return m_rows.size(); }
+    bool isActive() const { return m_active; }
+    /** Whether the view wants updates; the controller turns tracking on and off with it */
+    void setActive(bool active);
+
+    void applyBatch(const HttpToSocksProxy::ConnectionBatch &batch);
+    Q_INVOKABLE void clear();
+
+    static QString phaseName(HttpToSocksProxy::ConnectionPhase phase);
+
+signals:
+    void countChanged();
+    void activeChanged();
+
+private:
+    void removeRows(const QList<quint64> &ids);
+    void reindexFrom(int row);
+
+    QList<HttpToSocksProxy::ConnectionInfo> m_rows;
+    QHash<quint64, int> m_rowOf;   // connection id -> row
+    bool m_active = false;
+};
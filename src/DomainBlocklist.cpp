@@ -0,0 +1,366 @@
+#include "DomainBlocklist.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// File layout (little-endian):
+//   header (kHeaderSize bytes), block offsets (quint32 each), front-coded
+//   entries, padding to 8, Bloom filter bits.
+// Entry: shared prefix length (1 byte), suffix length (1 byte), suffix.
+static const char kMagic[8] = {'P', 'Q', 'B', 'L', 'O', 'C', 'K', '1'};
+static constexpr int kHeaderSize = 64;
+static constexpr int kBloomBitsPerEntry = 10;
+static constexpr quint32 kBloomHashes = 7;   // ~1% false positives at 10 bits/entry
+
+static quint64 hashKey(const char *key, int length) {
+    quint64 h = 14695981039346656037ULL;   // FNV-1a, then a splitmix finalizer
+    for (int i = 0; i < length; ++i) {
+        h ^= static_cast<uchar>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/** Byte-wise order, the one build() sorts by */
+static int compareKeys(const char *a, int aLength, const char *b, int bLength) {
+    const int c = std::memcmp(a, b, static_cast<size_t>(qMin(aLength, bLength)));
+    if (c != 0)
+        return c;
+    return aLength == bLength ? 0 : (aLength < bLength ? -1 : 1);
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * @brief The domain on one list line, lower-cased in place
+ * @return Empty for comments, unsupported syntax and invalid names
+ */
+static QByteArrayView extractDomain(char *p, qsizetype n) {
+    while (n > 0 && isBlank(*p)) {
+        ++p;
+        --n;
+    }
+    while (n > 0 && isBlank(p[n - 1]))
+        --n;
+    if (n == 0 || *p == '#' || *p == '!' || *p == '[')
+        return {};
+
+    qsizetype cut = n;
+    if (n > 2 && p[0] == '|' && p[1] == '|') {
+        // Adblock: ||example.com^ (options after ^ or $ ignored)
+        p += 2;
+        n -= 2;
+        cut = n;
+        for (qsizetype i = 0; i < n; ++i) {
+            if (p[i] == '^' || p[i] == '/' || p[i] == '$' || p[i] == ':') {
+                cut = i;
+                break;
+            }
+        }
+    } else {
+        qsizetype space = 0;
+        while (space < n && !isBlank(p[space]))
+            ++space;
+        if (space < n) {
+            // hosts: only sink-hole addresses count, the name is the next token
+            const QByteArrayView ip(p, space);
+            if (ip != "0.0.0.0" && ip != "127.0.0.1" && ip != "::" && ip != "::1")
+                return {};
+            while (space < n && isBlank(p[space]))
+                ++space;
+            p += space;
+            n -= space;
+            cut = n;
+        }
+        for (qsizetype i = 0; i < n; ++i) {
+            if (isBlank(p[i]) || p[i] == '#') {
+                cut = i;
+                break;
+            }
+        }
+    }
+    n = cut;
+
+    if (n >= 2 && p[0] == '*' && p[1] == '.') {
+        p += 2;
+        n -= 2;
+    }
+    while (n > 0 && *p == '.') {
+        ++p;
+        --n;
+    }
+    while (n > 0 && p[n - 1] == '.')
+        --n;
+    if (n == 0 || n > DomainBlocklist::kMaxDomain)
+        return {};
+
+    bool dotted = false;
+    for (qsizetype i = 0; i < n; ++i) {
+        char &c = p[i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c + 32);
+        else if (c == '.')
+            dotted = true;
+        else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+            return {};
+    }
+    // Single labels ("localhost", "local") are never worth blocking
+    if (!dotted || QByteArrayView(p, n) == "localhost.localdomain")
+        return {};
+    return QByteArrayView(p, n);
+}
+
+DomainBlocklist::~DomainBlocklist() = default;
+
+quint64 DomainBlocklist::sourceStamp(const QStringList &sources) {
+    QByteArray key;
+    for (const QString &path : sources) {
+        const QFileInfo info(path);
+        key += path.toUtf8();
+        key += '\0';
+        key += QByteArray::number(info.size());
+        key += '\0';
+        key += QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+        key += '\n';
+    }
+    return hashKey(key.constData(), static_cast<int>(key.size())) | 1;   // never 0
+}
+
+bool DomainBlocklist::build(const QStringList &sources, const QString &outPath, quint64 stamp,
+                            QString *error, int *entries) {
+    // Whole files in memory, domains as views into them
+    QList<QByteArray> contents;
+    for (const QString &path : sources) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *error = QStringLiteral("cannot read %1: %2").arg(path, file.errorString());
+            return false;
+        }
+        contents.append(file.readAll());
+    }
+    std::vector<QByteArrayView> domains;
+    for (QByteArray &text : contents) {
+        char *data = text.data();
+        const qsizetype size = text.size();
+        qsizetype pos = 0;
+        while (pos < size) {
+            const void *nl = std::memchr(data + pos, '\n', static_cast<size_t>(size - pos));
+            const qsizetype end = nl ? static_cast<const char *>(nl) - data : size;
+            const QByteArrayView domain = extractDomain(data + pos, end - pos);
+            if (!domain.isEmpty())
+                domains.push_back(domain);
+            pos = end + 1;
+        }
+    }
+
+    auto less = [](QByteArrayView a, QByteArrayView b) {
+        return compareKeys(a.data(), int(a.size()), b.data(), int(b.size())) < 0;
+    };
+    std::sort(domains.begin(), domains.end(), less);
+    domains.erase(std::unique(domains.begin(), domains.end()), domains.end());
+
+    // Front-coded entries, a full one at the start of every block
+    QByteArray data;
+    std::vector<quint32> blocks;
+    QByteArrayView previous;
+    for (size_t i = 0; i < domains.size(); ++i) {
+        const QByteArrayView domain = domains[i];
+        int shared = 0;
+        if (i % kBlockSize == 0) {
+            blocks.push_back(static_cast<quint32>(data.size()));
+        } else {
+            const int limit = int(qMin(previous.size(), domain.size()));
+            while (shared < limit && previous[shared] == domain[shared])
+                ++shared;
+        }
+        data.append(static_cast<char>(shared));
+        data.append(static_cast<char>(domain.size() - shared));
+        data.append(domain.data() + shared, domain.size() - shared);
+        previous = domain;
+    }
+
+    quint64 bloomBits = 64;
+    while (bloomBits < quint64(domains.size()) * kBloomBitsPerEntry)
+        bloomBits <<= 1;
+    QByteArray bloom(static_cast<qsizetype>(bloomBits / 8), '\0');
+    for (const QByteArrayView domain : domains) {
+        const quint64 h = hashKey(domain.data(), int(domain.size()));
+        const quint64 step = (h >> 32) | 1;
+        for (quint32 k = 0; k < kBloomHashes; ++k) {
+            const quint64 bit = (h + k * step) & (bloomBits - 1);
+            bloom[bit >> 3] = static_cast<char>(bloom[bit >> 3] | (1 << (bit & 7)));
+        }
+    }
+
+    QByteArray header(kHeaderSize, '\0');
+    uchar *h = reinterpret_cast<uchar *>(header.data());
+    std::memcpy(h, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint64>(stamp, h + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(domains.size()), h + 16);
+    qToLittleEndian<quint32>(static_cast<quint32>(blocks.size()), h + 20);
+    qToLittleEndian<quint64>(static_cast<quint64>(data.size()), h + 24);
+    qToLittleEndian<quint64>(bloomBits, h + 32);
+    qToLittleEndian<quint32>(kBloomHashes, h + 40);
+
+    QByteArray index(static_cast<qsizetype>(blocks.size() * 4), '\0');
+    for (size_t i = 0; i < blocks.size(); ++i)
+        qToLittleEndian<quint32>(blocks[i], reinterpret_cast<uchar *>(index.data()) + 4 * i);
+    const qint64 unpadded = kHeaderSize + index.size() + data.size();
+    const QByteArray padding(static_cast<qsizetype>((8 - unpadded % 8) % 8), '\0');
+
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        *error = QStringLiteral("cannot write %1: %2").arg(outPath, out.errorString());
+        return false;
+    }
+    out.write(header);
+    out.write(index);
+    out.write(data);
+    out.write(padding);
+    out.write(bloom);
+    if (!out.commit()) {
+        *error = QStringLiteral("cannot write %1: %2").arg(outPath, out.errorString());
+        return false;
+    }
+    if (entries)
+        *entries = static_cast<int>(domains.size());
+    return true;
+}
+
+std::shared_ptr<const DomainBlocklist> DomainBlocklist::open(const QString &path, quint64 stamp, QString *error) {
+    auto fail = [error](const QString &message) {
+        if (error)
+            *error = message;
+        return std::shared_ptr<const DomainBlocklist>();
+    };
+
+    std::shared_ptr<DomainBlocklist> list(new DomainBlocklist);
+    list->m_file.setFileName(path);
+    if (!list->m_file.open(QIODevice::ReadOnly))
+        return fail(QStringLiteral("cannot open %1").arg(path));
+    const qint64 size = list->m_file.size();
+    if (size < kHeaderSize)
+        return fail(QStringLiteral("%1 is truncated").arg(path));
+    const uchar *base = list->m_file.map(0, size);
+    if (!base)
+        return fail(QStringLiteral("cannot map %1").arg(path));
+
+    if (std::memcmp(base, kMagic, sizeof(kMagic)) != 0)
+        return fail(QStringLiteral("%1 is not a blocklist").arg(path));
+    if (stamp != 0 && qFromLittleEndian<quint64>(base + 8) != stamp)
+        return fail(QStringLiteral("%1 is out of date").arg(path));
+    list->m_count = qFromLittleEndian<quint32>(base + 16);
+    list->m_blockCount = qFromLittleEndian<quint32>(base + 20);
+    list->m_dataSize = qFromLittleEndian<quint64>(base + 24);
+    const quint64 bloomBits = qFromLittleEndian<quint64>(base + 32);
+    list->m_bloomHashes = qFromLittleEndian<quint32>(base + 40);
+
+    const quint64 dataOffset = kHeaderSize + quint64(list->m_blockCount) * 4;
+    const quint64 bloomOffset = (dataOffset + list->m_dataSize + 7) & ~quint64(7);
+    const bool bloomValid = bloomBits >= 64 && (bloomBits & (bloomBits - 1)) == 0;
+    if (!bloomValid || quint64(size) != bloomOffset + bloomBits / 8
+        || list->m_blockCount != (list->m_count + kBlockSize - 1) / kBlockSize)
+        return fail(QStringLiteral("%1 is corrupt").arg(path));
+
+    list->m_blockIndex = base + kHeaderSize;
+    list->m_data = base + dataOffset;
+    list->m_bloom = base + bloomOffset;
+    list->m_bloomMask = bloomBits - 1;
+    for (quint32 i = 0; i < list->m_blockCount; ++i) {
+        if (qFromLittleEndian<quint32>(list->m_blockIndex + 4 * i) >= list->m_dataSize)
+            return fail(QStringLiteral("%1 is corrupt").arg(path));
+    }
+    return list;
+}
+
+bool DomainBlocklist::bloomContains(quint64 hash) const {
+    const quint64 step = (hash >> 32) | 1;
+    for (quint32 k = 0; k < m_bloomHashes; ++k) {
+        const quint64 bit = (hash + k * step) & m_bloomMask;
+        if (!(m_bloom[bit >> 3] & (1 << (bit & 7))))
+            return false;
+    }
+    return true;
+}
+
+bool DomainBlocklist::probe(const char *key, int length) const {
+    if (m_bloomMask && !bloomContains(hashKey(key, length)))
+        return false;
+
+    auto blockOffset = [this](quint32 block) {
+        return qFromLittleEndian<quint32>(m_blockIndex + 4 * block);
+    };
+    // First block whose head sorts after the key; the one before may hold it
+    quint32 lo = 0;
+    quint32 hi = m_blockCount;
+    while (lo < hi) {
+        const quint32 mid = lo + (hi - lo) / 2;
+        const uchar *head = m_data + blockOffset(mid);
+        if (compareKeys(reinterpret_cast<const char *>(head + 2), head[1], key, length) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return false;
+
+    const quint32 block = lo - 1;
+    const uchar *p = m_data + blockOffset(block);
+    const uchar *end = m_data + (block + 1 < m_blockCount ? blockOffset(block + 1) : m_dataSize);
+    char current[512];
+    for (int i = 0; i < kBlockSize && p + 2 <= end; ++i) {
+        const int shared = p[0];
+        const int suffix = p[1];
+        if (p + 2 + suffix > end)
+            return false;
+        std::memcpy(current + shared, p + 2, static_cast<size_t>(suffix));
+        p += 2 + suffix;
+        const int c = compareKeys(current, shared + suffix, key, length);
+        if (c == 0)
+            return true;
+        if (c > 0)
+            return false;
+    }
+    return false;
+}
+
+bool DomainBlocklist::contains(QStringView host) const {
+    qsizetype n = host.size();
+    while (n > 0 && host[n - 1] == u'.')
+        --n;
+    if (n == 0 || n > kMaxDomain || m_count == 0)
+        return false;
+
+    char key[kMaxDomain];
+    for (qsizetype i = 0; i < n; ++i) {
+        char16_t c = host[i].unicode();
+        if (c >= 0x80)
+            return false;   // lists carry punycode only
+        if (c >= u'A' && c <= u'Z')
+            c = char16_t(c + 32);
+        key[i] = static_cast<char>(c);
+    }
+    // An address literal has no parent domains
+    if (host.contains(u':') || (key[n - 1] >= '0' && key[n - 1] <= '9'))
+        return probe(key, int(n));
+
+    qsizetype start = 0;
+    for (;;) {
+        if (probe(key + start, int(n - start)))
+            return true;
+        const void *dot = std::memchr(key + start, '.', static_cast<size_t>(n - start));
+        if (!dot)
+            return false;
+        start = static_cast<const char *>(dot) - key + 1;
+    }
+}
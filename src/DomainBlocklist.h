@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <memory>
+
+/**
+ * @brief Read-only set of blocked domains backed by a memory-mapped file
+ *
+ * The file holds the domains sorted and front-coded in blocks of
+ * kBlockSize (each block starts with a full entry), a table of block
+ * offsets, and a Bloom filter (about 10 bits per entry) that answers most
+ * misses without touching the sorted data. The file is mapped, so it is
+ * shared with the page cache rather than the heap; tests/bench_domain_blocklist
+ * reports its size and the open and lookup cost for a given list size.
+ *
+ * An entry blocks the domain itself and everything below it. A lookup
+ * probes the host and each parent domain: a Bloom test, and on a positive
+ * a binary search over the block heads plus a scan of one block.
+ *
+ * Immutable once opened; safe to share between worker threads.
+ */
+class DomainBlocklist
+{
+public:
+    ~DomainBlocklist();
+
+    /**
+     * @brief Compile list files into @p outPath. Accepted line formats:
+     * plain "domain", hosts "0.0.0.0 domain" and Adblock "||domain^";
+     * comments and anything else are skipped.
+     * @param stamp Stored in the file for open() (see sourceStamp())
+     * @return false on I/O errors (described in @p error)
+     */
+    static bool build(const QStringList &sources, const QString &outPath, quint64 stamp,
+                      QString *error, int *entries = nullptr);
+
+    /**
+     * @brief Map a file written by build()
+     * @param stamp If non-zero, the file must have been built with it
+     * @return null if the file is missing, corrupt or stale
+     */
+    static std::shared_ptr<const DomainBlocklist> open(const QString &path, quint64 stamp = 0,
+                                                       QString *error = nullptr);
+
+    /** Fingerprint of the list files (paths, sizes, modification times) */
+    static quint64 sourceStamp(const QStringList &sources);
+
+    /** True if @p host or one of its parent domains is listed */
+    bool contains(QStringView host) const;
+
+    int count() const { return static_cast<int>(m_count); }
+
+    static constexpr int kBlockSize = 16;
+    static constexpr int kMaxDomain = 253;
+
+private:
+    DomainBlocklist() = default;
+
+    bool probe(const char *key, int length) const;
+    bool bloomContains(quint64 hash) const;
+
+    QFile m_file;
+    const uchar *m_blockIndex = nullptr;   // kBlockSize-entry blocks: quint32 offsets into m_data
+    const uchar *m_data = nullptr;
+    const uchar *m_bloom = nullptr;
+    quint32 m_count = 0;
+    quint32 m_blockCount = 0;
+    quint64 m_dataSize = 0;
+    quint64 m_bloomMask = 0;               // bit count - 1 (power of two), 0 = no filter
+    quint32 m_bloomHashes = 0;
+};
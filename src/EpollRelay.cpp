@@ -0,0 +1,339 @@
+#include "EpollRelay.h"
+#include "AllocCounter.h"
+#include <QObject>
+#include <QSocketNotifier>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Bounded work per wakeup so one fat tunnel cannot monopolize the worker's
+// event loop; deferred tunnels continue on the next turn.
+static constexpr int kMaxRoundsPerWakeup = 16;
+static constexpr int kMaxEvents = 256;
+
+#ifdef Q_OS_LINUX
+
+// epoll data: the tunnel pointer with the low bit set for its SOCKS side;
+// 0 is the wakeup eventfd
+static quint64 tag(EpollRelay::Tunnel *tunnel, bool socks) {
+    return reinterpret_cast<quintptr>(tunnel) | (socks ? 1 : 0);
+}
+
+bool EpollRelay::isSupported() { return true; }
+
+std::shared_ptr<EpollRelay> EpollRelay::create(QObject *parent, BufferPool *buffers)
+{
+    const int epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0)
+        return nullptr;
+    std::shared_ptr<EpollRelay> relay(new EpollRelay());
+    relay->m_epoll = epoll;
+    relay->m_buffers = buffers;
+    // Level-triggered: stays readable (and keeps the notifier firing) until
+    // runDeferred() drains it
+    relay->m_wakeup = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    if (relay->m_wakeup < 0 || ::epoll_ctl(epoll, EPOLL_CTL_ADD, relay->m_wakeup, &ev) < 0)
+        return nullptr;
+    relay->m_deferred.reserve(kReservedDeferred);
+    relay->m_running.reserve(kReservedDeferred);
+    relay->m_notifier = new QSocketNotifier(epoll, QSocketNotifier::Read, parent);
+    EpollRelay *self = relay.get();
+    QObject::connect(relay->m_notifier, &QSocketNotifier::activated, parent, [self]() { self->onReady(); });
+    return relay;
+}
+
+EpollRelay::~EpollRelay()
+{
+    delete m_notifier.data();
+    if (m_wakeup >= 0)
+        ::close(m_wakeup);
+    if (m_epoll >= 0)
+        ::close(m_epoll);
+}
+
+std::unique_ptr<EpollRelay::Tunnel> EpollRelay::add(qintptr clientFd, qintptr socksFd)
+{
+    const int client = static_cast<int>(clientFd);
+    const int socks = static_cast<int>(socksFd);
+    if (client < 0 || socks < 0) {
+        for (int fd : {client, socks}) {
+            if (fd >= 0) ::close(fd);
+        }
+        return nullptr;
+    }
+    // The tunnel owns the descriptors from here on
+    std::unique_ptr<Tunnel> tunnel(new Tunnel(shared_from_this(), client, socks));
+    for (int fd : {client, socks}) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = tag(tunnel.get(), fd == socks);
+        if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+            return nullptr;
+    }
+    return tunnel;
+}
+
+void EpollRelay::onReady()
+{
+    epoll_event events[kMaxEvents];
+    bool wakeup = false;
+    int n;
+    do {
+        n = ::epoll_wait(m_epoll, events, kMaxEvents, 0);
+        if (n <= 0)
+            break;
+        m_dispatching = true;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == 0) {
+                wakeup = true;
+                continue;
+            }
+            auto *tunnel = reinterpret_cast<Tunnel *>(quintptr(events[i].data.u64) & ~quintptr(1));
+            if (m_gone.contains(tunnel))
+                continue;
+            const bool socks = events[i].data.u64 & 1;
+            tunnel->onEvents(socks ? tunnel->m_down.src : tunnel->m_up.src, events[i].events);
+        }
+        m_dispatching = false;
+        m_gone.clear();
+    } while (n == kMaxEvents);
+    if (wakeup)
+        runDeferred();
+}
+
+EpollRelay::Tunnel::~Tunnel()
+{
+    // Closing a descriptor drops it from the epoll set
+    ::close(m_up.src);
+    ::close(m_down.src);
+    m_relay->forget(this);
+}
+
+void EpollRelay::Tunnel::onEvents(int fd, quint32 events)
+{
+    // fd is the source of one direction and the sink of the other
+    Direction &in = fd == m_up.src ? m_up : m_down;
+    Direction &out = fd == m_up.src ? m_down : m_up;
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        in.readable = true;
+    if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        out.writable = true;
+    continuePumping();
+}
+
+void EpollRelay::Tunnel::continuePumping()
+{
+    PAQET_ALLOC_SCOPE(Relay);
+    const bool upLeft = pump(m_up);
+    const bool downLeft = pump(m_down);
+    if (upLeft || downLeft)
+        m_relay->defer(this);
+}
+
+bool EpollRelay::Tunnel::pump(Direction &d)
+{
+    if (!m_started || m_done || d.done)
+        return false;
+
+    for (int round = 0; round < kMaxRoundsPerWakeup; ++round) {
+        // Send what is buffered while the sink takes it; a partial send
+        // leaves the rest of the slab at the head of the chain
+        while (!d.chain.isEmpty() && d.writable) {
+            qint64 length = 0;
+            const char *data = d.chain.front(&length);
+            const ssize_t n = ::send(d.dst, data, static_cast<size_t>(length), MSG_NOSIGNAL);
+            if (n > 0) {
+                d.chain.consume(n);
+                d.bytes += n;
+                if (m_progress)
+                    m_progress(&d == &m_up, n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                d.writable = false;
+            } else {
+                fail();
+                return false;
+            }
+        }
+
+        if (d.eof) {
+            if (d.chain.isEmpty()) {
+                ::shutdown(d.dst, SHUT_WR);
+                d.done = true;
+                checkFinished();
+            }
+            return false;
+        }
+        // The source's EPOLLIN edge, the sink's EPOLLOUT edge or resume() brings us back
+        const qint64 room = kMaxBuffered - d.chain.size();
+        if (!d.readable || d.parked || room <= 0)
+            return false;
+
+        qint64 want = room;
+        if (m_grant) {
+            want = m_grant(&d == &m_up, want);
+            if (want <= 0) {
+                d.parked = true;
+                return false;
+            }
+        }
+        qint64 space = 0;
+        char *data = d.chain.reserve(&space);
+        if (!data)
+            return false;   // ring full: the sink's EPOLLOUT edge brings us back
+        const ssize_t n = ::recv(d.src, data, static_cast<size_t>(qMin(want, space)), 0);
+        d.chain.commit(n > 0 ? n : 0);
+        if (n > 0) {
+            continue;
+        } else if (n == 0) {
+            d.eof = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            d.readable = false;   // one more round flushes what is buffered
+        } else {
+            fail();
+            return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+bool EpollRelay::isSupported() { return false; }
+
+std::shared_ptr<EpollRelay> EpollRelay::create(QObject *, BufferPool *)
+{
+    return nullptr;
+}
+
+EpollRelay::~EpollRelay() = default;
+
+std::unique_ptr<EpollRelay::Tunnel> EpollRelay::add(qintptr, qintptr)
+{
+    return nullptr;
+}
+
+void EpollRelay::onReady() {}
+
+EpollRelay::Tunnel::~Tunnel()
+{
+    m_relay->forget(this);
+}
+
+void EpollRelay::Tunnel::onEvents(int, quint32) {}
+void EpollRelay::Tunnel::continuePumping() {}
+bool EpollRelay::Tunnel::pump(Direction &) { return false; }
+
+#endif
+
+EpollRelay::Tunnel::Tunnel(std::shared_ptr<EpollRelay> relay, int client, int socks)
+    : m_relay(std::move(relay))
+{
+    m_up.src = client;
+    m_up.dst = socks;
+    m_down.src = socks;
+    m_down.dst = client;
+    m_up.chain = BufferChain(m_relay->m_buffers, BufferPool::kSmallSize);
+    m_down.chain = BufferChain(m_relay->m_buffers, BufferPool::kSmallSize);
+    ++m_relay->m_tunnels;
+}
+
+void EpollRelay::Tunnel::start()
+{
+    m_started = true;
+    // Bytes that arrived before registration produced no edge we saw
+    m_up.readable = true;
+    m_down.readable = true;
+    continuePumping();
+}
+
+void EpollRelay::Tunnel::resume(bool up)
+{
+    PAQET_ALLOC_SCOPE(Relay);
+    Direction &d = up ? m_up : m_down;
+    d.parked = false;
+    if (pump(d))
+        m_relay->defer(this);
+}
+
+void EpollRelay::Tunnel::fail()
+{
+    if (m_done)
+        return;
+    m_up.done = true;
+    m_down.done = true;
+    checkFinished();
+}
+
+void EpollRelay::Tunnel::checkFinished()
+{
+    if (m_done || !m_up.done || !m_down.done)
+        return;
+    m_done = true;
+    if (m_finished)
+        m_finished();
+}
+
+void EpollRelay::defer(Tunnel *tunnel)
+{
+    if (!tunnel->m_queued) {
+        tunnel->m_queued = true;
+        m_deferred.push_back(tunnel);
+    }
+    if (m_deferPosted)
+        return;
+    m_deferPosted = true;
+#ifdef Q_OS_LINUX
+    // Seen by the notifier on the next event-loop turn; unlike a queued
+    // call this allocates nothing
+    const quint64 one = 1;
+    if (::write(m_wakeup, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        m_deferPosted = false;
+#endif
+}
+
+void EpollRelay::runDeferred()
+{
+#ifdef Q_OS_LINUX
+    quint64 count = 0;
+    if (::read(m_wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return;
+#endif
+    m_deferPosted = false;
+    // Only the tunnels deferred so far; ones deferring again wait a turn.
+    // Both vectors keep their capacity across turns.
+    m_running.swap(m_deferred);
+    for (Tunnel *tunnel : m_running) {
+        if (!tunnel)
+            continue;   // destroyed by an earlier tunnel's callbacks
+        tunnel->m_queued = false;
+        tunnel->continuePumping();
+    }
+    m_running.clear();
+}
+
+void EpollRelay::forget(Tunnel *tunnel)
+{
+    --m_tunnels;
+    if (tunnel->m_queued) {
+        // Nulled rather than erased: runDeferred() may be walking m_running
+        std::replace(m_deferred.begin(), m_deferred.end(), tunnel, static_cast<Tunnel *>(nullptr));
+        std::replace(m_running.begin(), m_running.end(), tunnel, static_cast<Tunnel *>(nullptr));
+    }
+    if (m_dispatching)
+        m_gone.insert(tunnel);
+}
@@ -0,0 +1,505 @@
+#include "HttpCache.h"
+#include "HttpMessageFramer.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QObject>
+#include <QTimeZone>
+#include <QtEndian>
+
+// File layout: magic, storedAt, freshUntil (LE ms), key length, head length
+// (LE), then key, head and body
+static const char kMagic[8] = {'P', 'Q', 'H', 'C', 'A', 'C', 'H', '1'};
+static constexpr qint64 kPrefixSize = 32;
+static constexpr quint32 kMaxStoredField = 64 * 1024;
+static constexpr qint64 kMaxHeuristicMs = 24 * 3600 * 1000;   // Last-Modified based lifetime cap
+static const QString kEntrySuffix = QStringLiteral(".entry");
+static const QString kPartialSuffix = QStringLiteral(".part");
+
+/**
+ * @brief Find Cache-Control directive @p name in any Cache-Control field
+ * @param value Argument of the directive, unquoted, if it has one
+ */
+static bool directive(const HttpHeadInfo &response, const QByteArray &name, QByteArray *value = nullptr) {
+    for (const auto &h : response.headers) {
+        if (h.first.compare("Cache-Control", Qt::CaseInsensitive) != 0)
+            continue;
+        for (const QByteArray &part : h.second.split(',')) {
+            const int eq = part.indexOf('=');
+            if (part.left(eq).trimmed().compare(name, Qt::CaseInsensitive) != 0)
+                continue;
+            if (value) {
+                QByteArray arg = eq < 0 ? QByteArray() : part.mid(eq + 1).trimmed();
+                if (arg.size() >= 2 && arg.startsWith('"') && arg.endsWith('"'))
+                    arg = arg.mid(1, arg.size() - 2);
+                *value = arg;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Seconds argument of directive @p name, -1 when absent or malformed */
+static qint64 deltaSeconds(const HttpHeadInfo &response, const QByteArray &name) {
+    QByteArray value;
+    if (!directive(response, name, &value))
+        return -1;
+    bool ok = false;
+    const qint64 seconds = value.toLongLong(&ok);
+    return ok && seconds >= 0 ? seconds : -1;
+}
+
+static bool isHopByHop(const QByteArray &name, const QList<QByteArray> &connectionTokens) {
+    static const char *const kHopByHop[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authenticate", "Proxy-Authorization",
+        "TE", "Trailer", "Transfer-Encoding", "Upgrade", "Age"
+    };
+    for (const char *hop : kHopByHop) {
+        if (name.compare(hop, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    for (const QByteArray &token : connectionTokens) {
+        if (name.compare(token, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+/** @p head without hop-by-hop fields (and without Age, added when served) */
+static QByteArray storedHead(const QByteArray &head, const HttpHeadInfo &response) {
+    QList<QByteArray> connectionTokens;
+    for (const auto &h : response.headers) {
+        if (h.first.compare("Connection", Qt::CaseInsensitive) != 0)
+            continue;
+        for (const QByteArray &token : h.second.split(','))
+            connectionTokens.append(token.trimmed());
+    }
+    QByteArray stored = head.left(head.indexOf("\r\n") + 2);
+    for (const auto &h : response.headers) {
+        if (isHopByHop(h.first, connectionTokens))
+            continue;
+        stored += h.first + ": " + h.second + "\r\n";
+    }
+    stored += "\r\n";
+    return stored;
+}
+
+static QByteArray prefix(qint64 storedAt, qint64 freshUntil) {
+    QByteArray times(16, Qt::Uninitialized);
+    qToLittleEndian<qint64>(storedAt, times.data());
+    qToLittleEndian<qint64>(freshUntil, times.data() + 8);
+    return times;
+}
+
+HttpCache::Fill::~Fill() {
+    discard();
+    if (m_revalidating && !m_refreshed)
+        m_cache->m_misses.fetch_add(1, std::memory_order_relaxed);
+    m_cache->endFill(m_key);
+}
+
+void HttpCache::Fill::discard() {
+    if (!m_file.isOpen())
+        return;
+    m_file.close();
+    m_file.remove();
+}
+
+bool HttpCache::Fill::begin(const QByteArray &head, const HttpHeadInfo &response, qint64 length) {
+    // One response may take at most an eighth of the cache
+    if (m_file.isOpen() || !isStorable(response) || length > m_cache->m_maxBytes / 8)
+        return false;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_entry.key = m_key;
+    m_entry.head = storedHead(head, response);
+    m_entry.storedAt = now;
+    m_entry.freshUntil = freshUntil(response, now);
+    m_entry.etag = response.header("ETag").trimmed();
+    m_entry.lastModified = response.header("Last-Modified").trimmed();
+    // Neither fresh nor revalidatable: it could never be served
+    if (m_entry.freshUntil <= now && !m_entry.hasValidator())
+        return false;
+    if (m_entry.head.size() > qsizetype(kMaxStoredField) || m_key.size() > qsizetype(kMaxStoredField))
+        return false;
+    m_entry.bodyOffset = kPrefixSize + m_key.size() + m_entry.head.size();
+    m_entry.bodySize = 0;
+    m_expected = length;
+
+    m_file.setFileName(m_cache->newFilePath(m_key) + kPartialSuffix);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QByteArray header(kMagic, sizeof(kMagic));
+    header += prefix(m_entry.storedAt, m_entry.freshUntil);
+    char lengths[8];
+    qToLittleEndian<quint32>(quint32(m_key.size()), lengths);
+    qToLittleEndian<quint32>(quint32(m_entry.head.size()), lengths + 4);
+    header.append(lengths, sizeof(lengths));
+    header += m_key;
+    header += m_entry.head;
+    if (m_file.write(header) != header.size()) {
+        discard();
+        return false;
+    }
+    return true;
+}
+
+void HttpCache::Fill::append(const char *data, qint64 size) {
+    if (!m_file.isOpen() || size <= 0)
+        return;
+    if (m_entry.bodySize + size > m_expected || m_file.write(data, size) != size) {
+        discard();
+        return;
+    }
+    m_entry.bodySize += size;
+}
+
+void HttpCache::Fill::commit() {
+    if (!m_file.isOpen())
+        return;
+    if (m_entry.bodySize != m_expected || !m_file.flush()) {
+        discard();
+        return;
+    }
+    m_file.close();
+    const QString path = m_file.fileName().chopped(kPartialSuffix.size()) + kEntrySuffix;
+    if (!m_file.rename(path)) {
+        m_file.remove();
+        return;
+    }
+    m_entry.path = path;
+    m_cache->insert(std::make_shared<const Entry>(m_entry));
+}
+
+std::shared_ptr<const HttpCache::Entry> HttpCache::Fill::refresh(const std::shared_ptr<const Entry> &entry,
+                                                                 const HttpHeadInfo &response) {
+    // RFC 9111 section 4.3.4: the 304's fields replace the stored ones
+    HttpHeadInfo merged;
+    HttpHeadInfo::parseResponse(entry->head, &merged);
+    for (const auto &h : response.headers) {
+        if (h.first.compare("Content-Length", Qt::CaseInsensitive) == 0)
+            continue;
+        merged.headers.removeIf([&h](const QPair<QByteArray, QByteArray> &stored) {
+            return stored.first.compare(h.first, Qt::CaseInsensitive) == 0;
+        });
+        merged.headers.append(h);
+    }
+
+    auto refreshed = std::make_shared<Entry>(*entry);
+    refreshed->storedAt = QDateTime::currentMSecsSinceEpoch();
+    refreshed->freshUntil = freshUntil(merged, refreshed->storedAt);
+    QFile file(entry->path);
+    if (file.open(QIODevice::ReadWrite) && file.seek(sizeof(kMagic)))
+        file.write(prefix(refreshed->storedAt, refreshed->freshUntil));
+    m_cache->replace(refreshed);
+    m_refreshed = true;
+    m_cache->m_revalidated.fetch_add(1, std::memory_order_relaxed);
+    return refreshed;
+}
+
+HttpCache::HttpCache(const QString &directory, qint64 maxBytes)
+    : m_directory(directory)
+    , m_maxBytes(qMax<qint64>(0, maxBytes))
+{
+    QDir().mkpath(m_directory);
+    load();
+}
+
+HttpCache::~HttpCache() = default;
+
+void HttpCache::load() {
+    QDir dir(m_directory);
+    // Fills cut short by a crash or a stop
+    for (const QString &name : dir.entryList({QLatin1Char('*') + kPartialSuffix}, QDir::Files))
+        dir.remove(name);
+
+    // Newest first, so the LRU order survives a restart as store order
+    const QFileInfoList files = dir.entryInfoList({QLatin1Char('*') + kEntrySuffix}, QDir::Files, QDir::Time);
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (const QFileInfo &info : files) {
+        QFile file(info.filePath());
+        auto entry = std::make_shared<Entry>();
+        bool ok = file.open(QIODevice::ReadOnly);
+        const QByteArray header = ok ? file.read(kPrefixSize) : QByteArray();
+        ok = header.size() == kPrefixSize && header.startsWith(QByteArray(kMagic, sizeof(kMagic)));
+        if (ok) {
+            const char *p = header.constData() + sizeof(kMagic);
+            entry->storedAt = qFromLittleEndian<qint64>(p);
+            entry->freshUntil = qFromLittleEndian<qint64>(p + 8);
+            const quint32 keyLength = qFromLittleEndian<quint32>(p + 16);
+            const quint32 headLength = qFromLittleEndian<quint32>(p + 20);
+            ok = keyLength <= kMaxStoredField && headLength <= kMaxStoredField;
+            if (ok) {
+                entry->key = file.read(keyLength);
+                entry->head = file.read(headLength);
+                entry->bodyOffset = kPrefixSize + keyLength + headLength;
+                entry->bodySize = info.size() - entry->bodyOffset;
+                ok = entry->key.size() == qsizetype(keyLength) && entry->head.size() == qsizetype(headLength)
+                    && entry->bodySize >= 0;
+            }
+        }
+        HttpHeadInfo response;
+        if (ok)
+            ok = HttpHeadInfo::parseResponse(entry->head, &response) && !m_index.contains(entry->key);
+        file.close();
+        if (!ok) {
+            // Corrupt, or an older copy of a key already indexed
+            file.remove();
+            continue;
+        }
+        entry->path = info.filePath();
+        entry->etag = response.header("ETag").trimmed();
+        entry->lastModified = response.header("Last-Modified").trimmed();
+        m_lru.push_back(entry);
+        m_index.insert(entry->key, std::prev(m_lru.end()));
+        m_size += entry->fileSize();
+    }
+    evictLocked();
+}
+
+HttpCache::Lookup HttpCache::lookup(const QByteArray &key, bool revalidate) {
+    Lookup result;
+    std::lock_guard<std::mutex> guard(m_lock);
+    const auto it = m_index.constFind(key);
+    if (it != m_index.cend()) {
+        m_lru.splice(m_lru.begin(), m_lru, it.value());
+        result.entry = *it.value();
+        if (!revalidate && QDateTime::currentMSecsSinceEpoch() < result.entry->freshUntil) {
+            result.status = Status::Fresh;
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+    }
+    if (m_filling.contains(key)) {
+        result.status = Status::Busy;
+        result.entry.reset();
+        return result;
+    }
+    m_filling.insert(key, {});
+    result.fill.reset(new Fill(this, key));
+    if (result.entry && result.entry->hasValidator()) {
+        result.status = Status::Stale;
+        result.fill->m_revalidating = true;
+    } else {
+        result.entry.reset();
+        result.status = Status::Miss;
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+quint64 HttpCache::wait(const QByteArray &key, QObject *context, std::function<void()> done) {
+    quint64 ticket;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        ticket = m_nextTicket++;
+        m_coalesced.fetch_add(1, std::memory_order_relaxed);
+        auto it = m_filling.find(key);
+        if (it != m_filling.end()) {
+            it->append({ticket, context, std::move(done)});
+            return ticket;
+        }
+    }
+    // The fetch ended in the meantime
+    QMetaObject::invokeMethod(context, std::move(done), Qt::QueuedConnection);
+    return ticket;
+}
+
+void HttpCache::cancel(quint64 ticket) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (QList<Waiter> &waiters : m_filling) {
+        if (waiters.removeIf([ticket](const Waiter &w) { return w.ticket == ticket; }) > 0)
+            return;
+    }
+}
+
+void HttpCache::endFill(const QByteArray &key) {
+    QList<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        waiters = m_filling.take(key);
+    }
+    for (Waiter &w : waiters)
+        QMetaObject::invokeMethod(w.context, std::move(w.done), Qt::QueuedConnection);
+}
+
+void HttpCache::insert(const std::shared_ptr<const Entry> &entry) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    const auto it = m_index.constFind(entry->key);
+    if (it != m_index.cend()) {
+        // Replaced by a newer response; a reader still holding the old file
+        // keeps it readable where the platform allows
+        const std::shared_ptr<const Entry> old = *it.value();
+        QFile::remove(old->path);
+        m_size -= old->fileSize();
+        m_lru.erase(it.value());
+    }
+    m_lru.push_front(entry);
+    m_index.insert(entry->key, m_lru.begin());
+    m_size += entry->fileSize();
+    m_stored.fetch_add(1, std::memory_order_relaxed);
+    evictLocked();
+}
+
+void HttpCache::replace(const std::shared_ptr<const Entry> &entry) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    const auto it = m_index.constFind(entry->key);
+    // Evicted or replaced meanwhile: the refreshed copy is served once
+    if (it == m_index.cend() || (*it.value())->path != entry->path)
+        return;
+    *it.value() = entry;
+    m_lru.splice(m_lru.begin(), m_lru, it.value());
+}
+
+void HttpCache::evictLocked() {
+    while (m_size > m_maxBytes && !m_lru.empty()) {
+        const std::shared_ptr<const Entry> victim = m_lru.back();
+        m_lru.pop_back();
+        m_index.remove(victim->key);
+        m_size -= victim->fileSize();
+        QFile::remove(victim->path);
+    }
+}
+
+QString HttpCache::newFilePath(const QByteArray &key) {
+    quint64 serial;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        serial = m_nextFile++;
+    }
+    return QStringLiteral("%1/%2-%3-%4").arg(m_directory)
+        .arg(qHash(key), 16, 16, QLatin1Char('0'))
+        .arg(QDateTime::currentMSecsSinceEpoch(), 0, 36)
+        .arg(serial, 0, 36);
+}
+
+void HttpCache::countServed(qint64 bytes) {
+    m_bytesSaved.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+QByteArray HttpCache::responseHead(const Entry &entry) {
+    const qint64 age = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - entry.storedAt) / 1000;
+    return entry.head.chopped(2) + "Age: " + QByteArray::number(age) + "\r\n\r\n";
+}
+
+bool HttpCache::isStorable(const HttpHeadInfo &response) {
+    if (response.status != 200 || directive(response, "no-store") || directive(response, "private"))
+        return false;
+    for (const auto &h : response.headers) {
+        // Per-user state must not be handed to other clients
+        if (h.first.compare("Set-Cookie", Qt::CaseInsensitive) == 0)
+            return false;
+        // Only Accept-Encoding is part of the key
+        if (h.first.compare("Vary", Qt::CaseInsensitive) != 0)
+            continue;
+        for (const QByteArray &field : h.second.split(',')) {
+            const QByteArray name = field.trimmed();
+            if (!name.isEmpty() && name.compare("Accept-Encoding", Qt::CaseInsensitive) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+qint64 HttpCache::freshUntil(const HttpHeadInfo &response, qint64 now) {
+    if (directive(response, "no-cache"))
+        return now;
+    qint64 lifetime = 0;
+    const qint64 sharedMaxAge = deltaSeconds(response, "s-maxage");
+    const qint64 maxAge = deltaSeconds(response, "max-age");
+    const qint64 date = parseHttpDate(response.header("Date"));
+    const qint64 origin = date >= 0 ? date : now;
+    if (sharedMaxAge >= 0) {
+        lifetime = sharedMaxAge * 1000;
+    } else if (maxAge >= 0) {
+        lifetime = maxAge * 1000;
+    } else if (!response.header("Expires").isEmpty()) {
+        // An invalid date (e.g. "0") means already expired
+        const qint64 expires = parseHttpDate(response.header("Expires"));
+        lifetime = expires >= 0 ? expires - origin : 0;
+    } else {
+        // Heuristic freshness (section 4.2.2): a tenth of the time since the
+        // last change
+        const qint64 modified = parseHttpDate(response.header("Last-Modified"));
+        if (modified >= 0)
+            lifetime = qMin((origin - modified) / 10, kMaxHeuristicMs);
+    }
+    bool ok = false;
+    const qint64 age = response.header("Age").trimmed().toLongLong(&ok);
+    return now + qMax<qint64>(0, lifetime) - (ok && age > 0 ? age * 1000 : 0);
+}
+
+qint64 HttpCache::parseHttpDate(const QByteArray &value) {
+    // The three forms of RFC 9110 section 5.6.7, weekday ignored:
+    //   IMF-fixdate  Sun, 06 Nov 1994 08:49:37 GMT
+    //   RFC 850      Sunday, 06-Nov-94 08:49:37 GMT
+    //   asctime      Sun Nov  6 08:49:37 1994
+    // Qt::RFC2822Date refuses the "GMT" of the first two. "UTC" and "+0000",
+    // which some servers send, count as GMT.
+    static const char kMonths[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    QByteArray text = value.trimmed();
+    text.replace(',', ' ').replace('-', ' ');
+    const QList<QByteArray> fields = text.simplified().split(' ');
+    auto month = [](const QByteArray &name) {
+        if (name.size() != 3)
+            return 0;
+        for (int m = 0; m < 12; ++m) {
+            if (qstrnicmp(name.constData(), kMonths + 3 * m, 3) == 0)
+                return m + 1;
+        }
+        return 0;
+    };
+    auto number = [](const QByteArray &digits, int maxLength) {
+        if (digits.isEmpty() || digits.size() > maxLength)
+            return -1;
+        for (char c : digits) {
+            if (c < '0' || c > '9')
+                return -1;
+        }
+        return digits.toInt();
+    };
+
+    int day, mon, year;
+    QByteArray time;
+    if (fields.size() == 5 && month(fields.at(1))) {
+        mon = month(fields.at(1));
+        day = number(fields.at(2), 2);
+        time = fields.at(3);
+        year = fields.at(4).size() == 4 ? number(fields.at(4), 4) : -1;
+    } else if (fields.size() == 6
+               && (fields.at(5) == "GMT" || fields.at(5) == "UTC" || fields.at(5) == "+0000")) {
+        day = number(fields.at(1), 2);
+        mon = month(fields.at(2));
+        year = number(fields.at(3), 4);
+        if (fields.at(3).size() == 2 && year >= 0)
+            year += year < 70 ? 2000 : 1900;   // RFC 850 two-digit year
+        else if (fields.at(3).size() != 4)
+            year = -1;
+        time = fields.at(4);
+    } else {
+        return -1;
+    }
+    const QList<QByteArray> hms = time.split(':');
+    if (day < 0 || mon == 0 || year < 0 || hms.size() != 3)
+        return -1;
+    const QDate date(year, mon, day);
+    const QTime clock(number(hms.at(0), 2), number(hms.at(1), 2), number(hms.at(2), 2));
+    if (!date.isValid() || !clock.isValid())
+        return -1;
+    return QDateTime(date, clock, QTimeZone::UTC).toMSecsSinceEpoch();
+}
+
+HttpCache::Stats HttpCache::stats() const {
+    Stats s;
+    s.hits = m_hits.load(std::memory_order_relaxed);
+    s.revalidated = m_revalidated.load(std::memory_order_relaxed);
+    s.misses = m_misses.load(std::memory_order_relaxed);
+    s.coalesced = m_coalesced.load(std::memory_order_relaxed);
+    s.stored = m_stored.load(std::memory_order_relaxed);
+    s.bytesSaved = m_bytesSaved.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(m_lock);
+    s.entries = m_index.size();
+    s.size = m_size;
+    return s;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+class QObject;
+struct HttpHeadInfo;
+
+/**
+ * @brief On-disk cache of plain-HTTP responses (a shared-cache subset of
+ * RFC 9111), shared by all proxy workers
+ *
+ * Only complete 200 responses to GET with a Content-Length are stored, one
+ * file per response: a small binary header, the key, the response head
+ * without hop-by-hop fields, then the body as received. An in-memory LRU
+ * index over the files keeps the directory under maxBytes; it is rebuilt
+ * from the directory on construction.
+ *
+ * A response is filled while it streams to the first client (Fill), and
+ * only enters the index once its body is complete. Requests for a key that
+ * is being fetched may wait() for that fetch instead of opening their own
+ * tunnel. A stale entry with a validator is revalidated with a conditional
+ * request; a 304 refreshes it in place.
+ *
+ * Every call is safe from any thread.
+ */
+class HttpCache
+{
+public:
+    struct Entry {
+        QByteArray key;
+        QString path;
+        QByteArray head;          // stored response head, terminator included
+        qint64 bodyOffset = 0;    // where the body starts in the file
+        qint64 bodySize = 0;
+        qint64 storedAt = 0;      // ms since the epoch: received or last revalidated
+        qint64 freshUntil = 0;    // ms since the epoch
+        QByteArray etag;
+        QByteArray lastModified;
+
+        qint64 fileSize() const { return bodyOffset + bodySize; }
+        bool hasValidator() const { return !etag.isEmpty() || !lastModified.isEmpty(); }
+    };
+
+    struct Stats {
+        qint64 hits = 0;            // served fresh from disk
+        qint64 revalidated = 0;     // stale, confirmed by a 304 and served from disk
+        qint64 misses = 0;          // fetched from the origin
+        qint64 coalesced = 0;       // waited for a concurrent fetch of the same key
+        qint64 stored = 0;          // responses written to the cache
+        qint64 bytesSaved = 0;      // body bytes served from disk
+        int entries = 0;
+        qint64 size = 0;            // bytes on disk
+    };
+
+    /**
+     * @brief One origin fetch of a key; only one exists per key at a time.
+     * Destroying it without commit() discards what was written and wakes
+     * the requests waiting for the key.
+     */
+    class Fill
+    {
+    public:
+        ~Fill();
+
+        /**
+         * @brief Start storing the response whose head is @p head, if it is
+         * storable and its body of @p length bytes fits
+         * @return false if it is not stored (the fill stays valid)
+         */
+        bool begin(const QByteArray &head, const HttpHeadInfo &response, qint64 length);
+        bool isStoring() const { return m_file.isOpen(); }
+
+        /** Body bytes, in order; a write error drops the fill */
+        void append(const char *data, qint64 size);
+
+        /** The body is complete: publish the entry */
+        void commit();
+
+        /**
+         * @brief A 304 for @p entry: extend its freshness from @p response
+         * @return The refreshed entry to serve
+         */
+        std::shared_ptr<const Entry> refresh(const std::shared_ptr<const Entry> &entry,
+                                             const HttpHeadInfo &response);
+
+    private:
+        friend class HttpCache;
+        Fill(HttpCache *cache, const QByteArray &key) : m_cache(cache), m_key(key) {}
+        void discard();
+
+        HttpCache *m_cache;
+        QByteArray m_key;
+        QFile m_file;
+        Entry m_entry;
+        qint64 m_expected = 0;
+        bool m_revalidating = false;   // fetching for a Stale lookup
+        bool m_refreshed = false;      // ... and the origin answered 304
+    };
+
+    enum class Status {
+        Fresh,   // serve entry
+        Stale,   // revalidate entry through fill
+        Miss,    // fetch through fill
+        Busy     // another request is fetching the key
+    };
+
+    struct Lookup {
+        Status status = Status::Miss;
+        std::shared_ptr<const Entry> entry;
+        std::unique_ptr<Fill> fill;
+    };
+
+    /** @param maxBytes Bound on the files in @p directory */
+    HttpCache(const QString &directory, qint64 maxBytes);
+    ~HttpCache();
+
+    /**
+     * @brief Look @p key up; a Stale or Miss result makes the caller the
+     * one fetching it
+     * @param revalidate Treat a fresh entry as stale (request no-cache)
+     */
+    Lookup lookup(const QByteArray &key, bool revalidate);
+
+    /**
+     * @brief After a Busy lookup: @p done runs on @p context's thread once
+     * the fetch of @p key ends, however it ends (look up again then)
+     * @return Ticket for cancel()
+     */
+    quint64 wait(const QByteArray &key, QObject *context, std::function<void()> done);
+    void cancel(quint64 ticket);
+
+    /** @p bytes of body went to a client from disk */
+    void countServed(qint64 bytes);
+
+    /** Response head to send for @p entry, with its current Age */
+    static QByteArray responseHead(const Entry &entry);
+
+    /** Stored-response rules of RFC 9111 section 3 this cache applies */
+    static bool isStorable(const HttpHeadInfo &response);
+
+    /** Ms since the epoch until which @p response is fresh when received at @p now */
+    static qint64 freshUntil(const HttpHeadInfo &response, qint64 now);
+
+    /** An HTTP-date (RFC 9110 section 5.6.7) as ms since the epoch, -1 when invalid */
+    static qint64 parseHttpDate(const QByteArray &value);
+
+    qint64 maxBytes() const { return m_maxBytes; }
+    Stats stats() const;
+
+private:
+    struct Waiter {
+        quint64 ticket;
+        QObject *context;
+        std::function<void()> done;
+    };
+    using Lru = std::list<std::shared_ptr<const Entry>>;   // most recently used first
+
+    void load();
+    void insert(const std::shared_ptr<const Entry> &entry);
+    void replace(const std::shared_ptr<const Entry> &entry);
+    void endFill(const QByteArray &key);
+    void evictLocked();
+    QString newFilePath(const QByteArray &key);
+
+    const QString m_directory;
+    const qint64 m_maxBytes;
+    mutable std::mutex m_lock;
+    Lru m_lru;
+    QHash<QByteArray, Lru::iterator> m_index;
+    QHash<QByteArray, QList<Waiter>> m_filling;   // keys being fetched, with their waiters
+    qint64 m_size = 0;
+    quint64 m_nextTicket = 1;
+    quint64 m_nextFile = 0;
+
+    std::atomic<qint64> m_hits{0};
+    std::atomic<qint64> m_revalidated{0};
+    std::atomic<qint64> m_misses{0};
+    std::atomic<qint64> m_coalesced{0};
+    std::atomic<qint64> m_stored{0};
+    std::atomic<qint64> m_bytesSaved{0};
+};
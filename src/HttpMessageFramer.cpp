@@ -0,0 +1,201 @@
+#include "HttpMessageFramer.h"
+
+void HttpBodyFramer::reset(Mode mode, qint64 length) {
+    m_mode = mode;
+    m_remaining = mode == Mode::Length ? qMax<qint64>(0, length) : 0;
+    m_chunk = Chunk::Size;
+    m_sawDigit = false;
+    m_error = false;
+    m_complete = mode == Mode::None || (mode == Mode::Length && m_remaining == 0);
+}
+
+qint64 HttpBodyFramer::consume(const char *data, qint64 size) {
+    if (m_complete || size <= 0)
+        return 0;
+    switch (m_mode) {
+    case Mode::None:
+        return 0;
+    case Mode::Length: {
+        const qint64 n = qMin(size, m_remaining);
+        m_remaining -= n;
+        m_complete = m_remaining == 0;
+        return n;
+    }
+    case Mode::Chunked:
+        return consumeChunked(data, size);
+    case Mode::UntilClose:
+        return size;
+    case Mode::Invalid:
+        return 0;
+    }
+    return 0;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+qint64 HttpBodyFramer::consumeChunked(const char *data, qint64 size) {
+    qint64 i = 0;
+    while (i < size && !m_complete) {
+        const char c = data[i];
+        switch (m_chunk) {
+        case Chunk::Size: {
+            const int v = hexValue(c);
+            if (v >= 0) {
+                if (m_remaining > (Q_INT64_C(1) << 58)) {
+                    m_error = m_complete = true;
+                    return i;
+                }
+                m_remaining = m_remaining * 16 + v;
+                m_sawDigit = true;
+            } else if (c == ';' && m_sawDigit) {
+                m_chunk = Chunk::Extension;
+            } else if (c == '\r' && m_sawDigit) {
+                m_chunk = Chunk::SizeLf;
+            } else if (c != ' ' && c != '\t') {
+                m_error = m_complete = true;
+                return i;
+            }
+            ++i;
+            break;
+        }
+        case Chunk::Extension:
+            if (c == '\r')
+                m_chunk = Chunk::SizeLf;
+            ++i;
+            break;
+        case Chunk::SizeLf:
+            if (c != '\n') {
+                m_error = m_complete = true;
+                return i;
+            }
+            m_chunk = m_remaining == 0 ? Chunk::TrailerStart : Chunk::Data;
+            ++i;
+            break;
+        case Chunk::Data: {
+            const qint64 n = qMin(size - i, m_remaining);
+            m_remaining -= n;
+            i += n;
+            if (m_remaining == 0)
+                m_chunk = Chunk::DataCr;
+            break;
+        }
+        case Chunk::DataCr:
+            if (c != '\r') {
+                m_error = m_complete = true;
+                return i;
+            }
+            m_chunk = Chunk::DataLf;
+            ++i;
+            break;
+        case Chunk::DataLf:
+            if (c != '\n') {
+                m_error = m_complete = true;
+                return i;
+            }
+            m_chunk = Chunk::Size;
+            m_sawDigit = false;
+            ++i;
+            break;
+        case Chunk::TrailerStart:
+            m_chunk = c == '\r' ? Chunk::FinalLf : Chunk::Trailer;
+            ++i;
+            break;
+        case Chunk::Trailer:
+            if (c == '\n')
+                m_chunk = Chunk::TrailerStart;
+            ++i;
+            break;
+        case Chunk::FinalLf:
+            if (c != '\n')
+                m_error = true;
+            m_complete = true;
+            ++i;
+            break;
+        }
+    }
+    return i;
+}
+
+QByteArray HttpHeadInfo::header(const QByteArray &name) const {
+    for (const auto &h : headers) {
+        if (h.first.compare(name, Qt::CaseInsensitive) == 0)
+            return h.second;
+    }
+    return QByteArray();
+}
+
+bool HttpHeadInfo::hasToken(const QByteArray &name, const QByteArray &token) const {
+    for (const auto &h : headers) {
+        if (h.first.compare(name, Qt::CaseInsensitive) != 0)
+            continue;
+        for (const QByteArray &part : h.second.split(',')) {
+            if (part.trimmed().compare(token, Qt::CaseInsensitive) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+bool HttpHeadInfo::keepAlive() const {
+    if (hasToken("Connection", "close") || hasToken("Proxy-Connection", "close"))
+        return false;
+    if (versionMinor >= 1)
+        return true;
+    return hasToken("Connection", "keep-alive") || hasToken("Proxy-Connection", "keep-alive");
+}
+
+HttpBodyFramer::Mode HttpHeadInfo::responseFraming(bool headRequest, qint64 *length) const {
+    *length = 0;
+    if (headRequest || (status >= 100 && status < 200) || status == 204 || status == 304)
+        return HttpBodyFramer::Mode::None;
+    const QByteArray te = header("Transfer-Encoding");
+    if (!te.isEmpty()) {
+        // Only a final "chunked" coding delimits the message
+        const QByteArray last = te.mid(te.lastIndexOf(',') + 1).trimmed();
+        return last.compare("chunked", Qt::CaseInsensitive) == 0 ? HttpBodyFramer::Mode::Chunked
+                                                                 : HttpBodyFramer::Mode::UntilClose;
+    }
+    const QByteArray cl = header("Content-Length");
+    if (cl.isEmpty())
+        return HttpBodyFramer::Mode::UntilClose;
+    // Digits only: no sign, no list such as "5, 5" (RFC 9112 section 6.3)
+    if (cl.size() > 18)
+        return HttpBodyFramer::Mode::Invalid;
+    for (char c : cl) {
+        if (c < '0' || c > '9')
+            return HttpBodyFramer::Mode::Invalid;
+        *length = *length * 10 + (c - '0');
+    }
+    return HttpBodyFramer::Mode::Length;
+}
+
+bool HttpHeadInfo::parseResponse(const QByteArray &head, HttpHeadInfo *info) {
+    // Status line: HTTP/1.x SP 3DIGIT SP reason
+    const int lineEnd = head.indexOf("\r\n");
+    const QByteArray statusLine = head.left(lineEnd < 0 ? head.size() : lineEnd);
+    if (statusLine.size() < 12 || !statusLine.startsWith("HTTP/1."))
+        return false;
+    info->versionMinor = statusLine.at(7) - '0';
+    bool ok = false;
+    info->status = statusLine.mid(9, 3).toInt(&ok);
+    if (!ok)
+        return false;
+
+    info->headers.clear();
+    int pos = lineEnd < 0 ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        int end = head.indexOf("\r\n", pos);
+        if (end < 0) end = head.size();
+        if (end == pos) break;
+        const int colon = head.indexOf(':', pos);
+        if (colon > pos && colon < end)
+            info->headers.append({head.mid(pos, colon - pos).trimmed(), head.mid(colon + 1, end - colon - 1).trimmed()});
+        pos = end + 2;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+/**
+ * @brief Incremental HTTP/1.1 body framing (RFC 9112 section 6)
+ *
+ * Tells how many bytes of a stream belong to the current message body so
+ * that a keep-alive connection can carry the next message right after it.
+ * Chunked bodies are tracked byte-wise through size lines, chunk data and
+ * trailers; the payload itself is skipped in bulk.
+ */
+class HttpBodyFramer
+{
+public:
+    enum class Mode {
+        None,        // no body (e.g. GET, HEAD response, 204, 304)
+        Length,      // Content-Length
+        Chunked,     // Transfer-Encoding: chunked
+        UntilClose,  // response delimited by the server closing
+        Invalid      // unusable Content-Length / Transfer-Encoding; the connection must close
+    };
+
+    void reset(Mode mode, qint64 length = 0);
+
+    Mode mode() const { return m_mode; }
+    bool isComplete() const { return m_complete; }
+    bool hasError() const { return m_error; }
+
+    /**
+     * @brief Advance over the body
+     * @return Number of leading bytes of @p data that belong to the body;
+     * fewer than @p size only once the body is complete (or malformed)
+     */
+    qint64 consume(const char *data, qint64 size);
+
+private:
+    enum class Chunk { Size, Extension, SizeLf, Data, DataCr, DataLf, TrailerStart, Trailer, FinalLf };
+
+    qint64 consumeChunked(const char *data, qint64 size);
+
+    Mode m_mode = Mode::None;
+    qint64 m_remaining = 0;
+    Chunk m_chunk = Chunk::Size;
+    bool m_sawDigit = false;
+    bool m_complete = true;
+    bool m_error = false;
+};
+
+/**
+ * @brief What the proxy needs to know about a parsed HTTP/1.x response
+ * head (requests go through HttpRequestParser)
+ */
+struct HttpHeadInfo {
+    int status = 0;
+    int versionMinor = 1;                           // HTTP/1.<minor>
+    QList<QPair<QByteArray, QByteArray>> headers;   // in wire order, original case
+
+    QByteArray header(const QByteArray &name) const;
+    bool hasToken(const QByteArray &name, const QByteArray &token) const;
+
+    /** Persistent connection per RFC 9112 section 9.3 */
+    bool keepAlive() const;
+    /** Invalid for a Content-Length that is not a single decimal number */
+    HttpBodyFramer::Mode responseFraming(bool headRequest, qint64 *length) const;
+
+    static bool parseResponse(const QByteArray &head, HttpHeadInfo *info);
+};
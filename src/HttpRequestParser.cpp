@@ -0,0 +1,301 @@
+#include "HttpRequestParser.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PAQET_HAVE_SSE2 1
+#endif
+
+static bool equalsNoCase(QByteArrayView a, QByteArrayView b) {
+    return a.size() == b.size() && qstrnicmp(a.data(), a.size(), b.data(), b.size()) == 0;
+}
+
+static bool startsWithNoCase(QByteArrayView text, QByteArrayView prefix) {
+    return text.size() >= prefix.size() && equalsNoCase(text.first(prefix.size()), prefix);
+}
+
+static QByteArrayView trimmed(QByteArrayView v) {
+    qsizetype begin = 0;
+    qsizetype end = v.size();
+    while (begin < end && (v[begin] == ' ' || v[begin] == '\t'))
+        ++begin;
+    while (end > begin && (v[end - 1] == ' ' || v[end - 1] == '\t' || v[end - 1] == '\r'))
+        --end;
+    return v.sliced(begin, end - begin);
+}
+
+/** Non-negative decimal, false on anything else (including overflow) */
+static bool parseDecimal(QByteArrayView v, qint64 *out) {
+    if (v.isEmpty() || v.size() > 18)
+        return false;
+    qint64 n = 0;
+    for (char c : v) {
+        if (c < '0' || c > '9')
+            return false;
+        n = n * 10 + (c - '0');
+    }
+    *out = n;
+    return true;
+}
+
+void HttpRequestParser::reset() {
+    m_scanned = 0;
+    m_headLength = 0;
+    m_lineBegin = 0;
+    m_method = {};
+    m_target = {};
+    m_version = {};
+    m_versionMinor = 1;
+    m_headers.clear();
+}
+
+qsizetype HttpRequestParser::findHeadEnd(const char *data, qsizetype size, qsizetype from) {
+    // Look for the final LF of "\r\n\r\n" and confirm the three bytes before it
+    qsizetype i = qMax<qsizetype>(from, 3);
+#ifdef PAQET_HAVE_SSE2
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+        while (mask) {
+            const qsizetype p = i + qCountTrailingZeroBits(mask);
+            if (data[p - 1] == '\r' && data[p - 2] == '\n' && data[p - 3] == '\r')
+                return p + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    // Tail (or the whole range without SSE2): memchr is vectorized by libc
+    while (i < size) {
+        const void *hit = std::memchr(data + i, '\n', static_cast<size_t>(size - i));
+        if (!hit)
+            break;
+        const qsizetype p = static_cast<const char *>(hit) - data;
+        if (data[p - 1] == '\r' && data[p - 2] == '\n' && data[p - 3] == '\r')
+            return p + 1;
+        i = p + 1;
+    }
+    return -1;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse(const QByteArray &buffer) {
+    if (m_headLength > 0)
+        return Status::Complete;
+
+    const char *data = buffer.constData();
+    const qsizetype size = buffer.size();
+
+    // Stray CRLFs between pipelined requests are allowed before the request line
+    if (m_scanned <= m_lineBegin) {
+        while (m_lineBegin < size && (data[m_lineBegin] == '\r' || data[m_lineBegin] == '\n'))
+            ++m_lineBegin;
+        m_scanned = m_lineBegin;
+    }
+
+    const qsizetype end = findHeadEnd(data + m_lineBegin, size - m_lineBegin, m_scanned - m_lineBegin);
+    if (end < 0) {
+        // Every LF seen so far was checked with its three predecessors
+        m_scanned = size;
+        return size > m_maxHead ? Status::TooLarge : Status::Incomplete;
+    }
+    if (m_lineBegin + end > m_maxHead)
+        return Status::TooLarge;
+    m_headLength = m_lineBegin + end;
+    return parseHead(data) ? Status::Complete : Status::Invalid;
+}
+
+bool HttpRequestParser::parseHead(const char *data) {
+    const char *p = data + m_lineBegin;
+    const char *end = data + m_headLength;
+
+    // Request line: method SP target SP HTTP/1.x
+    const char *eol = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    const QByteArrayView line = trimmed(QByteArrayView(p, eol - p));
+    const qsizetype sp1 = line.indexOf(' ');
+    const qsizetype sp2 = sp1 < 0 ? -1 : line.lastIndexOf(' ');
+    if (sp1 <= 0 || sp2 <= sp1 + 1)
+        return false;
+    m_method = line.first(sp1);
+    m_target = line.sliced(sp1 + 1, sp2 - sp1 - 1);
+    m_version = line.sliced(sp2 + 1);
+    if (m_version.size() != 8 || !m_version.startsWith("HTTP/1.") || m_version[7] < '0' || m_version[7] > '9')
+        return false;
+    m_versionMinor = m_version[7] - '0';
+
+    // Header fields, up to the empty line
+    m_headers.clear();
+    p = eol + 1;
+    while (p < end) {
+        eol = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const QByteArrayView field(p, eol - p);
+        if (field.isEmpty() || (field.size() == 1 && field[0] == '\r'))
+            break;
+        const qsizetype colon = field.indexOf(':');
+        if (colon > 0) {
+            Header h;
+            h.name = trimmed(field.first(colon));
+            h.value = trimmed(field.sliced(colon + 1));
+            h.lineBegin = p - data;
+            h.lineEnd = eol + 1 - data;
+            m_headers.append(h);
+        }
+        p = eol + 1;
+    }
+    return true;
+}
+
+bool HttpRequestParser::isConnect() const {
+    return m_method.size() == 7 && std::memcmp(m_method.data(), "CONNECT", 7) == 0;
+}
+
+bool HttpRequestParser::isHead() const {
+    return m_method.size() == 4 && std::memcmp(m_method.data(), "HEAD", 4) == 0;
+}
+
+bool HttpRequestParser::isGet() const {
+    return m_method.size() == 3 && std::memcmp(m_method.data(), "GET", 3) == 0;
+}
+
+QByteArrayView HttpRequestParser::header(QByteArrayView name) const {
+    for (const Header &h : m_headers) {
+        if (equalsNoCase(h.name, name))
+            return h.value;
+    }
+    return {};
+}
+
+bool HttpRequestParser::hasToken(QByteArrayView name, QByteArrayView token) const {
+    for (const Header &h : m_headers) {
+        if (!equalsNoCase(h.name, name))
+            continue;
+        QByteArrayView rest = h.value;
+        while (!rest.isEmpty()) {
+            const qsizetype comma = rest.indexOf(',');
+            const QByteArrayView part = comma < 0 ? rest : rest.first(comma);
+            if (equalsNoCase(trimmed(part), token))
+                return true;
+            rest = comma < 0 ? QByteArrayView() : rest.sliced(comma + 1);
+        }
+    }
+    return false;
+}
+
+bool HttpRequestParser::keepAlive() const {
+    if (hasToken("Connection", "close") || hasToken("Proxy-Connection", "close"))
+        return false;
+    if (m_versionMinor >= 1)
+        return true;
+    return hasToken("Connection", "keep-alive") || hasToken("Proxy-Connection", "keep-alive");
+}
+
+HttpBodyFramer::Mode HttpRequestParser::bodyFraming(qint64 *length) const {
+    *length = 0;
+    const QByteArrayView te = header("Transfer-Encoding");
+    if (!te.isEmpty()) {
+        // The length of a request is unknowable unless chunked is the final coding
+        const qsizetype comma = te.lastIndexOf(',');
+        return equalsNoCase(trimmed(comma < 0 ? te : te.sliced(comma + 1)), "chunked")
+            ? HttpBodyFramer::Mode::Chunked : HttpBodyFramer::Mode::Invalid;
+    }
+    const QByteArrayView cl = header("Content-Length");
+    if (cl.isEmpty())
+        return HttpBodyFramer::Mode::None;
+    if (!parseDecimal(cl, length))
+        return HttpBodyFramer::Mode::Invalid;   // sign, list ("5, 5") or garbage
+    return *length > 0 ? HttpBodyFramer::Mode::Length : HttpBodyFramer::Mode::None;
+}
+
+bool HttpRequestParser::destination(QByteArrayView *host, quint16 *port) const {
+    QByteArrayView authority;
+    quint16 defaultPort = 80;
+    if (isConnect()) {
+        authority = m_target;
+        defaultPort = 443;
+    } else if (startsWithNoCase(m_target, "http://")) {
+        authority = m_target.sliced(7);
+        for (qsizetype i = 0; i < authority.size(); ++i) {
+            if (authority[i] == '/' || authority[i] == '?' || authority[i] == '#') {
+                authority = authority.first(i);
+                break;
+            }
+        }
+    } else {
+        authority = header("Host");
+    }
+
+    // host, host:port, [v6] or [v6]:port
+    QByteArrayView portText;
+    if (authority.startsWith('[')) {
+        const qsizetype close = authority.indexOf(']');
+        if (close < 0)
+            return false;
+        *host = authority.sliced(1, close - 1);
+        if (close + 1 < authority.size() && authority[close + 1] == ':')
+            portText = authority.sliced(close + 2);
+    } else {
+        const qsizetype colon = authority.lastIndexOf(':');
+        *host = colon < 0 ? authority : authority.first(colon);
+        if (colon >= 0)
+            portText = authority.sliced(colon + 1);
+    }
+    *port = defaultPort;
+    qint64 value = 0;
+    if (!portText.isEmpty()) {
+        if (!parseDecimal(portText, &value) || value == 0 || value > 65535)
+            return false;
+        *port = static_cast<quint16>(value);
+    }
+    return !host->isEmpty();
+}
+
+qsizetype HttpRequestParser::rewriteForOrigin(QByteArray &buffer) {
+    struct Span { qsizetype begin; qsizetype end; };
+    QVarLengthArray<Span, 40> keep;
+
+    const char *base = buffer.constData();
+    const qsizetype targetBegin = m_target.data() - base;
+    const qsizetype targetEnd = targetBegin + m_target.size();
+    bool changed = false;
+
+    // Request line up to the target
+    keep.append({m_lineBegin, targetBegin});
+    if (!isConnect() && startsWithNoCase(m_target, "http://")) {
+        qsizetype path = targetBegin + 7;
+        while (path < targetEnd && base[path] != '/' && base[path] != '?')
+            ++path;
+        if (path == targetEnd || base[path] != '/')
+            keep.append({targetBegin + 6, targetBegin + 7});  // the second '/' of "http://"
+        keep.append({path, targetEnd});
+        changed = true;
+    } else {
+        keep.append({targetBegin, targetEnd});
+    }
+    const qsizetype lineEnd = m_headers.isEmpty() ? m_headLength - 2 : m_headers.first().lineBegin;
+    keep.append({targetEnd, lineEnd});
+
+    for (const Header &h : m_headers) {
+        if (startsWithNoCase(h.name, "proxy-")) {
+            changed = true;
+            continue;
+        }
+        keep.append({h.lineBegin, h.lineEnd});
+    }
+    keep.append({m_headLength - 2, m_headLength});
+
+    m_method = m_target = m_version = {};
+    m_headers.clear();
+    if (!changed)
+        return m_lineBegin;
+
+    // Pack right-to-left against the end of the head: every span moves
+    // towards higher offsets, so no unread span is overwritten
+    char *data = buffer.data();
+    qsizetype dst = m_headLength;
+    for (qsizetype i = keep.size() - 1; i >= 0; --i) {
+        const qsizetype len = keep[i].end - keep[i].begin;
+        dst -= len;
+        if (dst != keep[i].begin)
+            std::memmove(data + dst, data + keep[i].begin, static_cast<size_t>(len));
+    }
+    return dst;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "HttpMessageFramer.h"
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QVarLengthArray>
+
+/**
+ * @brief Incremental, allocation-free HTTP/1.x request-head parser
+ *
+ * parse() is called with the connection's receive buffer every time it
+ * grows; only bytes not seen before are scanned for the end of the head.
+ * Once the head is complete, the request line and the headers are exposed
+ * as views into that buffer, valid until the buffer is modified.
+ */
+class HttpRequestParser
+{
+public:
+    enum class Status {
+        Incomplete,   // need more bytes
+        Complete,     // head parsed, views are valid
+        Invalid,      // malformed request line
+        TooLarge      // head exceeds the limit without terminating
+    };
+
+    struct Header {
+        QByteArrayView name;
+        QByteArrayView value;       // without surrounding whitespace
+        qsizetype lineBegin = 0;    // offsets of the whole line, CRLF included
+        qsizetype lineEnd = 0;
+    };
+
+    explicit HttpRequestParser(qsizetype maxHead = 64 * 1024) : m_maxHead(maxHead) {}
+
+    /** Forget the current head, e.g. once it has been removed from the buffer */
+    void reset();
+
+    Status parse(const QByteArray &buffer);
+
+    /** Bytes the head occupies at the front of the buffer (terminator included) */
+    qsizetype headLength() const { return m_headLength; }
+
+    QByteArrayView method() const { return m_method; }
+    QByteArrayView target() const { return m_target; }
+    QByteArrayView version() const { return m_version; }
+    int versionMinor() const { return m_versionMinor; }
+    const QVarLengthArray<Header, 32> &headers() const { return m_headers; }
+
+    bool isConnect() const;
+    bool isHead() const;
+    bool isGet() const;
+
+    QByteArrayView header(QByteArrayView name) const;
+    bool hasToken(QByteArrayView name, QByteArrayView token) const;
+
+    /** Persistent connection per RFC 9112 section 9.3 (Proxy-Connection honoured) */
+    bool keepAlive() const;
+    /**
+     * @brief Request body framing; Invalid for a Content-Length that is not
+     * a single decimal number or a Transfer-Encoding not ending in chunked
+     */
+    HttpBodyFramer::Mode bodyFraming(qint64 *length) const;
+
+    /**
+     * @brief Where the request goes: the CONNECT authority, the authority
+     * of an absolute-form target, or the Host header
+     * @return false if there is no usable host
+     */
+    bool destination(QByteArrayView *host, quint16 *port) const;
+
+    /**
+     * @brief Rewrite the head in place for the origin server: an
+     * absolute-form target becomes origin-form and Proxy-* headers go.
+     * The result is packed against the end of the original head, so it is
+     * immediately followed by the body bytes.
+     * @return Offset in @p buffer where the rewritten head starts; it ends
+     * at headLength(). Views are invalid afterwards.
+     */
+    qsizetype rewriteForOrigin(QByteArray &buffer);
+
+    /**
+     * @brief Find "\r\n\r\n" whose final LF is at or after @p from
+     * @return Offset just past the terminator, or -1
+     */
+    static qsizetype findHeadEnd(const char *data, qsizetype size, qsizetype from);
+
+private:
+    bool parseHead(const char *data);
+
+    qsizetype m_maxHead;
+    qsizetype m_scanned = 0;      // bytes already searched for the terminator
+    qsizetype m_headLength = 0;
+    qsizetype m_lineBegin = 0;    // request line start (after stray leading CRLFs)
+    QByteArrayView m_method;
+    QByteArrayView m_target;
+    QByteArrayView m_version;
+    int m_versionMinor = 1;
+    QVarLengthArray<Header, 32> m_headers;
+};
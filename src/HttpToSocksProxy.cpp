@@ -1,50 +1,271 @@
 #include "HttpToSocksProxy.h"
+#include "AllocCounter.h"
+#include "BufferPool.h"
+#include "ClientLimiter.h"
+#include "ConnectGate.h"
+#include "EpollRelay.h"
+#include "HttpCache.h"
+#include "HttpMessageFramer.h"
+#include "HttpRequestParser.h"
 #include "LogBuffer.h"
+#include "OriginTunnelPool.h"
+#include "PreconnectPool.h"
+#include "RangeDownload.h"
+#include "RelayScheduler.h"
+#include "Socks5.h"
+#include "SocksConnectionPool.h"
+#include "SpliceRelay.h"
+#include "TimerWheel.h"
+#include "TrafficCounters.h"
+#include "UpstreamBalancer.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QHostAddress>
 #include <QRegularExpression>
-#include <QUrl>
+#include <QStringList>
 #include <QMetaObject>
-
-// SOCKS5 constants
-static constexpr quint8 SOCKS5_VERSION = 0x05;
-static constexpr quint8 SOCKS5_AUTH_NONE = 0x00;
-static constexpr quint8 SOCKS5_CMD_CONNECT = 0x01;
-static constexpr quint8 SOCKS5_ATYP_DOMAIN = 0x03;
-static constexpr quint8 SOCKS5_ATYP_IPV4 = 0x01;
+#include <QPointer>
+#include <QTimer>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+// Relay tuning
+static constexpr qint64 kSocketReadBuffer = 256 * 1024;   // per-socket Qt read buffer cap
+static constexpr qint64 kRelayChunk = 64 * 1024;          // bytes moved per read()
+static constexpr int kMaxRequestHead = 64 * 1024;         // request line + headers
+static constexpr int kMaxResponseHead = 64 * 1024;        // status line + headers
+static constexpr int kBudgetRetryMs = 50;                 // re-check while the global budget is exhausted
+static constexpr int kMaxWorkers = 64;
+static constexpr int kTimerWheelSlots = 512;              // one revolution = 512 ticks
+static constexpr int kTimerTickMs = 1000;                 // timeout resolution
+static constexpr int kCloseLingerMs = 5000;               // after an error reply, before a hard close
+static constexpr int kCacheWaitMs = 10000;                // for a concurrent fetch of the same resource
+
+static std::atomic<quint64> s_nextConnectionId{1};
+
+static const QByteArray kConnectEstablished = QByteArrayLiteral("HTTP/1.1 200 Connection Established\r\n\r\n");
 
 class ProxyServerRunner;
 
+/**
+ * @brief Proxy-wide accept-rate token bucket, shared by every listener
+ */
+struct AcceptGuard {
+    std::mutex lock;
+    qint64 perSecond = 0;      // 0 = unlimited
+    qint64 milliTokens = 0;    // 1000 per accept
+    qint64 refilledAt = 0;
+    QElapsedTimer clock;
+
+    void reset(qint64 rate) {
+        std::lock_guard<std::mutex> guard(lock);
+        perSecond = qMax<qint64>(0, rate);
+        milliTokens = burst();
+        clock.start();
+        refilledAt = 0;
+    }
+
+    /**
+     * @brief Count one accept
+     * @return 0, or how long the listener should pause once the bucket is dry
+     */
+    int take() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (perSecond == 0)
+            return 0;
+        const qint64 now = clock.elapsed();
+        milliTokens = qMin(burst(), milliTokens + (now - refilledAt) * perSecond);
+        refilledAt = now;
+        milliTokens -= 1000;
+        if (milliTokens > 0)
+            return 0;
+        // Until one accept's worth has refilled
+        return static_cast<int>(qBound<qint64>(1, (1000 - milliTokens) / perSecond + 1, 1000));
+    }
+
+private:
+    qint64 burst() const { return qMax<qint64>(perSecond, 16) * 1000; }   // one second's worth
+};
+
+/**
+ * @brief Proxy-wide write-queue accounting shared by all workers
+ */
+struct RelayBudget {
+    std::atomic<qint64> queuedBytes{0};      // bytes sitting in socket write buffers
+    std::atomic<qint64> throttleEvents{0};   // times any connection paused a source
+    std::atomic<qint64> reaped[4]{};         // connections closed per HttpToSocksProxy::ReapReason
+    std::atomic<qint64> routed[3]{};         // requests per RoutingRules::Action
+    std::atomic<qint64> blocked{0};          // requests refused by the domain blocklist
+    std::atomic<qint64> classBytes[2]{};     // bytes relayed as interactive [0] / bulk [1]
+    std::atomic<qint64> deniedClients{0};    // accepted descriptors closed by the allow-list
+    std::atomic<qint64> acceptPauses{0};     // listener pauses for the accept rate
+    PreconnectPool::Counters preconnect;     // speculative tunnels of all workers
+    AcceptGuard acceptGuard;
+    qint64 limit = 0;                        // 0 = unlimited
+
+    bool exhausted() const {
+        return limit > 0 && queuedBytes.load(std::memory_order_relaxed) >= limit;
+    }
+};
+
+/**
+ * @brief Per-worker state shared by all connections of one ProxyServerRunner
+ */
+struct WorkerContext {
+    HttpToSocksProxy::Options options;
+    RelayBudget *budget = nullptr;
+    TrafficCounters *traffic = nullptr;   // this worker's byte counters
+    UpstreamBalancer *upstreams = nullptr;  // SOCKS endpoints, shared by all workers
+    QList<SocksConnectionPool *> pools;   // warm greeted sockets per upstream, empty when off
+    OriginTunnelPool *originPool = nullptr;  // idle keep-alive tunnels by origin, may be null
+    PreconnectPool *preconnect = nullptr;  // speculative tunnels to popular targets, may be null
+    TimerWheel *timers = nullptr;         // connection timeouts, ticked by the worker
+    RelayScheduler *scheduler = nullptr;  // interactive-first relay order, driven by the worker
+    BufferPool *buffers = nullptr;        // this worker's relay I/O slabs
+    ClientLimiter *clients = nullptr;     // per-source-IP statistics and limits, shared
+    ConnectGate *connectGate = nullptr;   // cap on concurrent tunnels, shared, may be null
+    HttpCache *cache = nullptr;           // plain-HTTP response cache, shared, may be null
+    EpollRelay *nativeRelay = nullptr;    // tunnel engine when RelayEngine::Native is in use
+    std::function<void(const QString &)> log;
+};
+
 /**
  * @brief Handles a single client connection (used from worker thread)
+ *
+ * Once tunneling, each direction is relayed with backpressure: when the
+ * sink's write queue passes the high watermark (or the proxy-wide budget is
+ * spent) we stop reading from the source, whose bounded Qt read buffer then
+ * fills and lets TCP flow control push back on the peer. Reading resumes
+ * from bytesWritten() once the sink drains below the low watermark.
+ * Flows the worker's RelayScheduler demotes to bulk get a lower high
+ * watermark and wait for the scheduler when its per-turn bulk quota is
+ * spent, so short interactive exchanges are not queued behind downloads.
+ * A client over its per-IP rate stops being read until its bucket refills.
+ *
+ * Exactly one timeout is armed at a time on the worker's timer wheel:
+ * header-read while a request head is awaited, handshake while the SOCKS
+ * side is set up, idle (no byte relayed either way) afterwards.
  */
 class HttpToSocksProxy::ClientConnection : public QObject
 {
     Q_OBJECT
 public:
-    using LogFunc = std::function<void(const QString &)>;
-
-    ClientConnection(QTcpSocket *clientSocket, const QString &socksHost, quint16 socksPort,
-                     LogFunc logFunc, QObject *parent)
+    ClientConnection(QTcpSocket *clientSocket, WorkerContext *context, QObject *parent)
         : QObject(parent)
         , m_client(clientSocket)
-        , m_socksHost(socksHost)
-        , m_socksPort(socksPort)
-        , m_logFunc(std::move(logFunc))
+        , m_ctx(context)
+        , m_id(s_nextConnectionId.fetch_add(1, std::memory_order_relaxed))
+        , m_peer(clientSocket->peerAddress())
+        , m_startedMs(QDateTime::currentMSecsSinceEpoch())
     {
         m_client->setParent(this);
-        m_socks = new QTcpSocket(this);
+        m_client->setReadBufferSize(kSocketReadBuffer);
 
         connect(m_client, &QTcpSocket::readyRead, this, &ClientConnection::onClientReadyRead);
+        connect(m_client, &QTcpSocket::bytesWritten, this, &ClientConnection::onClientBytesWritten);
         connect(m_client, &QTcpSocket::disconnected, this, &ClientConnection::onClientDisconnected);
-        connect(m_socks, &QTcpSocket::connected, this, &ClientConnection::onSocksConnected);
-        connect(m_socks, &QTcpSocket::readyRead, this, &ClientConnection::onSocksReadyRead);
-        connect(m_socks, &QTcpSocket::disconnected, this, &ClientConnection::onSocksDisconnected);
-        connect(m_socks, &QTcpSocket::errorOccurred, this, &ClientConnection::onSocksError);
+        attachSocks(new QTcpSocket(this));
+
+        m_timeout.onExpired = [this]() { onTimeout(); };
+        m_lastActivity = m_ctx->timers->now();
+        armTimeout(HttpToSocksProxy::HeaderTimeout);
+        if (m_ctx->clients) {
+            // Refused once the request is read, so the client gets a reply
+            m_clientLimit = m_ctx->clients->enter(m_peer, &m_overClientLimit);
+            if (m_ctx->clients->isRateLimited())
+                m_rateLimit = m_clientLimit.get();
+        }
     }
 
     ~ClientConnection() override {
-        if (m_client) m_client->close();
-        if (m_socks) m_socks->close();
+        m_ctx->timers->cancel(&m_timeout);
+        if (m_deferred[Upstream] || m_deferred[Downstream])
+            m_ctx->scheduler->cancel(this);
+        releaseUpstream();
+        leaveConnectGate();
+        if (m_cacheTicket != 0)
+            m_ctx->cache->cancel(m_cacheTicket);
+        if (m_ctx->clients)
+            m_ctx->clients->leave(m_clientLimit);
+        m_client->disconnect(this);
+        m_socks->disconnect(this);
+        // Whatever is still queued dies with the sockets
+        release(m_queued[Upstream], m_queued[Upstream]);
+        release(m_queued[Downstream], m_queued[Downstream]);
+        m_client->close();
+        m_socks->close();
+    }
+
+    /**
+     * @brief How many times this connection paused a source for backpressure
+     */
+    int throttleCount() const { return m_throttleCount; }
+
+    /** Bytes sent towards the upstream / the client so far */
+    qint64 bytesUp() const { return m_bytes[Upstream]; }
+    qint64 bytesDown() const { return m_bytes[Downstream]; }
+
+    quint64 id() const { return m_id; }
+
+    /**
+     * @brief Add this connection to @p batch: as added on the first call
+     * after setPublished(false), as changed when something it shows moved
+     */
+    void publishInto(HttpToSocksProxy::ConnectionBatch &batch) {
+        const HttpToSocksProxy::ConnectionPhase phase = this->phase();
+        if (m_published && phase == m_publishedPhase && m_targetPort == m_publishedPort
+            && m_bytes[Upstream] == m_publishedBytes[Upstream]
+            && m_bytes[Downstream] == m_publishedBytes[Downstream]
+            && m_targetHost == m_publishedHost) {
+            return;
+        }
+        HttpToSocksProxy::ConnectionInfo info;
+        info.id = m_id;
+        if (!m_targetHost.isEmpty())
+            info.target = QStringLiteral("%1:%2").arg(m_targetHost).arg(m_targetPort);
+        info.startedMs = m_startedMs;
+        info.bytesUp = m_bytes[Upstream];
+        info.bytesDown = m_bytes[Downstream];
+        info.phase = phase;
+        if (m_published) {
+            batch.changed.append(info);
+        } else {
+            info.client = m_peer.toString();
+            batch.added.append(info);
+            m_published = true;
+        }
+        m_publishedPhase = phase;
+        m_publishedHost = m_targetHost;
+        m_publishedPort = m_targetPort;
+        m_publishedBytes[Upstream] = m_bytes[Upstream];
+        m_publishedBytes[Downstream] = m_bytes[Downstream];
+    }
+
+    bool isPublished() const { return m_published; }
+    void setPublished(bool published) { m_published = published; }
+
+    /**
+     * @brief Continue direction @p dir parked with the scheduler by defer()
+     */
+    void resumeDeferred(int dir) {
+        m_deferred[dir] = false;
+        resumeRelay(static_cast<Direction>(dir));
     }
 
 signals:
@@ -52,357 +273,2147 @@ signals:
 
 private slots:
     void onClientReadyRead() {
-        if (m_tunnelEstablished) {
-            // Tunnel mode - just forward data
-            QByteArray data = m_client->readAll();
-            if (m_socks->state() == QAbstractSocket::ConnectedState) {
-                m_socks->write(data);
-            }
+        switch (m_state) {
+        case State::Tunneling:
+        case State::Forwarding:
+            relay(Upstream);
             return;
+        case State::WaitingForRequest:
+            break;
+        default:
+            return;  // stays in the socket buffer until the upstream is ready
         }
 
-        // Read HTTP request
         m_requestBuffer.append(m_client->readAll());
+        if (m_timeoutReason == HttpToSocksProxy::IdleTimeout)
+            armTimeout(HttpToSocksProxy::HeaderTimeout);  // next request on a kept-alive connection
+        if (!m_sniffed && !m_requestBuffer.isEmpty()) {
+            // No HTTP method starts with 0x05
+            m_sniffed = true;
+            m_socksClient = static_cast<quint8>(m_requestBuffer[0]) == SOCKS5_VERSION;
+        }
+        if (m_socksClient)
+            processSocksRequest();
+        else
+            processRequest();
+    }
 
-        // Check if we have complete headers
-        int headerEnd = m_requestBuffer.indexOf("\r\n\r\n");
-        if (headerEnd == -1) {
-            return; // Wait for more data
+    void onSocksConnected() {
+        if (m_direct) {
+            upstreamEstablished();
+            return;
+        }
+        if (m_optimistic) {
+            // Pipelined: greeting and CONNECT in one write, replies are read in order
+            write(Upstream, socks5Greeting() + socks5ConnectRequest(m_targetHost, m_targetPort));
+            m_greetingPending = true;
+            m_state = State::SocksConnectRequest;
+            return;
         }
+        write(Upstream, socks5Greeting());
+        m_state = State::SocksGreeting;
+    }
 
-        // Parse the request line
-        int firstLineEnd = m_requestBuffer.indexOf("\r\n");
-        QString requestLine = QString::fromUtf8(m_requestBuffer.left(firstLineEnd));
-        
-        QStringList parts = requestLine.split(' ');
-        if (parts.size() < 3) {
-            sendError(400, "Bad Request");
+    void onSocksReadyRead() {
+        if (m_state == State::Tunneling || m_state == State::Forwarding) {
+            relay(Downstream);
             return;
         }
 
-        m_method = parts[0].toUpper();
-        m_requestUrl = parts[1];
-        m_httpVersion = parts[2];
+        m_socksBuffer.append(m_socks->readAll());
 
-        // Parse headers
-        QString headersStr = QString::fromUtf8(m_requestBuffer.mid(firstLineEnd + 2, headerEnd - firstLineEnd - 2));
-        QStringList headerLines = headersStr.split("\r\n");
-        for (const QString &line : headerLines) {
-            int colonPos = line.indexOf(':');
-            if (colonPos > 0) {
-                QString key = line.left(colonPos).trimmed().toLower();
-                QString value = line.mid(colonPos + 1).trimmed();
-                m_headers.insert(key, value);
-            }
+        switch (m_state) {
+        case State::SocksGreeting:
+            handleSocksGreeting();
+            break;
+        case State::SocksConnectRequest:
+            handleSocksConnectResponse();
+            break;
+        default:
+            break;
         }
+    }
+
+    void onClientBytesWritten(qint64 bytes) {
+        release(m_queued[Downstream], bytes);
+        if (m_paused[Downstream] && m_client->bytesToWrite() <= lowWatermark())
+            relay(Downstream);
+        closeIfDrained();
+        maybeStartSplice();
+    }
+
+    void onSocksBytesWritten(qint64 bytes) {
+        release(m_queued[Upstream], bytes);
+        if (m_paused[Upstream] && m_socks->bytesToWrite() <= lowWatermark())
+            relay(Upstream);
+        closeIfDrained();
+        maybeStartSplice();
+    }
 
-        // Store body if present
-        m_requestBody = m_requestBuffer.mid(headerEnd + 4);
+    void onClientDisconnected() {
+        m_clientEof = true;
+        if (m_state == State::Tunneling || m_state == State::Forwarding)
+            relay(Upstream);
+        closeIfDrained();
+    }
 
-        // Extract target host and port
-        if (m_method == QLatin1String("CONNECT")) {
-            // CONNECT host:port HTTP/1.1
-            QStringList hostPort = m_requestUrl.split(':');
-            m_targetHost = hostPort[0];
-            m_targetPort = hostPort.size() > 1 ? hostPort[1].toUShort() : 443;
-            m_isConnect = true;
+    void onSocksDisconnected() {
+        if (m_state == State::Forwarding) {
+            upstreamClosedWhileForwarding();
+            return;
+        }
+        m_socksEof = true;
+        if (m_state == State::Tunneling) {
+            relay(Downstream);
+        } else if (isHandshaking()) {
+            if (retryOnAnotherUpstream(true))
+                return;
+            sendError(502, "Bad Gateway - SOCKS connection closed");
         } else {
-            // Regular HTTP request - extract from URL or Host header
-            if (m_requestUrl.startsWith(QLatin1String("http://"))) {
-                QUrl url(m_requestUrl);
-                m_targetHost = url.host();
-                m_targetPort = url.port(80);
-                // Rewrite URL to relative path for the request we send to the target
-                m_requestUrl = url.path();
-                if (m_requestUrl.isEmpty()) m_requestUrl = QStringLiteral("/");
-                if (!url.query().isEmpty()) {
-                    m_requestUrl += QStringLiteral("?") + url.query();
-                }
-            } else {
-                QString host = m_headers.value(QStringLiteral("host"));
-                QStringList hostPort = host.split(':');
-                m_targetHost = hostPort[0];
-                m_targetPort = hostPort.size() > 1 ? hostPort[1].toUShort() : 80;
-            }
-            m_isConnect = false;
+            sendError(502, "Bad Gateway - SOCKS connection closed");
         }
+        closeIfDrained();
+    }
 
-        if (m_targetHost.isEmpty()) {
-            sendError(400, "Bad Request - No host");
+    void onSocksError(QAbstractSocket::SocketError error) {
+        if (m_state == State::Forwarding) {
+            if (m_socks->state() == QAbstractSocket::UnconnectedState)
+                upstreamClosedWhileForwarding();
             return;
         }
+        if (m_state != State::Tunneling && error != QAbstractSocket::RemoteHostClosedError) {
+            log(QStringLiteral("[HTTP2SOCKS] SOCKS error: %1").arg(m_socks->errorString()));
+            if (isHandshaking() && retryOnAnotherUpstream(true))
+                return;  // the failed socket is gone, a new attempt is running
+            sendError(502, "Bad Gateway - SOCKS connection failed");
+        }
+        // disconnected() only follows for sockets that were connected
+        if (m_socks->state() == QAbstractSocket::UnconnectedState) {
+            m_socksEof = true;
+            closeIfDrained();
+        }
+    }
 
-        log(QStringLiteral("[HTTP2SOCKS] %1 %2:%3").arg(m_method, m_targetHost).arg(m_targetPort));
+private:
+    void attachSocks(QTcpSocket *socket) {
+        m_socks = socket;
+        m_socksEof = false;
+        m_socks->setParent(this);
+        m_socks->setReadBufferSize(kSocketReadBuffer);
+        connect(m_socks, &QTcpSocket::connected, this, &ClientConnection::onSocksConnected);
+        connect(m_socks, &QTcpSocket::readyRead, this, &ClientConnection::onSocksReadyRead);
+        connect(m_socks, &QTcpSocket::bytesWritten, this, &ClientConnection::onSocksBytesWritten);
+        connect(m_socks, &QTcpSocket::disconnected, this, &ClientConnection::onSocksDisconnected);
+        connect(m_socks, &QTcpSocket::errorOccurred, this, &ClientConnection::onSocksError);
+    }
 
-        // Connect to SOCKS5 proxy
+    /**
+     * @brief Start the SOCKS side on the upstream the balancer picks, with
+     * every upstream eligible again
+     */
+    void openUpstream() {
+        if (m_direct) {
+            openDirect();
+            return;
+        }
+        // Not again once admitted by the gate: the visit was counted already
+        if (m_isConnect && !m_gateSlot && takePreconnected())
+            return;
+        if (!enterConnectGate())
+            return;
+        m_triedUpstreams = 0;
+        m_upstreamAttempts = 0;
+        openUpstream(m_ctx->upstreams->pick());
+    }
+
+    /**
+     * @brief Adopt a tunnel PreconnectPool set up ahead of this CONNECT,
+     * together with its upstream and its ConnectGate slot
+     */
+    bool takePreconnected() {
+        if (!m_ctx->preconnect)
+            return false;
+        int upstream = -1;
+        QTcpSocket *tunnel = m_ctx->preconnect->take(m_targetHost, m_targetPort, &upstream);
+        if (!tunnel)
+            return false;
+        m_gateSlot = m_ctx->connectGate != nullptr;
+        releaseUpstream();
+        m_upstream = upstream;
+        m_socks->disconnect(this);
+        delete m_socks;
+        attachSocks(tunnel);
+        upstreamEstablished();
+        return true;
+    }
+
+    /**
+     * @brief Take a slot under the proxy-wide tunnel cap, or queue for one
+     * @return false while queued; openUpstream() runs again once admitted
+     */
+    bool enterConnectGate() {
+        ConnectGate *gate = m_ctx->connectGate;
+        if (!gate || m_gateSlot)
+            return true;
+        QPointer<ClientConnection> self(this);
+        const bool entered = gate->enterOrWait(parent(), [self, gate]() {
+            if (!self || self->m_finished) {
+                gate->leave();
+                return;
+            }
+            self->m_gateTicket = 0;
+            self->m_gateSlot = true;
+            self->openUpstream();
+        }, &m_gateTicket);
+        if (entered) {
+            m_gateSlot = true;
+            return true;
+        }
+        m_state = State::QueuedForUpstream;
+        armTimeout(HttpToSocksProxy::ConnectQueueTimeout);
+        return false;
+    }
+
+    void leaveConnectGate() {
+        ConnectGate *gate = m_ctx->connectGate;
+        if (m_gateTicket != 0) {
+            // Already handed over: the admitted callback finds us finished
+            // (or gone) and gives the slot back itself
+            gate->cancel(m_gateTicket);
+            m_gateTicket = 0;
+        }
+        if (m_gateSlot) {
+            m_gateSlot = false;
+            gate->leave();
+        }
+    }
+
+    /**
+     * @brief Connect straight to the target; once connected the socket is
+     * used exactly like an established SOCKS tunnel
+     */
+    void openDirect() {
         m_state = State::ConnectingToSocks;
-        m_socks->connectToHost(m_socksHost, m_socksPort);
+        armTimeout(HttpToSocksProxy::HandshakeTimeout);
+        releaseUpstream();
+        m_socks->connectToHost(m_targetHost, m_targetPort);
     }
 
-    void onSocksConnected() {
-        // Send SOCKS5 greeting: version, num methods, methods
-        QByteArray greeting;
-        greeting.append(static_cast<char>(SOCKS5_VERSION));
-        greeting.append(static_cast<char>(1)); // 1 auth method
-        greeting.append(static_cast<char>(SOCKS5_AUTH_NONE)); // No auth
-        m_socks->write(greeting);
-        m_state = State::SocksGreeting;
+    /**
+     * @brief Apply the blocklist and the routing rules to the parsed target
+     * @return false if the request was refused (and answered)
+     */
+    bool route() {
+        if (m_overClientLimit) {
+            log(QStringLiteral("[HTTP2SOCKS] %1 over its connection limit, refused %2:%3")
+                .arg(m_client->peerAddress().toString(), m_targetHost).arg(m_targetPort));
+            m_socksReply = SOCKS5_REPLY_NOT_ALLOWED;
+            sendError(429, "Too Many Requests - Connection limit per client");
+            return false;
+        }
+        const DomainBlocklist *blocklist = m_ctx->options.blocklist.get();
+        if (blocklist && blocklist->contains(m_targetHost)) {
+            m_ctx->budget->blocked.fetch_add(1, std::memory_order_relaxed);
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 blocked").arg(m_targetHost).arg(m_targetPort));
+            m_socksReply = SOCKS5_REPLY_NOT_ALLOWED;
+            sendError(403, "Forbidden - Blocked domain");
+            return false;
+        }
+        const RoutingRules *rules = m_ctx->options.routing.get();
+        const RoutingRules::Action action = rules ? rules->match(m_targetHost, m_targetPort)
+                                                  : RoutingRules::Action::Tunnel;
+        m_ctx->budget->routed[static_cast<int>(action)].fetch_add(1, std::memory_order_relaxed);
+        m_direct = action == RoutingRules::Action::Direct;
+        if (action != RoutingRules::Action::Reject)
+            return true;
+        log(QStringLiteral("[HTTP2SOCKS] %1:%2 rejected by routing rules").arg(m_targetHost).arg(m_targetPort));
+        m_socksReply = SOCKS5_REPLY_NOT_ALLOWED;
+        sendError(403, "Forbidden - Blocked by routing rules");
+        return false;
     }
 
-    void onSocksReadyRead() {
-        m_socksBuffer.append(m_socks->readAll());
+    /**
+     * @brief Start the SOCKS side on upstream @p index: a warm pooled socket
+     * only needs the CONNECT, a fresh one goes through connect + greeting first
+     */
+    void openUpstream(int index) {
+        m_state = State::ConnectingToSocks;
+        armTimeout(HttpToSocksProxy::HandshakeTimeout);
+        releaseUpstream();
+        if (index < 0) {
+            sendError(502, "Bad Gateway - No SOCKS upstream");
+            return;
+        }
+        m_upstream = index;
+        m_triedUpstreams |= quint64(1) << index;
+        ++m_upstreamAttempts;
+        m_ctx->upstreams->acquire(index);
+        m_connectClock.start();
+
+        SocksConnectionPool *pool = m_ctx->pools.value(index);
+        if (QTcpSocket *warm = pool ? pool->take() : nullptr) {
+            m_socks->disconnect(this);
+            delete m_socks;
+            attachSocks(warm);
+            write(Upstream, socks5ConnectRequest(m_targetHost, m_targetPort));
+            m_state = State::SocksConnectRequest;
+            return;
+        }
+        const UpstreamBalancer::Endpoint &endpoint = m_ctx->upstreams->endpoint(index);
+        m_socks->connectToHost(endpoint.host, endpoint.port);
+    }
 
+    HttpToSocksProxy::ConnectionPhase phase() const {
+        using Phase = HttpToSocksProxy::ConnectionPhase;
         switch (m_state) {
+        case State::WaitingForRequest: return Phase::Request;
+        case State::QueuedForUpstream: return Phase::Queued;
+        case State::ConnectingToSocks:
         case State::SocksGreeting:
-            handleSocksGreeting();
+        case State::SocksConnectRequest: return Phase::Connecting;
+        case State::Forwarding: return Phase::Forwarding;
+        case State::Tunneling: return Phase::Tunnel;
+        case State::Splicing: return Phase::Splice;
+        case State::Closing:
+        case State::Failed: return Phase::Closing;
+        }
+        return Phase::Request;
+    }
+
+    bool isHandshaking() const {
+        return m_state == State::ConnectingToSocks || m_state == State::SocksGreeting
+            || m_state == State::SocksConnectRequest;
+    }
+
+    /**
+     * @brief The SOCKS side failed before the tunnel was up. Nothing has
+     * reached the target yet, so the request may still go through another
+     * upstream.
+     * @param upstreamFault Count the failure against the upstream (false
+     * when it answered, e.g. the target refused)
+     * @return true if a new attempt was started on a fresh socket
+     */
+    bool retryOnAnotherUpstream(bool upstreamFault) {
+        if (m_direct)
+            return false;
+        if (m_upstream >= 0 && upstreamFault && m_ctx->upstreams->reportFailure(m_upstream)) {
+            const UpstreamBalancer::Endpoint &endpoint = m_ctx->upstreams->endpoint(m_upstream);
+            log(QStringLiteral("[HTTP2SOCKS] Upstream %1:%2 ejected after repeated failures")
+                .arg(endpoint.host).arg(endpoint.port));
+        }
+        releaseUpstream();
+        if (m_upstreamAttempts >= m_ctx->options.upstreamAttempts
+            || m_client->state() != QAbstractSocket::ConnectedState)
+            return false;
+        const int next = m_ctx->upstreams->pick(m_triedUpstreams);
+        if (next < 0)
+            return false;
+
+        m_socks->disconnect(this);
+        m_socks->abort();
+        m_socks->deleteLater();
+        release(m_queued[Upstream], m_queued[Upstream]);
+        m_socksBuffer.clear();
+        m_greetingPending = false;
+        attachSocks(new QTcpSocket(this));
+        openUpstream(next);
+        return true;
+    }
+
+    void releaseUpstream() {
+        if (m_upstream < 0)
+            return;
+        m_ctx->upstreams->release(m_upstream);
+        m_upstream = -1;
+    }
+
+    /**
+     * @brief Parse the request head at the front of m_requestBuffer and
+     * route it; anything after the head stays buffered as body (or the next
+     * pipelined request)
+     */
+    void processRequest() {
+        PAQET_ALLOC_SCOPE(Parse);
+        switch (m_parser.parse(m_requestBuffer)) {
+        case HttpRequestParser::Status::Incomplete:
+            return; // Wait for more data
+        case HttpRequestParser::Status::TooLarge:
+            sendError(431, "Request Header Fields Too Large");
+            return;
+        case HttpRequestParser::Status::Invalid:
+            sendError(400, "Bad Request");
+            return;
+        case HttpRequestParser::Status::Complete:
             break;
-        case State::SocksConnectRequest:
-            handleSocksConnectResponse();
+        }
+
+        QByteArrayView host;
+        if (!m_parser.destination(&host, &m_targetPort)) {
+            sendError(400, "Bad Request - No host");
+            return;
+        }
+        m_targetHost = QString::fromLatin1(host.data(), host.size());
+        m_isConnect = m_parser.isConnect();
+        if (!route())
+            return;
+
+        log(QStringLiteral("[HTTP2SOCKS] %1 %2:%3%4")
+                .arg(QLatin1StringView(m_parser.method().data(), m_parser.method().size()), m_targetHost)
+                .arg(m_targetPort)
+                .arg(m_direct ? QStringLiteral(" (direct)") : QString()));
+
+        if (!m_isConnect) {
+            startExchange();
+            return;
+        }
+
+        // Bytes the client sent right after the CONNECT head
+        m_requestBuffer.remove(0, m_parser.headLength());
+        m_parser.reset();
+        m_requestBody = m_requestBuffer;
+        m_requestBuffer.clear();
+        if (m_ctx->options.optimisticConnect) {
+            // Answer right away; the client's first flight (e.g. the TLS
+            // ClientHello) waits in its socket buffer while the SOCKS
+            // handshake runs, and is flushed when the reply arrives.
+            m_optimistic = true;
+            m_replied = true;
+            write(Downstream, kConnectEstablished);
+        }
+        openUpstream();
+    }
+
+    /**
+     * @brief Serve a SOCKS5 client: method negotiation, then its CONNECT
+     * request, which continues like an HTTP CONNECT
+     */
+    void processSocksRequest() {
+        PAQET_ALLOC_SCOPE(Parse);
+        if (!m_socksGreeted) {
+            // VER NMETHODS METHODS...
+            if (m_requestBuffer.size() < 2)
+                return;
+            const int methodCount = static_cast<quint8>(m_requestBuffer[1]);
+            if (m_requestBuffer.size() < 2 + methodCount)
+                return;
+            const bool noAuth = m_requestBuffer.mid(2, methodCount).contains(static_cast<char>(SOCKS5_AUTH_NONE));
+            m_requestBuffer.remove(0, 2 + methodCount);
+
+            QByteArray choice;
+            choice.append(static_cast<char>(SOCKS5_VERSION));
+            choice.append(static_cast<char>(noAuth ? SOCKS5_AUTH_NONE : SOCKS5_AUTH_NO_ACCEPTABLE));
+            write(Downstream, choice);
+            if (!noAuth) {
+                m_state = State::Failed;
+                m_replied = true;
+                m_client->disconnectFromHost();
+                return;
+            }
+            m_socksGreeted = true;
+        }
+
+        // VER CMD RSV ATYP DST.ADDR DST.PORT
+        if (m_requestBuffer.size() < 5)
+            return;
+        const quint8 version = static_cast<quint8>(m_requestBuffer[0]);
+        const quint8 command = static_cast<quint8>(m_requestBuffer[1]);
+        const quint8 atyp = static_cast<quint8>(m_requestBuffer[3]);
+        int addrLen = 0;
+        switch (atyp) {
+        case SOCKS5_ATYP_IPV4:
+            addrLen = 4;
             break;
-        case State::Tunneling:
-            // Forward data to client
-            if (m_client->state() == QAbstractSocket::ConnectedState) {
-                m_client->write(m_socksBuffer);
+        case SOCKS5_ATYP_DOMAIN:
+            addrLen = 1 + static_cast<quint8>(m_requestBuffer[4]);
+            break;
+        case SOCKS5_ATYP_IPV6:
+            addrLen = 16;
+            break;
+        default:
+            m_socksReply = SOCKS5_REPLY_ATYP_NOT_SUPPORTED;
+            sendError(400, "Bad Request - Unknown SOCKS address type");
+            return;
+        }
+        if (m_requestBuffer.size() < 4 + addrLen + 2)
+            return;
+
+        const auto *addr = reinterpret_cast<const uchar *>(m_requestBuffer.constData()) + 4;
+        if (atyp == SOCKS5_ATYP_IPV4)
+            m_targetHost = QHostAddress(qFromBigEndian<quint32>(addr)).toString();
+        else if (atyp == SOCKS5_ATYP_IPV6)
+            m_targetHost = QHostAddress(addr).toString();
+        else
+            m_targetHost = QString::fromUtf8(reinterpret_cast<const char *>(addr) + 1, addrLen - 1);
+        m_targetPort = qFromBigEndian<quint16>(addr + addrLen);
+        m_requestBuffer.remove(0, 4 + addrLen + 2);
+
+        if (version != SOCKS5_VERSION || command != SOCKS5_CMD_CONNECT) {
+            m_socksReply = SOCKS5_REPLY_CMD_NOT_SUPPORTED;
+            sendError(400, "Bad Request - Unsupported SOCKS command");
+            return;
+        }
+        if (m_targetHost.isEmpty() || m_targetPort == 0) {
+            m_socksReply = SOCKS5_REPLY_GENERAL_FAILURE;
+            sendError(400, "Bad Request - No host");
+            return;
+        }
+        m_isConnect = true;
+        if (!route())
+            return;
+
+        log(QStringLiteral("[HTTP2SOCKS] SOCKS5 %1:%2%3").arg(m_targetHost).arg(m_targetPort)
+                .arg(m_direct ? QStringLiteral(" (direct)") : QString()));
+
+        m_requestBody = m_requestBuffer;
+        m_requestBuffer.clear();
+        if (m_ctx->options.optimisticConnect) {
+            m_optimistic = true;
+            m_replied = true;
+            write(Downstream, socks5Reply(SOCKS5_REPLY_SUCCEEDED));
+        }
+        openUpstream();
+    }
+
+    /**
+     * @brief Begin forwarding one plain-HTTP request, on an idle tunnel to
+     * the same origin when there is one
+     */
+    void startExchange() {
+        qint64 length = 0;
+        const HttpBodyFramer::Mode framing = m_parser.bodyFraming(&length);
+        if (framing == HttpBodyFramer::Mode::Invalid) {
+            // Where this body ends is unknowable: never forward it
+            sendError(400, "Bad Request - Invalid body framing");
+            return;
+        }
+        m_requestFramer.reset(framing, length);
+        m_clientKeepAlive = m_parser.versionMinor() >= 1 && m_parser.keepAlive();
+        m_headRequest = m_parser.isHead();
+        m_cacheKey = m_ctx->cache ? cacheKey() : QByteArray();
+        // A body-less GET of a whole resource through paqet may be split
+        // into ranges once the response shows the origin supports them
+        const bool splittable = m_ctx->options.rangeSplitCount > 1 && !m_direct && m_parser.isGet()
+            && m_parser.header("Range").isEmpty() && m_parser.header("If-Range").isEmpty()
+            && m_requestFramer.mode() == HttpBodyFramer::Mode::None;
+
+        // The head is rewritten where it lies and stays at the front of the
+        // buffer until the response starts (a stale pooled tunnel replays it)
+        const qsizetype headBegin = m_parser.rewriteForOrigin(m_requestBuffer);
+        m_forwardHeadLength = m_parser.headLength() - headBegin;
+        m_requestBuffer.remove(0, headBegin);
+        m_parser.reset();
+        m_splitHead = splittable ? m_requestBuffer.left(m_forwardHeadLength) : QByteArray();
+
+        m_origin = OriginTunnelPool::key(m_targetHost, m_targetPort);
+        m_responseBuffer.clear();
+        m_responseHeadDone = false;
+        m_upstreamKeepAlive = false;
+        m_exchangeRetried = false;
+        m_replied = false;
+        m_cacheEntry.reset();
+        m_cacheFill.reset();
+
+        if (!m_cacheKey.isEmpty() && answerFromCache(true))
+            return;
+        fetchFromOrigin();
+    }
+
+    /**
+     * @brief Send the exchange to the origin, on an idle tunnel to it when
+     * there is one
+     */
+    void fetchFromOrigin() {
+        if (QTcpSocket *idle = m_ctx->originPool ? m_ctx->originPool->take(m_origin) : nullptr) {
+            releaseUpstream();
+            m_socks->disconnect(this);
+            delete m_socks;
+            attachSocks(idle);
+            m_upstreamReused = true;
+            beginForwarding();
+            return;
+        }
+        m_upstreamReused = false;
+        openUpstream();
+    }
+
+    /**
+     * @brief Cache key of the parsed request, empty when the cache must stay
+     * out of it: anything but a plain GET, credentials, and conditions or
+     * ranges the client evaluates itself
+     */
+    QByteArray cacheKey() {
+        m_cacheRevalidate = false;
+        static const char *const kBypass[] = {
+            "Authorization", "Range", "If-Range", "If-None-Match", "If-Modified-Since", "If-Match",
+            "If-Unmodified-Since"
+        };
+        if (!m_parser.isGet() || m_requestFramer.mode() != HttpBodyFramer::Mode::None
+            || m_parser.hasToken("Cache-Control", "no-store")) {
+            return QByteArray();
+        }
+        for (const char *name : kBypass) {
+            if (!m_parser.header(name).isEmpty())
+                return QByteArray();
+        }
+        m_cacheRevalidate = m_parser.hasToken("Cache-Control", "no-cache")
+            || m_parser.hasToken("Cache-Control", "max-age=0") || m_parser.hasToken("Pragma", "no-cache");
+
+        // Absolute-form and origin-form targets name the same resource
+        QByteArrayView path = m_parser.target();
+        const qsizetype scheme = path.indexOf("://");
+        if (scheme >= 0) {
+            const qsizetype slash = path.sliced(scheme + 3).indexOf('/');
+            path = slash < 0 ? QByteArrayView("/") : path.sliced(scheme + 3 + slash);
+        }
+        // Responses varying on anything else are not stored
+        return OriginTunnelPool::key(m_targetHost, m_targetPort).toUtf8() + ' ' + path.toByteArray()
+            + '\n' + m_parser.header("Accept-Encoding").toByteArray();
+    }
+
+    /**
+     * @brief Look the exchange up in the cache: serve a fresh entry, make
+     * the request conditional for a stale one, or wait for a concurrent
+     * fetch of the same resource
+     * @return true if the origin is not contacted now
+     */
+    bool answerFromCache(bool coalesce) {
+        HttpCache::Lookup found = m_ctx->cache->lookup(m_cacheKey, m_cacheRevalidate);
+        switch (found.status) {
+        case HttpCache::Status::Fresh:
+            return serveFromCache(found.entry);
+        case HttpCache::Status::Busy:
+            return coalesce && waitForCacheFill();
+        case HttpCache::Status::Stale:
+            m_cacheEntry = found.entry;
+            addValidators(*found.entry);
+            break;
+        case HttpCache::Status::Miss:
+            break;
+        }
+        m_cacheFill = std::move(found.fill);
+        return false;
+    }
+
+    /**
+     * @brief Another exchange is fetching the same resource: wait for it to
+     * land in the cache (at most kCacheWaitMs) rather than fetch it twice
+     */
+    bool waitForCacheFill() {
+        QPointer<ClientConnection> self(this);
+        const quint64 ticket = m_ctx->cache->wait(m_cacheKey, parent(), [self]() {
+            if (self && !self->m_finished && self->m_cacheTicket != 0)
+                self->endCacheWait();
+        });
+        m_cacheTicket = ticket;
+        m_state = State::QueuedForUpstream;
+        armTimeout(HttpToSocksProxy::IdleTimeout);
+        QTimer::singleShot(kCacheWaitMs, this, [this, ticket]() {
+            if (m_finished || m_cacheTicket != ticket)
+                return;
+            m_ctx->cache->cancel(ticket);
+            endCacheWait();
+        });
+        return true;
+    }
+
+    void endCacheWait() {
+        m_cacheTicket = 0;
+        if (!answerFromCache(false))
+            fetchFromOrigin();
+    }
+
+    /** Make the forwarded request conditional on @p entry's validators */
+    void addValidators(const HttpCache::Entry &entry) {
+        QByteArray conditions;
+        if (!entry.etag.isEmpty())
+            conditions += "If-None-Match: " + entry.etag + "\r\n";
+        if (!entry.lastModified.isEmpty())
+            conditions += "If-Modified-Since: " + entry.lastModified + "\r\n";
+        // Ahead of the blank line that ends the head
+        m_requestBuffer.insert(m_forwardHeadLength - 2, conditions);
+        m_forwardHeadLength += conditions.size();
+    }
+
+    /**
+     * @brief Answer the exchange from @p entry; the body streams from the
+     * file with the same backpressure as from a tunnel
+     * @return false if the file cannot be read
+     */
+    bool serveFromCache(const std::shared_ptr<const HttpCache::Entry> &entry) {
+        auto body = std::make_unique<QFile>(entry->path);
+        if (!body->open(QIODevice::ReadOnly) || body->size() < entry->fileSize() || !body->seek(entry->bodyOffset))
+            return false;
+        m_cacheBody = std::move(body);
+        m_cacheLeft = entry->bodySize;
+        m_ctx->cache->countServed(entry->bodySize);
+        m_requestBuffer.remove(0, m_forwardHeadLength);
+        m_forwardHeadLength = 0;
+        m_state = State::Forwarding;
+        armTimeout(HttpToSocksProxy::IdleTimeout);
+        m_replied = true;
+        write(Downstream, HttpCache::responseHead(*entry));
+        m_responseFramer.reset(HttpBodyFramer::Mode::Length, entry->bodySize);
+        m_responseHeadDone = true;
+        pumpCachedResponse();
+        return true;
+    }
+
+    /**
+     * @brief Body of a response served from the cache
+     */
+    void pumpCachedResponse() {
+        BufferPool::Buffer buffer;
+        while (m_cacheLeft > 0) {
+            const qint64 quota = relayQuota(Downstream);
+            if (quota == 0)
+                return;
+            if (buffer.isNull())
+                buffer = m_ctx->buffers->acquire(kRelayChunk);
+            const qint64 n = m_cacheBody->read(buffer.data(), qMin(qMin(quota, m_cacheLeft), buffer.size()));
+            if (n <= 0) {
+                // The head is out: a short body is all that is left to give
+                log(QStringLiteral("[HTTP2SOCKS] %1:%2 cached body unreadable (%3)")
+                    .arg(m_targetHost).arg(m_targetPort).arg(m_cacheBody->errorString()));
+                m_state = State::Failed;
+                m_client->abort();
+                closeIfDrained();
+                return;
+            }
+            m_responseFramer.consume(buffer.data(), n);
+            write(Downstream, buffer.data(), n);
+            m_cacheLeft -= n;
+        }
+        m_paused[Downstream] = false;
+        m_cacheBody.reset();
+        maybeFinishExchange();
+    }
+
+    /**
+     * @brief The origin answered 304 to a revalidation: its tunnel is done
+     * with this exchange and the client gets the refreshed entry from disk
+     */
+    void serveRevalidated(const HttpHeadInfo &notModified) {
+        const std::shared_ptr<const HttpCache::Entry> entry = m_cacheFill->refresh(m_cacheEntry, notModified);
+        m_cacheFill.reset();
+        m_cacheEntry.reset();
+        // A 304 never has a body; anything after it is not to be trusted
+        m_upstreamKeepAlive = notModified.keepAlive() && m_responseBuffer.isEmpty();
+        m_responseBuffer.clear();
+        detachExchangeUpstream();
+        if (!serveFromCache(entry))
+            sendError(502, "Bad Gateway - Cached response unreadable");
+    }
+
+    /**
+     * @brief Upstream tunnel is ready: send the rewritten head, then stream
+     * the body and the response as they come
+     */
+    void beginForwarding() {
+        m_state = State::Forwarding;
+        armTimeout(HttpToSocksProxy::IdleTimeout);
+        write(Upstream, m_requestBuffer.constData(), m_forwardHeadLength);
+
+        // Response bytes that arrived with the SOCKS reply
+        m_responseBuffer.append(m_socksBuffer);
+        m_socksBuffer.clear();
+
+        pumpRequestBody();
+        if (m_state == State::Forwarding)
+            pumpResponse();
+    }
+
+    /**
+     * @brief Forward request body bytes, up to the end of the body
+     */
+    void pumpRequestBody() {
+        PAQET_ALLOC_SCOPE(Relay);
+        if (!m_requestFramer.isComplete() && m_requestBuffer.size() > m_forwardHeadLength) {
+            const char *body = m_requestBuffer.constData() + m_forwardHeadLength;
+            const qint64 n = m_requestFramer.consume(body, m_requestBuffer.size() - m_forwardHeadLength);
+            write(Upstream, body, n);
+            m_requestBuffer.remove(m_forwardHeadLength, n);
+        }
+        BufferPool::Buffer buffer;
+        while (!m_requestFramer.isComplete() && m_client->bytesAvailable() > 0) {
+            const qint64 quota = relayQuota(Upstream);
+            if (quota == 0)
+                return;
+            if (buffer.isNull())
+                buffer = m_ctx->buffers->acquire(kRelayChunk);
+            const qint64 peeked = m_client->peek(buffer.data(), qMin(quota, buffer.size()));
+            if (peeked <= 0)
+                break;
+            const qint64 n = m_requestFramer.consume(buffer.data(), peeked);
+            write(Upstream, buffer.data(), n);
+            m_client->skip(n);
+            if (n < peeked)
+                break;
+        }
+        m_paused[Upstream] = false;
+        if (m_requestFramer.hasError()) {
+            sendError(400, "Bad Request - Malformed body");
+            return;
+        }
+        maybeFinishExchange();
+    }
+
+    /**
+     * @brief Forward the response head (and any 1xx interim heads), then
+     * the body up to its end
+     */
+    void pumpResponse() {
+        PAQET_ALLOC_SCOPE(Relay);
+        if (m_cacheBody) {
+            pumpCachedResponse();
+            return;
+        }
+        while (!m_responseHeadDone) {
+            const int headEnd = m_responseBuffer.indexOf("\r\n\r\n");
+            if (headEnd == -1) {
+                if (m_responseBuffer.size() > kMaxResponseHead) {
+                    sendError(502, "Bad Gateway - Response head too large");
+                    return;
+                }
+                if (m_socks->bytesAvailable() == 0)
+                    return;
+                m_responseBuffer.append(m_socks->read(kRelayChunk));
+                continue;
+            }
+
+            HttpHeadInfo response;
+            const QByteArray head = m_responseBuffer.left(headEnd + 4);
+            if (!HttpHeadInfo::parseResponse(head, &response)) {
+                sendError(502, "Bad Gateway - Invalid response");
+                return;
+            }
+            if (m_cacheEntry && response.status == 304) {
+                m_responseBuffer.remove(0, headEnd + 4);
+                serveRevalidated(response);
+                return;
             }
+            write(Downstream, head);
+            m_responseBuffer.remove(0, headEnd + 4);
+            m_replied = true;
+            // Past the point of replaying the request
+            m_requestBuffer.remove(0, m_forwardHeadLength);
+            m_forwardHeadLength = 0;
+
+            if (response.status == 101) {
+                // Protocol switch: from here on both sides are opaque bytes
+                m_cacheFill.reset();
+                m_state = State::Tunneling;
+                armTimeout(HttpToSocksProxy::IdleTimeout);
+                write(Downstream, m_responseBuffer);
+                write(Upstream, m_requestBuffer);
+                m_responseBuffer.clear();
+                m_requestBuffer.clear();
+                relay(Upstream);
+                relay(Downstream);
+                maybeStartSplice();
+                return;
+            }
+            if (response.status < 200)
+                continue;  // interim (e.g. 100 Continue), the final head follows
+
+            qint64 length = 0;
+            const HttpBodyFramer::Mode mode = response.responseFraming(m_headRequest, &length);
+            if (mode == HttpBodyFramer::Mode::Invalid) {
+                sendError(502, "Bad Gateway - Invalid response framing");
+                return;
+            }
+            m_responseFramer.reset(mode, length);
+            m_upstreamKeepAlive = response.keepAlive() && mode != HttpBodyFramer::Mode::UntilClose;
+            m_responseHeadDone = true;
+            // Stored while it streams to this client
+            m_cacheEntry.reset();
+            if (m_cacheFill && !(mode == HttpBodyFramer::Mode::Length && m_cacheFill->begin(head, response, length)))
+                m_cacheFill.reset();
+            if (mode == HttpBodyFramer::Mode::Length)
+                maybeSplitDownload(response, length);
+        }
+
+        if (m_split) {
+            pumpSplitResponse();
+            return;
+        }
+
+        if (!m_responseBuffer.isEmpty()) {
+            const qint64 n = m_responseFramer.consume(m_responseBuffer.constData(), m_responseBuffer.size());
+            writeBody(m_responseBuffer.constData(), n);
+            if (n < m_responseBuffer.size())
+                m_upstreamKeepAlive = false;  // bytes past the response: don't trust this tunnel again
+            m_responseBuffer.clear();
+        }
+        BufferPool::Buffer buffer;
+        while (!m_responseFramer.isComplete() && m_socks->bytesAvailable() > 0) {
+            const qint64 quota = relayQuota(Downstream);
+            if (quota == 0)
+                return;
+            if (buffer.isNull())
+                buffer = m_ctx->buffers->acquire(kRelayChunk);
+            const qint64 peeked = m_socks->peek(buffer.data(), qMin(quota, buffer.size()));
+            if (peeked <= 0)
+                break;
+            const qint64 n = m_responseFramer.consume(buffer.data(), peeked);
+            writeBody(buffer.data(), n);
+            m_socks->skip(n);
+            if (n < peeked) {
+                m_upstreamKeepAlive = false;
+                break;
+            }
+        }
+        m_paused[Downstream] = false;
+        if (m_responseFramer.hasError()) {
+            sendError(502, "Bad Gateway - Malformed response body");
+            return;
+        }
+        maybeFinishExchange();
+    }
+
+    /**
+     * @brief Fetch the rest of a large response to a splittable GET as byte
+     * ranges over extra tunnels; the original tunnel delivers the first one
+     */
+    void maybeSplitDownload(const HttpHeadInfo &response, qint64 length) {
+        const QByteArray head = m_splitHead;
+        m_splitHead.clear();
+        const HttpToSocksProxy::Options &o = m_ctx->options;
+        if (head.isEmpty() || response.status != 200 || length < qMax<qint64>(o.rangeSplitThreshold, 1)
+            || !response.hasToken("Accept-Ranges", "bytes") || !response.header("Content-Range").isEmpty())
+            return;
+        // If-Range needs a strong validator, or ranges of a changed resource could mix
+        QByteArray validator = response.header("ETag").trimmed();
+        if (validator.startsWith("W/"))
+            validator.clear();
+        if (validator.isEmpty())
+            validator = response.header("Last-Modified").trimmed();
+        if (validator.isEmpty())
+            return;
+
+        RangeDownload::Plan plan;
+        plan.requestHead = head;
+        plan.host = m_targetHost;
+        plan.port = m_targetPort;
+        plan.validator = validator;
+        plan.length = length;
+        plan.segments = o.rangeSplitCount;
+        plan.bufferLimit = qMax<qint64>(o.rangeSplitBuffer, kRelayChunk);
+        auto *split = new RangeDownload(m_ctx->upstreams, m_ctx->connectGate, this);
+        if (!split->start(plan)) {
+            delete split;
+            return;
+        }
+        connect(split, &RangeDownload::confirmed, this, [this]() { resumeRelay(Downstream); });
+        connect(split, &RangeDownload::readyRead, this, [this]() { resumeRelay(Downstream); });
+        connect(split, &RangeDownload::failed, this, &ClientConnection::onSplitFailed);
+        m_split = split;
+        m_splitPrimaryLeft = split->firstSegmentEnd();
+        m_splitDetached = false;
+        // The original tunnel is cut after the first range
+        m_upstreamKeepAlive = false;
+        log(QStringLiteral("[HTTP2SOCKS] %1:%2 %3 bytes split into %4 ranges")
+            .arg(m_targetHost).arg(m_targetPort).arg(length).arg(split->segmentCount()));
+    }
+
+    /**
+     * @brief Response body of a split download: the first range from the
+     * original tunnel, the others from the RangeDownload in order
+     */
+    void pumpSplitResponse() {
+        if (m_splitPrimaryLeft > 0) {
+            // What came with the head; bytes past the first range stay in
+            // m_responseBuffer in case the split is abandoned
+            if (!m_responseBuffer.isEmpty()) {
+                const qint64 n = m_responseFramer.consume(m_responseBuffer.constData(),
+                                                          qMin<qint64>(m_responseBuffer.size(), m_splitPrimaryLeft));
+                writeBody(m_responseBuffer.constData(), n);
+                m_responseBuffer.remove(0, n);
+                m_splitPrimaryLeft -= n;
+            }
+            BufferPool::Buffer buffer;
+            while (m_splitPrimaryLeft > 0 && m_socks->bytesAvailable() > 0) {
+                const qint64 quota = relayQuota(Downstream);
+                if (quota == 0)
+                    return;
+                if (buffer.isNull())
+                    buffer = m_ctx->buffers->acquire(kRelayChunk);
+                const qint64 peeked = m_socks->peek(buffer.data(), qMin(qMin(quota, m_splitPrimaryLeft), buffer.size()));
+                if (peeked <= 0)
+                    break;
+                const qint64 n = m_responseFramer.consume(buffer.data(), peeked);
+                writeBody(buffer.data(), n);
+                m_socks->skip(n);
+                m_splitPrimaryLeft -= n;
+            }
+            m_paused[Downstream] = false;
+            if (m_splitPrimaryLeft > 0)
+                return;
+        }
+        // The original tunnel is held (unread) until every range is answered
+        if (!m_split->isConfirmed())
+            return;
+        if (!m_splitDetached) {
+            m_splitDetached = true;
+            m_socks->disconnect(this);
+            m_socks->abort();
+            m_socks->deleteLater();
+            release(m_queued[Upstream], m_queued[Upstream]);
+            releaseUpstream();
+            m_responseBuffer.clear();
+            attachSocks(new QTcpSocket(this));
+        }
+        BufferPool::Buffer buffer;
+        while (!m_responseFramer.isComplete() && m_split->bytesAvailable() > 0) {
+            const qint64 quota = relayQuota(Downstream);
+            if (quota == 0)
+                return;
+            if (buffer.isNull())
+                buffer = m_ctx->buffers->acquire(kRelayChunk);
+            const qint64 taken = m_split->read(buffer.data(), qMin(quota, buffer.size()));
+            if (taken <= 0)
+                break;
+            const qint64 n = m_responseFramer.consume(buffer.data(), taken);
+            writeBody(buffer.data(), n);
+        }
+        m_paused[Downstream] = false;
+        maybeFinishExchange();
+    }
+
+    void onSplitFailed(const QString &reason) {
+        RangeDownload *split = m_split;
+        m_split = nullptr;
+        split->disconnect(this);
+        split->deleteLater();
+        if (!m_splitDetached) {
+            // Nothing was taken from the original response past the first
+            // range, which simply carries on
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 range split abandoned (%3)")
+                .arg(m_targetHost).arg(m_targetPort).arg(reason));
+            m_splitPrimaryLeft = 0;
+            resumeRelay(Downstream);
+            return;
+        }
+        log(QStringLiteral("[HTTP2SOCKS] %1:%2 split download failed (%3)")
+            .arg(m_targetHost).arg(m_targetPort).arg(reason));
+        // The client gets a short body rather than a silently corrupt one
+        m_state = State::Failed;
+        m_client->abort();
+        closeIfDrained();
+    }
+
+    /**
+     * @brief Once the response is complete, park the tunnel for reuse (or
+     * drop it) and move on to the next request on the client connection
+     */
+    void maybeFinishExchange() {
+        if (m_state != State::Forwarding || !m_responseHeadDone || !m_responseFramer.isComplete())
+            return;
+        if (m_split) {
+            m_split->disconnect(this);
+            m_split->deleteLater();
+            m_split = nullptr;
+        }
+        if (m_cacheFill) {
+            m_cacheFill->commit();
+            m_cacheFill.reset();
+        }
+
+        const bool requestDone = m_requestFramer.isComplete();
+        detachExchangeUpstream();
+
+        if (!m_clientKeepAlive || !requestDone) {
+            // Unread body bytes would be taken for the next request
+            m_state = State::Closing;
+            m_client->disconnectFromHost();
+            return;
+        }
+        m_state = State::WaitingForRequest;
+        armTimeout(HttpToSocksProxy::IdleTimeout);
+        if (m_client->bytesAvailable() > 0)
+            m_requestBuffer.append(m_client->readAll());
+        if (!m_requestBuffer.isEmpty())
+            processRequest();  // pipelined
+    }
+
+    /**
+     * @brief Take the exchange's tunnel off the connection, parking it in
+     * the origin pool when it can carry another request
+     *
+     * The ConnectGate slot goes with it: a kept-alive client waiting for
+     * its next request holds no tunnel, and openUpstream() queues for a
+     * slot again when that request needs a new one.
+     */
+    void detachExchangeUpstream() {
+        QTcpSocket *upstream = m_socks;
+        upstream->disconnect(this);
+        release(m_queued[Upstream], m_queued[Upstream]);
+        releaseUpstream();
+        leaveConnectGate();
+        attachSocks(new QTcpSocket(this));
+        if (m_upstreamKeepAlive && m_requestFramer.isComplete() && m_ctx->originPool
+            && upstream->bytesAvailable() == 0 && upstream->bytesToWrite() == 0) {
+            m_ctx->originPool->put(m_origin, upstream);
+        } else {
+            upstream->abort();
+            upstream->deleteLater();
+        }
+    }
+
+    /**
+     * @brief Response body bytes towards the client, copied into the cache
+     * when the response is being stored
+     */
+    void writeBody(const char *data, qint64 size) {
+        write(Downstream, data, size);
+        if (m_cacheFill)
+            m_cacheFill->append(data, size);
+    }
+
+    /**
+     * @brief The upstream of a plain-HTTP exchange went away
+     */
+    void upstreamClosedWhileForwarding() {
+        if (m_socksEof)
+            return;
+        m_socksEof = true;
+
+        // An idle keep-alive tunnel may have been closed by the origin just
+        // as we picked it up: replay a body-less request once on a fresh one
+        if (m_upstreamReused && !m_exchangeRetried && !m_responseHeadDone && m_responseBuffer.isEmpty()
+            && m_socks->bytesAvailable() == 0 && m_requestFramer.mode() == HttpBodyFramer::Mode::None) {
+            m_exchangeRetried = true;
+            m_upstreamReused = false;
+            m_socks->disconnect(this);
+            m_socks->deleteLater();
+            release(m_queued[Upstream], m_queued[Upstream]);
+            attachSocks(new QTcpSocket(this));
+            openUpstream();
+            return;
+        }
+
+        QTcpSocket *closed = m_socks;
+        pumpResponse();
+        if (m_socks != closed)
+            return;  // the response completed and the connection moved on
+        if (m_state == State::Forwarding && !m_responseHeadDone && m_socks->bytesAvailable() == 0)
+            sendError(502, "Bad Gateway - Connection closed by origin");
+        closeIfDrained();
+    }
+
+    enum class State {
+        WaitingForRequest,
+        ConnectingToSocks,
+        SocksGreeting,
+        SocksConnectRequest,
+        QueuedForUpstream,  // waiting for a slot under the tunnel cap
+        Forwarding,    // plain-HTTP request/response exchange in progress
+        Tunneling,
+        Splicing,      // tunnel handed to SpliceRelay or EpollRelay, Qt sockets detached
+        Closing,       // last response sent, waiting for the client to close
+        Failed         // error answered, waiting for both sides to close
+    };
+
+    enum Direction {
+        Upstream = 0,    // client -> SOCKS
+        Downstream = 1   // SOCKS -> client
+    };
+
+    /**
+     * @brief Consume the method-selection reply
+     * @return false while it is incomplete or after failing the request
+     */
+    bool consumeGreetingReply() {
+        if (m_socksBuffer.size() < 2) return false;
+
+        quint8 version = static_cast<quint8>(m_socksBuffer[0]);
+        quint8 method = static_cast<quint8>(m_socksBuffer[1]);
+        m_socksBuffer.remove(0, 2);
+
+        if (version != SOCKS5_VERSION || method != SOCKS5_AUTH_NONE) {
+            if (!retryOnAnotherUpstream(true))
+                sendError(502, "Bad Gateway - SOCKS auth failed");
+            return false;
+        }
+        return true;
+    }
+
+    void handleSocksGreeting() {
+        if (!consumeGreetingReply()) return;
+
+        write(Upstream, socks5ConnectRequest(m_targetHost, m_targetPort));
+        m_state = State::SocksConnectRequest;
+    }
+
+    void handleSocksConnectResponse() {
+        if (m_greetingPending) {
+            if (!consumeGreetingReply()) return;
+            m_greetingPending = false;
+        }
+
+        const int totalLen = socks5ReplyLength(m_socksBuffer.constData(), m_socksBuffer.size());
+        if (totalLen == 0) return;
+        if (totalLen < 0) {
+            if (!retryOnAnotherUpstream(true))
+                sendError(502, "Bad Gateway - Unknown SOCKS address type");
+            return;
+        }
+
+        const quint8 version = static_cast<quint8>(m_socksBuffer[0]);
+        const quint8 reply = static_cast<quint8>(m_socksBuffer[1]);
+
+        m_socksBuffer.remove(0, totalLen);
+
+        // Only a general failure (or garbage) is the upstream's fault; for
+        // the target's errors it answered just fine
+        const bool upstreamFault = version != SOCKS5_VERSION || reply == SOCKS5_REPLY_GENERAL_FAILURE;
+        if (!upstreamFault && m_upstream >= 0)
+            m_ctx->upstreams->reportSuccess(m_upstream, m_connectClock.elapsed());
+        if (version != SOCKS5_VERSION || reply != SOCKS5_REPLY_SUCCEEDED) {
+            if (retryOnAnotherUpstream(upstreamFault))
+                return;
+            m_socksReply = reply != SOCKS5_REPLY_SUCCEEDED ? reply : SOCKS5_REPLY_GENERAL_FAILURE;
+            sendError(502, QStringLiteral("Bad Gateway - SOCKS connect failed (code %1)").arg(reply));
+            return;
+        }
+        upstreamEstablished();
+    }
+
+    /**
+     * @brief The upstream (SOCKS tunnel or direct connection) reaches the
+     * target: start the exchange, or answer the CONNECT and relay
+     */
+    void upstreamEstablished() {
+        if (!m_isConnect) {
+            beginForwarding();
+            return;
+        }
+        m_state = State::Tunneling;
+        armTimeout(HttpToSocksProxy::IdleTimeout);
+
+        // Send 200 Connection Established (optimistic mode already did)
+        if (!m_replied)
+            write(Downstream, m_socksClient ? socks5Reply(SOCKS5_REPLY_SUCCEEDED) : kConnectEstablished);
+        m_replied = true;
+        write(Upstream, m_requestBody);  // bytes the client sent right after the CONNECT head
+        m_requestBody.clear();
+
+        // Process any remaining data in the SOCKS buffer
+        if (!m_socksBuffer.isEmpty()) {
+            write(Downstream, m_socksBuffer);
             m_socksBuffer.clear();
-            break;
-        default:
-            break;
         }
+        // Anything the client sent while we were connecting is still in its socket
+        relay(Upstream);
+        relay(Downstream);
+        maybeStartSplice();
     }
 
-    void onClientDisconnected() {
-        if (m_socks) m_socks->close();
-        emit finished();
+    /**
+     * @brief Move what the sink can take from the source, pausing when the
+     * sink is backed up
+     */
+    void relay(Direction dir) {
+        PAQET_ALLOC_SCOPE(Relay);
+        if (m_state == State::Forwarding) {
+            // Framed: only the current message's bytes may cross
+            if (dir == Upstream)
+                pumpRequestBody();
+            else
+                pumpResponse();
+            return;
+        }
+        if (m_state != State::Tunneling)
+            return;
+        QTcpSocket *source = dir == Upstream ? m_client : m_socks;
+        BufferPool::Buffer buffer;   // back to the pool when this pass ends
+        while (source->bytesAvailable() > 0) {
+            const qint64 quota = relayQuota(dir);
+            if (quota == 0)
+                return;
+            if (buffer.isNull())
+                buffer = m_ctx->buffers->acquire(kRelayChunk);
+            const qint64 n = source->read(buffer.data(), qMin(quota, buffer.size()));
+            if (n <= 0)
+                break;
+            write(dir, buffer.data(), n);
+        }
+        m_paused[dir] = false;
     }
 
-    void onSocksDisconnected() {
-        if (m_client) m_client->close();
-        emit finished();
+    /**
+     * @brief Bytes @p dir may move now (at most kRelayChunk); 0 when the
+     * sink is backed up (direction paused) or the bulk quota of this turn
+     * is spent (direction deferred to the scheduler)
+     */
+    qint64 relayQuota(Direction dir) {
+        QTcpSocket *sink = dir == Upstream ? m_socks : m_client;
+        const qint64 highWatermark = m_flow.bulk ? m_ctx->options.bulkHighWatermark
+                                                 : m_ctx->options.relayHighWatermark;
+        if (sink->bytesToWrite() >= highWatermark || m_ctx->budget->exhausted()) {
+            pause(dir);
+            return 0;
+        }
+        return grant(dir, kRelayChunk);
     }
 
-    void onSocksError(QAbstractSocket::SocketError) {
-        log(QStringLiteral("[HTTP2SOCKS] SOCKS error: %1").arg(m_socks->errorString()));
-        sendError(502, "Bad Gateway - SOCKS connection failed");
+    /**
+     * @brief Apply the client's rate limit and the scheduler's bulk quota
+     * to a read of at most @p want bytes; 0 parks @p dir until a timer or
+     * the scheduler resumes it
+     */
+    qint64 grant(Direction dir, qint64 want) {
+        if (m_rateLimit) {
+            want = m_ctx->clients->allowance(*m_rateLimit, dir, want);
+            if (want == 0) {
+                waitForTokens(dir);
+                return 0;
+            }
+        }
+        const qint64 quota = m_ctx->scheduler->grant(m_flow, want);
+        if (quota == 0)
+            defer(dir);
+        return quota;
     }
 
-private:
-    enum class State {
-        WaitingForRequest,
-        ConnectingToSocks,
-        SocksGreeting,
-        SocksConnectRequest,
-        Tunneling
-    };
+    void waitForTokens(Direction dir) {
+        if (m_tokenWait[dir])
+            return;
+        m_tokenWait[dir] = true;
+        QTimer::singleShot(m_ctx->clients->refillDelayMs(*m_rateLimit, dir), this, [this, dir]() {
+            m_tokenWait[dir] = false;
+            resumeRelay(dir);
+        });
+    }
 
-    void handleSocksGreeting() {
-        if (m_socksBuffer.size() < 2) return;
+    /**
+     * @brief Continue a direction parked by grant()
+     */
+    void resumeRelay(Direction dir) {
+        if (m_finished)
+            return;
+        if (m_state == State::Splicing) {
+            if (m_splice)
+                m_splice->resume(dir == Upstream);
+            else if (m_native)
+                m_native->resume(dir == Upstream);
+            return;
+        }
+        relay(dir);
+        closeIfDrained();
+    }
 
-        quint8 version = static_cast<quint8>(m_socksBuffer[0]);
-        quint8 method = static_cast<quint8>(m_socksBuffer[1]);
-        m_socksBuffer.remove(0, 2);
+    qint64 lowWatermark() const {
+        if (m_flow.bulk)
+            return qMin(m_ctx->options.relayLowWatermark, m_ctx->options.bulkHighWatermark / 2);
+        return m_ctx->options.relayLowWatermark;
+    }
 
-        if (version != SOCKS5_VERSION || method != SOCKS5_AUTH_NONE) {
-            sendError(502, "Bad Gateway - SOCKS auth failed");
+    /**
+     * @brief Park @p dir until the scheduler's next turn
+     */
+    void defer(Direction dir) {
+        if (m_deferred[dir])
             return;
+        m_deferred[dir] = true;
+        m_ctx->scheduler->defer(this, dir);
+    }
+
+    void pause(Direction dir) {
+        if (!m_paused[dir]) {
+            m_paused[dir] = true;
+            ++m_throttleCount;
+            m_ctx->budget->throttleEvents.fetch_add(1, std::memory_order_relaxed);
         }
+        // Stalled by the global budget with an idle sink: no bytesWritten() will wake us
+        QTcpSocket *sink = dir == Upstream ? m_socks : m_client;
+        if (sink->bytesToWrite() <= lowWatermark() && !m_retryScheduled[dir]) {
+            m_retryScheduled[dir] = true;
+            QTimer::singleShot(kBudgetRetryMs, this, [this, dir]() {
+                m_retryScheduled[dir] = false;
+                relay(dir);
+                closeIfDrained();
+            });
+        }
+    }
 
-        // Send SOCKS5 connect request
-        QByteArray connectReq;
-        connectReq.append(static_cast<char>(SOCKS5_VERSION));
-        connectReq.append(static_cast<char>(SOCKS5_CMD_CONNECT));
-        connectReq.append(static_cast<char>(0x00)); // Reserved
+    /**
+     * @brief Hand the tunnel to the worker's EpollRelay (native engine) or
+     * to SpliceRelay once both Qt sockets are idle (nothing buffered in
+     * either direction), so no byte can be reordered
+     */
+    void maybeStartSplice() {
+        if (m_state != State::Tunneling || m_spliceTried || m_finished)
+            return;
+        EpollRelay *native = m_ctx->nativeRelay;
+        if (!native && (!m_ctx->options.spliceRelay || !SpliceRelay::isSupported()))
+            return;
+        if (m_clientEof || m_socksEof
+            || m_client->bytesAvailable() > 0 || m_socks->bytesAvailable() > 0
+            || m_client->bytesToWrite() > 0 || m_socks->bytesToWrite() > 0) {
+            return;
+        }
+        m_spliceTried = true;
+#ifdef Q_OS_LINUX
+        // Close-on-exec like every descriptor Qt opens, so a QProcess spawned
+        // meanwhile (paqet itself) does not inherit the tunnel
+        const int clientFd = ::fcntl(static_cast<int>(m_client->socketDescriptor()), F_DUPFD_CLOEXEC, 0);
+        const int socksFd = ::fcntl(static_cast<int>(m_socks->socketDescriptor()), F_DUPFD_CLOEXEC, 0);
+        if (clientFd < 0 || socksFd < 0) {
+            if (clientFd >= 0) ::close(clientFd);
+            if (socksFd >= 0) ::close(socksFd);
+            return;
+        }
+        if (native)
+            m_native = native->add(clientFd, socksFd);
+        else
+            m_splice = SpliceRelay::create(clientFd, socksFd, this);
+        if (!m_splice && !m_native)
+            return;
+        // The duplicates keep both connections open; abort() only drops Qt's descriptors
+        m_client->disconnect(this);
+        m_socks->disconnect(this);
+        m_client->abort();
+        m_socks->abort();
+        release(m_queued[Upstream], m_queued[Upstream]);
+        release(m_queued[Downstream], m_queued[Downstream]);
+        m_state = State::Splicing;
+        auto hand = [this](auto &relay) {
+            relay->setFinishedCallback([this]() { finish(); });
+            relay->setProgressCallback([this](bool up, qint64 bytes) { count(up ? Upstream : Downstream, bytes); });
+            relay->setGrantCallback([this](bool up, qint64 want) { return grant(up ? Upstream : Downstream, want); });
+            relay->start();
+        };
+        if (m_native)
+            hand(m_native);
+        else
+            hand(m_splice);
+#endif
+    }
 
-        // Use domain name type
-        QByteArray hostBytes = m_targetHost.toUtf8();
-        connectReq.append(static_cast<char>(SOCKS5_ATYP_DOMAIN));
-        connectReq.append(static_cast<char>(hostBytes.size()));
-        connectReq.append(hostBytes);
+    void write(Direction dir, const QByteArray &data) {
+        write(dir, data.constData(), data.size());
+    }
 
-        // Port in network byte order
-        connectReq.append(static_cast<char>((m_targetPort >> 8) & 0xFF));
-        connectReq.append(static_cast<char>(m_targetPort & 0xFF));
+    void write(Direction dir, const char *data, qint64 size) {
+        QTcpSocket *sink = dir == Upstream ? m_socks : m_client;
+        if (size <= 0 || sink->state() != QAbstractSocket::ConnectedState)
+            return;
+        const qint64 written = sink->write(data, size);
+        if (written > 0) {
+            m_queued[dir] += written;
+            m_ctx->budget->queuedBytes.fetch_add(written, std::memory_order_relaxed);
+            count(dir, written);
+        }
+    }
 
-        m_socks->write(connectReq);
-        m_state = State::SocksConnectRequest;
+    void count(Direction dir, qint64 bytes) {
+        m_bytes[dir] += bytes;
+        const bool bulk = m_ctx->scheduler->account(m_flow, bytes);
+        m_ctx->budget->classBytes[bulk].fetch_add(bytes, std::memory_order_relaxed);
+        if (m_clientLimit)
+            m_ctx->clients->consume(*m_clientLimit, dir, bytes);
+        m_lastActivity = m_ctx->timers->now();
+        if (dir == Upstream)
+            m_ctx->traffic->addUp(bytes);
+        else
+            m_ctx->traffic->addDown(bytes);
     }
 
-    void handleSocksConnectResponse() {
-        // Minimum response: version(1) + reply(1) + rsv(1) + atyp(1) + addr(varies) + port(2)
-        if (m_socksBuffer.size() < 4) return;
+    void release(qint64 &queued, qint64 bytes) {
+        const qint64 n = qMin(bytes, queued);
+        queued -= n;
+        m_ctx->budget->queuedBytes.fetch_sub(n, std::memory_order_relaxed);
+    }
 
-        quint8 version = static_cast<quint8>(m_socksBuffer[0]);
-        quint8 reply = static_cast<quint8>(m_socksBuffer[1]);
-        quint8 atyp = static_cast<quint8>(m_socksBuffer[3]);
+    /**
+     * @brief Half-close handling: a side that hit EOF is closed towards its
+     * peer only after everything it sent has been relayed; the connection
+     * finishes once both sockets are down.
+     */
+    void closeIfDrained() {
+        if (m_finished)
+            return;
+        const bool relaying = m_state == State::Tunneling || m_state == State::Forwarding;
+        if (m_clientEof && (!relaying || m_client->bytesAvailable() == 0)
+            && m_socks->state() != QAbstractSocket::UnconnectedState) {
+            m_socks->disconnectFromHost();
+        }
+        if (m_socksEof && (!relaying || m_socks->bytesAvailable() == 0)
+            && m_client->state() != QAbstractSocket::UnconnectedState) {
+            m_client->disconnectFromHost();
+        }
+        if (m_client->state() == QAbstractSocket::UnconnectedState
+            && m_socks->state() == QAbstractSocket::UnconnectedState) {
+            finish();
+        }
+    }
 
-        // Calculate full response size
-        int addrLen = 0;
-        switch (atyp) {
-        case SOCKS5_ATYP_IPV4:
-            addrLen = 4;
-            break;
-        case SOCKS5_ATYP_DOMAIN:
-            if (m_socksBuffer.size() < 5) return;
-            addrLen = 1 + static_cast<quint8>(m_socksBuffer[4]);
-            break;
-        case 0x04: // IPv6
-            addrLen = 16;
-            break;
-        default:
-            sendError(502, "Bad Gateway - Unknown SOCKS address type");
+    void finish() {
+        if (m_finished)
             return;
+        m_finished = true;
+        m_ctx->timers->cancel(&m_timeout);
+        releaseUpstream();
+        leaveConnectGate();
+        if (m_throttleCount > 0) {
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 throttled %3 time(s)")
+                .arg(m_targetHost).arg(m_targetPort).arg(m_throttleCount));
         }
+        emit finished();
+    }
 
-        int totalLen = 4 + addrLen + 2;
-        if (m_socksBuffer.size() < totalLen) return;
+    int timeoutMs(HttpToSocksProxy::ReapReason reason) const {
+        const HttpToSocksProxy::Options &o = m_ctx->options;
+        switch (reason) {
+        case HttpToSocksProxy::IdleTimeout: return o.idleTimeoutSec * 1000;
+        case HttpToSocksProxy::HeaderTimeout: return o.headerTimeoutSec * 1000;
+        case HttpToSocksProxy::HandshakeTimeout: return o.handshakeTimeoutSec * 1000;
+        case HttpToSocksProxy::ConnectQueueTimeout: return o.connectQueueTimeoutSec * 1000;
+        }
+        return 0;
+    }
 
-        m_socksBuffer.remove(0, totalLen);
+    void armTimeout(HttpToSocksProxy::ReapReason reason) {
+        m_timeoutReason = reason;
+        const int ms = timeoutMs(reason);
+        if (ms > 0)
+            m_ctx->timers->schedule(&m_timeout, ms);
+        else
+            m_ctx->timers->cancel(&m_timeout);
+    }
 
-        if (version != SOCKS5_VERSION || reply != 0x00) {
-            sendError(502, QStringLiteral("Bad Gateway - SOCKS connect failed (code %1)").arg(reply));
+    void onTimeout() {
+        if (m_finished)
+            return;
+        if (m_state == State::Failed || m_state == State::Closing) {
+            // We already asked the client to go away and it did not
+            closeNow();
             return;
         }
-
-        // SOCKS5 connection established
-        m_tunnelEstablished = true;
-        m_state = State::Tunneling;
-
-        if (m_isConnect) {
-            // Send 200 Connection Established for CONNECT
-            QString response = QStringLiteral("HTTP/1.1 200 Connection Established\r\n\r\n");
-            m_client->write(response.toUtf8());
-        } else {
-            // Forward the original HTTP request
-            QByteArray request;
-            request.append(m_method.toUtf8());
-            request.append(' ');
-            request.append(m_requestUrl.toUtf8());
-            request.append(' ');
-            request.append(m_httpVersion.toUtf8());
-            request.append("\r\n");
-
-            // Add headers
-            for (auto it = m_headers.begin(); it != m_headers.end(); ++it) {
-                // Skip proxy-specific headers
-                if (it.key().startsWith(QLatin1String("proxy-"))) continue;
-                request.append(it.key().toUtf8());
-                request.append(": ");
-                request.append(it.value().toUtf8());
-                request.append("\r\n");
+        if (m_timeoutReason == HttpToSocksProxy::IdleTimeout) {
+            // Activity only stamps a tick; push the deadline out lazily
+            const qint64 idleMs = static_cast<qint64>(m_ctx->timers->now() - m_lastActivity) * m_ctx->timers->tickMs();
+            const int limitMs = timeoutMs(HttpToSocksProxy::IdleTimeout);
+            if (idleMs < limitMs) {
+                m_ctx->timers->schedule(&m_timeout, limitMs - idleMs);
+                return;
             }
-            request.append("\r\n");
-            request.append(m_requestBody);
-
-            m_socks->write(request);
         }
-
-        // Process any remaining data in the SOCKS buffer
-        if (!m_socksBuffer.isEmpty() && m_client->state() == QAbstractSocket::ConnectedState) {
-            m_client->write(m_socksBuffer);
-            m_socksBuffer.clear();
+        if (m_timeoutReason == HttpToSocksProxy::HandshakeTimeout && isHandshaking()) {
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 SOCKS handshake timed out").arg(m_targetHost).arg(m_targetPort));
+            if (retryOnAnotherUpstream(true))
+                return;
+        }
+        m_ctx->budget->reaped[m_timeoutReason].fetch_add(1, std::memory_order_relaxed);
+        switch (m_timeoutReason) {
+        case HttpToSocksProxy::IdleTimeout:
+            closeNow();
+            return;
+        case HttpToSocksProxy::HeaderTimeout:
+            sendError(408, "Request Timeout");
+            break;
+        case HttpToSocksProxy::HandshakeTimeout:
+            sendError(504, "Gateway Timeout - SOCKS handshake");
+            break;
+        case HttpToSocksProxy::ConnectQueueTimeout:
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 no tunnel slot within %3 s")
+                .arg(m_targetHost).arg(m_targetPort).arg(m_ctx->options.connectQueueTimeoutSec));
+            leaveConnectGate();
+            sendError(503, "Service Unavailable - Too many tunnels");
+            break;
         }
+        m_ctx->timers->schedule(&m_timeout, kCloseLingerMs);
+    }
+
+    /**
+     * @brief Drop both sides immediately, whatever is still queued
+     */
+    void closeNow() {
+        m_client->disconnect(this);
+        m_socks->disconnect(this);
+        release(m_queued[Upstream], m_queued[Upstream]);
+        release(m_queued[Downstream], m_queued[Downstream]);
+        m_splice.reset();
+        m_native.reset();
+        m_client->abort();
+        m_socks->abort();
+        finish();
     }
 
     void sendError(int code, const QString &message) {
+        if (m_state == State::Failed)
+            return;
+        m_state = State::Failed;
+        if (m_replied) {
+            // Optimistic CONNECT already answered 200, or a response head is
+            // already out: all we can do is a clean close
+            log(QStringLiteral("[HTTP2SOCKS] %1:%2 closed: %3").arg(m_targetHost).arg(m_targetPort).arg(message));
+            m_client->disconnectFromHost();
+            return;
+        }
+        if (m_client->state() != QAbstractSocket::ConnectedState)
+            return;
+        m_replied = true;
+        if (m_socksClient) {
+            log(QStringLiteral("[HTTP2SOCKS] SOCKS5 %1:%2 failed: %3").arg(m_targetHost).arg(m_targetPort).arg(message));
+            write(Downstream, socks5Reply(m_socksReply));
+            m_client->disconnectFromHost();
+            return;
+        }
         QString response = QStringLiteral("HTTP/1.1 %1 %2\r\n"
                                           "Content-Type: text/plain\r\n"
                                           "Connection: close\r\n"
                                           "\r\n"
                                           "%2\r\n").arg(code).arg(message);
-        m_client->write(response.toUtf8());
+        write(Downstream, response.toUtf8());
         m_client->disconnectFromHost();
     }
 
     void log(const QString &msg) {
-        if (m_logFunc) m_logFunc(msg);
+        PAQET_ALLOC_SCOPE(Log);
+        if (m_ctx->log) m_ctx->log(msg);
     }
 
     QTcpSocket *m_client = nullptr;
     QTcpSocket *m_socks = nullptr;
-    QString m_socksHost;
-    quint16 m_socksPort = 0;
-    LogFunc m_logFunc;
+    WorkerContext *m_ctx = nullptr;
 
     QByteArray m_requestBuffer;
     QByteArray m_socksBuffer;
     QByteArray m_requestBody;
-    QString m_method;
-    QString m_requestUrl;
-    QString m_httpVersion;
-    QMap<QString, QString> m_headers;
+    HttpRequestParser m_parser{kMaxRequestHead};
     QString m_targetHost;
     quint16 m_targetPort = 0;
     bool m_isConnect = false;
-    bool m_tunnelEstablished = false;
+    bool m_direct = false;           // routing rules bypass paqet for this target
     State m_state = State::WaitingForRequest;
+    std::unique_ptr<SpliceRelay> m_splice;
+    std::unique_ptr<EpollRelay::Tunnel> m_native;
+    bool m_spliceTried = false;
+
+    // Plain-HTTP forwarding, per exchange
+    QString m_origin;
+    QByteArray m_responseBuffer;          // response head being assembled
+    qsizetype m_forwardHeadLength = 0;    // rewritten request head at the front of m_requestBuffer
+    HttpBodyFramer m_requestFramer;
+    HttpBodyFramer m_responseFramer;
+    bool m_responseHeadDone = false;
+    bool m_headRequest = false;
+    bool m_clientKeepAlive = false;
+    bool m_upstreamKeepAlive = false;
+    bool m_upstreamReused = false;        // tunnel came from the origin pool
+    bool m_exchangeRetried = false;
+    QByteArray m_splitHead;               // request head kept while the exchange may be split
+    RangeDownload *m_split = nullptr;     // ranges after the first, while split
+    qint64 m_splitPrimaryLeft = 0;        // first-range bytes still due from the original tunnel
+    bool m_splitDetached = false;         // original tunnel dropped after the first range
+    QByteArray m_cacheKey;                // empty when the cache stays out of the exchange
+    bool m_cacheRevalidate = false;       // client asked for a revalidated answer
+    std::shared_ptr<const HttpCache::Entry> m_cacheEntry;   // stale entry being revalidated
+    std::unique_ptr<HttpCache::Fill> m_cacheFill;           // this exchange fetches m_cacheKey
+    std::unique_ptr<QFile> m_cacheBody;   // cached body being served
+    qint64 m_cacheLeft = 0;               // ... bytes of it still to send
+    quint64 m_cacheTicket = 0;            // waiting for a concurrent fetch of m_cacheKey
+
+    qint64 m_queued[2] = {0, 0};   // bytes written towards each direction's sink, not yet flushed
+    qint64 m_bytes[2] = {0, 0};    // bytes sent towards each direction's sink
+    bool m_paused[2] = {false, false};
+    bool m_retryScheduled[2] = {false, false};
+    bool m_deferred[2] = {false, false};    // waiting for the scheduler's next turn
+    bool m_tokenWait[2] = {false, false};   // waiting for the client's bucket to refill
+    RelayScheduler::Flow m_flow;
+    std::shared_ptr<ClientLimiter::Client> m_clientLimit;
+    ClientLimiter::Client *m_rateLimit = nullptr;           // m_clientLimit when rate limited
+    bool m_overClientLimit = false;
+    bool m_gateSlot = false;                // holds a ConnectGate slot
+    quint64 m_gateTicket = 0;               // queued at the ConnectGate
+    int m_throttleCount = 0;
+    bool m_clientEof = false;
+    bool m_socksEof = false;
+    bool m_replied = false;          // client got its 200, a response head or an error response
+    bool m_optimistic = false;       // 200 sent before the SOCKS handshake finished
+    bool m_greetingPending = false;  // greeting reply still expected ahead of the CONNECT reply
+    bool m_finished = false;
+
+    // Connection table
+    const quint64 m_id;
+    const QHostAddress m_peer;
+    const qint64 m_startedMs;
+    bool m_published = false;
+    HttpToSocksProxy::ConnectionPhase m_publishedPhase = HttpToSocksProxy::ConnectionPhase::Request;
+    QString m_publishedHost;
+    quint16 m_publishedPort = 0;
+    qint64 m_publishedBytes[2] = {0, 0};
+
+    // Upstream selection for the current SOCKS attempt
+    int m_upstream = -1;             // balancer index holding our slot, -1 = none
+    quint64 m_triedUpstreams = 0;    // bit i: upstream i already failed this request
+    int m_upstreamAttempts = 0;
+    QElapsedTimer m_connectClock;    // since the attempt started, for the reply-time EWMA
+
+    TimerWheel::Entry m_timeout;
+    HttpToSocksProxy::ReapReason m_timeoutReason = HttpToSocksProxy::HeaderTimeout;
+    quint64 m_lastActivity = 0;      // timer-wheel tick of the last relayed byte
+
+    // SOCKS5 clients on the same port
+    bool m_sniffed = false;          // protocol decided from the first byte
+    bool m_socksClient = false;
+    bool m_socksGreeted = false;
+    quint8 m_socksReply = SOCKS5_REPLY_GENERAL_FAILURE;  // code sent if the request fails
+};
+
+/**
+ * @brief Listening socket with SO_REUSEPORT set, so that every worker can
+ * own a separate accept queue on the same port and the kernel spreads new
+ * connections across them.
+ * @return Native descriptor, or -1 where the platform cannot shard accepts
+ */
+static qintptr createReusePortListener(const QHostAddress &address, quint16 port, int backlog)
+{
+#if defined(Q_OS_LINUX) && defined(SO_REUSEPORT)
+    sockaddr_storage storage{};
+    socklen_t length = 0;
+    int family = AF_INET;
+    if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+        auto *sa6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+        sa6->sin6_family = AF_INET6;
+        sa6->sin6_port = htons(port);
+        const Q_IPV6ADDR raw = address.toIPv6Address();
+        memcpy(&sa6->sin6_addr, &raw, sizeof(raw));
+        length = sizeof(sockaddr_in6);
+        family = AF_INET6;
+    } else {
+        auto *sa4 = reinterpret_cast<sockaddr_in *>(&storage);
+        sa4->sin_family = AF_INET;
+        sa4->sin_port = htons(port);
+        sa4->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length = sizeof(sockaddr_in);
+    }
+
+    const int fd = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        return -1;
+    const int one = 1;
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0
+        || ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0
+        || ::bind(fd, reinterpret_cast<sockaddr *>(&storage), length) < 0
+        || ::listen(fd, backlog) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    Q_UNUSED(backlog);
+    return -1;
+#endif
+}
+
+static void closeNativeSocket(qintptr socketDescriptor)
+{
+#ifdef Q_OS_WIN
+    ::closesocket(static_cast<SOCKET>(socketDescriptor));
+#else
+    ::close(static_cast<int>(socketDescriptor));
+#endif
+}
+
+/**
+ * @brief Check an accepted descriptor's peer against @p acl, without
+ * wrapping it in a QTcpSocket first
+ */
+static bool isPeerAllowed(qintptr socketDescriptor, const CidrAllowList &acl)
+{
+    sockaddr_storage storage{};
+    socklen_t length = sizeof(storage);
+#ifdef Q_OS_WIN
+    if (::getpeername(static_cast<SOCKET>(socketDescriptor), reinterpret_cast<sockaddr *>(&storage), &length) != 0)
+        return false;
+#else
+    if (::getpeername(static_cast<int>(socketDescriptor), reinterpret_cast<sockaddr *>(&storage), &length) != 0)
+        return false;
+#endif
+    if (storage.ss_family == AF_INET) {
+        const auto *sa4 = reinterpret_cast<const sockaddr_in *>(&storage);
+        return acl.allows(reinterpret_cast<const quint8 *>(&sa4->sin_addr), 4);
+    }
+    if (storage.ss_family == AF_INET6) {
+        const auto *sa6 = reinterpret_cast<const sockaddr_in6 *>(&storage);
+        return acl.allows(reinterpret_cast<const quint8 *>(&sa6->sin6_addr), 16);
+    }
+    return false;
+}
+
+/**
+ * @brief Let the process hold many client sockets: raise the soft
+ * descriptor limit to the hard one (Unix; Windows has no such cap)
+ */
+static void raiseDescriptorLimit()
+{
+#ifndef Q_OS_WIN
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+/**
+ * @brief QTcpServer that screens accepted descriptors and can hand them to
+ * another worker instead of queueing them (single-acceptor fallback).
+ */
+class AcceptServer : public QTcpServer
+{
+public:
+    using Dispatch = std::function<bool(qintptr)>;
+    using Admit = std::function<bool(qintptr)>;
+
+    explicit AcceptServer(QObject *parent = nullptr) : QTcpServer(parent) {}
+    void setDispatch(Dispatch dispatch) { m_dispatch = std::move(dispatch); }
+    /** Runs first on every descriptor; false closes it right away */
+    void setAdmit(Admit admit) { m_admit = std::move(admit); }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override {
+        if (m_admit && !m_admit(socketDescriptor)) {
+            closeNativeSocket(socketDescriptor);
+            return;
+        }
+        if (m_dispatch && m_dispatch(socketDescriptor))
+            return;
+        QTcpServer::incomingConnection(socketDescriptor);
+    }
+
+private:
+    Dispatch m_dispatch;
+    Admit m_admit;
 };
 
 /**
- * @brief Runs in worker thread: owns QTcpServer and all connection I/O
- * so that large proxy traffic does not block the GUI thread.
+ * @brief One proxy worker: owns a listener (or adopts sockets handed over by
+ * the acceptor) and all I/O of its connections, so that large proxy traffic
+ * neither blocks the GUI thread nor the other workers.
  */
 class ProxyServerRunner : public QObject
 {
     Q_OBJECT
 public:
-    explicit ProxyServerRunner(QObject *parent = nullptr) : QObject(parent) {}
+    ProxyServerRunner(int index, const HttpToSocksProxy::Options &options, RelayBudget *budget,
+                      TrafficCounters *traffic, BufferPool::Counters *bufferCounters, UpstreamBalancer *upstreams,
+                      ClientLimiter *clients, ConnectGate *connectGate, HttpCache *cache, QObject *parent = nullptr)
+        : QObject(parent), m_index(index), m_buffers(bufferCounters), m_scheduler(options.bulkBytesPerTurn)
+    {
+        m_context.options = options;
+        m_context.budget = budget;
+        m_context.traffic = traffic;
+        m_context.upstreams = upstreams;
+        m_context.clients = clients;
+        m_context.connectGate = connectGate;
+        m_context.cache = cache;
+        m_context.timers = &m_timers;
+        m_context.buffers = &m_buffers;
+        m_tickTimer = new QTimer(this);
+        m_tickTimer->setInterval(m_timers.tickMs());
+        connect(m_tickTimer, &QTimer::timeout, this, [this]() { m_timers.tick(); });
+        m_context.scheduler = &m_scheduler;
+        // Zero-delay: fires once the socket events already queued are handled
+        m_turnTimer = new QTimer(this);
+        m_turnTimer->setSingleShot(true);
+        m_turnTimer->setInterval(0);
+        connect(m_turnTimer, &QTimer::timeout, this, [this]() { m_scheduler.endTurn(); });
+        m_scheduler.onTurnNeeded = [this]() { m_turnTimer->start(); };
+        m_scheduler.onResume = [](QObject *owner, int direction) {
+            static_cast<HttpToSocksProxy::ClientConnection *>(owner)->resumeDeferred(direction);
+        };
+        m_publishTimer = new QTimer(this);
+        m_publishTimer->setInterval(HttpToSocksProxy::kConnectionBatchIntervalMs);
+        connect(m_publishTimer, &QTimer::timeout, this, &ProxyServerRunner::publishConnections);
+        m_context.log = [this](const QString &msg) { emit logRequested(msg); };
+    }
+
+    ~ProxyServerRunner() override {
+        // Connections (including ones only scheduled for deleteLater) use
+        // m_context and the timer wheel: they must go before our members
+        qDeleteAll(findChildren<HttpToSocksProxy::ClientConnection *>(Qt::FindDirectChildrenOnly));
+    }
+
+    int index() const { return m_index; }
+    bool isReusePort() const { return m_reusePort; }
+    /** The port actually bound (the one picked by the system for port 0) */
+    quint16 httpPort() const { return m_httpPort; }
+
+    /**
+     * @brief Workers that receive sockets when this runner is the single
+     * acceptor. Must be set before the worker threads start.
+     */
+    void setPeers(const QList<ProxyServerRunner *> &peers) { m_peers = peers; }
 
 public slots:
-    bool startListen(quint16 httpPort, const QString &socksHost, quint16 socksPort) {
-        m_socksHost = socksHost;
-        m_socksPort = socksPort;
+    /**
+     * @param reusePort Listen on a SO_REUSEPORT socket of our own; when false
+     * (or when that fails on worker 0) listen normally and dispatch to peers.
+     */
+    bool startListen(quint16 httpPort, bool reusePort) {
+        prepareUpstreams();
         m_httpPort = httpPort;
 
-        if (!m_server) {
-            m_server = new QTcpServer(this);
-            connect(m_server, &QTcpServer::newConnection, this, &ProxyServerRunner::onNewConnection);
-        }
-        if (m_server->isListening())
-            m_server->close();
+        closeServers();
         for (HttpToSocksProxy::ClientConnection *conn : m_connections) {
             conn->deleteLater();
         }
         m_connections.clear();
 
-        if (!m_server->listen(QHostAddress::LocalHost, httpPort))
-            return false;
+        QList<QHostAddress> addresses = m_context.options.listenAddresses;
+        if (addresses.isEmpty())
+            addresses.append(QHostAddress(QHostAddress::LocalHost));
+        const int backlog = qMax(1, m_context.options.listenBacklog);
+        m_reusePort = false;
+        if (reusePort) {
+            bool bound = true;
+            for (const QHostAddress &address : std::as_const(addresses)) {
+                const qintptr fd = createReusePortListener(address, m_httpPort, backlog);
+                AcceptServer *server = fd < 0 ? nullptr : addServer();
+                if (!server || !server->setSocketDescriptor(fd)) {
+                    if (fd >= 0)
+                        closeNativeSocket(fd);
+                    bound = false;
+                    break;
+                }
+                m_httpPort = server->serverPort();   // further addresses share a picked port
+            }
+            if (bound) {
+                m_reusePort = true;
+                return true;
+            }
+            closeServers();
+            m_httpPort = httpPort;
+            if (m_index != 0)
+                return false;  // only worker 0 may fall back to single-acceptor mode
+        }
+
+        for (const QHostAddress &address : std::as_const(addresses)) {
+            AcceptServer *server = addServer();
+            if (m_peers.size() > 1)
+                server->setDispatch([this](qintptr fd) { return dispatchToPeer(fd); });
+            server->setListenBacklogSize(backlog);
+            if (!server->listen(address, m_httpPort)) {
+                emit logRequested(QStringLiteral("[HTTP2SOCKS] Cannot listen on %1:%2: %3")
+                                      .arg(address.toString()).arg(m_httpPort).arg(server->errorString()));
+                closeServers();
+                return false;
+            }
+            m_httpPort = server->serverPort();
+        }
         return true;
     }
 
+    /**
+     * @brief Close the listeners and connections and stop every timer of
+     * this worker, so nothing wakes it up until it is destroyed
+     */
     void stopListen() {
-        if (m_server && m_server->isListening())
-            m_server->close();
+        closeServers();
+        for (SocksConnectionPool *pool : std::as_const(m_context.pools)) {
+            pool->setLimits(0, 0);   // stops its adapt timer and refills
+            pool->flush();
+        }
+        if (m_originPool)
+            m_originPool->clear();
+        if (m_preconnect)
+            m_preconnect->stop();
         for (HttpToSocksProxy::ClientConnection *conn : m_connections) {
             conn->deleteLater();
         }
         m_connections.clear();
+        m_tickTimer->stop();
+        m_turnTimer->stop();
+        // No more rows for a stopped listener; a restart starts a new session
+        m_publishTimer->stop();
+        m_removedIds.clear();
+    }
+
+    /**
+     * @brief Set up the per-worker upstream state (one warm pool per SOCKS
+     * endpoint); also used on its own for workers fed by the single acceptor
+     */
+    void prepareUpstreams() {
+        if (!m_tickTimer->isActive())
+            m_tickTimer->start();
+        if (!m_originPool) {
+            m_originPool = new OriginTunnelPool(this);
+            m_context.originPool = m_originPool;
+        }
+        if (m_context.options.socksPoolMax > 0 && m_context.pools.isEmpty()) {
+            for (int i = 0; i < m_context.upstreams->size(); ++i) {
+                const UpstreamBalancer::Endpoint &endpoint = m_context.upstreams->endpoint(i);
+                auto *pool = new SocksConnectionPool(this);
+                pool->setUpstream(endpoint.host, endpoint.port);
+                pool->setLimits(m_context.options.socksPoolMin, m_context.options.socksPoolMax);
+                m_context.pools.append(pool);
+            }
+        }
+        if (m_context.options.relayEngine == HttpToSocksProxy::RelayEngine::Native && !m_nativeRelay) {
+            m_nativeRelay = EpollRelay::create(this, &m_buffers);
+            m_context.nativeRelay = m_nativeRelay.get();
+            if (!m_nativeRelay && m_index == 0)
+                emit logRequested(QStringLiteral("[HTTP2SOCKS] Native relay engine unavailable, using Qt sockets"));
+        }
+        if (m_context.options.preconnectBudget > 0 && !m_preconnect) {
+            m_preconnect = new PreconnectPool(m_context.upstreams, m_context.connectGate,
+                                              &m_context.budget->preconnect, this);
+            m_preconnect->setLimits(m_context.options.preconnectBudget, m_context.options.preconnectTopK,
+                                    m_context.options.preconnectTtlSec * 1000);
+            m_context.preconnect = m_preconnect;
+        }
+    }
+
+    /**
+     * @brief Drop warm upstream sockets and idle origin tunnels, e.g.
+     * because paqet restarted
+     */
+    void flushUpstreamPool() {
+        if (m_originPool)
+            m_originPool->clear();
+        if (m_preconnect)
+            m_preconnect->flush();
+        for (SocksConnectionPool *pool : std::as_const(m_context.pools)) {
+            pool->flush();
+            pool->setLimits(m_context.options.socksPoolMin, m_context.options.socksPoolMax);
+        }
+    }
+
+    /**
+     * @brief Start or stop publishing connection batches; a new session
+     * starts with every open connection as added
+     */
+    void setConnectionTracking(bool enabled) {
+        m_removedIds.clear();
+        if (!enabled) {
+            m_publishTimer->stop();
+            return;
+        }
+        for (HttpToSocksProxy::ClientConnection *conn : std::as_const(m_connections))
+            conn->setPublished(false);
+        m_publishTimer->start();
+    }
+
+    void setBlocklist(std::shared_ptr<const DomainBlocklist> blocklist) {
+        m_context.options.blocklist = std::move(blocklist);
+    }
+
+    /**
+     * @brief Take over a socket accepted by the acceptor worker
+     */
+    void adoptSocket(qintptr socketDescriptor) {
+        auto *clientSocket = new QTcpSocket(this);
+        if (!clientSocket->setSocketDescriptor(socketDescriptor)) {
+            delete clientSocket;
+            closeNativeSocket(socketDescriptor);
+            return;
+        }
+        addConnection(clientSocket);
     }
 
 signals:
     void logRequested(const QString &message);
+    void connectionBatchReady(const HttpToSocksProxy::ConnectionBatch &batch);
 
-private slots:
-    void onNewConnection() {
-        while (m_server->hasPendingConnections()) {
-            QTcpSocket *clientSocket = m_server->nextPendingConnection();
-            auto logFunc = [this](const QString &msg) { emit logRequested(msg); };
-            auto *conn = new HttpToSocksProxy::ClientConnection(
-                clientSocket, m_socksHost, m_socksPort, logFunc, this);
-            m_connections.append(conn);
-
-            connect(conn, &HttpToSocksProxy::ClientConnection::finished, this, [this, conn]() {
-                m_connections.removeOne(conn);
-                conn->deleteLater();
+private:
+    AcceptServer *addServer() {
+        auto *server = new AcceptServer(this);
+        server->setAdmit([this, server](qintptr fd) { return admit(server, fd); });
+        connect(server, &QTcpServer::newConnection, this, [this, server]() {
+            while (server->hasPendingConnections())
+                addConnection(server->nextPendingConnection());
+        });
+        m_servers.append(server);
+        return server;
+    }
+
+    void closeServers() {
+        qDeleteAll(m_servers);
+        m_servers.clear();
+    }
+
+    /**
+     * @brief Screen a freshly accepted descriptor: drop clients outside the
+     * allow-list, and pause accepting when the proxy-wide rate is spent
+     */
+    bool admit(AcceptServer *server, qintptr fd) {
+        const CidrAllowList *acl = m_context.options.allowedClients.get();
+        if (acl && !isPeerAllowed(fd, *acl)) {
+            m_context.budget->deniedClients.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (const int pauseMs = m_context.budget->acceptGuard.take()) {
+            // New connections wait in the kernel backlog meanwhile
+            m_context.budget->acceptPauses.fetch_add(1, std::memory_order_relaxed);
+            server->pauseAccepting();
+            QPointer<AcceptServer> guard(server);
+            QTimer::singleShot(pauseMs, this, [guard]() {
+                if (guard)
+                    guard->resumeAccepting();
             });
         }
+        return true;
     }
 
-private:
-    QTcpServer *m_server = nullptr;
-    QString m_socksHost;
-    quint16 m_socksPort = 0;
+    void addConnection(QTcpSocket *clientSocket) {
+        auto *conn = new HttpToSocksProxy::ClientConnection(clientSocket, &m_context, this);
+        m_connections.append(conn);
+
+        connect(conn, &HttpToSocksProxy::ClientConnection::finished, this, [this, conn]() {
+            if (conn->isPublished() && m_publishTimer->isActive())
+                m_removedIds.append(conn->id());
+            m_connections.removeOne(conn);
+            conn->deleteLater();
+        });
+    }
+
+    /**
+     * @brief Send what changed since the last batch: one queued signal per
+     * interval whatever the number of connections
+     */
+    void publishConnections() {
+        HttpToSocksProxy::ConnectionBatch batch;
+        batch.removed.swap(m_removedIds);
+        for (HttpToSocksProxy::ClientConnection *conn : std::as_const(m_connections))
+            conn->publishInto(batch);
+        if (!batch.added.isEmpty() || !batch.changed.isEmpty() || !batch.removed.isEmpty())
+            emit connectionBatchReady(batch);
+    }
+
+    bool dispatchToPeer(qintptr socketDescriptor) {
+        ProxyServerRunner *peer = m_peers.at(m_nextPeer);
+        m_nextPeer = (m_nextPeer + 1) % m_peers.size();
+        if (peer == this)
+            return false;  // let QTcpServer queue it for onNewConnection()
+        QMetaObject::invokeMethod(peer, [peer, socketDescriptor]() {
+            peer->adoptSocket(socketDescriptor);
+        }, Qt::QueuedConnection);
+        return true;
+    }
+
+    const int m_index;
+    QList<AcceptServer *> m_servers;   // one per listen address
+    QList<ProxyServerRunner *> m_peers;
+    int m_nextPeer = 0;
+    bool m_reusePort = false;
+    WorkerContext m_context;
+    BufferPool m_buffers;                        // outlives the connections and their tunnels
+    OriginTunnelPool *m_originPool = nullptr;
+    PreconnectPool *m_preconnect = nullptr;
+    std::shared_ptr<EpollRelay> m_nativeRelay;   // when Options::relayEngine is Native
     quint16 m_httpPort = 0;
     QList<HttpToSocksProxy::ClientConnection*> m_connections;
+    TimerWheel m_timers{kTimerWheelSlots, kTimerTickMs};
+    QTimer *m_tickTimer = nullptr;
+    RelayScheduler m_scheduler;
+    QTimer *m_turnTimer = nullptr;
+    QTimer *m_publishTimer = nullptr;      // connection batches, while tracking
+    QList<quint64> m_removedIds;           // published connections gone since the last batch
 };
 
 // Include the moc file for the nested class and ProxyServerRunner
@@ -410,73 +2421,282 @@ private:
 
 HttpToSocksProxy::HttpToSocksProxy(QObject *parent)
     : QObject(parent)
+    , m_budget(std::make_unique<RelayBudget>())
+    , m_traffic(std::make_unique<TrafficCounters[]>(kMaxWorkers))
+    , m_bufferCounters(std::make_unique<BufferPool::Counters[]>(kMaxWorkers))
 {
+    qRegisterMetaType<HttpToSocksProxy::ConnectionBatch>();
 }
 
 HttpToSocksProxy::~HttpToSocksProxy() {
     stop();
-    if (m_thread) {
-        m_thread->quit();
-        if (!m_thread->wait(3000))
-            m_thread->terminate();
-        delete m_runner;
-        m_runner = nullptr;
-        m_thread = nullptr;
-    }
+    shutdownWorkers();
 }
 
 bool HttpToSocksProxy::start(quint16 httpPort, const QString &socksHost, quint16 socksPort) {
+    return start(httpPort, {UpstreamBalancer::Endpoint{socksHost, socksPort}});
+}
+
+bool HttpToSocksProxy::start(quint16 httpPort, const QList<UpstreamBalancer::Endpoint> &upstreams) {
     if (m_running)
         stop();
+    shutdownWorkers();
 
-    m_socksHost = socksHost;
-    m_socksPort = socksPort;
+    if (upstreams.isEmpty()) {
+        emit error(tr("HTTP proxy has no SOCKS upstream"));
+        return false;
+    }
+    // Connections track the upstreams they tried in a 64-bit mask
+    const QList<UpstreamBalancer::Endpoint> endpoints = upstreams.mid(0, 64);
+    if (endpoints.size() < upstreams.size())
+        log(QStringLiteral("[HTTP2SOCKS] Using the first 64 of %1 SOCKS upstreams").arg(upstreams.size()));
+    m_upstreams = std::make_unique<UpstreamBalancer>(endpoints, m_options.upstreamPolicy);
+    ClientLimiter::Limits limits;
+    limits.bytesPerSec = m_options.clientRateLimit;
+    limits.maxConnections = m_options.clientMaxConnections;
+    m_clientLimiter = std::make_unique<ClientLimiter>(limits);
+    m_connectGate.reset();
+    if (m_options.maxConcurrentConnects > 0)
+        m_connectGate = std::make_unique<ConnectGate>(m_options.maxConcurrentConnects);
+    m_cache.reset();
+    if (m_options.cacheMaxBytes > 0 && !m_options.cacheDirectory.isEmpty())
+        m_cache = std::make_unique<HttpCache>(m_options.cacheDirectory, m_options.cacheMaxBytes);
     m_httpPort = httpPort;
+    m_budget->limit = m_options.relayMemoryBudget;
+    // Local clients are never throttled: the guard is for LAN gateway mode
+    const bool exposed = std::any_of(m_options.listenAddresses.cbegin(), m_options.listenAddresses.cend(),
+                                     [](const QHostAddress &address) { return !address.isLoopback(); });
+    m_budget->acceptGuard.reset(exposed ? m_options.acceptRate : 0);
+    raiseDescriptorLimit();
+
+    const int workers = qBound(1, m_options.workerCount > 0 ? m_options.workerCount
+                                                           : QThread::idealThreadCount(), kMaxWorkers);
+    for (int i = 0; i < workers; ++i) {
+        auto *thread = new QThread(this);
+        thread->setObjectName(QStringLiteral("http2socks-%1").arg(i));
+        auto *runner = new ProxyServerRunner(i, m_options, m_budget.get(), &m_traffic[i], &m_bufferCounters[i],
+                                             m_upstreams.get(), m_clientLimiter.get(), m_connectGate.get(),
+                                             m_cache.get());
+        runner->moveToThread(thread);
+        connect(runner, &ProxyServerRunner::logRequested, this, &HttpToSocksProxy::onLogFromWorker, Qt::QueuedConnection);
+        // Batches still queued from workers that were stopped meanwhile are stale
+        connect(runner, &ProxyServerRunner::connectionBatchReady, this, [this, runner](const ConnectionBatch &batch) {
+            if (m_runners.contains(runner))
+                emit connectionBatch(batch);
+        }, Qt::QueuedConnection);
+        m_threads.append(thread);
+        m_runners.append(runner);
+    }
+    m_runners.first()->setPeers(m_runners);
+    for (QThread *thread : std::as_const(m_threads))
+        thread->start();
+
+    auto startWorker = [&](ProxyServerRunner *runner, bool reusePort) {
+        bool ok = false;
+        const bool invoked = QMetaObject::invokeMethod(runner, "startListen",
+            Qt::BlockingQueuedConnection,
+            Q_RETURN_ARG(bool, ok),
+            Q_ARG(quint16, httpPort),
+            Q_ARG(bool, reusePort));
+        return invoked && ok;
+    };
 
-    if (!m_thread) {
-        m_thread = new QThread(this);
-        m_runner = new ProxyServerRunner();
-        m_runner->moveToThread(m_thread);
-        connect(static_cast<ProxyServerRunner *>(m_runner), &ProxyServerRunner::logRequested, this, &HttpToSocksProxy::onLogFromWorker, Qt::QueuedConnection);
-        m_thread->start();
-    }
-
-    bool ok = false;
-    const bool invoked = QMetaObject::invokeMethod(m_runner, "startListen",
-        Qt::BlockingQueuedConnection,
-        Q_RETURN_ARG(bool, ok),
-        Q_ARG(quint16, httpPort),
-        Q_ARG(QString, socksHost),
-        Q_ARG(quint16, socksPort));
-    if (!invoked || !ok) {
-        if (invoked)
-            log(QStringLiteral("[HTTP2SOCKS] Failed to start on port %1").arg(httpPort));
+    // Worker 0 decides the mode: sharded listeners when SO_REUSEPORT works,
+    // otherwise it becomes the single acceptor for the whole pool.
+    if (!startWorker(m_runners.first(), workers > 1)) {
+        log(QStringLiteral("[HTTP2SOCKS] Failed to start on port %1").arg(httpPort));
+        shutdownWorkers();
         emit error(tr("HTTP proxy failed to start"));
         return false;
     }
+    // Port 0: the others join the port worker 0 was given
+    httpPort = m_runners.first()->httpPort();
+    m_httpPort = httpPort;
+    const bool sharded = m_runners.first()->isReusePort();
+    for (int i = 1; i < m_runners.size(); ++i) {
+        ProxyServerRunner *runner = m_runners.at(i);
+        if (sharded) {
+            if (!startWorker(runner, true))
+                log(QStringLiteral("[HTTP2SOCKS] Worker %1 could not bind its own listener").arg(i));
+        } else {
+            QMetaObject::invokeMethod(runner, "prepareUpstreams", Qt::BlockingQueuedConnection);
+        }
+    }
 
     m_running = true;
-    log(QStringLiteral("[HTTP2SOCKS] Started HTTP proxy on 127.0.0.1:%1, forwarding to SOCKS5 %2:%3")
-        .arg(httpPort).arg(socksHost).arg(socksPort));
+    if (m_tracking)
+        setConnectionTracking(true);
+    QStringList targets;
+    for (const UpstreamBalancer::Endpoint &endpoint : endpoints)
+        targets.append(QStringLiteral("%1:%2").arg(endpoint.host).arg(endpoint.port));
+    QStringList listening;
+    for (const QHostAddress &address : std::as_const(m_options.listenAddresses))
+        listening.append(address.toString());
+    if (listening.isEmpty())
+        listening.append(QStringLiteral("127.0.0.1"));
+    log(QStringLiteral("[HTTP2SOCKS] Started HTTP proxy on %1 port %2, forwarding to SOCKS5 %3")
+        .arg(listening.join(QStringLiteral(", "))).arg(httpPort).arg(targets.join(QStringLiteral(", "))));
+    if (m_options.allowedClients) {
+        log(QStringLiteral("[HTTP2SOCKS] Accepting clients from %1 network range(s)")
+            .arg(m_options.allowedClients->rangeCount()));
+    }
+    if (endpoints.size() > 1) {
+        log(QStringLiteral("[HTTP2SOCKS] Balancing %1 upstreams by %2").arg(endpoints.size())
+            .arg(m_options.upstreamPolicy == UpstreamBalancer::Policy::FastestReply
+                 ? QStringLiteral("CONNECT reply time") : QStringLiteral("least connections")));
+    }
+    if (limits.bytesPerSec > 0 || limits.maxConnections > 0) {
+        log(QStringLiteral("[HTTP2SOCKS] Per-client limits: %1 KiB/s each way, %2 connection(s)")
+            .arg(m_options.clientRateLimit > 0 ? QString::number(m_options.clientRateLimit / 1024) : QStringLiteral("unlimited"))
+            .arg(m_options.clientMaxConnections > 0 ? QString::number(m_options.clientMaxConnections) : QStringLiteral("unlimited")));
+    }
+    log(QStringLiteral("[HTTP2SOCKS] %1 worker(s), %2")
+        .arg(workers)
+        .arg(sharded ? QStringLiteral("SO_REUSEPORT listeners") : QStringLiteral("single acceptor")));
     emit started();
     return true;
 }
 
 void HttpToSocksProxy::stop() {
-    if (!m_running || !m_runner)
+    if (!m_running || m_runners.isEmpty())
         return;
-    QMetaObject::invokeMethod(m_runner, "stopListen", Qt::BlockingQueuedConnection);
+    for (ProxyServerRunner *runner : std::as_const(m_runners))
+        QMetaObject::invokeMethod(runner, "stopListen", Qt::BlockingQueuedConnection);
+    shutdownWorkers();
     m_running = false;
     log(QStringLiteral("[HTTP2SOCKS] Stopped"));
     emit stopped();
 }
 
+void HttpToSocksProxy::shutdownWorkers() {
+    // A runner's timers, sockets and notifiers belong to its thread, so it
+    // is destroyed there: deferred deletes still run after finished(), and
+    // wait() returns once they have
+    for (int i = 0; i < m_threads.size(); ++i) {
+        QThread *thread = m_threads.at(i);
+        connect(thread, &QThread::finished, m_runners.at(i), &QObject::deleteLater);
+        thread->quit();
+    }
+    for (QThread *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+    m_runners.clear();
+}
+
+void HttpToSocksProxy::setConnectionTracking(bool enabled) {
+    m_tracking = enabled;
+    for (ProxyServerRunner *runner : std::as_const(m_runners)) {
+        QMetaObject::invokeMethod(runner, [runner, enabled]() {
+            runner->setConnectionTracking(enabled);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void HttpToSocksProxy::setBlocklist(std::shared_ptr<const DomainBlocklist> blocklist) {
+    m_options.blocklist = blocklist;
+    for (ProxyServerRunner *runner : std::as_const(m_runners)) {
+        QMetaObject::invokeMethod(runner, [runner, blocklist]() {
+            runner->setBlocklist(blocklist);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void HttpToSocksProxy::flushUpstreamPool() {
+    for (ProxyServerRunner *runner : std::as_const(m_runners))
+        QMetaObject::invokeMethod(runner, "flushUpstreamPool", Qt::QueuedConnection);
+}
+
+qint64 HttpToSocksProxy::queuedBytes() const {
+    return m_budget->queuedBytes.load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::throttleEvents() const {
+    return m_budget->throttleEvents.load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::interactiveBytes() const {
+    return m_budget->classBytes[0].load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::bulkBytes() const {
+    return m_budget->classBytes[1].load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::reapedConnections(ReapReason reason) const {
+    return m_budget->reaped[reason].load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::routedConnections(RoutingRules::Action action) const {
+    return m_budget->routed[static_cast<int>(action)].load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::blockedRequests() const {
+    return m_budget->blocked.load(std::memory_order_relaxed);
+}
+
+PreconnectPool::Stats HttpToSocksProxy::preconnectStats() const {
+    return PreconnectPool::stats(m_budget->preconnect);
+}
+
+HttpCache::Stats HttpToSocksProxy::cacheStats() const {
+    return m_cache ? m_cache->stats() : HttpCache::Stats();
+}
+
+BufferPool::Stats HttpToSocksProxy::bufferPoolStats() const {
+    return BufferPool::stats(m_bufferCounters.get(), kMaxWorkers);
+}
+
+QList<ClientLimiter::Stats> HttpToSocksProxy::clientStats() const {
+    return m_clientLimiter ? m_clientLimiter->stats() : QList<ClientLimiter::Stats>();
+}
+
+qint64 HttpToSocksProxy::deniedClients() const {
+    return m_budget->deniedClients.load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::acceptPauses() const {
+    return m_budget->acceptPauses.load(std::memory_order_relaxed);
+}
+
+qint64 HttpToSocksProxy::refusedClientConnections() const {
+    return m_clientLimiter ? m_clientLimiter->refusedConnections() : 0;
+}
+
+int HttpToSocksProxy::activeConnects() const {
+    return m_connectGate ? m_connectGate->active() : 0;
+}
+
+int HttpToSocksProxy::waitingConnects() const {
+    return m_connectGate ? m_connectGate->waiting() : 0;
+}
+
+QList<UpstreamBalancer::Stats> HttpToSocksProxy::upstreamStats() const {
+    return m_upstreams ? m_upstreams->stats() : QList<UpstreamBalancer::Stats>();
+}
+
+quint64 HttpToSocksProxy::bytesUp() const {
+    quint64 total = 0;
+    for (int i = 0; i < kMaxWorkers; ++i)
+        total += m_traffic[i].up.load(std::memory_order_relaxed);
+    return total;
+}
+
+quint64 HttpToSocksProxy::bytesDown() const {
+    quint64 total = 0;
+    for (int i = 0; i < kMaxWorkers; ++i)
+        total += m_traffic[i].down.load(std::memory_order_relaxed);
+    return total;
+}
+
 void HttpToSocksProxy::onLogFromWorker(const QString &message) {
     if (m_logBuffer)
         m_logBuffer->append(message);
 }
 
 void HttpToSocksProxy::log(const QString &message) {
+    PAQET_ALLOC_SCOPE(Log);
     if (m_logBuffer)
         m_logBuffer->append(message);
 }
@@ -6,42 +6,227 @@
 #include <QList>
 #include <QByteArray>
 #include <QThread>
+#include "BufferPool.h"
+#include "CidrAllowList.h"
+#include "ClientLimiter.h"
+#include "DomainBlocklist.h"
+#include "HttpCache.h"
+#include "PreconnectPool.h"
+#include "RoutingRules.h"
+#include "UpstreamBalancer.h"
 #include <functional>
+#include <memory>
 
+class ConnectGate;
 class LogBuffer;
 class ProxyServerRunner;
+struct RelayBudget;
+struct TrafficCounters;
 
 /**
  * @brief HTTP-to-SOCKS5 proxy server
  *
  * Accepts HTTP and HTTPS (via CONNECT) requests on a local port
- * and forwards them through a SOCKS5 proxy.
- * Runs the server and all connection I/O in a dedicated thread so that
- * large downloads (e.g. IDM) do not freeze the UI.
+ * and forwards them through a SOCKS5 proxy. SOCKS5 clients may use the
+ * same port: the first byte of a connection tells the protocols apart, and
+ * both share the pooled, metered upstream path.
+ * Runs the server and all connection I/O on a pool of worker threads so
+ * that large downloads (e.g. IDM) neither freeze the UI nor starve other
+ * tunnels. Each worker owns its own listener on the HTTP port via
+ * SO_REUSEPORT where the platform supports it; otherwise worker 0 accepts
+ * and hands sockets to the workers round-robin.
+ *
+ * Several SOCKS5 upstreams may be given; new connections are balanced over
+ * them by UpstreamBalancer, and a CONNECT that fails on one is retried on
+ * another before the client sees an error. Optional routing rules send
+ * some targets straight out (same relay path and counters) or refuse them.
+ *
+ * By default only 127.0.0.1 is served. In LAN gateway mode the bridge also
+ * listens on other addresses; clients outside the allow-list are closed on
+ * the raw descriptor, and an accept-rate guard pauses the listeners during
+ * connection storms (the kernel backlog absorbs the rest).
  */
 class HttpToSocksProxy : public QObject
 {
     Q_OBJECT
 public:
+    /**
+     * @brief What moves the bytes of established tunnels
+     */
+    enum class RelayEngine {
+        Qt,       // QTcpSocket, handed to SpliceRelay when Options::spliceRelay
+        Native    // the worker's EpollRelay (Linux; Qt elsewhere)
+    };
+
+    /**
+     * @brief Tuning knobs, applied on the next start()
+     */
+    struct Options {
+        int workerCount = 0;  // 0 = QThread::idealThreadCount()
+
+        // Backpressure, per relay direction: stop reading from the source once
+        // the sink has this many bytes queued, resume when it drains below low.
+        qint64 relayHighWatermark = 1024 * 1024;
+        qint64 relayLowWatermark = 256 * 1024;
+        // Flows RelayScheduler classified as bulk get this (smaller) high
+        // watermark, and together at most bulkBytesPerTurn per event-loop
+        // turn of their worker (0 = no per-turn limit)
+        qint64 bulkHighWatermark = 256 * 1024;
+        qint64 bulkBytesPerTurn = 512 * 1024;
+        // Cap on bytes queued in write buffers across all connections (0 = unlimited)
+        qint64 relayMemoryBudget = 256 * 1024 * 1024;
+        // Linux: once a tunnel is established, move its bytes with splice()
+        // between the two sockets instead of copying through QByteArray
+        bool spliceRelay = true;
+        // Linux: relay established tunnels on one edge-triggered epoll set
+        // per worker with fixed buffers, bypassing Qt sockets and splice
+        RelayEngine relayEngine = RelayEngine::Qt;
+        // Reply 200 to CONNECT before the SOCKS handshake completes and
+        // pipeline greeting + CONNECT; saves one tunnel RTT, but upstream
+        // failures become a plain close instead of a 502
+        bool optimisticConnect = false;
+        // Per worker: SOCKS connections kept connected and greeted ahead of
+        // demand; the pool sizes itself between min and max (max 0 = off)
+        int socksPoolMin = 1;
+        int socksPoolMax = 16;
+        // Per worker: tunnels CONNECTed ahead of demand to the preconnectTopK
+        // most visited destinations, each kept for up to preconnectTtlSec
+        // (budget 0 = off)
+        int preconnectBudget = 0;
+        int preconnectTopK = 8;
+        int preconnectTtlSec = 10;
+        // Plain-HTTP GETs of at least rangeSplitThreshold bytes from origins
+        // that accept byte ranges are fetched as rangeSplitCount ranges over
+        // as many tunnels (below 2 = off); each extra range buffers at most
+        // rangeSplitBuffer bytes ahead of the client
+        int rangeSplitCount = 0;
+        qint64 rangeSplitThreshold = 16 * 1024 * 1024;
+        qint64 rangeSplitBuffer = 4 * 1024 * 1024;
+        // Cacheable plain-HTTP responses are kept in cacheDirectory, at most
+        // cacheMaxBytes of them (0 = no cache)
+        QString cacheDirectory;
+        qint64 cacheMaxBytes = 0;
+        // Connection timeouts in seconds (0 = none): no byte relayed either
+        // way, request head not complete, SOCKS side not established
+        int idleTimeoutSec = 300;
+        int headerTimeoutSec = 30;
+        int handshakeTimeoutSec = 15;
+        // How new connections are spread over several SOCKS upstreams
+        UpstreamBalancer::Policy upstreamPolicy = UpstreamBalancer::Policy::LeastConnections;
+        // Upstreams tried for one CONNECT before replying 502
+        int upstreamAttempts = 3;
+        // Per-target direct / tunnel / reject decision (null = tunnel everything)
+        std::shared_ptr<const RoutingRules> routing;
+        // Domains refused with 403 before any upstream work (null = none)
+        std::shared_ptr<const DomainBlocklist> blocklist;
+        // Per source IP (LAN sharing): bytes per second each way, enforced
+        // by pausing reads, and concurrent connections (0 = unlimited)
+        qint64 clientRateLimit = 0;
+        int clientMaxConnections = 0;
+        // Proxy-wide cap on concurrent tunnels through paqet; requests over
+        // it queue for up to connectQueueTimeoutSec (0 = no cap)
+        int maxConcurrentConnects = 0;
+        int connectQueueTimeoutSec = 10;
+        // Addresses to listen on (empty = 127.0.0.1 only); an any-address
+        // must not be combined with others
+        QList<QHostAddress> listenAddresses;
+        // Clients allowed to connect, checked at accept time (null = all)
+        std::shared_ptr<const CidrAllowList> allowedClients;
+        // Kernel queue of not yet accepted connections, per listener
+        int listenBacklog = 1024;
+        // Proxy-wide accepts per second before the listeners pause (0 = unlimited);
+        // only applied when a listen address is not loopback
+        int acceptRate = 0;
+    };
+
+    /**
+     * @brief Why a connection was closed by the timeout reaper
+     */
+    enum ReapReason {
+        IdleTimeout = 0,
+        HeaderTimeout = 1,
+        HandshakeTimeout = 2,
+        ConnectQueueTimeout = 3
+    };
+
+    /**
+     * @brief What a connection is doing, as shown in the connection table
+     */
+    enum class ConnectionPhase : quint8 {
+        Request,      // reading the request
+        Queued,       // waiting for a tunnel slot
+        Connecting,   // upstream being set up
+        Forwarding,   // plain-HTTP exchange
+        Tunnel,
+        Splice,       // tunnel relayed by SpliceRelay or EpollRelay
+        Closing
+    };
+
+    struct ConnectionInfo {
+        quint64 id = 0;           // unique per proxy instance
+        QString target;           // "host:port", empty until the request is read
+        QString client;           // client address
+        qint64 startedMs = 0;     // ms since epoch
+        qint64 bytesUp = 0;
+        qint64 bytesDown = 0;
+        ConnectionPhase phase = ConnectionPhase::Request;
+    };
+
+    /**
+     * @brief One worker's connection changes since its previous batch
+     */
+    struct ConnectionBatch {
+        QList<ConnectionInfo> added;
+        QList<ConnectionInfo> changed;   // target, counters or phase moved
+        QList<quint64> removed;
+    };
+
+    static constexpr int kConnectionBatchIntervalMs = 250;
+
     explicit HttpToSocksProxy(QObject *parent = nullptr);
     ~HttpToSocksProxy() override;
 
     void setLogBuffer(LogBuffer *logBuffer) { m_logBuffer = logBuffer; }
 
+    void setOptions(const Options &options) { m_options = options; }
+    const Options &options() const { return m_options; }
+
     /**
      * @brief Start the HTTP proxy server
-     * @param httpPort Port to listen on for HTTP requests
+     * @param httpPort Port to listen on for HTTP requests (0 = a free one, see httpPort())
      * @param socksHost SOCKS5 proxy host (e.g., "127.0.0.1")
      * @param socksPort SOCKS5 proxy port (e.g., 1080)
      * @return true if started successfully
      */
     bool start(quint16 httpPort, const QString &socksHost, quint16 socksPort);
 
+    /**
+     * @brief Start the HTTP proxy server, balancing over several SOCKS5
+     * upstreams (at most 64)
+     * @param httpPort Port to listen on for HTTP requests (0 = a free one, see httpPort())
+     * @param upstreams SOCKS5 endpoints; must not be empty
+     * @return true if started successfully
+     */
+    bool start(quint16 httpPort, const QList<UpstreamBalancer::Endpoint> &upstreams);
+
     /**
      * @brief Stop the HTTP proxy server
      */
     void stop();
 
+    /**
+     * @brief Publish connectionBatch() every kConnectionBatchIntervalMs
+     * while enabled; enabling starts with every open connection as added
+     */
+    void setConnectionTracking(bool enabled);
+    bool isConnectionTracking() const { return m_tracking; }
+
+    /**
+     * @brief Replace Options::blocklist, also in the workers of a running
+     * proxy (for a list compiled after start())
+     */
+    void setBlocklist(std::shared_ptr<const DomainBlocklist> blocklist);
+
     /**
      * @brief Check if the proxy is running
      */
@@ -52,10 +237,114 @@ public:
      */
     quint16 httpPort() const { return m_httpPort; }
 
+    /**
+     * @brief Number of worker threads while running (0 when stopped)
+     */
+    int workerCount() const { return m_runners.size(); }
+
+    /**
+     * @brief Drop all pre-handshaked SOCKS connections (call when paqet restarts)
+     */
+    void flushUpstreamPool();
+
+    /**
+     * @brief Bytes currently queued in relay write buffers (all workers)
+     */
+    qint64 queuedBytes() const;
+
+    /**
+     * @brief Total number of times a connection paused reading for backpressure
+     */
+    qint64 throttleEvents() const;
+
+    /**
+     * @brief Bytes relayed towards upstream / towards clients since the
+     * proxy was created (all workers, both protocols, splice included)
+     */
+    quint64 bytesUp() const;
+    quint64 bytesDown() const;
+
+    /**
+     * @brief Bytes relayed while their flow was classified interactive /
+     * bulk by the relay scheduler (all workers, both directions)
+     */
+    qint64 interactiveBytes() const;
+    qint64 bulkBytes() const;
+
+    /**
+     * @brief Connections closed so far because @p reason's timeout expired
+     */
+    qint64 reapedConnections(ReapReason reason) const;
+
+    /**
+     * @brief Per-upstream load, reply time and health (last start's upstreams)
+     */
+    QList<UpstreamBalancer::Stats> upstreamStats() const;
+
+    /**
+     * @brief Requests the routing rules sent @p action's way so far
+     */
+    qint64 routedConnections(RoutingRules::Action action) const;
+
+    /**
+     * @brief Requests refused because the domain blocklist matched
+     */
+    qint64 blockedRequests() const;
+
+    /**
+     * @brief Connections refused because their client had
+     * Options::clientMaxConnections open already
+     */
+    qint64 refusedClientConnections() const;
+
+    /**
+     * @brief Tunnels through paqet open / requests waiting for a slot under
+     * Options::maxConcurrentConnects
+     */
+    int activeConnects() const;
+    int waitingConnects() const;
+
+    /**
+     * @brief Speculative tunnel hits, misses and waste (all workers, since
+     * the proxy was created)
+     */
+    PreconnectPool::Stats preconnectStats() const;
+
+    /**
+     * @brief Response cache hits, misses and bytes served from disk (since
+     * the last start; zero without Options::cacheMaxBytes)
+     */
+    HttpCache::Stats cacheStats() const;
+
+    /**
+     * @brief Relay I/O slabs of all workers: bytes on loan and cached, the
+     * sum of the workers' high-water marks, and acquisitions that missed
+     * the free lists (since the proxy was created)
+     */
+    BufferPool::Stats bufferPoolStats() const;
+
+    /**
+     * @brief Connections and bytes per client address (last start's clients)
+     */
+    QList<ClientLimiter::Stats> clientStats() const;
+
+    /**
+     * @brief Connections closed at accept because the client was not in
+     * Options::allowedClients
+     */
+    qint64 deniedClients() const;
+
+    /**
+     * @brief Times the listeners paused for Options::acceptRate
+     */
+    qint64 acceptPauses() const;
+
 signals:
     void started();
     void stopped();
     void error(const QString &message);
+    /** From each worker while tracking (queued to this object's thread) */
+    void connectionBatch(const HttpToSocksProxy::ConnectionBatch &batch);
 
 private slots:
     void onLogFromWorker(const QString &message);
@@ -65,13 +354,23 @@ private:
     friend class ProxyServerRunner;  // defined in .cpp; needs ClientConnection access
 
     void log(const QString &message);
+    void shutdownWorkers();
 
     LogBuffer *m_logBuffer = nullptr;
-    QString m_socksHost;
-    quint16 m_socksPort = 0;
+    Options m_options;
+    std::unique_ptr<UpstreamBalancer> m_upstreams;  // shared by all workers
+    std::unique_ptr<ClientLimiter> m_clientLimiter;  // shared by all workers
+    std::unique_ptr<ConnectGate> m_connectGate;      // shared by all workers, null = no cap
+    std::unique_ptr<HttpCache> m_cache;              // shared by all workers, null = off
     quint16 m_httpPort = 0;
     bool m_running = false;
+    bool m_tracking = false;
 
-    QThread *m_thread = nullptr;
-    QObject *m_runner = nullptr;  // ProxyServerRunner, lives in m_thread
+    QList<QThread *> m_threads;
+    QList<ProxyServerRunner *> m_runners;  // m_runners[i] lives in m_threads[i]
+    std::unique_ptr<RelayBudget> m_budget;  // shared by all workers
+    std::unique_ptr<TrafficCounters[]> m_traffic;  // one per worker slot, kept across restarts
+    std::unique_ptr<BufferPool::Counters[]> m_bufferCounters;  // likewise, for the relay I/O slabs
 };
+
+Q_DECLARE_METATYPE(HttpToSocksProxy::ConnectionBatch)
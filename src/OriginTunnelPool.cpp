@@ -0,0 +1,117 @@
+#include "OriginTunnelPool.h"
+#include <QTcpSocket>
+#include <QTimer>
+
+static constexpr int kMaxIdlePerOrigin = 4;
+static constexpr int kMaxIdleTotal = 64;
+static constexpr int kIdleTimeoutMs = 30000;   // below typical origin keep-alive timeouts
+static constexpr int kSweepIntervalMs = 5000;
+
+OriginTunnelPool::OriginTunnelPool(QObject *parent) : QObject(parent) {
+    m_clock.start();
+    m_sweepTimer = new QTimer(this);
+    m_sweepTimer->setInterval(kSweepIntervalMs);
+    connect(m_sweepTimer, &QTimer::timeout, this, &OriginTunnelPool::expire);
+}
+
+OriginTunnelPool::~OriginTunnelPool() {
+    clear();
+}
+
+QString OriginTunnelPool::key(const QString &host, quint16 port) {
+    return host.toLower() + QLatin1Char(':') + QString::number(port);
+}
+
+void OriginTunnelPool::put(const QString &origin, QTcpSocket *socket) {
+    QList<Idle> &list = m_idle[origin];
+    if (socket->state() != QAbstractSocket::ConnectedState || socket->bytesAvailable() > 0
+        || list.size() >= kMaxIdlePerOrigin || m_total >= kMaxIdleTotal) {
+        if (list.isEmpty())
+            m_idle.remove(origin);
+        socket->disconnect();
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+    socket->disconnect();
+    socket->setParent(this);
+    // Anything arriving on an idle tunnel (data or close) makes it unusable
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { remove(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { remove(socket); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket]() { remove(socket); });
+    list.append({socket, m_clock.elapsed()});
+    ++m_total;
+    if (!m_sweepTimer->isActive())
+        m_sweepTimer->start();
+}
+
+QTcpSocket *OriginTunnelPool::take(const QString &origin) {
+    auto it = m_idle.find(origin);
+    if (it == m_idle.end())
+        return nullptr;
+    QTcpSocket *socket = nullptr;
+    while (!it->isEmpty() && !socket) {
+        QTcpSocket *candidate = it->takeLast().socket;
+        --m_total;
+        if (candidate->state() == QAbstractSocket::ConnectedState && candidate->bytesAvailable() == 0) {
+            socket = candidate;
+        } else {
+            candidate->disconnect(this);
+            candidate->abort();
+            candidate->deleteLater();
+        }
+    }
+    if (it->isEmpty())
+        m_idle.erase(it);
+    if (!socket)
+        return nullptr;
+    socket->disconnect(this);
+    socket->setParent(nullptr);
+    ++m_reuses;
+    return socket;
+}
+
+void OriginTunnelPool::clear() {
+    for (const QList<Idle> &list : std::as_const(m_idle)) {
+        for (const Idle &idle : list) {
+            idle.socket->disconnect(this);
+            idle.socket->abort();
+            idle.socket->deleteLater();
+        }
+    }
+    m_idle.clear();
+    m_total = 0;
+    m_sweepTimer->stop();
+}
+
+void OriginTunnelPool::remove(QTcpSocket *socket) {
+    for (auto it = m_idle.begin(); it != m_idle.end(); ++it) {
+        for (int i = 0; i < it->size(); ++i) {
+            if (it->at(i).socket != socket)
+                continue;
+            it->removeAt(i);
+            --m_total;
+            if (it->isEmpty())
+                m_idle.erase(it);
+            socket->disconnect(this);
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+    }
+}
+
+void OriginTunnelPool::expire() {
+    const qint64 now = m_clock.elapsed();
+    QList<QTcpSocket *> stale;
+    for (const QList<Idle> &list : std::as_const(m_idle)) {
+        for (const Idle &idle : list) {
+            if (now - idle.since > kIdleTimeoutMs)
+                stale.append(idle.socket);
+        }
+    }
+    for (QTcpSocket *socket : std::as_const(stale))
+        remove(socket);
+    if (m_total == 0)
+        m_sweepTimer->stop();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QElapsedTimer>
+
+class QTcpSocket;
+class QTimer;
+
+/**
+ * @brief Idle upstream tunnels (SOCKS CONNECT already done) keyed by origin
+ *
+ * Plain-HTTP requests hand their tunnel back here once the response is
+ * complete and the origin agreed to keep the connection, so the next
+ * request to the same host:port skips the SOCKS handshake and TCP setup
+ * through paqet. Entries expire after an idle timeout.
+ *
+ * Lives in (and must be used from) one worker thread.
+ */
+class OriginTunnelPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit OriginTunnelPool(QObject *parent = nullptr);
+    ~OriginTunnelPool() override;
+
+    static QString key(const QString &host, quint16 port);
+
+    /**
+     * @brief Park a tunnel; the pool takes ownership (and may just close it)
+     */
+    void put(const QString &origin, QTcpSocket *socket);
+
+    /**
+     * @brief Most recently parked live tunnel to @p origin, or nullptr.
+     * Ownership passes to the caller; the pool's signal connections are gone.
+     */
+    QTcpSocket *take(const QString &origin);
+
+    void clear();
+
+    int idleCount() const { return m_total; }
+    qint64 reuses() const { return m_reuses; }
+
+private:
+    struct Idle {
+        QTcpSocket *socket;
+        qint64 since;
+    };
+
+    void remove(QTcpSocket *socket);
+    void expire();
+
+    QHash<QString, QList<Idle>> m_idle;
+    QTimer *m_sweepTimer = nullptr;
+    QElapsedTimer m_clock;
+    int m_total = 0;
+    qint64 m_reuses = 0;
+};
@@ -20,6 +20,9 @@
 #include <QDir>
 #include <QSettings>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QNetworkInterface>
+#include <QStandardPaths>
 #include <QPointer>
 
 #ifdef Q_OS_WIN
@@ -43,6 +46,11 @@ PaqetController::PaqetController(QObject *parent) : QObject(parent) {
     m_tunAssetsManager = new TunAssetsManager(m_logBuffer, m_tunManager, this);
     m_httpProxy = new HttpToSocksProxy(this);
     m_httpProxy->setLogBuffer(m_logBuffer);
+    m_speedMonitor = new SpeedMonitorModel(this);
+    m_speedMonitor->setSource([this]() {
+        return qMakePair(m_httpProxy->bytesUp(), m_httpProxy->bytesDown());
+    });
+    m_connectionTable = new ConnectionTableModel(this);
 
     connect(m_repo, &ConfigRepository::configsChanged, this, &PaqetController::reloadConfigList);
     connect(m_tunManager, &TunManager::runningChanged, this, &PaqetController::tunRunningChanged);
@@ -80,6 +88,21 @@ PaqetController::PaqetController(QObject *parent) : QObject(parent) {
     });
 
     connect(m_runner, &PaqetRunner::runningChanged, this, &PaqetController::isRunningChanged);
+    // Warm SOCKS connections of the HTTP proxy die with the paqet process
+    connect(m_runner, &PaqetRunner::stopped, m_httpProxy, &HttpToSocksProxy::flushUpstreamPool);
+    connect(m_runner, &PaqetRunner::started, m_httpProxy, &HttpToSocksProxy::flushUpstreamPool);
+    // Sample throughput only while the bridge is up; each session starts a fresh history
+    connect(m_httpProxy, &HttpToSocksProxy::started, this, [this]() {
+        m_speedMonitor->reset();
+        m_speedMonitor->setActive(true);
+    });
+    connect(m_httpProxy, &HttpToSocksProxy::stopped, m_speedMonitor, [this]() { m_speedMonitor->setActive(false); });
+    // Workers only collect connection batches while a view shows the table
+    connect(m_connectionTable, &ConnectionTableModel::activeChanged, this, [this]() {
+        m_httpProxy->setConnectionTracking(m_connectionTable->isActive());
+    });
+    connect(m_httpProxy, &HttpToSocksProxy::connectionBatch, m_connectionTable, &ConnectionTableModel::applyBatch);
+    connect(m_httpProxy, &HttpToSocksProxy::stopped, m_connectionTable, &ConnectionTableModel::clear);
     connect(m_logBuffer, &LogBuffer::logAppended, this, &PaqetController::logTextChanged);
     connect(m_latencyChecker, &LatencyChecker::result, this, [this](int ms) {
         m_latencyMs = ms;
@@ -481,7 +504,8 @@ void PaqetController::connectToSelected() {
                 quint16 socksPort = c.socksPort();
                 quint16 httpPort = socksPort + 1;
                 
-                if (m_httpProxy && m_httpProxy->start(httpPort, QStringLiteral("127.0.0.1"), socksPort)) {
+                applyHttpProxyOptions();
+                if (startHttpProxy(httpPort, socksPort)) {
                     m_logBuffer->append(tr("[PaqetN] HTTP proxy started on port %1").arg(httpPort));
                     
                     // Now set system proxy to use our HTTP proxy
@@ -859,7 +883,8 @@ void PaqetController::setProxyMode(const QString &mode) {
         quint16 socksPort = c.socksPort();
         quint16 httpPort = socksPort + 1;
         
-        if (m_httpProxy && m_httpProxy->start(httpPort, QStringLiteral("127.0.0.1"), socksPort)) {
+        applyHttpProxyOptions();
+        if (startHttpProxy(httpPort, socksPort)) {
             m_logBuffer->append(tr("[PaqetN] HTTP proxy started on port %1").arg(httpPort));
             
             // Now set system proxy to use our HTTP proxy
@@ -993,6 +1018,441 @@ void PaqetController::setAllowLocalLan(bool enabled) {
     m_settings->setAllowLocalLan(enabled);
 }
 
+int PaqetController::getHttpProxyWorkers() const {
+    return m_settings->httpProxyWorkers();
+}
+
+void PaqetController::setHttpProxyWorkers(int workers) {
+    m_settings->setHttpProxyWorkers(workers);
+}
+
+bool PaqetController::getHttpProxyOptimisticConnect() const {
+    return m_settings->httpProxyOptimisticConnect();
+}
+
+void PaqetController::setHttpProxyOptimisticConnect(bool enabled) {
+    m_settings->setHttpProxyOptimisticConnect(enabled);
+}
+
+int PaqetController::getHttpProxyIdleTimeout() const {
+    return m_settings->httpProxyIdleTimeout();
+}
+
+void PaqetController::setHttpProxyIdleTimeout(int seconds) {
+    m_settings->setHttpProxyIdleTimeout(seconds);
+}
+
+int PaqetController::getHttpProxyHeaderTimeout() const {
+    return m_settings->httpProxyHeaderTimeout();
+}
+
+void PaqetController::setHttpProxyHeaderTimeout(int seconds) {
+    m_settings->setHttpProxyHeaderTimeout(seconds);
+}
+
+int PaqetController::getHttpProxyHandshakeTimeout() const {
+    return m_settings->httpProxyHandshakeTimeout();
+}
+
+void PaqetController::setHttpProxyHandshakeTimeout(int seconds) {
+    m_settings->setHttpProxyHandshakeTimeout(seconds);
+}
+
+int PaqetController::getHttpProxyClientRateLimit() const {
+    return m_settings->httpProxyClientRateLimit();
+}
+
+void PaqetController::setHttpProxyClientRateLimit(int kibPerSec) {
+    m_settings->setHttpProxyClientRateLimit(kibPerSec);
+}
+
+int PaqetController::getHttpProxyClientMaxConnections() const {
+    return m_settings->httpProxyClientMaxConnections();
+}
+
+void PaqetController::setHttpProxyClientMaxConnections(int connections) {
+    m_settings->setHttpProxyClientMaxConnections(connections);
+}
+
+int PaqetController::getHttpProxyMaxConcurrentConnects() const {
+    return m_settings->httpProxyMaxConcurrentConnects();
+}
+
+void PaqetController::setHttpProxyMaxConcurrentConnects(int connects) {
+    m_settings->setHttpProxyMaxConcurrentConnects(connects);
+}
+
+int PaqetController::getHttpProxyConnectQueueTimeout() const {
+    return m_settings->httpProxyConnectQueueTimeout();
+}
+
+void PaqetController::setHttpProxyConnectQueueTimeout(int seconds) {
+    m_settings->setHttpProxyConnectQueueTimeout(seconds);
+}
+
+int PaqetController::getHttpProxyPreconnectBudget() const {
+    return m_settings->httpProxyPreconnectBudget();
+}
+
+void PaqetController::setHttpProxyPreconnectBudget(int tunnels) {
+    m_settings->setHttpProxyPreconnectBudget(tunnels);
+}
+
+int PaqetController::getHttpProxyPreconnectTtl() const {
+    return m_settings->httpProxyPreconnectTtl();
+}
+
+void PaqetController::setHttpProxyPreconnectTtl(int seconds) {
+    m_settings->setHttpProxyPreconnectTtl(seconds);
+}
+
+QVariantMap PaqetController::getHttpProxyPreconnectStats() const {
+    QVariantMap m;
+    const PreconnectPool::Stats s = m_httpProxy ? m_httpProxy->preconnectStats() : PreconnectPool::Stats();
+    m[QStringLiteral("hits")] = s.hits;
+    m[QStringLiteral("misses")] = s.misses;
+    m[QStringLiteral("opened")] = s.opened;
+    m[QStringLiteral("wasted")] = s.wasted;
+    m[QStringLiteral("failed")] = s.failed;
+    m[QStringLiteral("hitRatio")] = s.hits + s.misses > 0 ? double(s.hits) / (s.hits + s.misses) : 0.0;
+    m[QStringLiteral("wasteRatio")] = s.opened > 0 ? double(s.wasted) / s.opened : 0.0;
+    return m;
+}
+
+int PaqetController::getHttpProxyRangeSplitCount() const {
+    return m_settings->httpProxyRangeSplitCount();
+}
+
+void PaqetController::setHttpProxyRangeSplitCount(int ranges) {
+    m_settings->setHttpProxyRangeSplitCount(ranges);
+}
+
+int PaqetController::getHttpProxyRangeSplitThreshold() const {
+    return m_settings->httpProxyRangeSplitThreshold();
+}
+
+void PaqetController::setHttpProxyRangeSplitThreshold(int mib) {
+    m_settings->setHttpProxyRangeSplitThreshold(mib);
+}
+
+QString PaqetController::getHttpProxyRelayEngine() const {
+    return m_settings->httpProxyRelayEngine();
+}
+
+void PaqetController::setHttpProxyRelayEngine(const QString &engine) {
+    m_settings->setHttpProxyRelayEngine(engine);
+}
+
+int PaqetController::getHttpProxyCacheSize() const {
+    return m_settings->httpProxyCacheSize();
+}
+
+void PaqetController::setHttpProxyCacheSize(int mib) {
+    m_settings->setHttpProxyCacheSize(mib);
+}
+
+QVariantMap PaqetController::getHttpProxyCacheStats() const {
+    QVariantMap m;
+    const HttpCache::Stats s = m_httpProxy ? m_httpProxy->cacheStats() : HttpCache::Stats();
+    m[QStringLiteral("hits")] = s.hits;
+    m[QStringLiteral("revalidated")] = s.revalidated;
+    m[QStringLiteral("misses")] = s.misses;
+    m[QStringLiteral("coalesced")] = s.coalesced;
+    m[QStringLiteral("stored")] = s.stored;
+    m[QStringLiteral("bytesSaved")] = s.bytesSaved;
+    m[QStringLiteral("entries")] = s.entries;
+    m[QStringLiteral("size")] = s.size;
+    const qint64 served = s.hits + s.revalidated;
+    m[QStringLiteral("hitRatio")] = served + s.misses > 0 ? double(served) / (served + s.misses) : 0.0;
+    return m;
+}
+
+QVariantMap PaqetController::getHttpProxyBufferPoolStats() const {
+    QVariantMap m;
+    const BufferPool::Stats s = m_httpProxy ? m_httpProxy->bufferPoolStats() : BufferPool::Stats();
+    m[QStringLiteral("acquired")] = s.acquired;
+    m[QStringLiteral("misses")] = s.misses;
+    m[QStringLiteral("inUseBytes")] = s.inUseBytes;
+    m[QStringLiteral("highWaterBytes")] = s.highWaterBytes;
+    m[QStringLiteral("idleBytes")] = s.idleBytes;
+    m[QStringLiteral("missRatio")] = s.acquired > 0 ? double(s.misses) / s.acquired : 0.0;
+    return m;
+}
+
+QStringList PaqetController::getHttpProxyListenInterfaces() const {
+    return m_settings->httpProxyListenInterfaces();
+}
+
+void PaqetController::setHttpProxyListenInterfaces(const QStringList &interfaces) {
+    m_settings->setHttpProxyListenInterfaces(interfaces);
+}
+
+QStringList PaqetController::getHttpProxyAllowedNetworks() const {
+    return m_settings->httpProxyAllowedNetworks();
+}
+
+void PaqetController::setHttpProxyAllowedNetworks(const QStringList &cidrs) {
+    m_settings->setHttpProxyAllowedNetworks(cidrs);
+}
+
+int PaqetController::getHttpProxyAcceptRate() const {
+    return m_settings->httpProxyAcceptRate();
+}
+
+void PaqetController::setHttpProxyAcceptRate(int perSecond) {
+    m_settings->setHttpProxyAcceptRate(perSecond);
+}
+
+int PaqetController::getHttpProxyListenBacklog() const {
+    return m_settings->httpProxyListenBacklog();
+}
+
+void PaqetController::setHttpProxyListenBacklog(int backlog) {
+    m_settings->setHttpProxyListenBacklog(backlog);
+}
+
+QVariantList PaqetController::getHttpProxyClientStats() const {
+    QVariantList list;
+    if (!m_httpProxy) return list;
+    const QList<ClientLimiter::Stats> stats = m_httpProxy->clientStats();
+    for (const ClientLimiter::Stats &s : stats) {
+        QVariantMap m;
+        m[QStringLiteral("address")] = s.address.toString();
+        m[QStringLiteral("connections")] = s.connections;
+        m[QStringLiteral("totalConnections")] = s.totalConnections;
+        m[QStringLiteral("refused")] = s.refused;
+        m[QStringLiteral("bytesUp")] = s.bytesUp;
+        m[QStringLiteral("bytesDown")] = s.bytesDown;
+        list.append(m);
+    }
+    return list;
+}
+
+/**
+ * @brief LAN gateway part of the HTTP proxy options: listen addresses,
+ * client allow-list and accept guard while allowLocalLan is on
+ */
+static void applyHttpProxyGateway(const SettingsRepository *settings, LogBuffer *logBuffer,
+                                  HttpToSocksProxy::Options &options) {
+    options.listenAddresses.clear();
+    options.allowedClients.reset();
+    options.listenBacklog = settings->httpProxyListenBacklog();
+    options.acceptRate = 0;
+    if (!settings->allowLocalLan())
+        return;  // loopback only, nothing to screen
+
+    options.acceptRate = settings->httpProxyAcceptRate();
+    const QStringList interfaces = settings->httpProxyListenInterfaces();
+    if (interfaces.isEmpty()) {
+        // Same as paqet's SOCKS listener in this mode
+        options.listenAddresses.append(QHostAddress(QHostAddress::AnyIPv4));
+    } else {
+        options.listenAddresses.append(QHostAddress(QHostAddress::LocalHost));
+        for (const QString &entry : interfaces) {
+            const QHostAddress address(entry.trimmed());
+            if (!address.isNull()) {
+                if (!options.listenAddresses.contains(address))
+                    options.listenAddresses.append(address);
+                continue;
+            }
+            const QNetworkInterface iface = QNetworkInterface::interfaceFromName(entry.trimmed());
+            if (!iface.isValid()) {
+                logBuffer->append(PaqetController::tr("[PaqetN] LAN gateway: no interface or address \"%1\"").arg(entry));
+                continue;
+            }
+            for (const QNetworkAddressEntry &e : iface.addressEntries()) {
+                // Link-local IPv6 needs a scope per listener; clients use IPv4 or a global address
+                const QHostAddress ip = e.ip();
+                if (ip.isLinkLocal() || ip.isLoopback() || options.listenAddresses.contains(ip))
+                    continue;
+                options.listenAddresses.append(ip);
+            }
+        }
+    }
+
+    QStringList networks = settings->httpProxyAllowedNetworks();
+    if (networks.isEmpty())
+        networks = CidrAllowList::privateNetworks();
+    // The machine itself is always let in
+    networks << QStringLiteral("127.0.0.0/8") << QStringLiteral("::1/128");
+    QStringList errors;
+    options.allowedClients = CidrAllowList::compile(networks, &errors);
+    for (const QString &e : std::as_const(errors))
+        logBuffer->append(PaqetController::tr("[PaqetN] LAN gateway allow-list, %1").arg(e));
+}
+
+void PaqetController::applyHttpProxyOptions() {
+    if (!m_httpProxy) return;
+    HttpToSocksProxy::Options options = m_httpProxy->options();
+    options.workerCount = m_settings->httpProxyWorkers();
+    options.optimisticConnect = m_settings->httpProxyOptimisticConnect();
+    options.idleTimeoutSec = m_settings->httpProxyIdleTimeout();
+    options.headerTimeoutSec = m_settings->httpProxyHeaderTimeout();
+    options.handshakeTimeoutSec = m_settings->httpProxyHandshakeTimeout();
+    options.clientRateLimit = qint64(m_settings->httpProxyClientRateLimit()) * 1024;
+    options.clientMaxConnections = m_settings->httpProxyClientMaxConnections();
+    options.maxConcurrentConnects = m_settings->httpProxyMaxConcurrentConnects();
+    options.connectQueueTimeoutSec = m_settings->httpProxyConnectQueueTimeout();
+    options.preconnectBudget = m_settings->httpProxyPreconnectBudget();
+    options.preconnectTtlSec = m_settings->httpProxyPreconnectTtl();
+    options.rangeSplitCount = m_settings->httpProxyRangeSplitCount();
+    options.rangeSplitThreshold = qint64(m_settings->httpProxyRangeSplitThreshold()) * 1024 * 1024;
+    options.relayEngine = m_settings->httpProxyRelayEngine() == QLatin1String("native")
+        ? HttpToSocksProxy::RelayEngine::Native
+        : HttpToSocksProxy::RelayEngine::Qt;
+    options.cacheMaxBytes = qint64(m_settings->httpProxyCacheSize()) * 1024 * 1024;
+    options.cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + QLatin1String("/http");
+    options.upstreamPolicy = m_settings->httpProxyUpstreamPolicy() == QLatin1String("fastestReply")
+        ? UpstreamBalancer::Policy::FastestReply
+        : UpstreamBalancer::Policy::LeastConnections;
+
+    const QString rules = m_settings->httpProxyRoutingRules();
+    options.routing.reset();
+    if (!rules.trimmed().isEmpty()) {
+        QStringList errors;
+        options.routing = RoutingRules::compile(rules, &errors);
+        for (const QString &e : std::as_const(errors))
+            m_logBuffer->append(tr("[PaqetN] Routing rules, %1").arg(e));
+        m_logBuffer->append(tr("[PaqetN] Routing rules: %1 rule(s), default %2")
+                                .arg(options.routing->ruleCount())
+                                .arg(RoutingRules::actionName(options.routing->defaultAction())));
+    }
+    applyHttpProxyGateway(m_settings, m_logBuffer, options);
+    m_httpProxy->setOptions(options);
+    loadHttpProxyBlocklist();
+}
+
+namespace {
+struct BlocklistBuild {
+    std::shared_ptr<const DomainBlocklist> list;
+    QString error;
+    int entries = 0;
+    qint64 elapsedMs = 0;
+};
+}
+
+void PaqetController::loadHttpProxyBlocklist() {
+    const int generation = ++m_blocklistGeneration;
+    const QStringList files = m_settings->httpProxyBlocklistFiles();
+    if (files.isEmpty()) {
+        m_httpProxy->setBlocklist(nullptr);
+        return;
+    }
+
+    // The compiled file is reused until a list file changes
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    const QString path = dir + QLatin1String("/blocklist.bin");
+    const quint64 stamp = DomainBlocklist::sourceStamp(files);
+    if (auto list = DomainBlocklist::open(path, stamp)) {
+        m_httpProxy->setBlocklist(list);
+        return;
+    }
+
+    // Compiling large lists takes seconds: do it off the UI thread, the proxy
+    // keeps the previous list (if any) until the new one is ready
+    QFutureWatcher<BlocklistBuild> *watcher = new QFutureWatcher<BlocklistBuild>(this);
+    connect(watcher, &QFutureWatcher<BlocklistBuild>::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation != m_blocklistGeneration || !m_httpProxy)
+            return;  // settings changed meanwhile, a newer load is under way
+        const BlocklistBuild result = watcher->result();
+        if (!result.list) {
+            m_logBuffer->append(tr("[PaqetN] Blocklist not built: %1").arg(result.error));
+            return;
+        }
+        m_logBuffer->append(tr("[PaqetN] Blocklist compiled: %1 domain(s) in %2 ms")
+                                .arg(result.entries).arg(result.elapsedMs));
+        m_httpProxy->setBlocklist(result.list);
+    });
+    watcher->setFuture(QtConcurrent::run([files, path, stamp]() {
+        BlocklistBuild result;
+        QElapsedTimer timer;
+        timer.start();
+        if (DomainBlocklist::build(files, path, stamp, &result.error, &result.entries))
+            result.list = DomainBlocklist::open(path, stamp, &result.error);
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }));
+}
+
+QStringList PaqetController::getHttpProxyBlocklistFiles() const {
+    return m_settings->httpProxyBlocklistFiles();
+}
+
+void PaqetController::setHttpProxyBlocklistFiles(const QStringList &files) {
+    m_settings->setHttpProxyBlocklistFiles(files);
+}
+
+bool PaqetController::startHttpProxy(quint16 httpPort, quint16 socksPort) {
+    if (!m_httpProxy) return false;
+    QList<UpstreamBalancer::Endpoint> upstreams{{QStringLiteral("127.0.0.1"), socksPort}};
+    const QStringList extra = m_settings->httpProxyExtraUpstreams();
+    for (const QString &entry : extra) {
+        const int colon = entry.lastIndexOf(QLatin1Char(':'));
+        bool ok = false;
+        const int port = colon > 0 ? entry.mid(colon + 1).toInt(&ok) : 0;
+        if (!ok || port <= 0 || port > 65535) {
+            m_logBuffer->append(tr("[PaqetN] Ignoring invalid SOCKS upstream \"%1\"").arg(entry));
+            continue;
+        }
+        QString host = entry.left(colon).trimmed();
+        if (host.startsWith(QLatin1Char('[')) && host.endsWith(QLatin1Char(']')))
+            host = host.mid(1, host.size() - 2);
+        upstreams.append({host, static_cast<quint16>(port)});
+    }
+    return m_httpProxy->start(httpPort, upstreams);
+}
+
+QString PaqetController::getHttpProxyRoutingRules() const {
+    return m_settings->httpProxyRoutingRules();
+}
+
+void PaqetController::setHttpProxyRoutingRules(const QString &rules) {
+    m_settings->setHttpProxyRoutingRules(rules);
+}
+
+QStringList PaqetController::getHttpProxyExtraUpstreams() const {
+    return m_settings->httpProxyExtraUpstreams();
+}
+
+void PaqetController::setHttpProxyExtraUpstreams(const QStringList &endpoints) {
+    m_settings->setHttpProxyExtraUpstreams(endpoints);
+}
+
+QString PaqetController::getHttpProxyUpstreamPolicy() const {
+    return m_settings->httpProxyUpstreamPolicy();
+}
+
+void PaqetController::setHttpProxyUpstreamPolicy(const QString &policy) {
+    m_settings->setHttpProxyUpstreamPolicy(policy);
+}
+
+QVariantList PaqetController::getHttpProxyUpstreamStats() const {
+    QVariantList list;
+    if (!m_httpProxy) return list;
+    const QList<UpstreamBalancer::Stats> stats = m_httpProxy->upstreamStats();
+    for (const UpstreamBalancer::Stats &s : stats) {
+        QVariantMap m;
+        m[QStringLiteral("endpoint")] = QStringLiteral("%1:%2").arg(s.endpoint.host).arg(s.endpoint.port);
+        m[QStringLiteral("active")] = s.active;
+        m[QStringLiteral("replyMs")] = s.replyMs;
+        m[QStringLiteral("ejected")] = s.ejected;
+        m[QStringLiteral("successes")] = s.successes;
+        m[QStringLiteral("failures")] = s.failures;
+        list.append(m);
+    }
+    return list;
+}
+
+QVariantMap PaqetController::getHttpProxyTrafficClasses() const {
+    QVariantMap m;
+    m[QStringLiteral("interactiveBytes")] = m_httpProxy ? m_httpProxy->interactiveBytes() : 0;
+    m[QStringLiteral("bulkBytes")] = m_httpProxy ? m_httpProxy->bulkBytes() : 0;
+    return m;
+}
+
 void PaqetController::startNetworkMonitoring() {
     if (!m_networkMonitorTimer) {
         m_networkMonitorTimer = new QTimer(this);
@@ -2,14 +2,17 @@
 
 #include "ConfigListModel.h"
 #include "ConfigRepository.h"
+#include "ConnectionTableModel.h"
 #include "NetworkInfoDetector.h"
 #include "SettingsRepository.h"
+#include "SpeedMonitorModel.h"
 #include <QObject>
 #include <QVariantList>
 #include <QVariantMap>
 #include <QStringList>
 #include <QFutureWatcher>
 #include <functional>
+#include <memory>
 
 class LogBuffer;
 class QTimer;
@@ -20,11 +23,14 @@ class TunManager;
 class SystemProxyManager;
 class TunAssetsManager;
 class HttpToSocksProxy;
+class DomainBlocklist;
 
 class PaqetController : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(ConfigListModel* configs READ configs CONSTANT)
+    Q_PROPERTY(SpeedMonitorModel* speedMonitor READ speedMonitor CONSTANT)
+    Q_PROPERTY(ConnectionTableModel* connectionTable READ connectionTable CONSTANT)
     Q_PROPERTY(QString selectedConfigId READ selectedConfigId WRITE setSelectedConfigId NOTIFY selectedConfigIdChanged)
     Q_PROPERTY(QString selectedConfigName READ selectedConfigName NOTIFY selectedConfigIdChanged)
     Q_PROPERTY(bool isRunning READ isRunning NOTIFY isRunningChanged)
@@ -52,6 +58,8 @@ public:
     ~PaqetController() override;
 
     ConfigListModel *configs() const { return m_configList; }
+    SpeedMonitorModel *speedMonitor() const { return m_speedMonitor; }
+    ConnectionTableModel *connectionTable() const { return m_connectionTable; }
     QString selectedConfigId() const { return m_selectedConfigId; }
     void setSelectedConfigId(const QString &id);
     QString selectedConfigName() const;
@@ -165,6 +173,77 @@ public:
     Q_INVOKABLE bool getAllowLocalLan() const;
     Q_INVOKABLE void setAllowLocalLan(bool enabled);
 
+    // HTTP proxy worker threads (0 = one per CPU core)
+    Q_INVOKABLE int getHttpProxyWorkers() const;
+    Q_INVOKABLE void setHttpProxyWorkers(int workers);
+    // Answer CONNECT before the SOCKS handshake finishes (saves one tunnel RTT)
+    Q_INVOKABLE bool getHttpProxyOptimisticConnect() const;
+    Q_INVOKABLE void setHttpProxyOptimisticConnect(bool enabled);
+    // HTTP proxy timeouts in seconds (0 = none), applied on the next start
+    Q_INVOKABLE int getHttpProxyIdleTimeout() const;
+    Q_INVOKABLE void setHttpProxyIdleTimeout(int seconds);
+    Q_INVOKABLE int getHttpProxyHeaderTimeout() const;
+    Q_INVOKABLE void setHttpProxyHeaderTimeout(int seconds);
+    Q_INVOKABLE int getHttpProxyHandshakeTimeout() const;
+    Q_INVOKABLE void setHttpProxyHandshakeTimeout(int seconds);
+    // Extra SOCKS5 upstreams ("host:port") balanced with paqet's own port
+    Q_INVOKABLE QStringList getHttpProxyExtraUpstreams() const;
+    Q_INVOKABLE void setHttpProxyExtraUpstreams(const QStringList &endpoints);
+    Q_INVOKABLE QString getHttpProxyUpstreamPolicy() const;
+    Q_INVOKABLE void setHttpProxyUpstreamPolicy(const QString &policy);
+    // One map per upstream: endpoint, active, replyMs, ejected, successes, failures
+    Q_INVOKABLE QVariantList getHttpProxyUpstreamStats() const;
+    // Bytes relayed as interactive / bulk flows: interactiveBytes, bulkBytes
+    Q_INVOKABLE QVariantMap getHttpProxyTrafficClasses() const;
+    // Direct / tunnel / reject rules for the HTTP proxy, applied on the next start
+    Q_INVOKABLE QString getHttpProxyRoutingRules() const;
+    Q_INVOKABLE void setHttpProxyRoutingRules(const QString &rules);
+    // Blocklist files, compiled into a mapped cache file on the next start
+    Q_INVOKABLE QStringList getHttpProxyBlocklistFiles() const;
+    Q_INVOKABLE void setHttpProxyBlocklistFiles(const QStringList &files);
+    // Per-client limits (KiB/s each way, connections) and the tunnel cap; 0 = unlimited
+    Q_INVOKABLE int getHttpProxyClientRateLimit() const;
+    Q_INVOKABLE void setHttpProxyClientRateLimit(int kibPerSec);
+    Q_INVOKABLE int getHttpProxyClientMaxConnections() const;
+    Q_INVOKABLE void setHttpProxyClientMaxConnections(int connections);
+    Q_INVOKABLE int getHttpProxyMaxConcurrentConnects() const;
+    Q_INVOKABLE void setHttpProxyMaxConcurrentConnects(int connects);
+    Q_INVOKABLE int getHttpProxyConnectQueueTimeout() const;
+    Q_INVOKABLE void setHttpProxyConnectQueueTimeout(int seconds);
+    // Speculative tunnels: per-worker budget (0 = off) and TTL in seconds
+    Q_INVOKABLE int getHttpProxyPreconnectBudget() const;
+    Q_INVOKABLE void setHttpProxyPreconnectBudget(int tunnels);
+    Q_INVOKABLE int getHttpProxyPreconnectTtl() const;
+    Q_INVOKABLE void setHttpProxyPreconnectTtl(int seconds);
+    // hits, misses, opened, wasted, failed, hitRatio (of CONNECTs), wasteRatio (of opened)
+    Q_INVOKABLE QVariantMap getHttpProxyPreconnectStats() const;
+    // Parallel range downloads: ranges per download (below 2 = off), threshold in MiB
+    Q_INVOKABLE int getHttpProxyRangeSplitCount() const;
+    Q_INVOKABLE void setHttpProxyRangeSplitCount(int ranges);
+    Q_INVOKABLE int getHttpProxyRangeSplitThreshold() const;
+    Q_INVOKABLE void setHttpProxyRangeSplitThreshold(int mib);
+    // Tunnel relay engine: "qt" or "native" (epoll, Linux); applies on the next start
+    Q_INVOKABLE QString getHttpProxyRelayEngine() const;
+    Q_INVOKABLE void setHttpProxyRelayEngine(const QString &engine);
+    // Plain-HTTP response cache size in MiB (0 = off)
+    Q_INVOKABLE int getHttpProxyCacheSize() const;
+    Q_INVOKABLE void setHttpProxyCacheSize(int mib);
+    // hits, revalidated, misses, coalesced, stored, bytesSaved, entries, size, hitRatio
+    Q_INVOKABLE QVariantMap getHttpProxyCacheStats() const;
+    // Relay I/O slabs: acquired, misses, inUseBytes, highWaterBytes, idleBytes, missRatio
+    Q_INVOKABLE QVariantMap getHttpProxyBufferPoolStats() const;
+    // LAN gateway: the HTTP proxy serves the LAN while allowLocalLan is on
+    Q_INVOKABLE QStringList getHttpProxyListenInterfaces() const;
+    Q_INVOKABLE void setHttpProxyListenInterfaces(const QStringList &interfaces);
+    Q_INVOKABLE QStringList getHttpProxyAllowedNetworks() const;
+    Q_INVOKABLE void setHttpProxyAllowedNetworks(const QStringList &cidrs);
+    Q_INVOKABLE int getHttpProxyAcceptRate() const;
+    Q_INVOKABLE void setHttpProxyAcceptRate(int perSecond);
+    Q_INVOKABLE int getHttpProxyListenBacklog() const;
+    Q_INVOKABLE void setHttpProxyListenBacklog(int backlog);
+    // One map per client address: address, connections, totalConnections, refused, bytesUp, bytesDown
+    Q_INVOKABLE QVariantList getHttpProxyClientStats() const;
+
 signals:
     void selectedConfigIdChanged();
     void isRunningChanged();
@@ -210,6 +289,9 @@ private:
     void reloadConfigList();
     PaqetConfig selectedConfig() const;
     void disconnectAsync(const std::function<void()> &callback);
+    void applyHttpProxyOptions();
+    bool startHttpProxy(quint16 httpPort, quint16 socksPort);
+    void loadHttpProxyBlocklist();
 
     ConfigRepository *m_repo = nullptr;
     SettingsRepository *m_settings = nullptr;
@@ -222,6 +304,8 @@ private:
     SystemProxyManager *m_systemProxyManager = nullptr;
     TunAssetsManager *m_tunAssetsManager = nullptr;
     HttpToSocksProxy *m_httpProxy = nullptr;
+    SpeedMonitorModel *m_speedMonitor = nullptr;
+    ConnectionTableModel *m_connectionTable = nullptr;
     QString m_selectedConfigId;
     QString m_connectedConfigId;
     qint64 m_connectionEstablishedAt = 0;  // When runner last started (for latency-test grace period)
@@ -242,6 +326,7 @@ private:
 
     // Single in-flight connect (network detection); replaced/cancelled when connectToSelected() is called again
     QFutureWatcher<NetworkAdapterInfo> *m_connectWatcher = nullptr;
+    int m_blocklistGeneration = 0;   // bumped per load, stale builds are dropped
 
     // Network monitoring (detection runs in background to avoid UI lag)
     QTimer *m_networkMonitorTimer = nullptr;
@@ -0,0 +1,257 @@
+#include "PreconnectPool.h"
+#include "ConnectGate.h"
+#include "Socks5.h"
+#include "UpstreamBalancer.h"
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static constexpr int kMaintainIntervalMs = 1000;
+static constexpr int kConnectTimeoutMs = 15000;     // a speculative CONNECT still unanswered
+static constexpr double kMinScore = 2.0;            // visited at least twice, recently
+static constexpr double kForgetScore = 0.05;
+static constexpr int kMaxTargets = 4096;             // popularity entries per worker
+static constexpr qint64 kReadBuffer = 64 * 1024;     // server-first protocols greet early
+
+PreconnectPool::PreconnectPool(UpstreamBalancer *upstreams, ConnectGate *gate, Counters *counters,
+                               QObject *parent)
+    : QObject(parent)
+    , m_upstreams(upstreams)
+    , m_gate(gate)
+    , m_counters(counters)
+{
+    m_clock.start();
+    m_maintainTimer = new QTimer(this);
+    m_maintainTimer->setInterval(kMaintainIntervalMs);
+    connect(m_maintainTimer, &QTimer::timeout, this, &PreconnectPool::maintain);
+}
+
+PreconnectPool::~PreconnectPool() {
+    flush();
+}
+
+void PreconnectPool::setLimits(int budget, int topK, int ttlMs) {
+    m_budget = qMax(0, budget);
+    m_topK = qMax(0, topK);
+    m_ttlMs = qMax(0, ttlMs);
+    if (m_budget > 0 && m_topK > 0 && m_ttlMs > 0) {
+        m_maintainTimer->start();
+    } else {
+        m_maintainTimer->stop();
+        flush();
+    }
+}
+
+QString PreconnectPool::key(const QString &host, quint16 port) {
+    return host.toLower() + QLatin1Char(':') + QString::number(port);
+}
+
+double PreconnectPool::scoreAt(const Target &target, qint64 now) const {
+    return target.score * std::exp2(-double(now - target.touchedAt) / kHalfLifeMs);
+}
+
+QTcpSocket *PreconnectPool::take(const QString &host, quint16 port, int *upstream) {
+    if (!m_maintainTimer->isActive())
+        return nullptr;
+    const qint64 now = m_clock.elapsed();
+    const QString k = key(host, port);
+    auto it = m_targets.find(k);
+    if (it != m_targets.end()) {
+        it->score = scoreAt(*it, now) + 1.0;
+        it->touchedAt = now;
+    } else if (m_targets.size() < kMaxTargets) {
+        // Full: newcomers wait until maintain() forgets the faded ones
+        m_targets.insert(k, {host, port, 1.0, now});
+    }
+
+    // Newest first: the oldest are the ones closest to their TTL
+    for (int i = m_tunnels.size() - 1; i >= 0; --i) {
+        const Tunnel &t = m_tunnels.at(i);
+        if (t.readyAt == 0 || t.key != k)
+            continue;
+        if (t.socket->state() != QAbstractSocket::ConnectedState) {
+            m_counters->wasted.fetch_add(1, std::memory_order_relaxed);
+            drop(i);
+            continue;
+        }
+        QTcpSocket *socket = t.socket;
+        *upstream = t.upstream;
+        m_tunnels.removeAt(i);
+        socket->disconnect(this);
+        socket->setParent(nullptr);
+        m_counters->hits.fetch_add(1, std::memory_order_relaxed);
+        return socket;
+    }
+    m_counters->misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void PreconnectPool::flush() {
+    while (!m_tunnels.isEmpty())
+        drop(m_tunnels.size() - 1);
+}
+
+void PreconnectPool::stop() {
+    m_maintainTimer->stop();
+    flush();
+}
+
+bool PreconnectPool::gateHasRoom() const {
+    // Real requests come first: leave the last quarter of the cap to them
+    return !m_gate || (m_gate->waiting() == 0 && m_gate->active() < m_gate->limit() - m_gate->limit() / 4);
+}
+
+void PreconnectPool::maintain() {
+    const qint64 now = m_clock.elapsed();
+    for (int i = m_tunnels.size() - 1; i >= 0; --i) {
+        const Tunnel &t = m_tunnels.at(i);
+        if (t.readyAt != 0 && now - t.readyAt > m_ttlMs) {
+            m_counters->wasted.fetch_add(1, std::memory_order_relaxed);
+            drop(i);
+        } else if (t.readyAt == 0 && now - t.startedAt > kConnectTimeoutMs) {
+            m_counters->failed.fetch_add(1, std::memory_order_relaxed);
+            m_upstreams->reportFailure(t.upstream);
+            drop(i);
+        }
+    }
+
+    // Rank, forgetting destinations that faded out
+    std::vector<std::pair<double, QString>> ranked;
+    for (auto it = m_targets.begin(); it != m_targets.end();) {
+        const double score = scoreAt(*it, now);
+        if (score < kForgetScore) {
+            it = m_targets.erase(it);
+            continue;
+        }
+        if (score >= kMinScore)
+            ranked.emplace_back(score, it.key());
+        ++it;
+    }
+    const size_t top = qMin(ranked.size(), size_t(m_topK));
+    std::partial_sort(ranked.begin(), ranked.begin() + top, ranked.end(),
+                      [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    for (size_t r = 0; r < top && m_tunnels.size() < m_budget; ++r) {
+        const double score = ranked[r].first;
+        const QString &k = ranked[r].second;
+        // At steady state score ~ rate * halfLife / ln 2, so this is the
+        // number of CONNECTs expected within one TTL
+        const int wanted = qBound(1, qCeil(score * M_LN2 * m_ttlMs / kHalfLifeMs), kMaxPerTarget);
+        int have = 0;
+        for (const Tunnel &t : std::as_const(m_tunnels))
+            have += t.key == k ? 1 : 0;
+        while (have < wanted && m_tunnels.size() < m_budget) {
+            if (!open(k, m_targets.value(k)))
+                return;
+            ++have;
+        }
+    }
+}
+
+bool PreconnectPool::open(const QString &key, const Target &target) {
+    if (!gateHasRoom())
+        return false;
+    if (m_gate && !m_gate->tryEnter())
+        return false;
+    const int upstream = m_upstreams->pick();
+    if (upstream < 0) {
+        if (m_gate)
+            m_gate->leave();
+        return false;
+    }
+    m_upstreams->acquire(upstream);
+
+    auto *socket = new QTcpSocket(this);
+    socket->setReadBufferSize(kReadBuffer);
+    m_tunnels.append({socket, key, upstream, m_clock.elapsed(), 0});
+    const QString host = target.host;
+    const quint16 port = target.port;
+    connect(socket, &QTcpSocket::connected, this, [socket, host, port]() {
+        // Greeting and CONNECT pipelined: the upstream only offers no-auth
+        socket->write(socks5Greeting() + socks5ConnectRequest(host, port));
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { onClosed(socket); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket]() { onClosed(socket); });
+    const UpstreamBalancer::Endpoint &endpoint = m_upstreams->endpoint(upstream);
+    socket->connectToHost(endpoint.host, endpoint.port);
+    return true;
+}
+
+void PreconnectPool::onReadyRead(QTcpSocket *socket) {
+    const int index = indexOf(socket);
+    if (index < 0 || m_tunnels.at(index).readyAt != 0)
+        return;  // established: whatever the target sends is the client's
+    Tunnel &t = m_tunnels[index];
+
+    // Method reply (2 bytes), then VER REP RSV ATYP ADDR PORT
+    const QByteArray head = socket->peek(2 + 4 + 256 + 2);
+    if (head.size() < 2)
+        return;
+    const int replyLength = socks5ReplyLength(head.constData() + 2, head.size() - 2);
+    const bool greeted = static_cast<quint8>(head[0]) == SOCKS5_VERSION
+        && static_cast<quint8>(head[1]) == SOCKS5_AUTH_NONE;
+    const bool wellFormed = greeted && replyLength >= 0
+        && (head.size() < 3 || static_cast<quint8>(head[2]) == SOCKS5_VERSION);
+    if (wellFormed && replyLength == 0)
+        return;
+    const quint8 reply = wellFormed ? static_cast<quint8>(head[3]) : SOCKS5_REPLY_GENERAL_FAILURE;
+    if (!wellFormed || reply != SOCKS5_REPLY_SUCCEEDED) {
+        // As for real connections, only garbage or a general failure is the upstream's fault
+        if (!wellFormed || reply == SOCKS5_REPLY_GENERAL_FAILURE)
+            m_upstreams->reportFailure(t.upstream);
+        else
+            m_upstreams->reportSuccess(t.upstream, m_clock.elapsed() - t.startedAt);
+        m_counters->failed.fetch_add(1, std::memory_order_relaxed);
+        drop(index);
+        return;
+    }
+    socket->skip(2 + replyLength);
+    t.readyAt = qMax<qint64>(m_clock.elapsed(), 1);
+    m_upstreams->reportSuccess(t.upstream, t.readyAt - t.startedAt);
+    m_counters->opened.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PreconnectPool::onClosed(QTcpSocket *socket) {
+    const int index = indexOf(socket);
+    if (index < 0)
+        return;
+    if (m_tunnels.at(index).readyAt != 0) {
+        m_counters->wasted.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        m_counters->failed.fetch_add(1, std::memory_order_relaxed);
+        m_upstreams->reportFailure(m_tunnels.at(index).upstream);
+    }
+    drop(index);
+}
+
+void PreconnectPool::drop(int index) {
+    const Tunnel t = m_tunnels.takeAt(index);
+    m_upstreams->release(t.upstream);
+    if (m_gate)
+        m_gate->leave();
+    t.socket->disconnect(this);
+    t.socket->abort();
+    t.socket->deleteLater();
+}
+
+int PreconnectPool::indexOf(QTcpSocket *socket) const {
+    for (int i = 0; i < m_tunnels.size(); ++i) {
+        if (m_tunnels.at(i).socket == socket)
+            return i;
+    }
+    return -1;
+}
+
+PreconnectPool::Stats PreconnectPool::stats(const Counters &counters) {
+    Stats s;
+    s.hits = counters.hits.load(std::memory_order_relaxed);
+    s.misses = counters.misses.load(std::memory_order_relaxed);
+    s.opened = counters.opened.load(std::memory_order_relaxed);
+    s.wasted = counters.wasted.load(std::memory_order_relaxed);
+    s.failed = counters.failed.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <atomic>
+
+class ConnectGate;
+class QTcpSocket;
+class QTimer;
+class UpstreamBalancer;
+
+/**
+ * @brief Speculative SOCKS tunnels (CONNECT already answered) to the
+ * destinations clients open most often
+ *
+ * Every CONNECT through paqet counts towards its host:port in a decayed
+ * frequency table (half-life kHalfLifeMs). Once a second the pool ranks
+ * the table, and for the top-K destinations seen at least twice recently
+ * keeps about as many tunnels as it expects to hand out within the TTL,
+ * capped per destination and by the budget. A CONNECT that finds a ready
+ * tunnel skips the whole SOCKS round trip; a tunnel unused for the TTL, or
+ * closed by the far end, is wasted.
+ *
+ * A speculative tunnel holds an upstream (UpstreamBalancer::acquire())
+ * and, when there is a cap, a ConnectGate slot, so it counts like a real
+ * one; both pass to the connection that takes it. The pool does not
+ * speculate while the gate is close to full.
+ *
+ * Lives in (and must be used from) one worker thread; the counters may be
+ * shared by the pools of all workers.
+ */
+class PreconnectPool : public QObject
+{
+    Q_OBJECT
+public:
+    struct Counters {
+        std::atomic<qint64> hits{0};      // CONNECTs handed a ready tunnel
+        std::atomic<qint64> misses{0};    // CONNECTs that had to set one up
+        std::atomic<qint64> opened{0};    // speculative tunnels established
+        std::atomic<qint64> wasted{0};    // established ones closed unused
+        std::atomic<qint64> failed{0};    // speculative CONNECTs that failed
+    };
+
+    struct Stats {
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 opened = 0;
+        qint64 wasted = 0;
+        qint64 failed = 0;
+    };
+
+    static constexpr qint64 kHalfLifeMs = 120000;
+    static constexpr int kMaxPerTarget = 4;
+
+    PreconnectPool(UpstreamBalancer *upstreams, ConnectGate *gate, Counters *counters,
+                   QObject *parent = nullptr);
+    ~PreconnectPool() override;
+
+    /**
+     * @param budget Tunnels held at most, ready or being set up (0 = off)
+     * @param topK Destinations considered
+     * @param ttlMs How long a ready tunnel waits for a CONNECT
+     */
+    void setLimits(int budget, int topK, int ttlMs);
+
+    /**
+     * @brief Count a CONNECT to @p host:@p port and hand it a ready tunnel
+     * if there is one. Ownership of the socket, its upstream acquisition
+     * (index in @p upstream) and its ConnectGate slot pass to the caller;
+     * the pool's signal connections are gone. Bytes the target already
+     * sent stay in the socket.
+     * @return nullptr on a miss
+     */
+    QTcpSocket *take(const QString &host, quint16 port, int *upstream);
+
+    /**
+     * @brief Close every tunnel (e.g. paqet restarted); popularity is kept
+     */
+    void flush();
+
+    /**
+     * @brief Close every tunnel and stop preconnecting until setLimits()
+     * turns the pool on again (e.g. the proxy stopped)
+     */
+    void stop();
+
+    int tunnelCount() const { return m_tunnels.size(); }
+
+    static Stats stats(const Counters &counters);
+
+private:
+    struct Target {
+        QString host;
+        quint16 port = 0;
+        double score = 0.0;       // decayed visit count as of touchedAt
+        qint64 touchedAt = 0;
+    };
+
+    struct Tunnel {
+        QTcpSocket *socket;
+        QString key;
+        int upstream;
+        qint64 startedAt;
+        qint64 readyAt;           // 0 while the CONNECT is pending
+    };
+
+    static QString key(const QString &host, quint16 port);
+    double scoreAt(const Target &target, qint64 now) const;
+    void maintain();
+    bool open(const QString &key, const Target &target);
+    void onReadyRead(QTcpSocket *socket);
+    void onClosed(QTcpSocket *socket);
+    void drop(int index);
+    int indexOf(QTcpSocket *socket) const;
+    bool gateHasRoom() const;
+
+    UpstreamBalancer *m_upstreams;
+    ConnectGate *m_gate;
+    Counters *m_counters;
+    int m_budget = 0;
+    int m_topK = 0;
+    int m_ttlMs = 0;
+
+    QHash<QString, Target> m_targets;
+    QList<Tunnel> m_tunnels;
+    QTimer *m_maintainTimer = nullptr;
+    QElapsedTimer m_clock;
+};
@@ -0,0 +1,316 @@
+#include "RangeDownload.h"
+#include "ConnectGate.h"
+#include "HttpMessageFramer.h"
+#include "Socks5.h"
+#include "UpstreamBalancer.h"
+#include <QTcpSocket>
+#include <QTimer>
+#include <cstring>
+
+static constexpr qint64 kReadBuffer = 256 * 1024;     // per helper socket, like relay sockets
+static constexpr int kMaxResponseHead = 64 * 1024;
+static constexpr int kConfirmTimeoutMs = 15000;       // every helper answered 206
+static constexpr int kMaxAttempts = 3;                // per segment
+static constexpr qsizetype kCompactOffset = 1024 * 1024;
+
+/**
+ * @brief Parse "bytes first-last/total" (RFC 9110 section 14.4)
+ */
+static bool parseContentRange(QByteArray value, qint64 *first, qint64 *last, qint64 *total) {
+    value = value.trimmed();
+    if (!value.toLower().startsWith("bytes "))
+        return false;
+    value = value.mid(6).trimmed();
+    const qsizetype dash = value.indexOf('-');
+    const qsizetype slash = value.indexOf('/');
+    if (dash <= 0 || slash <= dash)
+        return false;
+    bool ok1 = false, ok2 = false, ok3 = false;
+    *first = value.left(dash).trimmed().toLongLong(&ok1);
+    *last = value.mid(dash + 1, slash - dash - 1).trimmed().toLongLong(&ok2);
+    *total = value.mid(slash + 1).trimmed().toLongLong(&ok3);
+    return ok1 && ok2 && ok3;
+}
+
+RangeDownload::RangeDownload(UpstreamBalancer *upstreams, ConnectGate *gate, QObject *parent)
+    : QObject(parent)
+    , m_upstreams(upstreams)
+    , m_gate(gate)
+{
+    m_clock.start();
+    m_confirmTimer = new QTimer(this);
+    m_confirmTimer->setSingleShot(true);
+    m_confirmTimer->setInterval(kConfirmTimeoutMs);
+    connect(m_confirmTimer, &QTimer::timeout, this, [this]() {
+        if (!m_confirmed)
+            fail(QStringLiteral("ranges not answered in time"));
+    });
+}
+
+RangeDownload::~RangeDownload() {
+    for (Segment &s : m_segments) {
+        closeSocket(s);
+        leaveGate(s);
+    }
+}
+
+bool RangeDownload::start(const Plan &plan) {
+    m_plan = plan;
+    if (m_upstreams->size() == 0 || plan.length <= 0)
+        return false;
+    // As many helpers as the tunnel cap has room for right now
+    int helpers = 0;
+    while (helpers < plan.segments - 1 && (!m_gate || m_gate->tryEnter()))
+        ++helpers;
+    if (helpers == 0)
+        return false;
+
+    const int parts = helpers + 1;
+    for (int i = 1; i < parts; ++i) {
+        Segment s;
+        s.begin = plan.length * i / parts;
+        s.end = plan.length * (i + 1) / parts;
+        s.gateSlot = m_gate != nullptr;
+        m_segments.append(s);
+    }
+    for (int i = 0; i < m_segments.size(); ++i)
+        open(i);
+    m_confirmTimer->start();
+    return true;
+}
+
+qint64 RangeDownload::bytesAvailable() const {
+    if (!m_confirmed || m_failed)
+        return 0;
+    const int index = readIndex();
+    return index < m_segments.size() ? m_segments.at(index).buffered() : 0;
+}
+
+int RangeDownload::readIndex() const {
+    int index = m_current;
+    while (index < m_segments.size() && m_segments.at(index).stage == Stage::Done
+           && m_segments.at(index).buffered() == 0)
+        ++index;
+    return index;
+}
+
+qint64 RangeDownload::read(char *data, qint64 maxSize) {
+    if (!m_confirmed || m_failed)
+        return 0;
+    m_current = readIndex();
+    if (m_current >= m_segments.size())
+        return 0;
+    Segment &s = m_segments[m_current];
+    const qint64 n = qMin<qint64>(maxSize, s.buffered());
+    if (n <= 0)
+        return 0;
+    std::memcpy(data, s.buffer.constData() + s.offset, static_cast<size_t>(n));
+    s.offset += n;
+    if (s.offset == s.buffer.size()) {
+        s.buffer.clear();
+        s.offset = 0;
+    } else if (s.offset >= kCompactOffset) {
+        s.buffer.remove(0, s.offset);
+        s.offset = 0;
+    }
+    fill(m_current);
+    return n;
+}
+
+void RangeDownload::open(int index) {
+    Segment &s = m_segments[index];
+    s.upstream = m_upstreams->pick();
+    m_upstreams->acquire(s.upstream);
+    s.stage = Stage::Socks;
+    s.head.clear();
+    s.startedAt = m_clock.elapsed();
+    ++s.attempts;
+
+    auto *socket = new QTcpSocket(this);
+    socket->setReadBufferSize(kReadBuffer);
+    s.socket = socket;
+    const QString host = m_plan.host;
+    const quint16 port = m_plan.port;
+    connect(socket, &QTcpSocket::connected, this, [socket, host, port]() {
+        socket->write(socks5Greeting() + socks5ConnectRequest(host, port));
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this, index]() { onReadyRead(index); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, index]() { onClosed(index); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, index]() { onClosed(index); });
+    const UpstreamBalancer::Endpoint &endpoint = m_upstreams->endpoint(s.upstream);
+    socket->connectToHost(endpoint.host, endpoint.port);
+}
+
+void RangeDownload::onReadyRead(int index) {
+    Segment &s = m_segments[index];
+    if (m_failed || !s.socket)
+        return;
+
+    if (s.stage == Stage::Socks) {
+        // Method reply (2 bytes), then VER REP RSV ATYP ADDR PORT
+        const QByteArray reply = s.socket->peek(2 + 4 + 256 + 2);
+        if (reply.size() < 2)
+            return;
+        const int length = socks5ReplyLength(reply.constData() + 2, reply.size() - 2);
+        const bool greeted = static_cast<quint8>(reply[0]) == SOCKS5_VERSION
+            && static_cast<quint8>(reply[1]) == SOCKS5_AUTH_NONE;
+        if (greeted && length == 0)
+            return;
+        if (!greeted || length < 0 || static_cast<quint8>(reply[2]) != SOCKS5_VERSION
+            || static_cast<quint8>(reply[3]) != SOCKS5_REPLY_SUCCEEDED) {
+            const bool upstreamFault = !greeted || length < 0
+                || static_cast<quint8>(reply[3]) == SOCKS5_REPLY_GENERAL_FAILURE;
+            if (upstreamFault)
+                m_upstreams->reportFailure(s.upstream);
+            onClosed(index);
+            return;
+        }
+        m_upstreams->reportSuccess(s.upstream, m_clock.elapsed() - s.startedAt);
+        s.socket->skip(2 + length);
+
+        // The original request, narrowed to what this segment still lacks
+        QByteArray request = m_plan.requestHead;
+        request.chop(2);
+        request += "Range: bytes=" + QByteArray::number(s.begin + s.received) + '-'
+            + QByteArray::number(s.end - 1) + "\r\nIf-Range: " + m_plan.validator + "\r\n\r\n";
+        s.socket->write(request);
+        s.stage = Stage::Head;
+    }
+
+    bool confirmedNow = false;
+    if (s.stage == Stage::Head) {
+        if (!readHead(index))
+            return;
+        if (!m_confirmed) {
+            bool all = true;
+            for (const Segment &other : std::as_const(m_segments))
+                all = all && other.confirmed;
+            if (all) {
+                m_confirmed = true;
+                m_confirmTimer->stop();
+                confirmedNow = true;
+            }
+        }
+    }
+
+    const qsizetype before = s.buffered();
+    fill(index);
+    if (confirmedNow)
+        emit confirmed();
+    else if (m_confirmed && index == readIndex() && s.buffered() > before)
+        emit readyRead();
+}
+
+bool RangeDownload::readHead(int index) {
+    Segment &s = m_segments[index];
+    s.head += s.socket->read(kMaxResponseHead - s.head.size());
+    const qsizetype end = s.head.indexOf("\r\n\r\n");
+    if (end < 0) {
+        if (s.head.size() >= kMaxResponseHead)
+            fail(QStringLiteral("range response head too large"));
+        return false;
+    }
+
+    HttpHeadInfo info;
+    qint64 first = -1, last = -1, total = -1;
+    const qint64 from = s.begin + s.received;
+    if (!HttpHeadInfo::parseResponse(s.head.left(end + 4), &info)) {
+        fail(QStringLiteral("invalid range response"));
+        return false;
+    }
+    // Anything but the exact slice of the same representation (a 200 means
+    // If-Range did not match) and the reassembled body would be corrupt
+    if (info.status != 206 || !info.header("Transfer-Encoding").isEmpty()
+        || !parseContentRange(info.header("Content-Range"), &first, &last, &total)
+        || first != from || last != s.end - 1 || total != m_plan.length) {
+        fail(QStringLiteral("origin answered range %1-%2 with %3").arg(from).arg(s.end - 1).arg(info.status));
+        return false;
+    }
+
+    // Body bytes that came with the head
+    const qint64 n = qMin<qint64>(s.head.size() - end - 4, s.end - s.begin - s.received);
+    s.buffer.append(s.head.constData() + end + 4, n);
+    s.received += n;
+    s.head.clear();
+    s.stage = Stage::Body;
+    s.confirmed = true;
+    return true;
+}
+
+void RangeDownload::fill(int index) {
+    Segment &s = m_segments[index];
+    if (s.stage != Stage::Body)
+        return;
+    const qint64 remaining = s.end - s.begin - s.received;
+    const qint64 room = m_plan.bufferLimit - s.buffered();
+    const qint64 n = qMin(remaining, qMin(room, s.socket->bytesAvailable()));
+    if (n > 0) {
+        s.buffer += s.socket->read(n);
+        s.received += n;
+    }
+    if (s.received == s.end - s.begin) {
+        s.stage = Stage::Done;
+        closeSocket(s);
+        leaveGate(s);
+    }
+}
+
+void RangeDownload::onClosed(int index) {
+    Segment &s = m_segments[index];
+    if (m_failed || !s.socket || s.stage == Stage::Done)
+        return;
+    if (s.stage == Stage::Body) {
+        // The closed socket still holds what arrived; keep all of it
+        const qint64 n = qMin(s.end - s.begin - s.received, s.socket->bytesAvailable());
+        s.buffer += s.socket->read(n);
+        s.received += n;
+        if (s.received == s.end - s.begin) {
+            fill(index);
+            return;
+        }
+    } else if (s.stage == Stage::Socks && s.socket->state() == QAbstractSocket::UnconnectedState) {
+        m_upstreams->reportFailure(s.upstream);
+    }
+    closeSocket(s);
+
+    // Until every range is confirmed the original response is still whole
+    if (!s.confirmed) {
+        fail(QStringLiteral("range tunnel closed before answering"));
+        return;
+    }
+    if (s.attempts >= kMaxAttempts) {
+        fail(QStringLiteral("range %1-%2 failed %3 times").arg(s.begin).arg(s.end - 1).arg(s.attempts));
+        return;
+    }
+    open(index);
+}
+
+void RangeDownload::closeSocket(Segment &segment) {
+    if (!segment.socket)
+        return;
+    m_upstreams->release(segment.upstream);
+    segment.upstream = -1;
+    segment.socket->disconnect(this);
+    segment.socket->abort();
+    segment.socket->deleteLater();
+    segment.socket = nullptr;
+}
+
+void RangeDownload::leaveGate(Segment &segment) {
+    if (segment.gateSlot) {
+        segment.gateSlot = false;
+        m_gate->leave();
+    }
+}
+
+void RangeDownload::fail(const QString &reason) {
+    if (m_failed)
+        return;
+    m_failed = true;
+    m_confirmTimer->stop();
+    for (Segment &s : m_segments) {
+        closeSocket(s);
+        leaveGate(s);
+    }
+    emit failed(reason);
+}
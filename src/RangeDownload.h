@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+class ConnectGate;
+class QTcpSocket;
+class QTimer;
+class UpstreamBalancer;
+
+/**
+ * @brief Fetches the tail of one large plain-HTTP response as byte ranges
+ * over extra SOCKS tunnels, for the connection that relays it
+ *
+ * A single stream through paqet rarely gets the whole link. Once a GET is
+ * answered 200 with Accept-Ranges: bytes, a known length and a validator,
+ * the body is cut into equal segments: the original response delivers the
+ * first one, each helper tunnel asks for one of the others with Range and
+ * If-Range. Segments are handed out strictly in body order through read();
+ * a helper stops being read once kReadBuffer plus Plan::bufferLimit bytes
+ * wait ahead of the read position, so reordering memory stays bounded and
+ * TCP flow control slows the helper down.
+ *
+ * The caller keeps relaying the original response until confirmed(), i.e.
+ * every helper got the exact 206 it asked for; failed() before that means
+ * nothing was lost and it just carries on with the original. A helper
+ * dropping later resumes its remaining range on a new tunnel.
+ *
+ * Helpers take an upstream from UpstreamBalancer and, when there is a cap,
+ * a ConnectGate slot each; fewer segments are used when slots are short.
+ *
+ * Lives in (and must be used from) one worker thread.
+ */
+class RangeDownload : public QObject
+{
+    Q_OBJECT
+public:
+    struct Plan {
+        QByteArray requestHead;   // the GET as sent to the origin, without Range
+        QString host;
+        quint16 port = 0;
+        QByteArray validator;     // If-Range: strong ETag or Last-Modified
+        qint64 length = 0;        // whole body
+        int segments = 2;         // including the first (the original response)
+        qint64 bufferLimit = 0;   // bytes buffered per helper segment
+    };
+
+    RangeDownload(UpstreamBalancer *upstreams, ConnectGate *gate, QObject *parent = nullptr);
+    ~RangeDownload() override;
+
+    /**
+     * @return false if no helper tunnel could be started
+     */
+    bool start(const Plan &plan);
+
+    /** Body bytes [0, firstSegmentEnd()) must come from the original response */
+    qint64 firstSegmentEnd() const { return m_segments.isEmpty() ? m_plan.length : m_segments.first().begin; }
+    int segmentCount() const { return m_segments.size() + 1; }
+
+    bool isConfirmed() const { return m_confirmed; }
+
+    /** Bytes that read() can return right now */
+    qint64 bytesAvailable() const;
+
+    /**
+     * @brief Copy the next bytes of the body after firstSegmentEnd(), in
+     * order, to @p data
+     * @return Bytes copied, at most @p maxSize
+     */
+    qint64 read(char *data, qint64 maxSize);
+
+signals:
+    void confirmed();
+    void readyRead();
+    void failed(const QString &reason);
+
+private:
+    enum class Stage {
+        Socks,      // greeting and CONNECT sent, reply pending
+        Head,       // range request sent, response head pending
+        Body,
+        Done
+    };
+
+    struct Segment {
+        qint64 begin = 0;         // [begin, end) of the body
+        qint64 end = 0;
+        qint64 received = 0;      // bytes taken off the socket (read + buffered)
+        QByteArray buffer;        // received; bytes before offset were read already
+        qsizetype offset = 0;
+        QByteArray head;          // response head so far
+        QTcpSocket *socket = nullptr;
+        int upstream = -1;
+        int attempts = 0;
+        qint64 startedAt = 0;
+        Stage stage = Stage::Socks;
+        bool confirmed = false;   // got the 206 for its range once
+        bool gateSlot = false;    // holds a ConnectGate slot (kept across retries)
+
+        qsizetype buffered() const { return buffer.size() - offset; }
+    };
+
+    int readIndex() const;
+    void open(int index);
+    void onReadyRead(int index);
+    void onClosed(int index);
+    bool readHead(int index);
+    void fill(int index);
+    void closeSocket(Segment &segment);
+    void leaveGate(Segment &segment);
+    void fail(const QString &reason);
+
+    UpstreamBalancer *m_upstreams;
+    ConnectGate *m_gate;
+    Plan m_plan;
+    QList<Segment> m_segments;    // helper segments in body order
+    int m_current = 0;            // segment read() takes from
+    bool m_confirmed = false;
+    bool m_failed = false;
+    QTimer *m_confirmTimer = nullptr;
+    QElapsedTimer m_clock;
+};
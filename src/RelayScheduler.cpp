@@ -0,0 +1,92 @@
+#include "RelayScheduler.h"
+
+RelayScheduler::RelayScheduler(qint64 bulkBytesPerTurn)
+    : m_bulkBytesPerTurn(qMax<qint64>(0, bulkBytesPerTurn))
+    , m_bulkLeft(m_bulkBytesPerTurn)
+{
+    m_deferred.reserve(kReservedParked);
+    m_ready.reserve(kReservedParked);
+    m_clock.start();
+}
+
+bool RelayScheduler::account(Flow &flow, qint64 bytes) {
+    if (bytes <= 0)
+        return flow.bulk;
+    const qint64 now = m_clock.elapsed();
+    if (flow.windowStart < 0) {
+        flow.windowStart = now;
+    } else if (now - flow.windowStart >= kRateWindowMs) {
+        // Judge the window that just ended; a flow that went quiet for a
+        // whole window comes back interactive whatever it moved before
+        const qint64 span = now - flow.windowStart;
+        if (flow.bulk && (now - flow.lastActive >= kRateWindowMs
+                          || flow.windowBytes * kRateWindowMs < kInteractiveRate * span))
+            flow.bulk = false;
+        flow.windowStart = now;
+        flow.windowBytes = 0;
+    }
+    flow.lastActive = now;
+    flow.total += bytes;
+    flow.windowBytes += bytes;
+    if (!flow.bulk && flow.total >= kBulkMinBytes && flow.windowBytes >= kBulkRate)
+        flow.bulk = true;
+
+    if (flow.bulk && m_bulkBytesPerTurn > 0) {
+        m_bulkLeft -= bytes;
+        requestTurn();
+    }
+    return flow.bulk;
+}
+
+qint64 RelayScheduler::grant(const Flow &flow, qint64 want) const {
+    if (!flow.bulk || m_bulkBytesPerTurn == 0)
+        return want;
+    return qBound<qint64>(0, m_bulkLeft, want);
+}
+
+void RelayScheduler::defer(QObject *owner, int direction) {
+    m_deferred.push_back(Parked{owner, direction});
+    requestTurn();
+}
+
+void RelayScheduler::cancel(const QObject *owner) {
+    // Nulled rather than erased: endTurn() may be walking m_ready right now
+    for (Parked &parked : m_deferred) {
+        if (parked.owner == owner)
+            parked.owner = nullptr;
+    }
+    for (Parked &parked : m_ready) {
+        if (parked.owner == owner)
+            parked.owner = nullptr;
+    }
+}
+
+void RelayScheduler::endTurn() {
+    m_turnRequested = false;
+    m_bulkLeft = m_bulkBytesPerTurn;
+    // Resumes may defer again (they land in the next turn) or cancel()
+    // other entries, so walk the swapped-out list; both vectors keep their
+    // capacity, so a warm scheduler does not allocate here
+    m_ready.swap(m_deferred);
+    size_t next = 0;
+    while (next < m_ready.size() && (m_bulkBytesPerTurn == 0 || m_bulkLeft > 0)) {
+        const Parked parked = m_ready[next++];
+        if (parked.owner && onResume)
+            onResume(parked.owner, parked.direction);
+    }
+    if (next < m_ready.size()) {
+        // Quota spent: the flows that did not get a go this turn start the
+        // next one, ahead of those that just ran and parked again
+        m_deferred.insert(m_deferred.begin(), m_ready.begin() + next, m_ready.end());
+        requestTurn();
+    }
+    m_ready.clear();
+}
+
+void RelayScheduler::requestTurn() {
+    if (m_turnRequested)
+        return;
+    m_turnRequested = true;
+    if (onTurnNeeded)
+        onTurnNeeded();
+}
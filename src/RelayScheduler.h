@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+#include <functional>
+#include <vector>
+
+class QObject;
+
+/**
+ * @brief Per-worker relay scheduler that keeps interactive flows ahead of
+ * bulk transfers
+ *
+ * Every connection carries a Flow that account() classifies from the bytes
+ * it moves: new and small flows are interactive; once a flow has moved
+ * kBulkMinBytes and keeps up kBulkRate over a window it is demoted to
+ * bulk, and a window below kInteractiveRate promotes it back.
+ *
+ * Interactive flows are never held back. Bulk flows share a byte quota per
+ * event-loop turn: grant() hands out what is left of it, and a flow that
+ * gets nothing parks itself and a direction with defer(). The owner ends the
+ * turn with endTurn() from a zero-delay timer (requested through
+ * onTurnNeeded), i.e. after the socket events already pending - which is
+ * where interactive traffic gets served - have been processed; the quota
+ * is then refilled and parked flows resume in FIFO order through
+ * onResume. Parking stores two words in vectors that keep their capacity
+ * across turns, so a warm relay does not allocate here.
+ *
+ * Not thread-safe: one scheduler per worker thread.
+ */
+class RelayScheduler
+{
+public:
+    struct Flow {
+        qint64 total = 0;          // bytes moved either way
+        qint64 windowBytes = 0;    // bytes moved in the current rate window
+        qint64 windowStart = -1;   // scheduler clock ms, -1 = no bytes yet
+        qint64 lastActive = 0;     // scheduler clock ms of the last bytes
+        bool bulk = false;
+    };
+
+    /** @param bulkBytesPerTurn Quota shared by all bulk flows per turn (0 = no limit) */
+    explicit RelayScheduler(qint64 bulkBytesPerTurn);
+
+    RelayScheduler(const RelayScheduler &) = delete;
+    RelayScheduler &operator=(const RelayScheduler &) = delete;
+
+    /** Called when a turn end is wanted; the owner must call endTurn() soon */
+    std::function<void()> onTurnNeeded;
+
+    /** Called by endTurn() for each parked (owner, direction) in defer() order */
+    std::function<void(QObject *owner, int direction)> onResume;
+
+    /**
+     * @brief Record @p bytes moved by @p flow, reclassify it and charge the
+     * bulk quota
+     * @return true if the bytes were counted as bulk
+     */
+    bool account(Flow &flow, qint64 bytes);
+
+    /** Bytes @p flow may move now, at most @p want; 0 means defer() */
+    qint64 grant(const Flow &flow, qint64 want) const;
+
+    /** Resume @p direction of @p owner on the next turn end (in defer() order) */
+    void defer(QObject *owner, int direction);
+
+    /** Drop everything @p owner parked, e.g. because it is being destroyed */
+    void cancel(const QObject *owner);
+
+    /** Refill the bulk quota and resume parked flows */
+    void endTurn();
+
+    int deferredCount() const { return static_cast<int>(m_deferred.size()); }
+
+    static constexpr qint64 kBulkMinBytes = 4 * 1024 * 1024;
+    static constexpr qint64 kRateWindowMs = 1000;
+    static constexpr qint64 kBulkRate = 1024 * 1024;       // bytes per window to stay bulk-eligible
+    static constexpr qint64 kInteractiveRate = 64 * 1024;  // bytes per window to be promoted back
+
+private:
+    struct Parked {
+        QObject *owner;   // null once cancelled
+        int direction;
+    };
+
+    void requestTurn();
+
+    static constexpr size_t kReservedParked = 256;
+
+    qint64 m_bulkBytesPerTurn;
+    qint64 m_bulkLeft;
+    bool m_turnRequested = false;
+    std::vector<Parked> m_deferred;   // parked for the next turn end
+    std::vector<Parked> m_ready;      // being resumed by endTurn()
+    QElapsedTimer m_clock;
+};
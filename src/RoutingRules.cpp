@@ -0,0 +1,330 @@
+#include "RoutingRules.h"
+#include <QHostAddress>
+#include <algorithm>
+#include <climits>
+#include <map>
+
+static char16_t lowerAscii(char16_t c) {
+    return (c >= u'A' && c <= u'Z') ? char16_t(c + 32) : c;
+}
+
+/** Byte-wise order of the lower-cased @p label against stored label bytes */
+static int compareLabel(QStringView label, const char *bytes, qsizetype length) {
+    const qsizetype n = qMin(label.size(), length);
+    for (qsizetype i = 0; i < n; ++i) {
+        const char16_t a = lowerAscii(label[i].unicode());
+        const char16_t b = static_cast<uchar>(bytes[i]);
+        if (a != b)
+            return a < b ? -1 : 1;
+    }
+    return label.size() == length ? 0 : (label.size() < length ? -1 : 1);
+}
+
+static bool parseAction(QStringView name, RoutingRules::Action *action) {
+    if (name.compare(QLatin1String("TUNNEL"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("PROXY"), Qt::CaseInsensitive) == 0) {
+        *action = RoutingRules::Action::Tunnel;
+    } else if (name.compare(QLatin1String("DIRECT"), Qt::CaseInsensitive) == 0) {
+        *action = RoutingRules::Action::Direct;
+    } else if (name.compare(QLatin1String("REJECT"), Qt::CaseInsensitive) == 0) {
+        *action = RoutingRules::Action::Reject;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString RoutingRules::actionName(Action action) {
+    switch (action) {
+    case Action::Tunnel: return QStringLiteral("tunnel");
+    case Action::Direct: return QStringLiteral("direct");
+    case Action::Reject: return QStringLiteral("reject");
+    }
+    return {};
+}
+
+std::shared_ptr<const RoutingRules> RoutingRules::compile(const QString &text, QStringList *errors) {
+    std::shared_ptr<RoutingRules> rules(new RoutingRules);
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    for (int i = 0; i < lines.size(); ++i) {
+        QString error;
+        if (!rules->addRule(QStringView(lines.at(i)).trimmed(), &error) && errors)
+            errors->append(QStringLiteral("line %1: %2").arg(i + 1).arg(error));
+    }
+    rules->finalizeDomains();
+    return rules;
+}
+
+bool RoutingRules::addRule(QStringView line, QString *error) {
+    if (line.isEmpty() || line.startsWith(u'#'))
+        return true;
+
+    QList<QStringView> parts;
+    for (QStringView part : line.tokenize(u','))
+        parts.append(part.trimmed());
+    const QStringView type = parts.first();
+
+    Action action;
+    if (type.compare(QLatin1String("MATCH"), Qt::CaseInsensitive) == 0
+        || type.compare(QLatin1String("FINAL"), Qt::CaseInsensitive) == 0) {
+        if (parts.size() != 2 || !parseAction(parts.at(1), &action)) {
+            *error = QStringLiteral("expected MATCH,<action>");
+            return false;
+        }
+        m_default = action;
+        return true;
+    }
+    // A trailing option (e.g. "no-resolve" in imported lists) is ignored
+    if (parts.size() < 3 || parts.size() > 4 || parts.at(1).isEmpty()) {
+        *error = QStringLiteral("expected <type>,<value>,<action>");
+        return false;
+    }
+    if (!parseAction(parts.at(2), &action)) {
+        *error = QStringLiteral("unknown action \"%1\"").arg(parts.at(2));
+        return false;
+    }
+    const QStringView value = parts.at(1);
+
+    if (type.compare(QLatin1String("DOMAIN"), Qt::CaseInsensitive) == 0) {
+        addDomain(value, false, newRule(action));
+    } else if (type.compare(QLatin1String("DOMAIN-SUFFIX"), Qt::CaseInsensitive) == 0) {
+        addDomain(value, true, newRule(action));
+    } else if (type.compare(QLatin1String("DOMAIN-KEYWORD"), Qt::CaseInsensitive) == 0) {
+        m_keywords.push_back({value.toString().toLower(), newRule(action)});
+    } else if (type.compare(QLatin1String("IP-CIDR"), Qt::CaseInsensitive) == 0
+               || type.compare(QLatin1String("IP-CIDR6"), Qt::CaseInsensitive) == 0) {
+        if (!addCidr(value, static_cast<int>(m_actions.size()), error))
+            return false;
+        newRule(action);
+    } else if (type.compare(QLatin1String("DST-PORT"), Qt::CaseInsensitive) == 0) {
+        const qsizetype dash = value.indexOf(u'-');
+        bool okLow = false;
+        bool okHigh = false;
+        const uint low = (dash < 0 ? value : value.first(dash)).toUInt(&okLow);
+        const uint high = dash < 0 ? low : value.sliced(dash + 1).toUInt(&okHigh);
+        if (!okLow || (dash >= 0 && !okHigh) || low == 0 || high > 65535 || low > high) {
+            *error = QStringLiteral("bad port \"%1\"").arg(value);
+            return false;
+        }
+        m_ports.push_back({static_cast<quint16>(low), static_cast<quint16>(high), newRule(action)});
+    } else {
+        *error = QStringLiteral("unknown rule type \"%1\"").arg(type);
+        return false;
+    }
+    return true;
+}
+
+int RoutingRules::newRule(Action action) {
+    m_actions.push_back(action);
+    return static_cast<int>(m_actions.size()) - 1;
+}
+
+void RoutingRules::addDomain(QStringView domain, bool suffix, int rule) {
+    if (domain.startsWith(QLatin1String("*.")))
+        domain = domain.sliced(2);
+    while (domain.startsWith(u'.'))
+        domain = domain.sliced(1);
+    while (domain.endsWith(u'.'))
+        domain.chop(1);
+    m_pendingDomains.push_back({domain.toString().toLower().toUtf8(), rule, suffix});
+}
+
+void RoutingRules::finalizeDomains() {
+    struct BuildNode {
+        std::map<QByteArray, int> children;
+        int exactRule = -1;
+        int suffixRule = -1;
+    };
+    std::vector<BuildNode> build(1);
+    for (const PendingDomain &d : m_pendingDomains) {
+        int node = 0;
+        qsizetype end = d.name.size();
+        while (end > 0) {
+            const qsizetype dot = d.name.lastIndexOf('.', end - 1);
+            const QByteArray label = d.name.mid(dot + 1, end - dot - 1);
+            end = dot < 0 ? 0 : dot;
+            if (label.isEmpty())
+                continue;
+            auto it = build[node].children.find(label);
+            if (it == build[node].children.end()) {
+                build.emplace_back();
+                it = build[node].children.emplace(label, static_cast<int>(build.size()) - 1).first;
+            }
+            node = it->second;
+        }
+        if (node == 0)
+            continue;  // nothing but dots
+        // Rules arrive in order, so the first one for a name wins
+        int &slot = d.suffix ? build[node].suffixRule : build[node].exactRule;
+        if (slot < 0)
+            slot = d.rule;
+    }
+    m_pendingDomains.clear();
+    m_pendingDomains.shrink_to_fit();
+
+    // Flatten breadth-first so every node's children are contiguous
+    m_domains.assign(1, DomainNode());
+    std::vector<int> order{0};   // build index of m_domains[i]
+    for (size_t i = 0; i < order.size(); ++i) {
+        const BuildNode &b = build[order[i]];
+        m_domains[i].exactRule = b.exactRule;
+        m_domains[i].suffixRule = b.suffixRule;
+        m_domains[i].childBegin = static_cast<quint32>(m_domains.size());
+        for (const auto &child : b.children) {
+            DomainNode node;
+            node.labelOffset = static_cast<quint32>(m_labels.size());
+            node.labelLength = static_cast<quint32>(child.first.size());
+            m_labels.append(child.first);
+            m_domains.push_back(node);
+            order.push_back(child.second);
+        }
+        m_domains[i].childEnd = static_cast<quint32>(m_domains.size());
+    }
+}
+
+bool RoutingRules::addCidr(QStringView cidr, int rule, QString *error) {
+    const qsizetype slash = cidr.indexOf(u'/');
+    QHostAddress address;
+    if (!address.setAddress((slash < 0 ? cidr : cidr.first(slash)).toString())) {
+        *error = QStringLiteral("bad address \"%1\"").arg(cidr);
+        return false;
+    }
+    const bool v4 = address.protocol() == QAbstractSocket::IPv4Protocol;
+    const int maxBits = v4 ? 32 : 128;
+    int prefix = maxBits;
+    if (slash >= 0) {
+        bool ok = false;
+        prefix = cidr.sliced(slash + 1).toInt(&ok);
+        if (!ok || prefix < 0 || prefix > maxBits) {
+            *error = QStringLiteral("bad prefix length \"%1\"").arg(cidr);
+            return false;
+        }
+    }
+
+    quint8 bytes[16];
+    if (v4) {
+        const quint32 ip = address.toIPv4Address();
+        for (int i = 0; i < 4; ++i)
+            bytes[i] = static_cast<quint8>(ip >> (24 - 8 * i));
+    } else {
+        const Q_IPV6ADDR ip = address.toIPv6Address();
+        std::copy(ip.c, ip.c + 16, bytes);
+    }
+
+    std::vector<quint32> &tree = v4 ? m_v4 : m_v6;
+    quint32 node = 0;
+    for (int bit = 0; bit < prefix; ++bit) {
+        const int b = (bytes[bit / 8] >> (7 - bit % 8)) & 1;
+        quint32 child = tree[3 * node + b];
+        if (child == 0) {
+            child = static_cast<quint32>(tree.size() / 3);
+            tree.insert(tree.end(), {0, 0, 0});
+            tree[3 * node + b] = child;
+        }
+        node = child;
+    }
+    if (tree[3 * node + 2] == 0)
+        tree[3 * node + 2] = static_cast<quint32>(rule) + 1;
+    return true;
+}
+
+int RoutingRules::matchDomain(QStringView host) const {
+    while (host.endsWith(u'.'))
+        host.chop(1);
+    int best = INT_MAX;
+    quint32 node = 0;
+    qsizetype end = host.size();
+    while (end > 0) {
+        const qsizetype dot = host.lastIndexOf(u'.', end - 1);
+        const QStringView label = host.sliced(dot + 1, end - dot - 1);
+
+        // Binary search among the sorted children
+        quint32 lo = m_domains[node].childBegin;
+        quint32 hi = m_domains[node].childEnd;
+        quint32 found = 0;
+        while (lo < hi) {
+            const quint32 mid = lo + (hi - lo) / 2;
+            const DomainNode &n = m_domains[mid];
+            const int c = compareLabel(label, m_labels.constData() + n.labelOffset, n.labelLength);
+            if (c == 0) {
+                found = mid;
+                break;
+            }
+            if (c < 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        if (found == 0)
+            break;
+        node = found;
+        const DomainNode &n = m_domains[node];
+        if (n.suffixRule >= 0)
+            best = qMin(best, n.suffixRule);
+        if (dot < 0) {
+            if (n.exactRule >= 0)
+                best = qMin(best, n.exactRule);
+            break;
+        }
+        end = dot;
+    }
+    return best == INT_MAX ? -1 : best;
+}
+
+int RoutingRules::matchAddress(const quint8 *bytes, int bits, const std::vector<quint32> &tree) const {
+    // The first rule on the path is the shortest prefix, not the lowest
+    // number, so keep the minimum over every rule met
+    quint32 best = 0;
+    quint32 node = 0;
+    for (int bit = 0;; ++bit) {
+        const quint32 rule = tree[3 * node + 2];
+        if (rule != 0 && (best == 0 || rule < best))
+            best = rule;
+        if (bit == bits)
+            break;
+        node = tree[3 * node + ((bytes[bit / 8] >> (7 - bit % 8)) & 1)];
+        if (node == 0)
+            break;
+    }
+    return static_cast<int>(best) - 1;
+}
+
+RoutingRules::Action RoutingRules::match(QStringView host, quint16 port) const {
+    int best = INT_MAX;
+    auto consider = [&best](int rule) {
+        if (rule >= 0 && rule < best)
+            best = rule;
+    };
+
+    // Only something that can be a literal goes through the address parser
+    QHostAddress address;
+    const bool maybeIp = !host.isEmpty() && (host.contains(u':') || (host.back() >= u'0' && host.back() <= u'9'));
+    if (maybeIp && address.setAddress(host.toString())) {
+        bool isV4 = false;   // also true for IPv4-mapped IPv6
+        const quint32 ip4 = address.toIPv4Address(&isV4);
+        if (isV4) {
+            const quint8 bytes[4] = {quint8(ip4 >> 24), quint8(ip4 >> 16), quint8(ip4 >> 8), quint8(ip4)};
+            consider(matchAddress(bytes, 32, m_v4));
+        } else {
+            const Q_IPV6ADDR ip6 = address.toIPv6Address();
+            consider(matchAddress(ip6.c, 128, m_v6));
+        }
+    } else {
+        consider(matchDomain(host));
+    }
+
+    // Linear lists are in rule order: stop once nothing can beat the best
+    for (const Keyword &k : m_keywords) {
+        if (k.rule >= best)
+            break;
+        if (host.contains(k.text, Qt::CaseInsensitive))
+            best = k.rule;
+    }
+    for (const PortRange &p : m_ports) {
+        if (p.rule >= best)
+            break;
+        if (port >= p.low && port <= p.high)
+            best = p.rule;
+    }
+    return best == INT_MAX ? m_default : m_actions[best];
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Compiled routing rule set: decides per target whether a
+ * connection goes through paqet, straight to the target, or is refused
+ *
+ * Rules are text lines, first match wins:
+ *
+ *     # comment
+ *     DOMAIN,exact.example.com,DIRECT
+ *     DOMAIN-SUFFIX,example.ir,DIRECT       (example.ir and any subdomain)
+ *     DOMAIN-KEYWORD,ads,REJECT
+ *     IP-CIDR,192.168.0.0/16,DIRECT
+ *     IP-CIDR6,fc00::/7,DIRECT
+ *     DST-PORT,25,REJECT                    (or a range: 6881-6889)
+ *     MATCH,TUNNEL                          (everything else; default TUNNEL)
+ *
+ * Actions are TUNNEL (alias PROXY), DIRECT and REJECT.
+ *
+ * Domain rules live in a label trie walked from the TLD, CIDRs in one
+ * binary radix tree per address family; a lookup is a handful of binary
+ * searches plus at most 32/128 bit steps and keeps the lowest matching rule
+ * number, so order is honoured without scanning the list. Keyword and port
+ * rules are scanned linearly and are meant to be few.
+ *
+ * IP rules only see targets given as IP literals; host names are not
+ * resolved here, which would leak the lookup outside the tunnel.
+ *
+ * Immutable once compiled; safe to share between worker threads.
+ */
+class RoutingRules
+{
+public:
+    enum class Action : quint8 {
+        Tunnel,
+        Direct,
+        Reject
+    };
+
+    /**
+     * @brief Parse @p text; bad lines are skipped and described in @p errors
+     */
+    static std::shared_ptr<const RoutingRules> compile(const QString &text, QStringList *errors = nullptr);
+
+    Action match(QStringView host, quint16 port) const;
+
+    int ruleCount() const { return static_cast<int>(m_actions.size()); }
+    Action defaultAction() const { return m_default; }
+
+    static QString actionName(Action action);
+
+private:
+    RoutingRules() = default;
+
+    bool addRule(QStringView line, QString *error);
+    int newRule(Action action);
+    void addDomain(QStringView domain, bool suffix, int rule);
+    bool addCidr(QStringView cidr, int rule, QString *error);
+    void finalizeDomains();
+
+    int matchDomain(QStringView host) const;
+    int matchAddress(const quint8 *bytes, int bits, const std::vector<quint32> &tree) const;
+
+    // Frozen domain trie: node 0 is the root, children of a node are a
+    // contiguous range sorted by label
+    struct DomainNode {
+        quint32 childBegin = 0;
+        quint32 childEnd = 0;
+        quint32 labelOffset = 0;
+        quint32 labelLength = 0;
+        qint32 exactRule = -1;    // DOMAIN: only this name
+        qint32 suffixRule = -1;   // DOMAIN-SUFFIX: this name and below
+    };
+    std::vector<DomainNode> m_domains;
+    QByteArray m_labels;          // lower-case label bytes referenced by the nodes
+
+    // Domain rules before finalizeDomains(): lower-cased name, rule, kind
+    struct PendingDomain {
+        QByteArray name;
+        int rule;
+        bool suffix;
+    };
+    std::vector<PendingDomain> m_pendingDomains;
+
+    // Radix trees, flattened: node i is [3*i] child 0, [3*i+1] child 1,
+    // [3*i+2] rule + 1 (0 = none); child index 0 means absent
+    std::vector<quint32> m_v4{0, 0, 0};
+    std::vector<quint32> m_v6{0, 0, 0};
+
+    struct Keyword {
+        QString text;
+        int rule;
+    };
+    std::vector<Keyword> m_keywords;
+
+    struct PortRange {
+        quint16 low;
+        quint16 high;
+        int rule;
+    };
+    std::vector<PortRange> m_ports;
+
+    std::vector<Action> m_actions;   // by rule number
+    Action m_default = Action::Tunnel;
+};
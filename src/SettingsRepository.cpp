@@ -11,8 +11,18 @@ static const QStringList proxyModeList = {
     QStringLiteral("none"), QStringLiteral("system"), QStringLiteral("tun")
 };
 
+static const QStringList upstreamPolicyList = {
+    QStringLiteral("leastConnections"), QStringLiteral("fastestReply")
+};
+
+static const QStringList relayEngineList = {
+    QStringLiteral("qt"), QStringLiteral("native")
+};
+
 const QStringList &SettingsRepository::logLevels() { return logLevelList; }
 const QStringList &SettingsRepository::proxyModes() { return proxyModeList; }
+const QStringList &SettingsRepository::upstreamPolicies() { return upstreamPolicyList; }
+const QStringList &SettingsRepository::relayEngines() { return relayEngineList; }
 
 QSettings *SettingsRepository::settings() const {
     if (!m_settings)
@@ -200,3 +210,250 @@ void SettingsRepository::setSelectedNetworkInterface(const QString &guid) {
     settings()->setValue(QStringLiteral("selectedNetworkInterface"), guid);
     emit selectedNetworkInterfaceChanged();
 }
+
+int SettingsRepository::httpProxyWorkers() const {
+    return settings()->value(QStringLiteral("httpProxyWorkers"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyWorkers(int workers) {
+    workers = qBound(0, workers, maxHttpProxyWorkers);
+    if (httpProxyWorkers() == workers) return;
+    settings()->setValue(QStringLiteral("httpProxyWorkers"), workers);
+    emit httpProxyWorkersChanged();
+}
+
+bool SettingsRepository::httpProxyOptimisticConnect() const {
+    return settings()->value(QStringLiteral("httpProxyOptimisticConnect"), false).toBool();
+}
+
+void SettingsRepository::setHttpProxyOptimisticConnect(bool enabled) {
+    if (httpProxyOptimisticConnect() == enabled) return;
+    settings()->setValue(QStringLiteral("httpProxyOptimisticConnect"), enabled);
+    emit httpProxyOptimisticConnectChanged();
+}
+
+int SettingsRepository::httpProxyIdleTimeout() const {
+    return settings()->value(QStringLiteral("httpProxyIdleTimeout"), defaultHttpProxyIdleTimeout).toInt();
+}
+
+void SettingsRepository::setHttpProxyIdleTimeout(int seconds) {
+    seconds = qBound(0, seconds, maxHttpProxyTimeout);
+    if (httpProxyIdleTimeout() == seconds) return;
+    settings()->setValue(QStringLiteral("httpProxyIdleTimeout"), seconds);
+    emit httpProxyTimeoutsChanged();
+}
+
+int SettingsRepository::httpProxyHeaderTimeout() const {
+    return settings()->value(QStringLiteral("httpProxyHeaderTimeout"), defaultHttpProxyHeaderTimeout).toInt();
+}
+
+void SettingsRepository::setHttpProxyHeaderTimeout(int seconds) {
+    seconds = qBound(0, seconds, maxHttpProxyTimeout);
+    if (httpProxyHeaderTimeout() == seconds) return;
+    settings()->setValue(QStringLiteral("httpProxyHeaderTimeout"), seconds);
+    emit httpProxyTimeoutsChanged();
+}
+
+int SettingsRepository::httpProxyHandshakeTimeout() const {
+    return settings()->value(QStringLiteral("httpProxyHandshakeTimeout"), defaultHttpProxyHandshakeTimeout).toInt();
+}
+
+void SettingsRepository::setHttpProxyHandshakeTimeout(int seconds) {
+    seconds = qBound(0, seconds, maxHttpProxyTimeout);
+    if (httpProxyHandshakeTimeout() == seconds) return;
+    settings()->setValue(QStringLiteral("httpProxyHandshakeTimeout"), seconds);
+    emit httpProxyTimeoutsChanged();
+}
+
+int SettingsRepository::httpProxyClientRateLimit() const {
+    return settings()->value(QStringLiteral("httpProxyClientRateLimit"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyClientRateLimit(int kibPerSec) {
+    kibPerSec = qBound(0, kibPerSec, maxHttpProxyClientRateLimit);
+    if (httpProxyClientRateLimit() == kibPerSec) return;
+    settings()->setValue(QStringLiteral("httpProxyClientRateLimit"), kibPerSec);
+    emit httpProxyLimitsChanged();
+}
+
+int SettingsRepository::httpProxyClientMaxConnections() const {
+    return settings()->value(QStringLiteral("httpProxyClientMaxConnections"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyClientMaxConnections(int connections) {
+    connections = qBound(0, connections, maxHttpProxyConnections);
+    if (httpProxyClientMaxConnections() == connections) return;
+    settings()->setValue(QStringLiteral("httpProxyClientMaxConnections"), connections);
+    emit httpProxyLimitsChanged();
+}
+
+int SettingsRepository::httpProxyMaxConcurrentConnects() const {
+    return settings()->value(QStringLiteral("httpProxyMaxConcurrentConnects"), defaultHttpProxyMaxConcurrentConnects).toInt();
+}
+
+void SettingsRepository::setHttpProxyMaxConcurrentConnects(int connects) {
+    connects = qBound(0, connects, maxHttpProxyConnections);
+    if (httpProxyMaxConcurrentConnects() == connects) return;
+    settings()->setValue(QStringLiteral("httpProxyMaxConcurrentConnects"), connects);
+    emit httpProxyLimitsChanged();
+}
+
+int SettingsRepository::httpProxyConnectQueueTimeout() const {
+    return settings()->value(QStringLiteral("httpProxyConnectQueueTimeout"), defaultHttpProxyConnectQueueTimeout).toInt();
+}
+
+void SettingsRepository::setHttpProxyConnectQueueTimeout(int seconds) {
+    seconds = qBound(0, seconds, maxHttpProxyTimeout);
+    if (httpProxyConnectQueueTimeout() == seconds) return;
+    settings()->setValue(QStringLiteral("httpProxyConnectQueueTimeout"), seconds);
+    emit httpProxyLimitsChanged();
+}
+
+int SettingsRepository::httpProxyPreconnectBudget() const {
+    return settings()->value(QStringLiteral("httpProxyPreconnectBudget"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyPreconnectBudget(int tunnels) {
+    tunnels = qBound(0, tunnels, maxHttpProxyPreconnectBudget);
+    if (httpProxyPreconnectBudget() == tunnels) return;
+    settings()->setValue(QStringLiteral("httpProxyPreconnectBudget"), tunnels);
+    emit httpProxyPreconnectChanged();
+}
+
+int SettingsRepository::httpProxyPreconnectTtl() const {
+    return settings()->value(QStringLiteral("httpProxyPreconnectTtl"), defaultHttpProxyPreconnectTtl).toInt();
+}
+
+void SettingsRepository::setHttpProxyPreconnectTtl(int seconds) {
+    seconds = qBound(1, seconds, maxHttpProxyPreconnectTtl);
+    if (httpProxyPreconnectTtl() == seconds) return;
+    settings()->setValue(QStringLiteral("httpProxyPreconnectTtl"), seconds);
+    emit httpProxyPreconnectChanged();
+}
+
+int SettingsRepository::httpProxyRangeSplitCount() const {
+    return settings()->value(QStringLiteral("httpProxyRangeSplitCount"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyRangeSplitCount(int ranges) {
+    ranges = qBound(0, ranges, maxHttpProxyRangeSplitCount);
+    if (httpProxyRangeSplitCount() == ranges) return;
+    settings()->setValue(QStringLiteral("httpProxyRangeSplitCount"), ranges);
+    emit httpProxyRangeSplitChanged();
+}
+
+int SettingsRepository::httpProxyRangeSplitThreshold() const {
+    return settings()->value(QStringLiteral("httpProxyRangeSplitThreshold"), defaultHttpProxyRangeSplitThreshold).toInt();
+}
+
+void SettingsRepository::setHttpProxyRangeSplitThreshold(int mib) {
+    mib = qBound(1, mib, maxHttpProxyRangeSplitThreshold);
+    if (httpProxyRangeSplitThreshold() == mib) return;
+    settings()->setValue(QStringLiteral("httpProxyRangeSplitThreshold"), mib);
+    emit httpProxyRangeSplitChanged();
+}
+
+QString SettingsRepository::httpProxyRelayEngine() const {
+    return settings()->value(QStringLiteral("httpProxyRelayEngine"), relayEngineList.first()).toString();
+}
+
+void SettingsRepository::setHttpProxyRelayEngine(const QString &engine) {
+    QString v = relayEngineList.contains(engine) ? engine : relayEngineList.first();
+    if (httpProxyRelayEngine() == v) return;
+    settings()->setValue(QStringLiteral("httpProxyRelayEngine"), v);
+    emit httpProxyRelayEngineChanged();
+}
+
+int SettingsRepository::httpProxyCacheSize() const {
+    return settings()->value(QStringLiteral("httpProxyCacheSize"), 0).toInt();
+}
+
+void SettingsRepository::setHttpProxyCacheSize(int mib) {
+    mib = qBound(0, mib, maxHttpProxyCacheSize);
+    if (httpProxyCacheSize() == mib) return;
+    settings()->setValue(QStringLiteral("httpProxyCacheSize"), mib);
+    emit httpProxyCacheChanged();
+}
+
+QStringList SettingsRepository::httpProxyListenInterfaces() const {
+    return settings()->value(QStringLiteral("httpProxyListenInterfaces")).toStringList();
+}
+
+void SettingsRepository::setHttpProxyListenInterfaces(const QStringList &interfaces) {
+    if (httpProxyListenInterfaces() == interfaces) return;
+    settings()->setValue(QStringLiteral("httpProxyListenInterfaces"), interfaces);
+    emit httpProxyGatewayChanged();
+}
+
+QStringList SettingsRepository::httpProxyAllowedNetworks() const {
+    return settings()->value(QStringLiteral("httpProxyAllowedNetworks")).toStringList();
+}
+
+void SettingsRepository::setHttpProxyAllowedNetworks(const QStringList &cidrs) {
+    if (httpProxyAllowedNetworks() == cidrs) return;
+    settings()->setValue(QStringLiteral("httpProxyAllowedNetworks"), cidrs);
+    emit httpProxyGatewayChanged();
+}
+
+int SettingsRepository::httpProxyAcceptRate() const {
+    return settings()->value(QStringLiteral("httpProxyAcceptRate"), defaultHttpProxyAcceptRate).toInt();
+}
+
+void SettingsRepository::setHttpProxyAcceptRate(int perSecond) {
+    perSecond = qBound(0, perSecond, maxHttpProxyConnections);
+    if (httpProxyAcceptRate() == perSecond) return;
+    settings()->setValue(QStringLiteral("httpProxyAcceptRate"), perSecond);
+    emit httpProxyGatewayChanged();
+}
+
+int SettingsRepository::httpProxyListenBacklog() const {
+    return settings()->value(QStringLiteral("httpProxyListenBacklog"), defaultHttpProxyListenBacklog).toInt();
+}
+
+void SettingsRepository::setHttpProxyListenBacklog(int backlog) {
+    backlog = qBound(1, backlog, maxHttpProxyListenBacklog);
+    if (httpProxyListenBacklog() == backlog) return;
+    settings()->setValue(QStringLiteral("httpProxyListenBacklog"), backlog);
+    emit httpProxyGatewayChanged();
+}
+
+QStringList SettingsRepository::httpProxyExtraUpstreams() const {
+    return settings()->value(QStringLiteral("httpProxyExtraUpstreams")).toStringList();
+}
+
+void SettingsRepository::setHttpProxyExtraUpstreams(const QStringList &endpoints) {
+    if (httpProxyExtraUpstreams() == endpoints) return;
+    settings()->setValue(QStringLiteral("httpProxyExtraUpstreams"), endpoints);
+    emit httpProxyUpstreamsChanged();
+}
+
+QString SettingsRepository::httpProxyUpstreamPolicy() const {
+    return settings()->value(QStringLiteral("httpProxyUpstreamPolicy"), upstreamPolicyList.first()).toString();
+}
+
+void SettingsRepository::setHttpProxyUpstreamPolicy(const QString &policy) {
+    QString v = upstreamPolicyList.contains(policy) ? policy : upstreamPolicyList.first();
+    if (httpProxyUpstreamPolicy() == v) return;
+    settings()->setValue(QStringLiteral("httpProxyUpstreamPolicy"), v);
+    emit httpProxyUpstreamsChanged();
+}
+
+QString SettingsRepository::httpProxyRoutingRules() const {
+    return settings()->value(QStringLiteral("httpProxyRoutingRules")).toString();
+}
+
+void SettingsRepository::setHttpProxyRoutingRules(const QString &rules) {
+    if (httpProxyRoutingRules() == rules) return;
+    settings()->setValue(QStringLiteral("httpProxyRoutingRules"), rules);
+    emit httpProxyRoutingRulesChanged();
+}
+
+QStringList SettingsRepository::httpProxyBlocklistFiles() const {
+    return settings()->value(QStringLiteral("httpProxyBlocklistFiles")).toStringList();
+}
+
+void SettingsRepository::setHttpProxyBlocklistFiles(const QStringList &files) {
+    if (httpProxyBlocklistFiles() == files) return;
+    settings()->setValue(QStringLiteral("httpProxyBlocklistFiles"), files);
+    emit httpProxyBlocklistFilesChanged();
+}
@@ -62,13 +62,109 @@ public:
     QString selectedNetworkInterface() const;  // GUID of selected interface
     void setSelectedNetworkInterface(const QString &guid);
 
+    int httpProxyWorkers() const;  // 0 = one per CPU core
+    void setHttpProxyWorkers(int workers);
+
+    bool httpProxyOptimisticConnect() const;
+    void setHttpProxyOptimisticConnect(bool enabled);
+
+    // HTTP proxy connection timeouts in seconds, 0 = none
+    int httpProxyIdleTimeout() const;
+    void setHttpProxyIdleTimeout(int seconds);
+    int httpProxyHeaderTimeout() const;
+    void setHttpProxyHeaderTimeout(int seconds);
+    int httpProxyHandshakeTimeout() const;
+    void setHttpProxyHandshakeTimeout(int seconds);
+
+    // SOCKS5 "host:port" endpoints the HTTP proxy balances over besides paqet's own
+    QStringList httpProxyExtraUpstreams() const;
+    void setHttpProxyExtraUpstreams(const QStringList &endpoints);
+    QString httpProxyUpstreamPolicy() const;  // one of upstreamPolicies()
+    void setHttpProxyUpstreamPolicy(const QString &policy);
+
+    // Routing rules for the HTTP proxy, one per line (see RoutingRules)
+    QString httpProxyRoutingRules() const;
+    void setHttpProxyRoutingRules(const QString &rules);
+
+    // Domain list files (plain, hosts or Adblock format) refused by the HTTP proxy
+    QStringList httpProxyBlocklistFiles() const;
+    void setHttpProxyBlocklistFiles(const QStringList &files);
+
+    // Per source IP limits for the HTTP proxy (LAN sharing), 0 = unlimited
+    int httpProxyClientRateLimit() const;  // KiB/s each way
+    void setHttpProxyClientRateLimit(int kibPerSec);
+    int httpProxyClientMaxConnections() const;
+    void setHttpProxyClientMaxConnections(int connections);
+    // Cap on concurrent tunnels through paqet (0 = none) and how long a
+    // request over it waits for a slot, in seconds
+    int httpProxyMaxConcurrentConnects() const;
+    void setHttpProxyMaxConcurrentConnects(int connects);
+    int httpProxyConnectQueueTimeout() const;
+    void setHttpProxyConnectQueueTimeout(int seconds);
+
+    // Speculative tunnels to popular destinations: tunnels per worker
+    // (0 = off) and how long an unused one is kept, in seconds
+    int httpProxyPreconnectBudget() const;
+    void setHttpProxyPreconnectBudget(int tunnels);
+    int httpProxyPreconnectTtl() const;
+    void setHttpProxyPreconnectTtl(int seconds);
+
+    // Large plain-HTTP downloads fetched as parallel byte ranges: ranges
+    // per download (below 2 = off) and the smallest size split, in MiB
+    int httpProxyRangeSplitCount() const;
+    void setHttpProxyRangeSplitCount(int ranges);
+    int httpProxyRangeSplitThreshold() const;
+    void setHttpProxyRangeSplitThreshold(int mib);
+
+    // What relays established tunnels: "qt" (Qt sockets, splice) or
+    // "native" (epoll engine, Linux only); one of relayEngines()
+    QString httpProxyRelayEngine() const;
+    void setHttpProxyRelayEngine(const QString &engine);
+
+    // On-disk cache of cacheable plain-HTTP responses, in MiB (0 = off)
+    int httpProxyCacheSize() const;
+    void setHttpProxyCacheSize(int mib);
+
+    // LAN gateway (HTTP proxy while allowLocalLan is on): interface names
+    // or addresses to listen on (empty = all), client networks allowed
+    // (empty = private ranges), accepts per second (0 = unlimited), backlog
+    QStringList httpProxyListenInterfaces() const;
+    void setHttpProxyListenInterfaces(const QStringList &interfaces);
+    QStringList httpProxyAllowedNetworks() const;
+    void setHttpProxyAllowedNetworks(const QStringList &cidrs);
+    int httpProxyAcceptRate() const;
+    void setHttpProxyAcceptRate(int perSecond);
+    int httpProxyListenBacklog() const;
+    void setHttpProxyListenBacklog(int backlog);
+
     static const QStringList &logLevels();
     static const QStringList &proxyModes();
+    static const QStringList &upstreamPolicies();
+    static const QStringList &relayEngines();
     static constexpr int defaultSocksPort = 1284;
     static constexpr const char *defaultConnectionCheckUrl = "https://www.gstatic.com/generate_204";
     static constexpr int defaultConnectionCheckTimeoutSeconds = 10;
     static constexpr int minConnectionCheckTimeout = 3;
     static constexpr int maxConnectionCheckTimeout = 60;
+    static constexpr int maxHttpProxyWorkers = 64;
+    static constexpr int defaultHttpProxyIdleTimeout = 300;
+    static constexpr int defaultHttpProxyHeaderTimeout = 30;
+    static constexpr int defaultHttpProxyHandshakeTimeout = 15;
+    static constexpr int maxHttpProxyTimeout = 86400;
+    static constexpr int maxHttpProxyClientRateLimit = 1024 * 1024;  // KiB/s
+    static constexpr int maxHttpProxyConnections = 100000;
+    static constexpr int defaultHttpProxyMaxConcurrentConnects = 0;
+    static constexpr int defaultHttpProxyConnectQueueTimeout = 10;
+    static constexpr int defaultHttpProxyAcceptRate = 500;
+    static constexpr int maxHttpProxyPreconnectBudget = 64;
+    static constexpr int defaultHttpProxyPreconnectTtl = 10;
+    static constexpr int maxHttpProxyPreconnectTtl = 120;
+    static constexpr int maxHttpProxyRangeSplitCount = 16;
+    static constexpr int defaultHttpProxyRangeSplitThreshold = 16;
+    static constexpr int maxHttpProxyRangeSplitThreshold = 4096;
+    static constexpr int maxHttpProxyCacheSize = 65536;
+    static constexpr int defaultHttpProxyListenBacklog = 1024;
+    static constexpr int maxHttpProxyListenBacklog = 65535;
 
 signals:
     void themeChanged();
@@ -88,6 +184,18 @@ signals:
     void closeToTrayChanged();
     void allowLocalLanChanged();
     void selectedNetworkInterfaceChanged();
+    void httpProxyWorkersChanged();
+    void httpProxyOptimisticConnectChanged();
+    void httpProxyTimeoutsChanged();
+    void httpProxyUpstreamsChanged();
+    void httpProxyRoutingRulesChanged();
+    void httpProxyBlocklistFilesChanged();
+    void httpProxyLimitsChanged();
+    void httpProxyGatewayChanged();
+    void httpProxyPreconnectChanged();
+    void httpProxyRangeSplitChanged();
+    void httpProxyCacheChanged();
+    void httpProxyRelayEngineChanged();
 
 private:
     QSettings *settings() const;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * SOCKS5 (RFC 1928) wire constants and message builders shared by the HTTP
+ * bridge (which also serves SOCKS5 clients) and its upstream connection
+ * pool. Only the no-auth method and the CONNECT command are used.
+ */
+
+// SOCKS5 constants
+static constexpr quint8 SOCKS5_VERSION = 0x05;
+static constexpr quint8 SOCKS5_AUTH_NONE = 0x00;
+static constexpr quint8 SOCKS5_AUTH_NO_ACCEPTABLE = 0xFF;
+static constexpr quint8 SOCKS5_CMD_CONNECT = 0x01;
+static constexpr quint8 SOCKS5_ATYP_DOMAIN = 0x03;
+static constexpr quint8 SOCKS5_ATYP_IPV4 = 0x01;
+static constexpr quint8 SOCKS5_ATYP_IPV6 = 0x04;
+static constexpr quint8 SOCKS5_REPLY_SUCCEEDED = 0x00;
+static constexpr quint8 SOCKS5_REPLY_GENERAL_FAILURE = 0x01;
+static constexpr quint8 SOCKS5_REPLY_NOT_ALLOWED = 0x02;
+static constexpr quint8 SOCKS5_REPLY_CMD_NOT_SUPPORTED = 0x07;
+static constexpr quint8 SOCKS5_REPLY_ATYP_NOT_SUPPORTED = 0x08;
+
+// SOCKS5 greeting: version, num methods, methods
+inline QByteArray socks5Greeting()
+{
+    QByteArray greeting;
+    greeting.append(static_cast<char>(SOCKS5_VERSION));
+    greeting.append(static_cast<char>(1)); // 1 auth method
+    greeting.append(static_cast<char>(SOCKS5_AUTH_NONE)); // No auth
+    return greeting;
+}
+
+// SOCKS5 CONNECT request using the domain name address type
+inline QByteArray socks5ConnectRequest(const QString &host, quint16 port)
+{
+    QByteArray connectReq;
+    connectReq.append(static_cast<char>(SOCKS5_VERSION));
+    connectReq.append(static_cast<char>(SOCKS5_CMD_CONNECT));
+    connectReq.append(static_cast<char>(0x00)); // Reserved
+
+    QByteArray hostBytes = host.toUtf8();
+    connectReq.append(static_cast<char>(SOCKS5_ATYP_DOMAIN));
+    connectReq.append(static_cast<char>(hostBytes.size()));
+    connectReq.append(hostBytes);
+
+    // Port in network byte order
+    connectReq.append(static_cast<char>((port >> 8) & 0xFF));
+    connectReq.append(static_cast<char>(port & 0xFF));
+    return connectReq;
+}
+
+// SOCKS5 reply to a client's request; the bound address is left unspecified
+inline QByteArray socks5Reply(quint8 code)
+{
+    QByteArray reply;
+    reply.append(static_cast<char>(SOCKS5_VERSION));
+    reply.append(static_cast<char>(code));
+    reply.append(static_cast<char>(0x00)); // Reserved
+    reply.append(static_cast<char>(SOCKS5_ATYP_IPV4));
+    reply.append(6, '\0'); // 0.0.0.0:0
+    return reply;
+}
+
+// Length of the complete CONNECT reply (VER REP RSV ATYP ADDR PORT) at the
+// front of @p data: 0 while incomplete, -1 for an unknown address type
+inline int socks5ReplyLength(const char *data, qsizetype size)
+{
+    if (size < 4)
+        return 0;
+    int addrLen = 0;
+    switch (static_cast<quint8>(data[3])) {
+    case SOCKS5_ATYP_IPV4:
+        addrLen = 4;
+        break;
+    case SOCKS5_ATYP_IPV6:
+        addrLen = 16;
+        break;
+    case SOCKS5_ATYP_DOMAIN:
+        if (size < 5)
+            return 0;
+        addrLen = 1 + static_cast<quint8>(data[4]);
+        break;
+    default:
+        return -1;
+    }
+    const int total = 4 + addrLen + 2;
+    return size >= total ? total : 0;
+}
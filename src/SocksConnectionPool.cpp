@@ -0,0 +1,175 @@
+#include "SocksConnectionPool.h"
+#include "Socks5.h"
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtMath>
+
+static constexpr int kAdaptIntervalMs = 1000;
+static constexpr int kMaxIdleMs = 20000;        // paqet may drop connections idling before CONNECT
+static constexpr int kMaxBackoffMs = 10000;
+static constexpr double kEwmaWeight = 0.3;
+
+SocksConnectionPool::SocksConnectionPool(QObject *parent) : QObject(parent) {
+    m_clock.start();
+    m_adaptTimer = new QTimer(this);
+    m_adaptTimer->setInterval(kAdaptIntervalMs);
+    connect(m_adaptTimer, &QTimer::timeout, this, &SocksConnectionPool::adapt);
+}
+
+SocksConnectionPool::~SocksConnectionPool() {
+    flush();
+}
+
+void SocksConnectionPool::setUpstream(const QString &host, quint16 port) {
+    if (m_host == host && m_port == port) return;
+    flush();
+    m_host = host;
+    m_port = port;
+    scheduleRefill();
+}
+
+void SocksConnectionPool::setLimits(int minSize, int maxSize) {
+    m_maxSize = qMax(0, maxSize);
+    m_minSize = qBound(0, minSize, m_maxSize);
+    m_target = qBound(m_minSize, m_target, m_maxSize);
+    if (m_maxSize > 0)
+        m_adaptTimer->start();
+    else
+        m_adaptTimer->stop();
+    scheduleRefill();
+}
+
+QTcpSocket *SocksConnectionPool::take() {
+    ++m_takesInWindow;
+    const qint64 now = m_clock.elapsed();
+    // Newest first: the oldest entries are the ones closest to being dropped upstream
+    while (!m_ready.isEmpty()) {
+        const Idle idle = m_ready.takeLast();
+        QTcpSocket *socket = idle.socket;
+        if (socket->state() != QAbstractSocket::ConnectedState || socket->bytesAvailable() > 0
+            || now - idle.readyAt > kMaxIdleMs) {
+            drop(socket);
+            continue;
+        }
+        socket->disconnect(this);
+        socket->setParent(nullptr);
+        ++m_hits;
+        scheduleRefill();
+        return socket;
+    }
+    ++m_misses;
+    // Grow right away instead of waiting for the next adapt() tick
+    if (m_target < m_maxSize)
+        ++m_target;
+    scheduleRefill();
+    return nullptr;
+}
+
+void SocksConnectionPool::flush() {
+    const QList<Idle> ready = m_ready;
+    const QList<QTcpSocket *> pending = m_pending;
+    m_ready.clear();
+    m_pending.clear();
+    for (const Idle &idle : ready)
+        drop(idle.socket);
+    for (QTcpSocket *socket : pending)
+        drop(socket);
+    m_failures = 0;
+}
+
+void SocksConnectionPool::scheduleRefill(int delayMs) {
+    if (m_refillScheduled || m_maxSize <= 0 || m_host.isEmpty() || m_port == 0)
+        return;
+    m_refillScheduled = true;
+    QTimer::singleShot(delayMs, this, [this]() {
+        m_refillScheduled = false;
+        refill();
+    });
+}
+
+void SocksConnectionPool::refill() {
+    if (m_host.isEmpty() || m_port == 0)
+        return;
+    while (m_ready.size() + m_pending.size() < m_target)
+        openOne();
+}
+
+void SocksConnectionPool::openOne() {
+    auto *socket = new QTcpSocket(this);
+    m_pending.append(socket);
+    const qint64 startedAt = m_clock.elapsed();
+
+    connect(socket, &QTcpSocket::connected, this, [socket]() {
+        socket->write(socks5Greeting());
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket, startedAt]() {
+        if (socket->bytesAvailable() < 2)
+            return;
+        const QByteArray reply = socket->read(2);
+        const bool ok = static_cast<quint8>(reply[0]) == SOCKS5_VERSION
+            && static_cast<quint8>(reply[1]) == SOCKS5_AUTH_NONE;
+        if (ok)
+            m_handshakeMsEwma = kEwmaWeight * (m_clock.elapsed() - startedAt) + (1.0 - kEwmaWeight) * m_handshakeMsEwma;
+        onHandshakeDone(socket, ok);
+    });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket]() {
+        onHandshakeDone(socket, false);
+    });
+    socket->connectToHost(m_host, m_port);
+}
+
+void SocksConnectionPool::onHandshakeDone(QTcpSocket *socket, bool ok) {
+    if (!m_pending.removeOne(socket))
+        return;
+    if (!ok) {
+        drop(socket);
+        // Upstream is down or refusing: retry with exponential backoff
+        ++m_failures;
+        scheduleRefill(qMin(kMaxBackoffMs, 250 << qMin(m_failures, 6)));
+        return;
+    }
+    m_failures = 0;
+    // A pooled socket that errors or closes is simply discarded
+    socket->disconnect(this);
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { drop(socket); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket]() { drop(socket); });
+    m_ready.append({socket, m_clock.elapsed()});
+}
+
+void SocksConnectionPool::drop(QTcpSocket *socket) {
+    for (int i = 0; i < m_ready.size(); ++i) {
+        if (m_ready.at(i).socket == socket) {
+            m_ready.removeAt(i);
+            break;
+        }
+    }
+    m_pending.removeOne(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void SocksConnectionPool::adapt() {
+    const double rate = m_takesInWindow * 1000.0 / kAdaptIntervalMs;
+    m_takesInWindow = 0;
+    m_rateEwma = kEwmaWeight * rate + (1.0 - kEwmaWeight) * m_rateEwma;
+
+    // Enough warm sockets to cover the requests expected while one refill
+    // is in flight, with 2x headroom for bursts
+    const double handshakeSec = qMax(m_handshakeMsEwma, 1.0) / 1000.0;
+    const int wanted = qCeil(m_rateEwma * handshakeSec * 2.0) + (m_rateEwma > 0.05 ? 1 : 0);
+    m_target = qBound(m_minSize, wanted, m_maxSize);
+
+    // Expire stale idle sockets and trim down to the target
+    const qint64 now = m_clock.elapsed();
+    const QList<Idle> ready = m_ready;
+    for (const Idle &idle : ready) {
+        if (now - idle.readyAt > kMaxIdleMs)
+            drop(idle.socket);
+    }
+    while (m_ready.size() > m_target)
+        drop(m_ready.first().socket);
+
+    if (m_failures == 0)
+        scheduleRefill();
+}
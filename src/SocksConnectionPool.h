@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QElapsedTimer>
+
+class QTcpSocket;
+class QTimer;
+
+/**
+ * @brief Warm pool of SOCKS5 connections with the greeting already done
+ *
+ * Keeps sockets connected to the upstream SOCKS listener whose method
+ * negotiation has completed, so a new request only has to send its CONNECT.
+ * The target size follows the recent take() rate times the measured
+ * handshake time, clamped to [minSize, maxSize]; refills run asynchronously
+ * and back off while the upstream refuses connections.
+ *
+ * Lives in (and must be used from) one worker thread.
+ */
+class SocksConnectionPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SocksConnectionPool(QObject *parent = nullptr);
+    ~SocksConnectionPool() override;
+
+    void setUpstream(const QString &host, quint16 port);
+    void setLimits(int minSize, int maxSize);
+
+    /**
+     * @brief A connected, greeted socket, or nullptr when none is ready.
+     * Ownership passes to the caller; the pool's signal connections are gone.
+     */
+    QTcpSocket *take();
+
+    /**
+     * @brief Close every pooled and in-flight socket (e.g. paqet restarted)
+     */
+    void flush();
+
+    int idleCount() const { return m_ready.size(); }
+    int targetSize() const { return m_target; }
+    qint64 hits() const { return m_hits; }
+    qint64 misses() const { return m_misses; }
+
+private:
+    struct Idle {
+        QTcpSocket *socket;
+        qint64 readyAt;
+    };
+
+    void scheduleRefill(int delayMs = 0);
+    void refill();
+    void openOne();
+    void onHandshakeDone(QTcpSocket *socket, bool ok);
+    void drop(QTcpSocket *socket);
+    void adapt();
+
+    QString m_host;
+    quint16 m_port = 0;
+    int m_minSize = 0;
+    int m_maxSize = 0;
+    int m_target = 0;
+
+    QList<Idle> m_ready;
+    QList<QTcpSocket *> m_pending;
+    QTimer *m_adaptTimer = nullptr;
+    QElapsedTimer m_clock;
+    bool m_refillScheduled = false;
+    int m_failures = 0;              // consecutive failed handshakes
+
+    int m_takesInWindow = 0;
+    double m_rateEwma = 0.0;         // takes per second
+    double m_handshakeMsEwma = 0.0;  // connect + greeting round-trip
+    qint64 m_hits = 0;
+    qint64 m_misses = 0;
+};
@@ -0,0 +1,115 @@
+#include "SpeedMonitorModel.h"
+#include <QDateTime>
+#include <QTimer>
+
+SpeedMonitorModel::SpeedMonitorModel(QObject *parent) : QAbstractListModel(parent) {
+    m_timer = new QTimer(this);
+    m_timer->setInterval(kSampleIntervalMs);
+    connect(m_timer, &QTimer::timeout, this, &SpeedMonitorModel::sample);
+    m_clock.start();
+}
+
+int SpeedMonitorModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : m_size;
+}
+
+QVariant SpeedMonitorModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_size)
+        return QVariant();
+    const Sample &s = sampleAt(index.row());
+    switch (role) {
+    case UpRateRole: return s.up;
+    case DownRateRole: return s.down;
+    case TimestampRole: return s.timestamp;
+    default: return QVariant();
+    }
+}
+
+QHash<int, QByteArray> SpeedMonitorModel::roleNames() const {
+    return {
+        { UpRateRole, "upRate" },
+        { DownRateRole, "downRate" },
+        { TimestampRole, "timestamp" }
+    };
+}
+
+bool SpeedMonitorModel::isActive() const {
+    return m_timer->isActive();
+}
+
+void SpeedMonitorModel::setActive(bool active) {
+    if (active == isActive())
+        return;
+    if (active) {
+        rebase();
+        m_timer->start();
+    } else {
+        m_timer->stop();
+        m_upRate = 0;
+        m_downRate = 0;
+        emit sampled();
+    }
+    emit activeChanged();
+}
+
+void SpeedMonitorModel::reset() {
+    beginResetModel();
+    m_head = 0;
+    m_size = 0;
+    endResetModel();
+    m_upRate = m_downRate = 0;
+    m_peakUp = m_peakDown = 0;
+    rebase();
+    m_baseUp = m_lastUp;
+    m_baseDown = m_lastDown;
+    emit countChanged();
+    emit sampled();
+}
+
+void SpeedMonitorModel::rebase() {
+    if (m_source) {
+        const auto totals = m_source();
+        m_lastUp = totals.first;
+        m_lastDown = totals.second;
+    }
+    m_lastAt = m_clock.elapsed();
+}
+
+void SpeedMonitorModel::sample() {
+    if (!m_source)
+        return;
+    const auto totals = m_source();
+    const qint64 now = m_clock.elapsed();
+    const qint64 elapsed = qMax<qint64>(1, now - m_lastAt);
+    // Counters never go backwards; guard anyway against a swapped source
+    const quint64 up = totals.first >= m_lastUp ? totals.first - m_lastUp : 0;
+    const quint64 down = totals.second >= m_lastDown ? totals.second - m_lastDown : 0;
+    m_lastUp = totals.first;
+    m_lastDown = totals.second;
+    m_lastAt = now;
+
+    m_upRate = static_cast<qint64>(up * 1000 / static_cast<quint64>(elapsed));
+    m_downRate = static_cast<qint64>(down * 1000 / static_cast<quint64>(elapsed));
+    m_peakUp = qMax(m_peakUp, m_upRate);
+    m_peakDown = qMax(m_peakDown, m_downRate);
+
+    const bool grew = m_size < kHistorySize;
+    if (!grew) {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        --m_size;
+        endRemoveRows();
+    }
+    beginInsertRows(QModelIndex(), m_size, m_size);
+    m_ring[m_head] = { m_upRate, m_downRate, QDateTime::currentMSecsSinceEpoch() };
+    m_head = (m_head + 1) % kHistorySize;
+    ++m_size;
+    endInsertRows();
+
+    if (grew)
+        emit countChanged();
+    emit sampled();
+}
+
+const SpeedMonitorModel::Sample &SpeedMonitorModel::sampleAt(int row) const {
+    return m_ring[(m_head - m_size + row + kHistorySize) % kHistorySize];
+}
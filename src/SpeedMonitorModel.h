@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QPair>
+#include <functional>
+
+class QTimer;
+
+/**
+ * @brief Proxy throughput for QML: current and peak rates plus a rolling
+ * history (one row per sample, oldest first) for a sparkline
+ *
+ * Samples cumulative byte counts from a source function once per second
+ * into a fixed ring buffer; rates are in bytes per second.
+ */
+class SpeedMonitorModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(qint64 upRate READ upRate NOTIFY sampled)
+    Q_PROPERTY(qint64 downRate READ downRate NOTIFY sampled)
+    Q_PROPERTY(qint64 peakUpRate READ peakUpRate NOTIFY sampled)
+    Q_PROPERTY(qint64 peakDownRate READ peakDownRate NOTIFY sampled)
+    Q_PROPERTY(qint64 totalUp READ totalUp NOTIFY sampled)
+    Q_PROPERTY(qint64 totalDown READ totalDown NOTIFY sampled)
+public:
+    enum Roles {
+        UpRateRole = Qt::UserRole,
+        DownRateRole,
+        TimestampRole
+    };
+
+    /** Cumulative (up, down) byte counts; must be callable from this thread */
+    using Source = std::function<QPair<quint64, quint64>()>;
+
+    static constexpr int kSampleIntervalMs = 1000;
+    static constexpr int kHistorySize = 120;   // two minutes
+
+    explicit SpeedMonitorModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    void setSource(Source source) { m_source = std::move(source); }
+
+    int count() const { return m_size; }
+    bool isActive() const;
+    void setActive(bool active);
+
+    qint64 upRate() const { return m_upRate; }
+    qint64 downRate() const { return m_downRate; }
+    qint64 peakUpRate() const { return m_peakUp; }
+    qint64 peakDownRate() const { return m_peakDown; }
+    qint64 totalUp() const { return static_cast<qint64>(m_lastUp - m_baseUp); }
+    qint64 totalDown() const { return static_cast<qint64>(m_lastDown - m_baseDown); }
+
+    /** Clear history, peaks and totals */
+    Q_INVOKABLE void reset();
+
+signals:
+    void countChanged();
+    void activeChanged();
+    void sampled();
+
+private:
+    struct Sample {
+        qint64 up = 0;
+        qint64 down = 0;
+        qint64 timestamp = 0;   // ms since epoch
+    };
+
+    void sample();
+    void rebase();
+    const Sample &sampleAt(int row) const;
+
+    Source m_source;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_lastAt = 0;
+    quint64 m_lastUp = 0;
+    quint64 m_lastDown = 0;
+    quint64 m_baseUp = 0;
+    quint64 m_baseDown = 0;
+    qint64 m_upRate = 0;
+    qint64 m_downRate = 0;
+    qint64 m_peakUp = 0;
+    qint64 m_peakDown = 0;
+
+    Sample m_ring[kHistorySize];
+    int m_head = 0;   // next slot to write
+    int m_size = 0;
+};
@@ -0,0 +1,200 @@
+#include "SpliceRelay.h"
+#include <QObject>
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Bounded work per notifier activation so one fat tunnel cannot monopolize
+// the worker's event loop; level-triggered notifiers bring us back.
+static constexpr int kMaxRoundsPerWakeup = 16;
+static constexpr int kPipeCapacity = 256 * 1024;
+
+struct SpliceRelay::Direction {
+    int src = -1;
+    int dst = -1;
+    int pipe[2] = {-1, -1};
+    qint64 inPipe = 0;
+    qint64 bytes = 0;
+    bool eof = false;
+    bool done = false;
+    QSocketNotifier *readNotifier = nullptr;
+    QSocketNotifier *writeNotifier = nullptr;
+};
+
+#ifdef Q_OS_LINUX
+
+bool SpliceRelay::isSupported() { return true; }
+
+std::unique_ptr<SpliceRelay> SpliceRelay::create(qintptr clientFd, qintptr socksFd, QObject *parent)
+{
+    const int client = static_cast<int>(clientFd);
+    const int socks = static_cast<int>(socksFd);
+    int up[2] = {-1, -1};
+    int down[2] = {-1, -1};
+    if (client < 0 || socks < 0
+        || ::pipe2(up, O_NONBLOCK | O_CLOEXEC) < 0
+        || ::pipe2(down, O_NONBLOCK | O_CLOEXEC) < 0) {
+        for (int fd : {client, socks, up[0], up[1], down[0], down[1]}) {
+            if (fd >= 0) ::close(fd);
+        }
+        return nullptr;
+    }
+    // Larger pipes mean fewer wakeups per megabyte; failure just keeps the default
+    for (int fd : {up[1], down[1]})
+        ::fcntl(fd, F_SETPIPE_SZ, kPipeCapacity);
+
+    std::unique_ptr<SpliceRelay> relay(new SpliceRelay());
+    relay->m_up = std::make_unique<Direction>();
+    relay->m_down = std::make_unique<Direction>();
+
+    auto setup = [&](Direction &d, int src, int dst, const int (&p)[2]) {
+        d.src = src;
+        d.dst = dst;
+        d.pipe[0] = p[0];
+        d.pipe[1] = p[1];
+        d.readNotifier = new QSocketNotifier(src, QSocketNotifier::Read, parent);
+        d.writeNotifier = new QSocketNotifier(dst, QSocketNotifier::Write, parent);
+        d.readNotifier->setEnabled(false);
+        d.writeNotifier->setEnabled(false);
+        SpliceRelay *self = relay.get();
+        Direction *dir = &d;
+        QObject::connect(d.readNotifier, &QSocketNotifier::activated, parent, [self, dir]() { self->pump(*dir); });
+        QObject::connect(d.writeNotifier, &QSocketNotifier::activated, parent, [self, dir]() { self->pump(*dir); });
+    };
+    setup(*relay->m_up, client, socks, up);
+    setup(*relay->m_down, socks, client, down);
+    return relay;
+}
+
+SpliceRelay::~SpliceRelay()
+{
+    // Each descriptor is the src of one direction; close it only once
+    for (Direction *d : {m_up.get(), m_down.get()}) {
+        if (!d) continue;
+        delete d->readNotifier;
+        delete d->writeNotifier;
+        for (int fd : {d->pipe[0], d->pipe[1], d->src}) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+}
+
+void SpliceRelay::start()
+{
+    m_up->readNotifier->setEnabled(true);
+    m_down->readNotifier->setEnabled(true);
+}
+
+void SpliceRelay::resume(bool up)
+{
+    pump(up ? *m_up : *m_down);
+}
+
+void SpliceRelay::pump(Direction &d)
+{
+    if (m_done || d.done)
+        return;
+
+    for (int round = 0; round < kMaxRoundsPerWakeup; ++round) {
+        // Drain the pipe into the sink before pulling more from the source
+        while (d.inPipe > 0) {
+            const ssize_t n = ::splice(d.pipe[0], nullptr, d.dst, nullptr, static_cast<size_t>(d.inPipe),
+                                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                d.inPipe -= n;
+                d.bytes += n;
+                if (m_progress)
+                    m_progress(&d == m_up.get(), n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                // Sink is full: wait for it, stop reading the source meanwhile
+                d.readNotifier->setEnabled(false);
+                d.writeNotifier->setEnabled(true);
+                return;
+            } else {
+                fail();
+                return;
+            }
+        }
+        d.writeNotifier->setEnabled(false);
+
+        if (d.eof) {
+            ::shutdown(d.dst, SHUT_WR);
+            d.done = true;
+            d.readNotifier->setEnabled(false);
+            checkFinished();
+            return;
+        }
+
+        qint64 want = kPipeCapacity;
+        if (m_grant) {
+            want = m_grant(&d == m_up.get(), want);
+            if (want <= 0) {
+                d.readNotifier->setEnabled(false);
+                return;
+            }
+        }
+        const ssize_t n = ::splice(d.src, nullptr, d.pipe[1], nullptr, static_cast<size_t>(want),
+                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            d.inPipe += n;
+        } else if (n == 0) {
+            d.eof = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN) {
+            d.readNotifier->setEnabled(true);
+            return;
+        } else {
+            fail();
+            return;
+        }
+    }
+    d.readNotifier->setEnabled(true);
+}
+
+#else
+
+bool SpliceRelay::isSupported() { return false; }
+
+std::unique_ptr<SpliceRelay> SpliceRelay::create(qintptr, qintptr, QObject *)
+{
+    return nullptr;
+}
+
+SpliceRelay::~SpliceRelay() = default;
+void SpliceRelay::start() {}
+void SpliceRelay::resume(bool) {}
+void SpliceRelay::pump(Direction &) {}
+
+#endif
+
+void SpliceRelay::fail()
+{
+    if (m_done)
+        return;
+    for (Direction *d : {m_up.get(), m_down.get()}) {
+        d->done = true;
+        d->readNotifier->setEnabled(false);
+        d->writeNotifier->setEnabled(false);
+    }
+    checkFinished();
+}
+
+void SpliceRelay::checkFinished()
+{
+    if (m_done || !m_up->done || !m_down->done)
+        return;
+    m_done = true;
+    if (m_finished)
+        m_finished();
+}
+
+qint64 SpliceRelay::bytesUp() const { return m_up ? m_up->bytes : 0; }
+qint64 SpliceRelay::bytesDown() const { return m_down ? m_down->bytes : 0; }
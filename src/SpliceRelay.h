@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QtGlobal>
+#include <functional>
+#include <memory>
+
+class QObject;
+class QSocketNotifier;
+
+/**
+ * Zero-copy relay for an established tunnel (Linux only).
+ *
+ * Moves bytes between two connected, non-blocking TCP descriptors with
+ * splice() through one pipe per direction, so payload never enters user
+ * space. Each direction half-closes its sink (shutdown SHUT_WR) on EOF; the
+ * finished callback runs once both directions are done or on any error.
+ *
+ * The relay owns the descriptors it is given (callers pass dup()s) and the
+ * pipes. Notifiers are parented to the QObject passed to create(), so all
+ * activity happens on that object's thread.
+ */
+class SpliceRelay
+{
+public:
+    using Callback = std::function<void()>;
+    using ProgressCallback = std::function<void(bool up, qint64 bytes)>;
+    using GrantCallback = std::function<qint64(bool up, qint64 want)>;
+
+    ~SpliceRelay();
+
+    /** True when the platform has splice(). */
+    static bool isSupported();
+
+    /**
+     * Takes ownership of both descriptors. Returns nullptr (after closing
+     * them) when splice is unavailable or the pipes cannot be created.
+     */
+    static std::unique_ptr<SpliceRelay> create(qintptr clientFd, qintptr socksFd, QObject *parent);
+
+    void setFinishedCallback(Callback callback) { m_finished = std::move(callback); }
+    /** Called with the bytes delivered by every successful splice into a sink */
+    void setProgressCallback(ProgressCallback callback) { m_progress = std::move(callback); }
+    /**
+     * Asked before every read from a source: how many bytes (at most want)
+     * may be pulled now. 0 parks that direction until resume().
+     */
+    void setGrantCallback(GrantCallback callback) { m_grant = std::move(callback); }
+    void start();
+    /** Pump a direction parked by the grant callback */
+    void resume(bool up);
+
+    qint64 bytesUp() const;     // client -> SOCKS
+    qint64 bytesDown() const;   // SOCKS -> client
+
+private:
+    struct Direction;
+
+    SpliceRelay() = default;
+    void pump(Direction &d);
+    void fail();
+    void checkFinished();
+
+    std::unique_ptr<Direction> m_up;
+    std::unique_ptr<Direction> m_down;
+    Callback m_finished;
+    ProgressCallback m_progress;
+    GrantCallback m_grant;
+    bool m_done = false;
+};
@@ -0,0 +1,78 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(int slotCount, int tickMs)
+    : m_slots(static_cast<size_t>(qMax(1, slotCount)))
+    , m_tickMs(qMax(1, tickMs))
+{
+    for (Entry &head : m_slots)
+        head.m_prev = head.m_next = &head;
+}
+
+TimerWheel::~TimerWheel() {
+    // Leave no dangling links in entries that outlive the wheel
+    for (Entry &head : m_slots) {
+        while (head.m_next != &head)
+            unlink(head.m_next);
+    }
+}
+
+void TimerWheel::unlink(Entry *entry) {
+    entry->m_prev->m_next = entry->m_next;
+    entry->m_next->m_prev = entry->m_prev;
+    entry->m_prev = entry->m_next = nullptr;
+}
+
+void TimerWheel::linkAfter(Entry *head, Entry *entry) {
+    entry->m_prev = head;
+    entry->m_next = head->m_next;
+    head->m_next->m_prev = entry;
+    head->m_next = entry;
+}
+
+void TimerWheel::schedule(Entry *entry, qint64 delayMs) {
+    cancel(entry);
+    const int slots = static_cast<int>(m_slots.size());
+    const quint64 ticks = static_cast<quint64>(qMax<qint64>(1, (delayMs + m_tickMs - 1) / m_tickMs));
+    entry->m_rounds = (ticks - 1) / static_cast<quint64>(slots);
+    const int slot = static_cast<int>((static_cast<quint64>(m_cursor) + ticks) % static_cast<quint64>(slots));
+    linkAfter(&m_slots[static_cast<size_t>(slot)], entry);
+    ++m_size;
+}
+
+void TimerWheel::cancel(Entry *entry) {
+    if (!entry->isScheduled())
+        return;
+    unlink(entry);
+    --m_size;
+}
+
+void TimerWheel::tick() {
+    ++m_now;
+    m_cursor = (m_cursor + 1) % static_cast<int>(m_slots.size());
+    Entry &head = m_slots[static_cast<size_t>(m_cursor)];
+
+    // Work on a detached list: callbacks may cancel, reschedule or delete
+    // any entry, including ones still waiting here
+    Entry due;
+    due.m_prev = due.m_next = &due;
+    if (head.m_next != &head) {
+        due.m_next = head.m_next;
+        due.m_prev = head.m_prev;
+        due.m_next->m_prev = &due;
+        due.m_prev->m_next = &due;
+        head.m_prev = head.m_next = &head;
+    }
+
+    while (due.m_next != &due) {
+        Entry *entry = due.m_next;
+        unlink(entry);
+        if (entry->m_rounds > 0) {
+            --entry->m_rounds;
+            linkAfter(&head, entry);
+            continue;
+        }
+        --m_size;
+        if (entry->onExpired)
+            entry->onExpired();
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QtGlobal>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Hashed timer wheel for many coarse timeouts on one thread
+ *
+ * Entries are intrusive list nodes embedded in the timed object, so
+ * scheduling, rescheduling and cancelling are O(1) and allocation-free;
+ * the owner drives the wheel by calling tick() every tickMs(). Delays
+ * longer than one revolution are handled with a per-entry round count.
+ *
+ * Not thread-safe: one wheel per worker thread.
+ */
+class TimerWheel
+{
+public:
+    struct Entry {
+        std::function<void()> onExpired;   // may reschedule or destroy the owner
+
+        bool isScheduled() const { return m_next != nullptr; }
+
+    private:
+        friend class TimerWheel;
+        Entry *m_prev = nullptr;
+        Entry *m_next = nullptr;
+        quint64 m_rounds = 0;
+    };
+
+    TimerWheel(int slotCount, int tickMs);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    int tickMs() const { return m_tickMs; }
+
+    /** Ticks elapsed since construction, usable as a coarse clock */
+    quint64 now() const { return m_now; }
+
+    /** (Re)arm @p entry to expire after at least @p delayMs */
+    void schedule(Entry *entry, qint64 delayMs);
+    void cancel(Entry *entry);
+
+    /** Advance one slot and run the callbacks of the entries due there */
+    void tick();
+
+    int size() const { return m_size; }
+
+private:
+    static void unlink(Entry *entry);
+    static void linkAfter(Entry *head, Entry *entry);
+
+    std::vector<Entry> m_slots;   // sentinel heads of circular lists
+    int m_tickMs;
+    int m_cursor = 0;
+    quint64 m_now = 0;
+    int m_size = 0;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Byte counters written by one thread and read from any other
+ *
+ * Every proxy worker owns one instance, so updates are a relaxed load and
+ * store rather than a locked read-modify-write, and the cache line (the
+ * struct is padded to one) is never shared with another writer.
+ */
+struct alignas(64) TrafficCounters {
+    std::atomic<quint64> up{0};     // client -> upstream
+    std::atomic<quint64> down{0};   // upstream -> client
+
+    void addUp(qint64 bytes) { add(up, bytes); }
+    void addDown(qint64 bytes) { add(down, bytes); }
+
+private:
+    static void add(std::atomic<quint64> &counter, qint64 bytes) {
+        counter.store(counter.load(std::memory_order_relaxed) + static_cast<quint64>(bytes),
+                      std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,139 @@
+#include "UpstreamBalancer.h"
+#include <QtGlobal>
+#include <limits>
+
+static constexpr int kEjectAfterFailures = 3;       // consecutive failures
+static constexpr qint64 kProbationMs = 10000;       // first ejection
+static constexpr int kMaxBackoffLevel = 5;          // probation caps at 10 s << 5 = 320 s
+static constexpr qint64 kTrialTimeoutMs = 30000;    // a trial that never reported
+static constexpr qint64 kEwmaWeightPct = 30;
+
+UpstreamBalancer::UpstreamBalancer(const QList<Endpoint> &endpoints, Policy policy)
+    : m_endpoints(endpoints)
+    , m_policy(policy)
+    , m_state(std::make_unique<State[]>(endpoints.size()))
+{
+    m_clock.start();
+}
+
+int UpstreamBalancer::pick(quint64 excluded) {
+    const qint64 now = m_clock.elapsed();
+    const int n = m_endpoints.size();
+    // Rotate the starting point so equal scores spread over the endpoints
+    const int first = static_cast<int>(m_next.fetch_add(1, std::memory_order_relaxed) % quint32(qMax(1, n)));
+    int best = -1;
+    qint64 bestScore = std::numeric_limits<qint64>::max();
+    int fallback = -1;
+    qint64 fallbackUntil = std::numeric_limits<qint64>::max();
+
+    for (int k = 0; k < n; ++k) {
+        const int i = (first + k) % n;
+        if (i < 64 && (excluded & (quint64(1) << i)))
+            continue;
+        State &s = m_state[i];
+        const qint64 until = s.ejectedUntil.load(std::memory_order_relaxed);
+        if (until != 0) {
+            if (until < fallbackUntil) {
+                fallbackUntil = until;
+                fallback = i;
+            }
+            if (until > now)
+                continue;
+            // Probation over: exactly one trial connection at a time
+            qint64 started = s.trialStarted.load(std::memory_order_relaxed);
+            if (started != 0 && now - started < kTrialTimeoutMs)
+                continue;
+            if (s.trialStarted.compare_exchange_strong(started, qMax<qint64>(now, 1)))
+                return i;
+            continue;
+        }
+
+        const qint64 active = s.active.load(std::memory_order_relaxed);
+        const qint64 replyUs = qMax<qint64>(0, s.replyUs.load(std::memory_order_relaxed));
+        qint64 score;
+        if (m_policy == Policy::LeastConnections) {
+            // Reply time only breaks ties (it is far below 2^40 us)
+            score = (active << 40) + replyUs;
+        } else {
+            // Unmeasured endpoints score 0 and get probed first
+            score = replyUs * (active + 1);
+        }
+        if (score < bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    // Everything left is ejected: the least recently failing one is still
+    // better than refusing the client outright
+    return best >= 0 ? best : fallback;
+}
+
+void UpstreamBalancer::acquire(int index) {
+    m_state[index].active.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UpstreamBalancer::release(int index) {
+    m_state[index].active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void UpstreamBalancer::reportSuccess(int index, qint64 replyMs) {
+    State &s = m_state[index];
+    s.successes.fetch_add(1, std::memory_order_relaxed);
+    s.consecutiveFailures.store(0, std::memory_order_relaxed);
+    if (s.ejectedUntil.load(std::memory_order_relaxed) != 0) {
+        s.ejectedUntil.store(0, std::memory_order_relaxed);
+        s.backoffLevel.store(0, std::memory_order_relaxed);
+        s.trialStarted.store(0, std::memory_order_relaxed);
+    }
+
+    const qint64 sample = qMax<qint64>(0, replyMs) * 1000;
+    qint64 old = s.replyUs.load(std::memory_order_relaxed);
+    qint64 next;
+    do {
+        next = old < 0 ? sample : old + (sample - old) * kEwmaWeightPct / 100;
+    } while (!s.replyUs.compare_exchange_weak(old, next, std::memory_order_relaxed));
+}
+
+bool UpstreamBalancer::reportFailure(int index) {
+    State &s = m_state[index];
+    s.failures.fetch_add(1, std::memory_order_relaxed);
+    const int failures = s.consecutiveFailures.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (s.ejectedUntil.load(std::memory_order_relaxed) != 0) {
+        // Failed its trial (or a last-resort pick while ejected): back off further
+        if (s.trialStarted.exchange(0, std::memory_order_relaxed) == 0)
+            return false;
+        eject(s, qMin(s.backoffLevel.load(std::memory_order_relaxed) + 1, kMaxBackoffLevel));
+        return true;
+    }
+    if (failures < kEjectAfterFailures)
+        return false;
+    eject(s, 0);
+    return true;
+}
+
+void UpstreamBalancer::eject(State &state, int level) {
+    state.backoffLevel.store(level, std::memory_order_relaxed);
+    state.ejectedUntil.store(qMax<qint64>(m_clock.elapsed() + (kProbationMs << level), 1),
+                             std::memory_order_relaxed);
+    state.ejections.fetch_add(1, std::memory_order_relaxed);
+}
+
+QList<UpstreamBalancer::Stats> UpstreamBalancer::stats() const {
+    QList<Stats> result;
+    result.reserve(m_endpoints.size());
+    for (int i = 0; i < m_endpoints.size(); ++i) {
+        const State &s = m_state[i];
+        Stats st;
+        st.endpoint = m_endpoints.at(i);
+        st.active = s.active.load(std::memory_order_relaxed);
+        const qint64 replyUs = s.replyUs.load(std::memory_order_relaxed);
+        st.replyMs = replyUs < 0 ? -1 : replyUs / 1000;
+        st.ejected = s.ejectedUntil.load(std::memory_order_relaxed) != 0;
+        st.successes = s.successes.load(std::memory_order_relaxed);
+        st.failures = s.failures.load(std::memory_order_relaxed);
+        st.ejections = s.ejections.load(std::memory_order_relaxed);
+        result.append(st);
+    }
+    return result;
+}
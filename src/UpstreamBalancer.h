@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief Picks the upstream SOCKS5 endpoint for each new connection
+ *
+ * Shared by all proxy workers; every per-endpoint figure is an atomic, so
+ * pick() and the report calls are safe from any thread without a lock.
+ *
+ * An endpoint that fails kEjectAfterFailures times in a row is ejected for
+ * a probation period. When it expires, a single trial connection is let
+ * through: success re-admits the endpoint, failure ejects it again for
+ * twice as long (capped).
+ */
+class UpstreamBalancer
+{
+public:
+    enum class Policy {
+        LeastConnections,   // fewest connections in flight
+        FastestReply        // lowest CONNECT reply-time EWMA, weighted by load
+    };
+
+    struct Endpoint {
+        QString host;
+        quint16 port = 0;
+    };
+
+    struct Stats {
+        Endpoint endpoint;
+        int active = 0;
+        qint64 replyMs = -1;        // EWMA, -1 until the first reply
+        bool ejected = false;       // ejected or on probation
+        qint64 successes = 0;
+        qint64 failures = 0;
+        qint64 ejections = 0;
+    };
+
+    UpstreamBalancer(const QList<Endpoint> &endpoints, Policy policy);
+
+    int size() const { return m_endpoints.size(); }
+    const Endpoint &endpoint(int index) const { return m_endpoints.at(index); }
+    Policy policy() const { return m_policy; }
+
+    /**
+     * @brief Best endpoint not in @p excluded (bit i = endpoint i). Ejected
+     * endpoints are only returned when nothing else is left.
+     * @return Endpoint index, or -1 when every endpoint is excluded
+     */
+    int pick(quint64 excluded = 0);
+
+    /** A connection starts / stops using @p index */
+    void acquire(int index);
+    void release(int index);
+
+    /** CONNECT succeeded after @p replyMs (connect + greeting included when not pooled) */
+    void reportSuccess(int index, qint64 replyMs);
+
+    /**
+     * @brief The endpoint failed a connection attempt
+     * @return true if this failure ejected it
+     */
+    bool reportFailure(int index);
+
+    QList<Stats> stats() const;
+
+private:
+    struct alignas(64) State {
+        std::atomic<int> active{0};
+        std::atomic<qint64> replyUs{-1};
+        std::atomic<int> consecutiveFailures{0};
+        std::atomic<qint64> ejectedUntil{0};   // m_clock ms, 0 = admitted
+        std::atomic<int> backoffLevel{0};
+        std::atomic<qint64> trialStarted{0};   // m_clock ms of the running trial, 0 = none
+        std::atomic<qint64> successes{0};
+        std::atomic<qint64> failures{0};
+        std::atomic<qint64> ejections{0};
+    };
+
+    void eject(State &state, int level);
+
+    QList<Endpoint> m_endpoints;
+    Policy m_policy;
+    std::unique_ptr<State[]> m_state;
+    std::atomic<quint32> m_next{0};
+    QElapsedTimer m_clock;
+};
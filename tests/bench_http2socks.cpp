@@ -0,0 +1,653 @@
+/**
+ * @file bench_http2socks.cpp
+ * @brief Throughput / latency benchmark for HttpToSocksProxy, self-contained
+ *
+ * Everything runs in this process on loopback:
+ *   - an origin HTTP server: GET /bytes/N answers N bytes, POST /sink
+ *     swallows the body, POST /echo sends it back;
+ *   - a SOCKS5 server stub that tunnels every CONNECT to the origin;
+ *   - the bridge (HttpToSocksProxy) with the stub as its upstream;
+ *   - a load generator keeping --concurrency requests in flight for
+ *     --duration seconds, one connection per request, either through the
+ *     bridge (CONNECT or plain GET, mixed by --connect-ratio) or straight
+ *     to the stub over SOCKS5 as the baseline.
+ *
+ * Reports MB/s (payload both ways), connections per second and p50/p99/
+ * p999 time to first response byte for both runs, and the bridge's
+ * overhead relative to the baseline. --json prints the same as JSON on
+ * stdout (the human summary then goes to stderr).
+ *
+ * Build with:
+ *   cd build
+ *   cmake .. -DBUILD_TESTS=ON
+ *   cmake --build . --target bench_http2socks
+ *
+ * Run:
+ *   ./bench_http2socks --concurrency 64 --size 1048576 --connect-ratio 0.5 --json
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include "../src/HttpToSocksProxy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+static constexpr qint64 kFillerSize = 64 * 1024;
+static constexpr qint64 kWriteAhead = 256 * 1024;    // queued per socket before waiting for bytesWritten
+static constexpr int kRequestTimeoutMs = 30000;
+static const QByteArray kOriginHost = QByteArrayLiteral("origin.test");
+
+static const QByteArray &filler() {
+    static const QByteArray bytes(kFillerSize, 'x');
+    return bytes;
+}
+
+/**
+ * @return Content-Length of an HTTP head, -1 if absent
+ */
+static qint64 contentLength(const QByteArray &head) {
+    const QByteArray lower = head.toLower();
+    const int at = lower.indexOf("\r\ncontent-length:");
+    if (at < 0)
+        return -1;
+    const int from = at + 17;
+    const int end = lower.indexOf("\r\n", from);
+    bool ok = false;
+    const qint64 length = lower.mid(from, end - from).trimmed().toLongLong(&ok);
+    return ok ? length : -1;
+}
+
+/**
+ * @brief Keep @p socket's write queue topped up from filler() until
+ * @p *left bytes were written
+ */
+static void writeFiller(QTcpSocket *socket, qint64 *left) {
+    while (*left > 0 && socket->bytesToWrite() < kWriteAhead) {
+        const qint64 n = qMin(*left, kFillerSize);
+        socket->write(filler().constData(), n);
+        *left -= n;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Origin
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Minimal HTTP/1.1 origin; one request per connection
+ */
+class OriginServer : public QTcpServer
+{
+public:
+    explicit OriginServer(QObject *parent = nullptr) : QTcpServer(parent) {
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = nextPendingConnection())
+                serve(socket);
+        });
+    }
+
+private:
+    struct Exchange {
+        QByteArray head;
+        bool headDone = false;
+        bool echo = false;
+        qint64 bodyLeft = 0;    // request body still to read
+        qint64 sendLeft = 0;    // generated response body still to write
+        bool replied = false;   // sink: response sent once the body is in
+    };
+
+    void serve(QTcpSocket *socket) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        auto x = std::make_shared<Exchange>();
+        connect(socket, &QTcpSocket::readyRead, socket, [socket, x]() {
+            if (!x->headDone) {
+                x->head += socket->readAll();
+                const int end = x->head.indexOf("\r\n\r\n");
+                if (end < 0)
+                    return;
+                const QByteArray rest = x->head.mid(end + 4);
+                x->head.truncate(end + 4);
+                x->headDone = true;
+                begin(socket, x.get());
+                consume(socket, x.get(), rest);
+            } else {
+                consume(socket, x.get(), socket->readAll());
+            }
+            finishIfDone(socket, x.get());
+        });
+        connect(socket, &QTcpSocket::bytesWritten, socket, [socket, x]() {
+            writeFiller(socket, &x->sendLeft);
+            finishIfDone(socket, x.get());
+        });
+    }
+
+    static void begin(QTcpSocket *socket, Exchange *x) {
+        const int lineEnd = x->head.indexOf("\r\n");
+        const QList<QByteArray> line = x->head.left(lineEnd).split(' ');
+        QByteArray path = line.value(1);
+        if (path.startsWith("http://"))
+            path = path.mid(path.indexOf('/', 7));
+        x->bodyLeft = qMax<qint64>(0, contentLength(x->head));
+        if (path.startsWith("/bytes/")) {
+            x->sendLeft = path.mid(7).toLongLong();
+            socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(x->sendLeft)
+                          + "\r\nConnection: close\r\n\r\n");
+            x->replied = true;
+            writeFiller(socket, &x->sendLeft);
+        } else if (path == "/echo") {
+            x->echo = true;
+            socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(x->bodyLeft)
+                          + "\r\nConnection: close\r\n\r\n");
+            x->replied = true;
+        } else if (path != "/sink") {
+            socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            x->replied = true;
+            x->bodyLeft = 0;
+        }
+    }
+
+    static void consume(QTcpSocket *socket, Exchange *x, const QByteArray &data) {
+        const qint64 n = qMin<qint64>(data.size(), x->bodyLeft);
+        x->bodyLeft -= n;
+        if (x->echo && n > 0)
+            socket->write(data.constData(), n);
+    }
+
+    static void finishIfDone(QTcpSocket *socket, Exchange *x) {
+        if (!x->headDone || x->bodyLeft > 0 || x->sendLeft > 0)
+            return;
+        if (!x->replied) {
+            socket->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            x->replied = true;
+        }
+        socket->disconnectFromHost();   // after the write queue drains
+    }
+};
+
+// ---------------------------------------------------------------------------
+// SOCKS5 stub
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief SOCKS5 server without authentication that tunnels every CONNECT,
+ * whatever its destination, to the origin
+ */
+class SocksStub : public QTcpServer
+{
+public:
+    SocksStub(quint16 originPort, QObject *parent = nullptr)
+        : QTcpServer(parent), m_originPort(originPort) {
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = nextPendingConnection())
+                serve(socket);
+        });
+    }
+
+private:
+    enum Stage { Greeting, Request, Connecting, Relaying };
+
+    // Bytes of the CONNECT request at the start of @p in, 0 while incomplete
+    static int requestLength(const QByteArray &in) {
+        if (in.size() < 5)
+            return 0;
+        switch (static_cast<quint8>(in[3])) {
+        case 0x01: return 10;
+        case 0x04: return 22;
+        default: return 7 + static_cast<quint8>(in[4]);
+        }
+    }
+
+    void serve(QTcpSocket *client) {
+        auto stage = std::make_shared<Stage>(Greeting);
+        auto *origin = new QTcpSocket(client);
+        connect(client, &QTcpSocket::readyRead, client, [client, origin, stage, this]() {
+            if (*stage == Relaying) {
+                origin->write(client->readAll());
+                return;
+            }
+            if (*stage == Connecting)
+                return;   // pipelined bytes wait in the socket
+            QByteArray in = client->peek(client->bytesAvailable());
+            if (*stage == Greeting) {
+                if (in.size() < 2 || in.size() < 2 + static_cast<quint8>(in[1]))
+                    return;
+                client->skip(2 + static_cast<quint8>(in[1]));
+                client->write(QByteArray("\x05\x00", 2));
+                *stage = Request;
+                in = client->peek(client->bytesAvailable());
+            }
+            const int length = requestLength(in);
+            if (length == 0 || in.size() < length)
+                return;
+            client->skip(length);
+            *stage = Connecting;
+            origin->connectToHost(QHostAddress::LocalHost, m_originPort);
+        });
+        connect(origin, &QTcpSocket::connected, client, [client, origin, stage]() {
+            client->write(QByteArray("\x05\x00\x00\x01\x7f\x00\x00\x01\x00\x50", 10));
+            *stage = Relaying;
+            origin->write(client->readAll());
+        });
+        connect(origin, &QTcpSocket::readyRead, client, [client, origin]() {
+            client->write(origin->readAll());
+        });
+        connect(origin, &QTcpSocket::errorOccurred, client, [client, stage]() {
+            if (*stage == Connecting)
+                client->write(QByteArray("\x05\x05\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+            client->disconnectFromHost();
+        });
+        connect(origin, &QTcpSocket::disconnected, client, [client, origin]() {
+            client->write(origin->readAll());
+            client->disconnectFromHost();
+        });
+        connect(client, &QTcpSocket::disconnected, client, [client, origin]() {
+            origin->disconnectFromHost();
+            client->deleteLater();
+        });
+    }
+
+    const quint16 m_originPort;
+};
+
+// ---------------------------------------------------------------------------
+// Load generator
+// ---------------------------------------------------------------------------
+
+struct Workload {
+    enum Mode { Download, Upload, Echo };
+
+    int concurrency = 32;
+    double connectRatio = 1.0;   // bridge requests sent as CONNECT, the rest as plain GET/POST
+    Mode mode = Download;
+    qint64 size = 64 * 1024;     // payload per request
+    int durationSec = 10;
+};
+
+/**
+ * @brief One request on its own connection
+ */
+class BenchClient : public QObject
+{
+public:
+    enum class Route {
+        Direct,          // SOCKS5 to the stub
+        BridgeConnect,   // CONNECT through the bridge, then HTTP in the tunnel
+        BridgePlain      // absolute-form request to the bridge
+    };
+
+    // ok, time to the first response byte, payload bytes moved
+    using Done = std::function<void(bool, qint64, qint64)>;
+
+    BenchClient(Route route, quint16 port, const Workload &work, QObject *parent = nullptr)
+        : QObject(parent), m_route(route), m_port(port), m_work(work), m_socket(new QTcpSocket(this)) {}
+
+    void start(Done done) {
+        m_done = std::move(done);
+        m_clock.start();
+        connect(m_socket, &QTcpSocket::connected, this, [this]() { onConnected(); });
+        connect(m_socket, &QTcpSocket::readyRead, this, [this]() { onReadyRead(); });
+        connect(m_socket, &QTcpSocket::bytesWritten, this, [this]() {
+            if (m_stage == Stage::Exchange)
+                writeFiller(m_socket, &m_uploadLeft);
+        });
+        connect(m_socket, &QTcpSocket::errorOccurred, this, [this]() { finish(false); });
+        m_timeout = new QTimer(this);
+        m_timeout->setSingleShot(true);
+        connect(m_timeout, &QTimer::timeout, this, [this]() { finish(false); });
+        m_timeout->start(kRequestTimeoutMs);
+        m_socket->connectToHost(QHostAddress::LocalHost, m_port);
+    }
+
+private:
+    enum class Stage { Setup, Exchange, Done };
+
+    QByteArray requestHead(bool absolute) const {
+        const QByteArray target = absolute ? "http://" + kOriginHost : QByteArray();
+        switch (m_work.mode) {
+        case Workload::Download:
+            return "GET " + target + "/bytes/" + QByteArray::number(m_work.size) + " HTTP/1.1\r\nHost: "
+                   + kOriginHost + "\r\nConnection: close\r\n\r\n";
+        case Workload::Upload:
+        case Workload::Echo:
+            return "POST " + target + (m_work.mode == Workload::Upload ? "/sink" : "/echo")
+                   + " HTTP/1.1\r\nHost: " + kOriginHost + "\r\nContent-Length: "
+                   + QByteArray::number(m_work.size) + "\r\nConnection: close\r\n\r\n";
+        }
+        return QByteArray();
+    }
+
+    void onConnected() {
+        switch (m_route) {
+        case Route::Direct: {
+            // Greeting and CONNECT pipelined, as the bridge's optimistic mode does
+            QByteArray hello("\x05\x01\x00\x05\x01\x00\x03", 7);
+            hello.append(char(kOriginHost.size()));
+            hello.append(kOriginHost);
+            hello.append("\x00\x50", 2);
+            m_socket->write(hello);
+            break;
+        }
+        case Route::BridgeConnect:
+            m_socket->write("CONNECT " + kOriginHost + ":80 HTTP/1.1\r\nHost: " + kOriginHost + ":80\r\n\r\n");
+            break;
+        case Route::BridgePlain:
+            sendRequest(true);
+            break;
+        }
+    }
+
+    void sendRequest(bool absolute) {
+        m_stage = Stage::Exchange;
+        m_uploadLeft = m_work.mode == Workload::Download ? 0 : m_work.size;
+        m_socket->write(requestHead(absolute));
+        writeFiller(m_socket, &m_uploadLeft);
+    }
+
+    void onReadyRead() {
+        if (m_stage == Stage::Setup) {
+            m_buffer += m_socket->readAll();
+            if (m_route == Route::Direct) {
+                if (m_buffer.size() < 12)
+                    return;
+                if (m_buffer[1] != 0 || m_buffer[3] != 0) {
+                    finish(false);
+                    return;
+                }
+                m_buffer.remove(0, 12);
+            } else {
+                const int end = m_buffer.indexOf("\r\n\r\n");
+                if (end < 0)
+                    return;
+                if (!m_buffer.startsWith("HTTP/1.1 200")) {
+                    finish(false);
+                    return;
+                }
+                m_buffer.remove(0, end + 4);
+            }
+            sendRequest(false);
+            if (m_buffer.isEmpty())
+                return;
+        }
+        if (m_stage != Stage::Exchange)
+            return;
+
+        if (m_ttfbNs < 0)
+            m_ttfbNs = m_clock.nsecsElapsed();
+        if (m_bodyLeft < 0) {
+            m_buffer += m_socket->readAll();
+            const int end = m_buffer.indexOf("\r\n\r\n");
+            if (end < 0)
+                return;
+            const QByteArray head = m_buffer.left(end + 4);
+            if (!head.startsWith("HTTP/1.1 200")) {
+                finish(false);
+                return;
+            }
+            m_bodyLeft = qMax<qint64>(0, contentLength(head));
+            m_received += qMin<qint64>(m_bodyLeft, m_buffer.size() - end - 4);
+            m_bodyLeft -= qMin<qint64>(m_bodyLeft, m_buffer.size() - end - 4);
+            m_buffer.clear();
+        } else {
+            const qint64 n = m_socket->skip(m_socket->bytesAvailable());
+            m_received += n;
+            m_bodyLeft -= n;
+        }
+        if (m_bodyLeft <= 0 && m_uploadLeft == 0)
+            finish(true);
+    }
+
+    void finish(bool ok) {
+        if (m_stage == Stage::Done)
+            return;
+        m_stage = Stage::Done;
+        m_timeout->stop();
+        m_socket->disconnect(this);
+        m_socket->abort();
+        const qint64 sent = m_work.mode == Workload::Download ? 0 : m_work.size;
+        m_done(ok, m_ttfbNs, ok ? sent + m_received : 0);
+    }
+
+    const Route m_route;
+    const quint16 m_port;
+    const Workload m_work;
+    QTcpSocket *m_socket;
+    QTimer *m_timeout = nullptr;
+    Done m_done;
+    Stage m_stage = Stage::Setup;
+    QElapsedTimer m_clock;
+    QByteArray m_buffer;
+    qint64 m_uploadLeft = 0;
+    qint64 m_bodyLeft = -1;    // -1 until the response head is in
+    qint64 m_received = 0;
+    qint64 m_ttfbNs = -1;
+};
+
+struct RunStats {
+    qint64 requests = 0;
+    qint64 errors = 0;
+    qint64 bytes = 0;
+    double seconds = 0.0;
+    std::vector<qint64> ttfbNs;
+
+    double megabytesPerSec() const { return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+    double connectionsPerSec() const { return seconds > 0 ? requests / seconds : 0.0; }
+
+    /** Nearest-rank percentile in ms (ttfbNs sorted) */
+    double ttfbMs(double q) const {
+        if (ttfbNs.empty())
+            return 0.0;
+        const size_t rank = static_cast<size_t>(std::ceil(q * ttfbNs.size()));
+        return ttfbNs[qBound<size_t>(1, rank, ttfbNs.size()) - 1] / 1e6;
+    }
+};
+
+/**
+ * @brief Keep work.concurrency requests in flight for work.durationSec
+ * @param bridge Through the bridge on @p port, else SOCKS5 to the stub on @p port
+ */
+static RunStats runLoad(bool bridge, quint16 port, const Workload &work) {
+    RunStats stats;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    const qint64 deadlineMs = qint64(work.durationSec) * 1000;
+    int inFlight = 0;
+    double connectCredit = 0.0;
+
+    std::function<void()> launch = [&]() {
+        BenchClient::Route route = BenchClient::Route::Direct;
+        if (bridge) {
+            connectCredit += work.connectRatio;
+            route = connectCredit >= 1.0 ? BenchClient::Route::BridgeConnect : BenchClient::Route::BridgePlain;
+            if (connectCredit >= 1.0)
+                connectCredit -= 1.0;
+        }
+        auto *client = new BenchClient(route, port, work);
+        ++inFlight;
+        client->start([&, client](bool ok, qint64 ttfbNs, qint64 bytes) {
+            client->deleteLater();
+            --inFlight;
+            if (ok) {
+                ++stats.requests;
+                stats.bytes += bytes;
+                stats.ttfbNs.push_back(ttfbNs);
+            } else {
+                ++stats.errors;
+            }
+            if (clock.elapsed() < deadlineMs)
+                launch();
+            else if (inFlight == 0)
+                loop.quit();
+        });
+    };
+
+    clock.start();
+    for (int i = 0; i < work.concurrency; ++i)
+        launch();
+    loop.exec();
+    stats.seconds = clock.nsecsElapsed() / 1e9;
+    std::sort(stats.ttfbNs.begin(), stats.ttfbNs.end());
+    return stats;
+}
+
+static QJsonObject toJson(const RunStats &s) {
+    QJsonObject ttfb;
+    ttfb[QStringLiteral("p50")] = s.ttfbMs(0.50);
+    ttfb[QStringLiteral("p99")] = s.ttfbMs(0.99);
+    ttfb[QStringLiteral("p999")] = s.ttfbMs(0.999);
+    QJsonObject o;
+    o[QStringLiteral("requests")] = s.requests;
+    o[QStringLiteral("errors")] = s.errors;
+    o[QStringLiteral("seconds")] = s.seconds;
+    o[QStringLiteral("mbPerSec")] = s.megabytesPerSec();
+    o[QStringLiteral("connectionsPerSec")] = s.connectionsPerSec();
+    o[QStringLiteral("ttfbMs")] = ttfb;
+    return o;
+}
+
+static void report(FILE *out, const char *name, const RunStats &s) {
+    std::fprintf(out, "  %-7s %8lld requests %6lld errors %9.1f MB/s %9.1f conn/s   TTFB p50 %7.3f  p99 %7.3f  p999 %7.3f ms\n",
+                 name, static_cast<long long>(s.requests), static_cast<long long>(s.errors),
+                 s.megabytesPerSec(), s.connectionsPerSec(), s.ttfbMs(0.50), s.ttfbMs(0.99), s.ttfbMs(0.999));
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Self-contained HttpToSocksProxy benchmark"));
+    parser.addHelpOption();
+    const QCommandLineOption concurrencyOpt(QStringLiteral("concurrency"), QStringLiteral("Requests in flight"), QStringLiteral("n"), QStringLiteral("32"));
+    const QCommandLineOption ratioOpt(QStringLiteral("connect-ratio"), QStringLiteral("Share of bridge requests sent as CONNECT (rest plain HTTP)"), QStringLiteral("0..1"), QStringLiteral("1"));
+    const QCommandLineOption modeOpt(QStringLiteral("mode"), QStringLiteral("download, upload or echo"), QStringLiteral("mode"), QStringLiteral("download"));
+    const QCommandLineOption sizeOpt(QStringLiteral("size"), QStringLiteral("Payload bytes per request"), QStringLiteral("bytes"), QStringLiteral("65536"));
+    const QCommandLineOption durationOpt(QStringLiteral("duration"), QStringLiteral("Seconds per run"), QStringLiteral("s"), QStringLiteral("10"));
+    const QCommandLineOption workersOpt(QStringLiteral("workers"), QStringLiteral("Bridge worker threads (0 = ideal)"), QStringLiteral("n"), QStringLiteral("0"));
+    const QCommandLineOption engineOpt(QStringLiteral("engine"), QStringLiteral("Bridge relay engine: qt or native"), QStringLiteral("engine"), QStringLiteral("qt"));
+    const QCommandLineOption portOpt(QStringLiteral("port"), QStringLiteral("Bridge port"), QStringLiteral("port"), QStringLiteral("18091"));
+    const QCommandLineOption noDirectOpt(QStringLiteral("no-direct"), QStringLiteral("Skip the direct SOCKS5 baseline"));
+    const QCommandLineOption jsonOpt(QStringLiteral("json"), QStringLiteral("Print results as JSON on stdout"));
+    parser.addOptions({concurrencyOpt, ratioOpt, modeOpt, sizeOpt, durationOpt, workersOpt, engineOpt, portOpt,
+                       noDirectOpt, jsonOpt});
+    parser.process(app);
+
+    Workload work;
+    work.concurrency = qMax(1, parser.value(concurrencyOpt).toInt());
+    work.connectRatio = qBound(0.0, parser.value(ratioOpt).toDouble(), 1.0);
+    const QString mode = parser.value(modeOpt);
+    work.mode = mode == QLatin1String("upload") ? Workload::Upload
+              : mode == QLatin1String("echo") ? Workload::Echo : Workload::Download;
+    work.size = qMax<qint64>(0, parser.value(sizeOpt).toLongLong());
+    work.durationSec = qMax(1, parser.value(durationOpt).toInt());
+    const bool json = parser.isSet(jsonOpt);
+    FILE *out = json ? stderr : stdout;
+
+    // Origin and stub on a thread of their own, so they do not compete with
+    // the load generator's event loop
+    QThread serverThread;
+    serverThread.start();
+    auto *serverContext = new QObject;
+    serverContext->moveToThread(&serverThread);
+    OriginServer *origin = nullptr;
+    SocksStub *stub = nullptr;
+    quint16 stubPort = 0;
+    QMetaObject::invokeMethod(serverContext, [&]() {
+        origin = new OriginServer(serverContext);
+        if (!origin->listen(QHostAddress::LocalHost, 0))
+            return;
+        stub = new SocksStub(origin->serverPort(), serverContext);
+        if (stub->listen(QHostAddress::LocalHost, 0))
+            stubPort = stub->serverPort();
+    }, Qt::BlockingQueuedConnection);
+    auto stopServers = [&]() {
+        QMetaObject::invokeMethod(serverContext, [serverContext]() { delete serverContext; },
+                                  Qt::BlockingQueuedConnection);
+        serverThread.quit();
+        serverThread.wait();
+    };
+    if (stubPort == 0) {
+        std::fprintf(stderr, "Cannot start the origin / SOCKS5 stub\n");
+        stopServers();
+        return 1;
+    }
+
+    std::fprintf(out, "%s %lld bytes, %d in flight, %.0f%% CONNECT, %d s per run\n",
+                 qPrintable(mode), static_cast<long long>(work.size), work.concurrency,
+                 work.connectRatio * 100.0, work.durationSec);
+
+    RunStats direct;
+    const bool runDirect = !parser.isSet(noDirectOpt);
+    if (runDirect)
+        direct = runLoad(false, stubPort, work);
+
+    HttpToSocksProxy proxy;
+    HttpToSocksProxy::Options options;
+    options.workerCount = qMax(0, parser.value(workersOpt).toInt());
+    options.relayEngine = parser.value(engineOpt) == QLatin1String("native") ? HttpToSocksProxy::RelayEngine::Native
+                                                                             : HttpToSocksProxy::RelayEngine::Qt;
+    proxy.setOptions(options);
+    const quint16 bridgePort = static_cast<quint16>(parser.value(portOpt).toUInt());
+    if (!proxy.start(bridgePort, QStringLiteral("127.0.0.1"), stubPort)) {
+        std::fprintf(stderr, "Cannot start the bridge on port %u\n", bridgePort);
+        stopServers();
+        return 1;
+    }
+    const RunStats bridge = runLoad(true, bridgePort, work);
+    proxy.stop();
+    stopServers();
+
+    if (runDirect)
+        report(out, "direct", direct);
+    report(out, "bridge", bridge);
+
+    QJsonObject overhead;
+    if (runDirect && direct.requests > 0) {
+        overhead[QStringLiteral("throughputRatio")] = direct.megabytesPerSec() > 0
+            ? bridge.megabytesPerSec() / direct.megabytesPerSec() : 0.0;
+        overhead[QStringLiteral("connectionsRatio")] = direct.connectionsPerSec() > 0
+            ? bridge.connectionsPerSec() / direct.connectionsPerSec() : 0.0;
+        overhead[QStringLiteral("ttfbP50Ms")] = bridge.ttfbMs(0.50) - direct.ttfbMs(0.50);
+        overhead[QStringLiteral("ttfbP99Ms")] = bridge.ttfbMs(0.99) - direct.ttfbMs(0.99);
+        overhead[QStringLiteral("ttfbP999Ms")] = bridge.ttfbMs(0.999) - direct.ttfbMs(0.999);
+        std::fprintf(out, "  overhead: %.1f%% of direct throughput, %.1f%% of direct conn/s, TTFB +%.3f / +%.3f / +%.3f ms\n",
+                     overhead[QStringLiteral("throughputRatio")].toDouble() * 100.0,
+                     overhead[QStringLiteral("connectionsRatio")].toDouble() * 100.0,
+                     overhead[QStringLiteral("ttfbP50Ms")].toDouble(),
+                     overhead[QStringLiteral("ttfbP99Ms")].toDouble(),
+                     overhead[QStringLiteral("ttfbP999Ms")].toDouble());
+    }
+
+    if (json) {
+        QJsonObject config;
+        config[QStringLiteral("mode")] = mode;
+        config[QStringLiteral("size")] = work.size;
+        config[QStringLiteral("concurrency")] = work.concurrency;
+        config[QStringLiteral("connectRatio")] = work.connectRatio;
+        config[QStringLiteral("durationSec")] = work.durationSec;
+        config[QStringLiteral("workers")] = options.workerCount;
+        config[QStringLiteral("engine")] = parser.value(engineOpt);
+        QJsonObject root;
+        root[QStringLiteral("config")] = config;
+        root[QStringLiteral("bridge")] = toJson(bridge);
+        if (runDirect) {
+            root[QStringLiteral("direct")] = toJson(direct);
+            root[QStringLiteral("overhead")] = overhead;
+        }
+        std::fputs(QJsonDocument(root).toJson(QJsonDocument::Indented).constData(), stdout);
+    }
+    return bridge.requests > 0 ? 0 : 1;
+}
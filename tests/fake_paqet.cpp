@@ -0,0 +1,434 @@
+/**
+ * @file fake_paqet.cpp
+ * @brief Stand-in for the paqet binary with a configurable, impaired tunnel
+ *
+ * Behaves like paqet as far as paqetN can tell: `fake_paqet run -c <yaml>`
+ * reads socks5.listen from the config paqetN wrote and serves SOCKS5 there
+ * (no authentication, CONNECT only); `fake_paqet version` answers like
+ * paqet does. Instead of a KCP tunnel to a server, every CONNECT goes
+ * straight to its target from this machine, through an impairment:
+ *
+ *   - rtt:       the CONNECT reply waits one round trip, and every byte
+ *                is delayed by half of it each way;
+ *   - jitter:    added to each one-way delay, uniform in [-jitter, +jitter];
+ *   - loss:      per 1400-byte packet; a lost packet stalls its direction
+ *                (and everything behind it, in order) for stall ms, as a
+ *                retransmission would;
+ *   - bandwidth: per connection and direction, in kbit/s.
+ *
+ * Set them in an `impair:` section of the YAML (rtt_ms, jitter_ms, loss,
+ * stall_ms, bandwidth_kbps, seed) or, so that paqetN's own PaqetRunner can
+ * launch it unchanged, through FAKE_PAQET_RTT_MS, FAKE_PAQET_JITTER_MS,
+ * FAKE_PAQET_LOSS, FAKE_PAQET_STALL_MS, FAKE_PAQET_BANDWIDTH_KBPS and
+ * FAKE_PAQET_SEED, which take precedence. Random draws come from a seeded
+ * generator per connection, so a run is reproducible.
+ *
+ * Point paqetN at it with the paqet binary path setting (or put it in
+ * cores/ as paqet) to test PaqetRunner, LatencyChecker, HttpToSocksProxy
+ * and the speed features without network access.
+ *
+ * Build with:
+ *   cd build
+ *   cmake .. -DBUILD_TESTS=ON
+ *   cmake --build . --target fake_paqet
+ *
+ * Run:
+ *   FAKE_PAQET_RTT_MS=120 FAKE_PAQET_LOSS=0.01 ./fake_paqet run -c config.yaml
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+
+static constexpr qint64 kReadChunk = 16 * 1024;
+static constexpr qint64 kMaxInFlight = 1024 * 1024;     // per direction, read and not delivered yet
+static constexpr qint64 kMaxSinkQueue = 256 * 1024;     // delivered and not written by the kernel yet
+static constexpr qint64 kPacketSize = 1400;             // loss is drawn per packet of this size
+
+static void say(const QString &line) {
+    std::fprintf(stdout, "[fake-paqet] %s\n", qPrintable(line));
+    std::fflush(stdout);
+}
+
+static qint64 nowUs() {
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return clock.nsecsElapsed() / 1000;
+}
+
+struct Impairment {
+    int rttMs = 0;
+    int jitterMs = 0;
+    double loss = 0.0;
+    int stallMs = 200;
+    qint64 bandwidthKbps = 0;   // 0 = unlimited
+    quint32 seed = 1;
+
+    void set(const QByteArray &key, const QByteArray &value) {
+        if (key == "rtt_ms")
+            rttMs = qMax(0, value.toInt());
+        else if (key == "jitter_ms")
+            jitterMs = qMax(0, value.toInt());
+        else if (key == "loss")
+            loss = qBound(0.0, value.toDouble(), 1.0);
+        else if (key == "stall_ms")
+            stallMs = qMax(0, value.toInt());
+        else if (key == "bandwidth_kbps")
+            bandwidthKbps = qMax<qint64>(0, value.toLongLong());
+        else if (key == "seed")
+            seed = value.toUInt();
+    }
+
+    void readEnvironment() {
+        static const char *const keys[][2] = {
+            {"FAKE_PAQET_RTT_MS", "rtt_ms"},
+            {"FAKE_PAQET_JITTER_MS", "jitter_ms"},
+            {"FAKE_PAQET_LOSS", "loss"},
+            {"FAKE_PAQET_STALL_MS", "stall_ms"},
+            {"FAKE_PAQET_BANDWIDTH_KBPS", "bandwidth_kbps"},
+            {"FAKE_PAQET_SEED", "seed"},
+        };
+        for (const auto &k : keys) {
+            if (qEnvironmentVariableIsSet(k[0]))
+                set(k[1], qgetenv(k[0]).trimmed());
+        }
+    }
+
+    QString describe() const {
+        return QStringLiteral("rtt %1 ms +/- %2, loss %3%, stall %4 ms, bandwidth %5, seed %6")
+            .arg(rttMs).arg(jitterMs).arg(loss * 100.0).arg(stallMs)
+            .arg(bandwidthKbps > 0 ? QStringLiteral("%1 kbit/s").arg(bandwidthKbps) : QStringLiteral("unlimited"))
+            .arg(seed);
+    }
+};
+
+/**
+ * @brief The bits of paqet's YAML this stand-in needs: socks5[0].listen
+ * and the optional impair section
+ */
+static bool parseConfig(const QString &path, QByteArray *listen, Impairment *impairment) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    QByteArray section;
+    while (!file.atEnd()) {
+        const QByteArray raw = file.readLine();
+        const QByteArray line = raw.trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        if (raw[0] != ' ' && raw[0] != '-') {
+            section = line.left(line.indexOf(':'));
+            continue;
+        }
+        QByteArray entry = line;
+        if (entry.startsWith("- "))
+            entry = entry.mid(2).trimmed();
+        const int colon = entry.indexOf(':');
+        if (colon < 0)
+            continue;
+        const QByteArray key = entry.left(colon).trimmed();
+        QByteArray value = entry.mid(colon + 1).trimmed();
+        if (value.size() >= 2 && (value.startsWith('"') || value.startsWith('\'')))
+            value = value.mid(1, value.size() - 2);
+        if (section == "socks5" && key == "listen" && listen->isEmpty())
+            *listen = value;
+        else if (section == "impair")
+            impairment->set(key, value);
+    }
+    return !listen->isEmpty();
+}
+
+/**
+ * @brief One direction of a tunnel: bytes read from the source reach the
+ * sink in order, after the one-way delay and any loss stall, no faster
+ * than the bandwidth allows
+ */
+class DelayLine
+{
+public:
+    /** @param done Called once the source closed and everything was delivered */
+    DelayLine(QTcpSocket *source, QTcpSocket *sink, const Impairment &impairment, std::mt19937 *rng,
+              std::function<void()> done)
+        : m_source(source), m_sink(sink), m_impairment(impairment), m_rng(rng), m_onDone(std::move(done)) {
+        m_timer.setSingleShot(true);
+        m_timer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&m_timer, &QTimer::timeout, sink, [this]() { release(); });
+        QObject::connect(sink, &QTcpSocket::bytesWritten, &m_timer, [this]() { release(); });
+        QObject::connect(source, &QTcpSocket::readyRead, &m_timer, [this]() { pull(); });
+    }
+
+    /** The source is closed: close the sink once the line is empty */
+    void sourceClosed() {
+        m_sourceClosed = true;
+        pull();
+    }
+
+    bool isDone() const { return m_done; }
+
+    void pull() {
+        while (m_queued < kMaxInFlight && m_source->bytesAvailable() > 0) {
+            Chunk chunk;
+            chunk.data = m_source->read(qMin(kReadChunk, kMaxInFlight - m_queued));
+            if (chunk.data.isEmpty())
+                break;
+            qint64 at = nowUs() + oneWayDelayUs();
+            if (stalled(chunk.data.size()))
+                at += qint64(m_impairment.stallMs) * 1000;
+            at = qMax(at, m_lastRelease);   // never overtakes the chunk before it
+            if (m_impairment.bandwidthKbps > 0)
+                at += chunk.data.size() * 8 * 1000 / m_impairment.bandwidthKbps;   // kbit/s = bit/ms
+            chunk.releaseAt = at;
+            m_lastRelease = at;
+            m_queued += chunk.data.size();
+            m_chunks.push_back(std::move(chunk));
+        }
+        release();
+    }
+
+private:
+    struct Chunk {
+        qint64 releaseAt = 0;   // us, nowUs() clock
+        QByteArray data;
+    };
+
+    qint64 oneWayDelayUs() {
+        qint64 us = qint64(m_impairment.rttMs) * 500;   // half the RTT
+        if (m_impairment.jitterMs > 0) {
+            std::uniform_int_distribution<int> jitter(-m_impairment.jitterMs * 1000, m_impairment.jitterMs * 1000);
+            us += jitter(*m_rng);
+        }
+        return qMax<qint64>(0, us);
+    }
+
+    bool stalled(qint64 bytes) {
+        if (m_impairment.loss <= 0.0)
+            return false;
+        const double packets = std::ceil(double(bytes) / kPacketSize);
+        const double lossy = 1.0 - std::pow(1.0 - m_impairment.loss, packets);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(*m_rng) < lossy;
+    }
+
+    void release() {
+        const qint64 now = nowUs();
+        while (!m_chunks.empty() && m_chunks.front().releaseAt <= now && m_sink->bytesToWrite() < kMaxSinkQueue) {
+            m_sink->write(m_chunks.front().data);
+            m_queued -= m_chunks.front().data.size();
+            m_chunks.pop_front();
+        }
+        if (m_queued < kMaxInFlight && m_source->bytesAvailable() > 0) {
+            QTimer::singleShot(0, &m_timer, [this]() { pull(); });
+            return;
+        }
+        if (m_chunks.empty()) {
+            if (m_sourceClosed && !m_done) {
+                m_done = true;
+                m_sink->disconnectFromHost();   // after its write queue drains
+                m_onDone();
+            }
+            return;
+        }
+        // A backed-up sink wakes us with bytesWritten()
+        if (m_sink->bytesToWrite() < kMaxSinkQueue && !m_timer.isActive())
+            m_timer.start(int((m_chunks.front().releaseAt - now + 999) / 1000));
+    }
+
+    QTcpSocket *m_source;
+    QTcpSocket *m_sink;
+    const Impairment &m_impairment;
+    std::mt19937 *m_rng;
+    std::function<void()> m_onDone;
+    std::deque<Chunk> m_chunks;
+    qint64 m_queued = 0;
+    qint64 m_lastRelease = 0;
+    bool m_sourceClosed = false;
+    bool m_done = false;
+    QTimer m_timer;
+};
+
+/**
+ * @brief One SOCKS5 client: handshake, then an impaired tunnel to its target
+ */
+class FakeTunnel : public QObject
+{
+public:
+    FakeTunnel(QTcpSocket *client, const Impairment &impairment, quint32 index, QObject *parent)
+        : QObject(parent), m_client(client), m_target(new QTcpSocket(this)), m_impairment(impairment)
+        , m_rng(impairment.seed + index) {
+        client->setParent(this);
+        client->setReadBufferSize(kMaxSinkQueue);
+        m_target->setReadBufferSize(kMaxSinkQueue);
+        connect(client, &QTcpSocket::readyRead, this, [this]() { onClientReadyRead(); });
+        connect(client, &QTcpSocket::disconnected, this, [this]() {
+            if (!m_up) {
+                deleteLater();
+                return;
+            }
+            m_up->sourceClosed();
+            maybeReap();
+        });
+        connect(m_target, &QTcpSocket::connected, this, [this]() { onTargetConnected(); });
+        connect(m_target, &QTcpSocket::disconnected, this, [this]() {
+            if (m_down)
+                m_down->sourceClosed();
+            maybeReap();
+        });
+        connect(m_target, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error) {
+            if (m_stage != Stage::Connecting)
+                return;
+            say(QStringLiteral("CONNECT %1:%2 failed: %3").arg(m_host).arg(m_port).arg(m_target->errorString()));
+            reply(error == QAbstractSocket::ConnectionRefusedError ? 0x05
+                  : error == QAbstractSocket::HostNotFoundError ? 0x04 : 0x01);
+            m_stage = Stage::Closed;
+            m_client->disconnectFromHost();
+        });
+        connect(client, &QTcpSocket::stateChanged, this, [this]() { maybeReap(); });
+        connect(m_target, &QTcpSocket::stateChanged, this, [this]() { maybeReap(); });
+    }
+
+private:
+    enum class Stage { Greeting, Request, Connecting, Relaying, Closed };
+
+    // Gone once both directions are delivered and both sockets closed
+    void maybeReap() {
+        if (m_up && m_down && m_up->isDone() && m_down->isDone()
+            && m_client->state() == QAbstractSocket::UnconnectedState
+            && m_target->state() == QAbstractSocket::UnconnectedState) {
+            deleteLater();
+        }
+    }
+
+    void onClientReadyRead() {
+        if (m_stage != Stage::Greeting && m_stage != Stage::Request)
+            return;   // tunnel bytes wait in the socket for the up line
+        const QByteArray in = m_client->peek(m_client->bytesAvailable());
+        if (m_stage == Stage::Greeting) {
+            if (in.size() < 2 || in.size() < 2 + static_cast<quint8>(in[1]))
+                return;
+            if (static_cast<quint8>(in[0]) != 0x05) {
+                m_client->abort();
+                return;
+            }
+            const QByteArray methods = in.mid(2, static_cast<quint8>(in[1]));
+            m_client->skip(2 + methods.size());
+            const bool noAuth = methods.contains('\x00');
+            m_client->write(QByteArray("\x05", 1) + (noAuth ? QByteArray(1, '\x00') : QByteArray(1, '\xff')));
+            if (!noAuth) {
+                m_client->disconnectFromHost();
+                return;
+            }
+            m_stage = Stage::Request;
+            onClientReadyRead();
+            return;
+        }
+        if (in.size() < 5)
+            return;
+        const quint8 command = static_cast<quint8>(in[1]);
+        const quint8 atyp = static_cast<quint8>(in[3]);
+        const int addressLength = atyp == 0x01 ? 4 : atyp == 0x04 ? 16 : 1 + static_cast<quint8>(in[4]);
+        const int length = 4 + addressLength + 2;
+        if (in.size() < length)
+            return;
+        m_client->skip(length);
+        if (atyp == 0x01) {
+            m_host = QHostAddress(qFromBigEndian<quint32>(in.constData() + 4)).toString();
+        } else if (atyp == 0x04) {
+            m_host = QHostAddress(reinterpret_cast<const quint8 *>(in.constData() + 4)).toString();
+        } else {
+            m_host = QString::fromLatin1(in.mid(5, addressLength - 1));
+        }
+        m_port = qFromBigEndian<quint16>(in.constData() + 4 + addressLength);
+        if (command != 0x01) {
+            reply(0x07);   // command not supported
+            m_stage = Stage::Closed;
+            m_client->disconnectFromHost();
+            return;
+        }
+        // The request travels to the paqet server and the reply comes back
+        m_stage = Stage::Connecting;
+        QTimer::singleShot(m_impairment.rttMs, this, [this]() { m_target->connectToHost(m_host, m_port); });
+    }
+
+    void onTargetConnected() {
+        reply(0x00);
+        m_stage = Stage::Relaying;
+        m_up = std::make_unique<DelayLine>(m_client, m_target, m_impairment, &m_rng, [this]() { maybeReap(); });
+        m_down = std::make_unique<DelayLine>(m_target, m_client, m_impairment, &m_rng, [this]() { maybeReap(); });
+        m_up->pull();   // sent along with the CONNECT
+        if (m_client->state() != QAbstractSocket::ConnectedState)
+            m_up->sourceClosed();
+    }
+
+    void reply(quint8 code) {
+        QByteArray r("\x05", 1);
+        r.append(char(code));
+        r.append("\x00\x01\x00\x00\x00\x00\x00\x00", 8);
+        m_client->write(r);
+    }
+
+    QTcpSocket *m_client;
+    QTcpSocket *m_target;
+    const Impairment &m_impairment;
+    std::mt19937 m_rng;
+    Stage m_stage = Stage::Greeting;
+    QString m_host;
+    quint16 m_port = 0;
+    std::unique_ptr<DelayLine> m_up;     // client -> target
+    std::unique_ptr<DelayLine> m_down;   // target -> client
+};
+
+static int usage() {
+    std::fprintf(stderr, "usage: fake_paqet run -c <config.yaml>\n       fake_paqet version\n");
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments().mid(1);
+    if (args.value(0) == QLatin1String("version")) {
+        std::printf("Version: v0.0.0-fake\n");
+        return 0;
+    }
+    if (args.size() < 3 || args[0] != QLatin1String("run") || args[1] != QLatin1String("-c"))
+        return usage();
+
+    Impairment impairment;
+    QByteArray listen;
+    if (!parseConfig(args[2], &listen, &impairment)) {
+        say(QStringLiteral("cannot read socks5.listen from %1").arg(args[2]));
+        return 1;
+    }
+    impairment.readEnvironment();
+
+    const int colon = listen.lastIndexOf(':');
+    QByteArray host = listen.left(colon);
+    if (host.startsWith('[') && host.endsWith(']'))
+        host = host.mid(1, host.size() - 2);
+    const QHostAddress address = host.isEmpty() ? QHostAddress(QHostAddress::Any) : QHostAddress(QString::fromLatin1(host));
+    const quint16 port = static_cast<quint16>(listen.mid(colon + 1).toUInt());
+
+    QTcpServer server;
+    if (colon < 0 || address.isNull() || !server.listen(address, port)) {
+        say(QStringLiteral("cannot listen on %1: %2").arg(QString::fromLatin1(listen), server.errorString()));
+        return 1;
+    }
+    quint32 connections = 0;
+    QObject::connect(&server, &QTcpServer::newConnection, &server, [&]() {
+        while (QTcpSocket *client = server.nextPendingConnection())
+            new FakeTunnel(client, impairment, connections++, &server);
+    });
+    say(QStringLiteral("SOCKS5 listening on %1 (%2)").arg(QString::fromLatin1(listen), impairment.describe()));
+    return app.exec();
+}
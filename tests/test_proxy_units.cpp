@@ -0,0 +1,450 @@
+/**
+ * @file test_proxy_units.cpp
+ * @brief Correctness checks for the building blocks of HttpToSocksProxy
+ *
+ * Runs in-process against the parsers and lookup structures directly; no
+ * paqet, SOCKS5 proxy or network is needed.
+ *
+ * Build with:
+ *   cd build
+ *   cmake .. -DBUILD_TESTS=ON
+ *   cmake --build . --target test_proxy_units
+ *
+ * Run:
+ *   ./test_proxy_units
+ */
+
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QFile>
+#include <QHostAddress>
+#include <QString>
+#include <QTemporaryDir>
+#include "../src/CidrAllowList.h"
+#include "../src/DomainBlocklist.h"
+#include "../src/HttpCache.h"
+#include "../src/HttpMessageFramer.h"
+#include "../src/HttpRequestParser.h"
+#include "../src/RoutingRules.h"
+
+#include <cstdio>
+
+#define LOG(msg) do { fprintf(stderr, "%s\n", qPrintable(msg)); fflush(stderr); } while(0)
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        LOG(QString("FAILED: %1 (line %2)").arg(#cond).arg(__LINE__)); \
+        ++g_failures; \
+    } \
+} while(0)
+
+/** Parse @p request in one go and return the head rewriteForOrigin() produces */
+static QByteArray rewritten(const QByteArray &request, QByteArray *rest = nullptr) {
+    QByteArray buffer = request;
+    HttpRequestParser parser;
+    if (parser.parse(buffer) != HttpRequestParser::Status::Complete)
+        return QByteArray();
+    const qsizetype begin = parser.rewriteForOrigin(buffer);
+    if (rest)
+        *rest = buffer.mid(parser.headLength());
+    return buffer.mid(begin, parser.headLength() - begin);
+}
+
+static void testRequestParser() {
+    LOG("--- HttpRequestParser ---");
+    const int failuresBefore = g_failures;
+
+    // Absolute-form targets become origin-form
+    CHECK(rewritten("GET http://host HTTP/1.1\r\nHost: host\r\n\r\n")
+          == "GET / HTTP/1.1\r\nHost: host\r\n\r\n");
+    CHECK(rewritten("GET http://host?q=1 HTTP/1.1\r\nHost: host\r\n\r\n")
+          == "GET /?q=1 HTTP/1.1\r\nHost: host\r\n\r\n");
+    CHECK(rewritten("GET http://host/p HTTP/1.1\r\nHost: host\r\n\r\n")
+          == "GET /p HTTP/1.1\r\nHost: host\r\n\r\n");
+    CHECK(rewritten("GET HTTP://Host:8080/a/b?c HTTP/1.0\r\n\r\n")
+          == "GET /a/b?c HTTP/1.0\r\n\r\n");
+
+    // Proxy-* headers go, the rest keeps its order; the body follows the head
+    QByteArray body;
+    CHECK(rewritten("POST http://host/form HTTP/1.1\r\n"
+                    "Proxy-Connection: keep-alive\r\n"
+                    "Host: host\r\n"
+                    "Proxy-Authorization: Basic dXNlcjpwYXNz\r\n"
+                    "Content-Length: 4\r\n"
+                    "\r\n"
+                    "data", &body)
+          == "POST /form HTTP/1.1\r\nHost: host\r\nContent-Length: 4\r\n\r\n");
+    CHECK(body == "data");
+
+    // Origin-form without Proxy-* headers stays where it is
+    {
+        QByteArray buffer("GET /index.html HTTP/1.1\r\nHost: host\r\n\r\n");
+        const QByteArray original = buffer;
+        HttpRequestParser parser;
+        CHECK(parser.parse(buffer) == HttpRequestParser::Status::Complete);
+        CHECK(parser.rewriteForOrigin(buffer) == 0);
+        CHECK(buffer == original);
+    }
+
+    // The head arrives split at every byte boundary
+    const QByteArray request("GET http://example.com/path?x=1 HTTP/1.1\r\n"
+                             "Host: example.com\r\n"
+                             "Proxy-Connection: keep-alive\r\n"
+                             "Accept: */*\r\n"
+                             "\r\n");
+    for (qsizetype split = 1; split < request.size(); ++split) {
+        HttpRequestParser parser;
+        QByteArray buffer = request.left(split);
+        CHECK(parser.parse(buffer) == HttpRequestParser::Status::Incomplete);
+        buffer += request.mid(split);
+        CHECK(parser.parse(buffer) == HttpRequestParser::Status::Complete);
+        CHECK(parser.headLength() == request.size());
+    }
+    {
+        HttpRequestParser parser;
+        QByteArray buffer;
+        for (qsizetype i = 0; i < request.size(); ++i) {
+            buffer += request.at(i);
+            const HttpRequestParser::Status status = parser.parse(buffer);
+            CHECK(status == (i + 1 == request.size() ? HttpRequestParser::Status::Complete
+                                                     : HttpRequestParser::Status::Incomplete));
+        }
+        CHECK(parser.target() == "http://example.com/path?x=1");
+    }
+
+    // The terminator at every offset, so it straddles each 16-byte block edge
+    for (int offset = 0; offset < 48; ++offset) {
+        const QByteArray data = QByteArray(offset, 'a') + "\r\n\r\n" + QByteArray(20, 'b');
+        for (int from = 0; from <= offset + 3; ++from)
+            CHECK(HttpRequestParser::findHeadEnd(data.constData(), data.size(), from) == offset + 4);
+        const QByteArray bare = QByteArray(offset, 'a') + "\r\n\n\r\n" + QByteArray(20, 'b');
+        CHECK(HttpRequestParser::findHeadEnd(bare.constData(), bare.size(), 0) == -1);
+        const QByteArray lfOnly = QByteArray(offset, 'a') + "\n\n\r\n" + QByteArray(20, 'b');
+        CHECK(HttpRequestParser::findHeadEnd(lfOnly.constData(), lfOnly.size(), 0) == -1);
+    }
+
+    // Body framing, including the headers that must be refused
+    auto framing = [](const QByteArray &headers, qint64 *length) {
+        QByteArray buffer = "POST / HTTP/1.1\r\nHost: host\r\n" + headers + "\r\n";
+        HttpRequestParser parser;
+        parser.parse(buffer);
+        return parser.bodyFraming(length);
+    };
+    qint64 length = -1;
+    CHECK(framing("", &length) == HttpBodyFramer::Mode::None);
+    CHECK(framing("Content-Length: 0\r\n", &length) == HttpBodyFramer::Mode::None);
+    CHECK(framing("Content-Length: 42\r\n", &length) == HttpBodyFramer::Mode::Length && length == 42);
+    CHECK(framing("Content-Length: 5, 5\r\n", &length) == HttpBodyFramer::Mode::Invalid);
+    CHECK(framing("Content-Length: -1\r\n", &length) == HttpBodyFramer::Mode::Invalid);
+    CHECK(framing("Content-Length: 1x\r\n", &length) == HttpBodyFramer::Mode::Invalid);
+    CHECK(framing("Transfer-Encoding: chunked\r\n", &length) == HttpBodyFramer::Mode::Chunked);
+    CHECK(framing("Transfer-Encoding: gzip, Chunked\r\n", &length) == HttpBodyFramer::Mode::Chunked);
+    CHECK(framing("Transfer-Encoding: chunked, gzip\r\n", &length) == HttpBodyFramer::Mode::Invalid);
+    CHECK(framing("Transfer-Encoding: chunked\r\nContent-Length: 3\r\n", &length) == HttpBodyFramer::Mode::Chunked);
+
+    LOG(QString("HttpRequestParser: %1").arg(g_failures == failuresBefore ? "PASSED" : "FAILED"));
+}
+
+static void testRoutingRules() {
+    LOG("--- RoutingRules ---");
+    const int failuresBefore = g_failures;
+    using Action = RoutingRules::Action;
+
+    QStringList errors;
+    const auto rules = RoutingRules::compile(QStringLiteral(
+        "# comment\n"
+        "DOMAIN,exact.example.com,DIRECT\n"
+        "DOMAIN-SUFFIX,example.ir,DIRECT\n"
+        "DOMAIN-SUFFIX,ads.example.ir,REJECT\n"
+        "DOMAIN-KEYWORD,tracker,REJECT\n"
+        "IP-CIDR,192.168.0.0/16,DIRECT\n"
+        "IP-CIDR,10.1.0.0/16,REJECT\n"
+        "IP-CIDR,10.0.0.0/8,DIRECT,no-resolve\n"
+        "IP-CIDR6,fc00::/7,DIRECT\n"
+        "DST-PORT,6881-6889,REJECT\n"
+        "BOGUS,line,DIRECT\n"
+        "DOMAIN,bad.action.com,SOMETIMES\n"
+        "MATCH,TUNNEL\n"), &errors);
+    CHECK(rules);
+    if (!rules)
+        return;
+    CHECK(errors.size() == 2);
+    CHECK(rules->ruleCount() == 9);
+    CHECK(rules->defaultAction() == Action::Tunnel);
+
+    // DOMAIN is the name only, DOMAIN-SUFFIX the name and below; no case, no trailing dot
+    CHECK(rules->match(u"exact.example.com", 443) == Action::Direct);
+    CHECK(rules->match(u"EXACT.Example.COM.", 443) == Action::Direct);
+    CHECK(rules->match(u"sub.exact.example.com", 443) == Action::Tunnel);
+    CHECK(rules->match(u"example.com", 443) == Action::Tunnel);
+    CHECK(rules->match(u"example.ir", 443) == Action::Direct);
+    CHECK(rules->match(u"www.example.ir", 443) == Action::Direct);
+    CHECK(rules->match(u"notexample.ir", 443) == Action::Tunnel);
+    CHECK(rules->match(u"bad.action.com", 443) == Action::Tunnel);
+    // First match wins, not the most specific one
+    CHECK(rules->match(u"ads.example.ir", 443) == Action::Direct);
+    CHECK(rules->match(u"cdn.tracker.net", 443) == Action::Reject);
+    CHECK(rules->match(u"MyTracker.com", 443) == Action::Reject);
+
+    // Address literals, IPv4-mapped IPv6 against the IPv4 rules
+    CHECK(rules->match(u"192.168.1.1", 80) == Action::Direct);
+    CHECK(rules->match(u"10.1.2.3", 80) == Action::Reject);
+    CHECK(rules->match(u"10.2.3.4", 80) == Action::Direct);
+    CHECK(rules->match(u"11.0.0.1", 80) == Action::Tunnel);
+    CHECK(rules->match(u"::ffff:192.168.1.1", 80) == Action::Direct);
+    CHECK(rules->match(u"fd00::1", 80) == Action::Direct);
+    CHECK(rules->match(u"2001:db8::1", 80) == Action::Tunnel);
+
+    // Port ranges
+    CHECK(rules->match(u"example.com", 6881) == Action::Reject);
+    CHECK(rules->match(u"example.com", 6889) == Action::Reject);
+    CHECK(rules->match(u"example.com", 6890) == Action::Tunnel);
+
+    // Rule order across kinds, and MATCH
+    const auto ordered = RoutingRules::compile(QStringLiteral(
+        "DST-PORT,25,REJECT\n"
+        "DOMAIN-SUFFIX,example.com,TUNNEL\n"
+        "MATCH,DIRECT\n"));
+    CHECK(ordered && ordered->defaultAction() == Action::Direct);
+    if (ordered) {
+        CHECK(ordered->match(u"mail.example.com", 25) == Action::Reject);
+        CHECK(ordered->match(u"mail.example.com", 587) == Action::Tunnel);
+        CHECK(ordered->match(u"other.org", 443) == Action::Direct);
+    }
+
+    LOG(QString("RoutingRules: %1").arg(g_failures == failuresBefore ? "PASSED" : "FAILED"));
+}
+
+static bool writeFile(const QString &path, const QByteArray &content) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(content) == content.size();
+}
+
+static void testDomainBlocklist() {
+    LOG("--- DomainBlocklist ---");
+    const int failuresBefore = g_failures;
+
+    QTemporaryDir dir;
+    CHECK(dir.isValid());
+    const QString plain = dir.filePath(QStringLiteral("plain.txt"));
+    const QString formats = dir.filePath(QStringLiteral("formats.txt"));
+    const QString compiled = dir.filePath(QStringLiteral("blocklist.bin"));
+
+    // Enough entries for many front-coded blocks
+    QByteArray many;
+    for (int i = 0; i < 1000; ++i)
+        many += "d" + QByteArray::number(i) + ".example.org\n";
+    CHECK(writeFile(plain, many));
+    CHECK(writeFile(formats,
+                    "# comment\n"
+                    "! adblock comment\n"
+                    "Mixed.Case.COM\n"
+                    "0.0.0.0 hosts-sink.net\n"
+                    "127.0.0.1 loopback-sink.net # trailing comment\n"
+                    "192.168.0.1 not-a-sink.net\n"
+                    "||adblock.net^$third-party\n"
+                    "*.wild.com\n"
+                    "localhost\n"
+                    "bad_char!.com\n"
+                    "d7.example.org\n"));
+
+    const QStringList sources{plain, formats};
+    const quint64 stamp = DomainBlocklist::sourceStamp(sources);
+    CHECK(stamp != 0);
+    QString error;
+    int entries = 0;
+    CHECK(DomainBlocklist::build(sources, compiled, stamp, &error, &entries));
+    CHECK(entries == 1000 + 5);   // duplicates merged, junk skipped
+
+    CHECK(!DomainBlocklist::open(compiled, stamp + 2));   // stale
+    const auto list = DomainBlocklist::open(compiled, stamp, &error);
+    CHECK(list);
+    if (!list)
+        return;
+    CHECK(list->count() == entries);
+
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(list->contains(QString("d%1.example.org").arg(i)));
+        CHECK(!list->contains(QString("x%1.example.org").arg(i)));
+    }
+    // An entry covers its subdomains, not its parents or look-alikes
+    CHECK(list->contains(u"deep.sub.d42.example.org"));
+    CHECK(!list->contains(u"example.org"));
+    CHECK(!list->contains(u"d42.example.org.evil.com"));
+    CHECK(!list->contains(u"xd42.example.org"));
+    CHECK(list->contains(u"D42.Example.ORG."));
+
+    CHECK(list->contains(u"mixed.case.com"));
+    CHECK(list->contains(u"hosts-sink.net"));
+    CHECK(list->contains(u"loopback-sink.net"));
+    CHECK(!list->contains(u"not-a-sink.net"));
+    CHECK(list->contains(u"cdn.adblock.net"));
+    CHECK(list->contains(u"wild.com"));
+    CHECK(list->contains(u"a.wild.com"));
+    CHECK(!list->contains(u"localhost"));
+    CHECK(!list->contains(u""));
+
+    // Anything but a file written by build() is refused
+    const QString garbage = dir.filePath(QStringLiteral("garbage.bin"));
+    CHECK(writeFile(garbage, QByteArray(4096, 'z')));
+    CHECK(!DomainBlocklist::open(garbage));
+    CHECK(!DomainBlocklist::open(dir.filePath(QStringLiteral("missing.bin"))));
+
+    LOG(QString("DomainBlocklist: %1").arg(g_failures == failuresBefore ? "PASSED" : "FAILED"));
+}
+
+static void testCidrAllowList() {
+    LOG("--- CidrAllowList ---");
+    const int failuresBefore = g_failures;
+    auto allows = [](const std::shared_ptr<const CidrAllowList> &list, const char *address) {
+        return list->allows(QHostAddress(QString::fromLatin1(address)));
+    };
+
+    QStringList errors;
+    const auto list = CidrAllowList::compile({
+        QStringLiteral("10.0.0.0/8"),
+        QStringLiteral("10.1.0.0/16"),       // nested, merged away
+        QStringLiteral("192.168.1.0/24"),
+        QStringLiteral(" 192.168.2.0/24 "),
+        QStringLiteral("203.0.113.7"),       // bare address: one host
+        QStringLiteral("2001:db8::/32"),
+        QStringLiteral("2001:db8::1"),
+        QStringLiteral("fe80::1"),
+        QStringLiteral("# comment"),
+        QStringLiteral(""),
+        QStringLiteral("garbage"),
+        QStringLiteral("300.1.1.1/8"),
+    }, &errors);
+    CHECK(errors.size() == 2);
+    CHECK(list->rangeCount() == 6);
+
+    CHECK(allows(list, "10.0.0.0"));
+    CHECK(allows(list, "10.255.255.255"));
+    CHECK(!allows(list, "9.255.255.255"));
+    CHECK(!allows(list, "11.0.0.0"));
+    CHECK(allows(list, "192.168.1.77"));
+    CHECK(allows(list, "192.168.2.1"));
+    CHECK(!allows(list, "192.168.3.1"));
+    CHECK(allows(list, "203.0.113.7"));
+    CHECK(!allows(list, "203.0.113.6"));
+    CHECK(!allows(list, "203.0.113.8"));
+    CHECK(allows(list, "2001:db8:ffff::1"));
+    CHECK(!allows(list, "2001:db9::1"));
+    CHECK(allows(list, "fe80::1"));
+    CHECK(!allows(list, "fe80::2"));
+    CHECK(!list->allows(QHostAddress()));
+
+    // IPv4-mapped IPv6 peers (dual-stack listeners) use the IPv4 ranges
+    CHECK(allows(list, "::ffff:10.1.2.3"));
+    CHECK(allows(list, "::ffff:203.0.113.7"));
+    CHECK(!allows(list, "::ffff:11.0.0.1"));
+    const quint8 mapped[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 192, 168, 1, 1};
+    CHECK(list->allows(mapped, 16));
+    CHECK(!list->allows(mapped, 5));
+
+    const auto lan = CidrAllowList::compile(CidrAllowList::privateNetworks());
+    CHECK(allows(lan, "127.0.0.1"));
+    CHECK(allows(lan, "172.31.255.255"));
+    CHECK(!allows(lan, "172.32.0.0"));
+    CHECK(allows(lan, "100.64.0.1"));
+    CHECK(!allows(lan, "8.8.8.8"));
+    CHECK(allows(lan, "::1"));
+    CHECK(allows(lan, "fd12::1"));
+    CHECK(!allows(lan, "2001:4860::8888"));
+    CHECK(allows(lan, "::ffff:192.168.0.10"));
+
+    const auto anyV4 = CidrAllowList::compile({QStringLiteral("0.0.0.0/0")});
+    CHECK(allows(anyV4, "255.255.255.255"));
+    CHECK(allows(anyV4, "::ffff:1.2.3.4"));
+    CHECK(!allows(anyV4, "2001::1"));
+    CHECK(!allows(CidrAllowList::compile({}), "127.0.0.1"));
+
+    LOG(QString("CidrAllowList: %1").arg(g_failures == failuresBefore ? "PASSED" : "FAILED"));
+}
+
+/** A parsed "HTTP/1.1 <status>" response head with @p headers */
+static HttpHeadInfo responseHead(const QByteArray &headers, int status = 200) {
+    HttpHeadInfo info;
+    HttpHeadInfo::parseResponse("HTTP/1.1 " + QByteArray::number(status) + " X\r\n" + headers + "\r\n", &info);
+    return info;
+}
+
+static void testHttpCache() {
+    LOG("--- HttpCache ---");
+    const int failuresBefore = g_failures;
+
+    // HTTP-date in all three forms of RFC 9110, and values that are not one
+    const qint64 date = 784111777000;   // Sun, 06 Nov 1994 08:49:37 GMT
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT") == date);
+    CHECK(HttpCache::parseHttpDate(" Sun, 06 Nov 1994 08:49:37 GMT ") == date);
+    CHECK(HttpCache::parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT") == date);
+    CHECK(HttpCache::parseHttpDate("Sun Nov  6 08:49:37 1994") == date);
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 08:49:37 +0000") == date);
+    CHECK(HttpCache::parseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT") == 0);
+    CHECK(HttpCache::parseHttpDate("Tue, 29 Feb 2000 23:59:59 GMT") == 951868799000);
+    CHECK(HttpCache::parseHttpDate("0") == -1);
+    CHECK(HttpCache::parseHttpDate("") == -1);
+    CHECK(HttpCache::parseHttpDate("garbage") == -1);
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 08:49:37") == -1);
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 08:49:37 CET") == -1);
+    CHECK(HttpCache::parseHttpDate("Fri, 30 Feb 2001 08:49:37 GMT") == -1);
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 24:00:00 GMT") == -1);
+    CHECK(HttpCache::parseHttpDate("Sun, 06 Nov 1994 08:49 GMT") == -1);
+
+    // Freshness: s-maxage over max-age over Expires, Age taken off
+    const qint64 now = date + 5000;   // received five seconds after Date
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: max-age=60, s-maxage=600\r\n"), now) == now + 600000);
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: s-maxage=0\r\nCache-Control: max-age=60\r\n"), now) == now);
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: max-age=60\r\n"
+                                             "Expires: Sun, 06 Nov 1994 09:49:37 GMT\r\n"), now) == now + 60000);
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: max-age=60\r\nAge: 10\r\n"), now) == now + 50000);
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: max-age=\"120\"\r\n"), now) == now + 120000);
+    CHECK(HttpCache::freshUntil(responseHead("Cache-Control: no-cache, max-age=60\r\n"), now) == now);
+
+    // Expires counts from Date when there is one, from receipt otherwise
+    CHECK(HttpCache::freshUntil(responseHead("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                             "Expires: Sun, 06 Nov 1994 09:49:37 GMT\r\n"), now) == now + 3600000);
+    CHECK(HttpCache::freshUntil(responseHead("Expires: Sun, 06 Nov 1994 08:50:37 GMT\r\n"), date) == date + 60000);
+    CHECK(HttpCache::freshUntil(responseHead("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                             "Expires: Sun, 06 Nov 1994 07:49:37 GMT\r\n"), now) == now);
+    // An invalid Expires means already expired, not "no Expires"
+    CHECK(HttpCache::freshUntil(responseHead("Expires: 0\r\n"
+                                             "Last-Modified: Sat, 05 Nov 1994 08:49:37 GMT\r\n"), now) == now);
+
+    // Heuristic: a tenth of the time since Last-Modified, at most a day
+    CHECK(HttpCache::freshUntil(responseHead("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                             "Last-Modified: Sun, 06 Nov 1994 03:49:37 GMT\r\n"), now) == now + 1800000);
+    CHECK(HttpCache::freshUntil(responseHead("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                             "Last-Modified: Sun, 06 Nov 1983 08:49:37 GMT\r\n"), now) == now + 86400000);
+    CHECK(HttpCache::freshUntil(responseHead(""), now) == now);
+
+    // What a shared cache may store
+    CHECK(HttpCache::isStorable(responseHead("Cache-Control: public, max-age=60\r\n")));
+    CHECK(HttpCache::isStorable(responseHead("Vary: Accept-Encoding\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Cache-Control: no-store\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Cache-Control: max-age=60, No-Store\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Cache-Control: private, max-age=60\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Cache-Control: private=\"Set-Cookie\"\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Set-Cookie: id=1\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Vary: Accept-Encoding, User-Agent\r\n")));
+    CHECK(!HttpCache::isStorable(responseHead("Cache-Control: max-age=60\r\n", 206)));
+
+    LOG(QString("HttpCache: %1").arg(g_failures == failuresBefore ? "PASSED" : "FAILED"));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    LOG("=== HTTP-to-SOCKS unit checks ===");
+
+    testRequestParser();
+    testRoutingRules();
+    testDomainBlocklist();
+    testCidrAllowList();
+    testHttpCache();
+
+    LOG(g_failures == 0 ? "=== ALL CHECKS PASSED ===" : QString("=== %1 CHECK(S) FAILED ===").arg(g_failures));
+    return g_failures == 0 ? 0 : 1;
+}